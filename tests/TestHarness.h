@@ -0,0 +1,28 @@
+// TestHarness.h
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Checks shared by the core tests: expect() reports a failed check and
+// carries on, and finish() prints the test's OK line when every check
+// passed and gives main() its exit status.
+namespace tinysynth::test {
+
+inline int failures = 0;
+
+inline void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+inline int finish(const char* okMessage) {
+    if (failures == 0) {
+        std::printf("%s\n", okMessage);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace tinysynth::test
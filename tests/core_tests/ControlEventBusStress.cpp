@@ -0,0 +1,200 @@
+// ControlEventBusStress.cpp
+//
+// Several control sources push timestamped SetParameter events at a
+// combined rate while the dummy driver renders in real time. Every event
+// must be applied exactly once, each source's events in order, and the
+// audio thread must keep its deadlines, and in a TINYSYNTH_RT_SANITIZER
+// build commit no realtime violations.
+//
+//   control_event_bus_stress [--producers N] [--rate EVENTS_PER_SECOND]
+//                            [--seconds S] [--max-xrun-ratio R]
+
+#include "core/DummyBackend.h"
+#include "core/GraphProcessor.h"
+#include "core/RealtimeSanitizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tinysynth;
+
+namespace {
+
+struct Options {
+    unsigned int producers = 3;
+    double rate = 100000.0;
+    double seconds = 1.0;
+    double maxXrunRatio = 0.05;
+};
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        const char* value = argv[i + 1];
+        if (arg == "--producers") {
+            options.producers = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--rate") {
+            options.rate = std::strtod(value, nullptr);
+        } else if (arg == "--seconds") {
+            options.seconds = std::strtod(value, nullptr);
+        } else if (arg == "--max-xrun-ratio") {
+            options.maxXrunRatio = std::strtod(value, nullptr);
+        } else {
+            return false;
+        }
+    }
+    return argc % 2 == 1 && options.producers > 0 &&
+           options.producers < ControlEventBus::MAX_PRODUCERS && options.rate > 0.0;
+}
+
+// Silent node that checks the events it receives. Parameter "pN" carries
+// producer N's event number, which must arrive as 1, 2, 3, ...
+class ProbeModule : public Module<float> {
+public:
+    explicit ProbeModule(unsigned int producers) : m_expected(producers, 1) {}
+
+    void process(const std::vector<std::optional<float*>>& /*inputs*/,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        std::fill(outputs[0], outputs[0] + numFrames, 0.0F);
+    }
+
+    void setParameter(const std::string& name, float value) override {
+        const auto producer = static_cast<std::size_t>(std::strtoul(name.c_str() + 1, nullptr, 10));
+        const auto number = static_cast<std::uint64_t>(value);
+        if (number != m_expected[producer]) {
+            ++m_outOfOrder;
+        }
+        m_expected[producer] = number + 1;
+        m_received.fetch_add(1, std::memory_order_release);
+    }
+
+    [[nodiscard]] unsigned int getNumInputs() const override { return 0; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return 1; }
+    [[nodiscard]] std::string getInputName(unsigned int /*index*/) const override { return ""; }
+    [[nodiscard]] std::string getOutputName(unsigned int /*index*/) const override {
+        return "out";
+    }
+    [[nodiscard]] float getParameter(const std::string& /*name*/) const override { return 0.0F; }
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override { return {}; }
+    [[nodiscard]] std::string getName() const override { return "Probe"; }
+    [[nodiscard]] std::string getDescription() const override { return "Event order probe"; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override { return nullptr; }
+    void reset() override {}
+
+    [[nodiscard]] std::uint64_t getReceived() const {
+        return m_received.load(std::memory_order_acquire);
+    }
+    [[nodiscard]] std::uint64_t getOutOfOrder() const { return m_outOfOrder; }
+
+private:
+    std::vector<std::uint64_t> m_expected;
+    std::atomic<std::uint64_t> m_received{0};
+    std::uint64_t m_outOfOrder = 0;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "usage: control_event_bus_stress [--producers N] [--rate EPS] "
+                             "[--seconds S] [--max-xrun-ratio R]\n");
+        return 2;
+    }
+
+    constexpr unsigned int SAMPLE_RATE = 48000;
+    constexpr unsigned int BLOCK = 64;
+    GraphProcessor graph(0, 1);
+    auto probe = std::make_unique<ProbeModule>(options.producers);
+    ProbeModule* probePointer = probe.get();
+    graph.getSystem().addModule("probe", std::move(probe));
+    graph.connectOutput("probe", 0, 0);
+
+    // Events are stamped one block ahead so they land inside a block
+    std::vector<ControlEventBus::Producer*> producers;
+    for (unsigned int p = 0; p < options.producers; ++p) {
+        producers.push_back(&graph.addControlSource("source" + std::to_string(p), false));
+    }
+
+    DummyBackend::Config config;
+    config.sampleRate = SAMPLE_RATE;
+    config.blockSize = BLOCK;
+    config.numOutputs = 1;
+    DummyBackend backend(config);
+    RealtimeSanitizer::startReporter();
+    backend.start(graph);
+
+    const double perProducer = options.rate / options.producers;
+    const auto total = static_cast<std::uint64_t>(perProducer * options.seconds);
+    std::vector<std::uint64_t> retries(options.producers, 0);
+    std::vector<std::thread> threads;
+    for (unsigned int p = 0; p < options.producers; ++p) {
+        threads.emplace_back([&, p] {
+            const std::string parameter = "p" + std::to_string(p);
+            const auto start = std::chrono::steady_clock::now();
+            for (std::uint64_t n = 1; n <= total; ++n) {
+                // Paced to the requested rate
+                const auto due = start + std::chrono::duration<double>(
+                                             static_cast<double>(n) / perProducer);
+                std::this_thread::sleep_until(due);
+                EngineCommand command = EngineCommand::setParameter(
+                    "probe", parameter, static_cast<float>(n));
+                while (!producers[p]->push(graph.getFrameTime() + BLOCK, command)) {
+                    ++retries[p];
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Let the driver apply what was pushed last
+    const std::uint64_t expected = total * options.producers;
+    const auto drainDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (probePointer->getReceived() < expected &&
+           std::chrono::steady_clock::now() < drainDeadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    backend.stop();
+    RealtimeSanitizer::stopReporter();
+    const std::uint64_t violations = RealtimeSanitizer::getViolationCount();
+
+    const DummyBackendStats& stats = backend.getStats();
+    std::uint64_t replies = 0;
+    std::uint64_t totalRetries = 0;
+    for (unsigned int p = 0; p < options.producers; ++p) {
+        replies += producers[p]->collectReplies();
+        totalRetries += retries[p];
+    }
+    const double xrunRatio =
+        stats.cycles > 0 ? static_cast<double>(stats.xruns) / static_cast<double>(stats.cycles)
+                         : 1.0;
+    const bool passed = probePointer->getReceived() == expected &&
+                        probePointer->getOutOfOrder() == 0 && replies == 0 &&
+                        xrunRatio <= options.maxXrunRatio && violations == 0;
+    std::printf("%u producers, %.0f events/s for %.1f s, %s\n", options.producers, options.rate,
+                options.seconds,
+                stats.realtimeScheduling ? "SCHED_FIFO" : "no realtime scheduling");
+    std::printf("events: %llu pushed, %llu applied, %llu out of order, %llu full-ring retries, "
+                "%llu rejected\n",
+                static_cast<unsigned long long>(expected),
+                static_cast<unsigned long long>(probePointer->getReceived()),
+                static_cast<unsigned long long>(probePointer->getOutOfOrder()),
+                static_cast<unsigned long long>(totalRetries),
+                static_cast<unsigned long long>(replies));
+    std::printf("render us: mean %.2f  max %.2f, %llu cycles, %llu xruns%s\n",
+                stats.meanRenderTime / 1e3, static_cast<double>(stats.maxRenderTime) / 1e3,
+                static_cast<unsigned long long>(stats.cycles),
+                static_cast<unsigned long long>(stats.xruns), passed ? "" : "  FAILED");
+    if (RealtimeSanitizer::isEnabled()) {
+        std::printf("%llu realtime violations\n", static_cast<unsigned long long>(violations));
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+// DenormalTails.cpp
+//
+// Checks that long decay tails never reach the denormal slow path. A JIT
+// compiled chain of one-pole feedback filters is excited by an impulse and
+// left to ring for several seconds, with and without ScopedDenormalGuard
+// and with and without fast math. Unguarded, the tail must pass through
+// denormals (otherwise the test proves nothing); guarded, no output sample
+// and no filter state may ever be denormal. ModularSystem::process must
+// install the guard by itself. Timings are printed for reference only.
+//
+//   denormal_tails [--seconds S]
+
+#include "core/DenormalGuard.h"
+#include "core/ModularSystem.h"
+#include "core/NodeStatePool.h"
+#include "core/SynthDefJIT.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace tinysynth;
+
+namespace {
+
+constexpr unsigned int BLOCK = 64;
+constexpr float SAMPLE_RATE = 48000.0F;
+
+struct TailResult {
+    unsigned long denormalSamples = 0;
+    unsigned long denormalStates = 0;
+    double seconds = 0.0;
+};
+
+bool isDenormal(float value) { return std::fpclassify(value) == FP_SUBNORMAL; }
+
+// In -> OnePole -> OnePole -> Out: a slow tail that decays well past
+// FLT_MIN within a few seconds
+SynthDef decayChain() {
+    SynthDef def;
+    def.setName("decay");
+    def.addUGen({"In", "in", {{"bus", 0}}});
+    def.addUGen({"OnePole", "lp1", {{"coef", 0.99F}}});
+    def.addUGen({"OnePole", "lp2", {{"coef", 0.995F}}});
+    def.addUGen({"Out", "out", {{"bus", 0}}});
+    def.addConnection({"in", 0, "lp1", 0});
+    def.addConnection({"lp1", 0, "lp2", 0});
+    def.addConnection({"lp2", 0, "out", 0});
+    return def;
+}
+
+TailResult renderTail(const CompiledSynthDef& def, unsigned long frames) {
+    NodeStatePool pool(def.layout, 1);
+    SynthNode node{&def, pool.acquire()};
+    std::vector<float> in(BLOCK, 0.0F);
+    std::vector<float> out(BLOCK);
+    const float* inputs[] = {in.data()};
+    float* outputs[] = {out.data()};
+    const auto* state = static_cast<const float*>(node.state);
+    const std::size_t numFields = def.layout.fields().size();
+
+    TailResult result;
+    in[0] = 1.0F;
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned long done = 0; done < frames; done += BLOCK) {
+        std::fill(out.begin(), out.end(), 0.0F);
+        node.process(inputs, outputs, BLOCK, SAMPLE_RATE);
+        in[0] = 0.0F;
+        for (float sample : out) {
+            result.denormalSamples += isDenormal(sample) ? 1 : 0;
+        }
+        for (std::size_t field = 0; field < numFields; ++field) {
+            result.denormalStates += isDenormal(state[field]) ? 1 : 0;
+        }
+    }
+    result.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pool.release(node.state);
+    return result;
+}
+
+// Records whether denormals were flushed while the system processed it
+class GuardProbe : public Module<float> {
+public:
+    bool flushed = false;
+
+    void process(const std::vector<std::optional<float*>>& /*inputs*/,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        flushed = ScopedDenormalGuard::isActive();
+        std::fill(outputs[0], outputs[0] + numFrames, 0.0F);
+    }
+    [[nodiscard]] unsigned int getNumInputs() const override { return 0; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return 1; }
+    [[nodiscard]] std::string getInputName(unsigned int /*index*/) const override { return ""; }
+    [[nodiscard]] std::string getOutputName(unsigned int /*index*/) const override {
+        return "out";
+    }
+    void setParameter(const std::string& /*name*/, float /*value*/) override {}
+    [[nodiscard]] float getParameter(const std::string& /*name*/) const override { return 0; }
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override { return {}; }
+    [[nodiscard]] std::string getName() const override { return "probe"; }
+    [[nodiscard]] std::string getDescription() const override { return "probe"; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override { return nullptr; }
+    void reset() override {}
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double seconds = 10.0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = std::strtod(argv[++i], nullptr);
+        } else {
+            std::fprintf(stderr, "usage: denormal_tails [--seconds S]\n");
+            return 2;
+        }
+    }
+    if (!ScopedDenormalGuard::isSupported()) {
+        std::printf("denormal flushing is not supported on this target; skipped\n");
+        return 0;
+    }
+
+    const auto frames = static_cast<unsigned long>(seconds * SAMPLE_RATE);
+    unsigned int failures = 0;
+    for (bool fastMath : {false, true}) {
+        SynthDefJIT jit(SynthDefJITOptions{.fastMath = fastMath});
+        const auto def = jit.compile(decayChain());
+
+        const TailResult unguarded = renderTail(*def, frames);
+        TailResult guarded;
+        {
+            ScopedDenormalGuard denormalGuard;
+            guarded = renderTail(*def, frames);
+        }
+
+        const bool pass = unguarded.denormalSamples > 0 && guarded.denormalSamples == 0 &&
+                          guarded.denormalStates == 0;
+        failures += pass ? 0 : 1;
+        std::printf("%-9s unguarded: %lu denormal samples, %lu states, %.2f ns/sample\n"
+                    "%-9s guarded:   %lu denormal samples, %lu states, %.2f ns/sample%s\n",
+                    fastMath ? "fast-math" : "ieee", unguarded.denormalSamples,
+                    unguarded.denormalStates, unguarded.seconds * 1e9 / frames, "",
+                    guarded.denormalSamples, guarded.denormalStates,
+                    guarded.seconds * 1e9 / frames, pass ? "" : "  FAILED");
+    }
+
+    ModularSystem<float> system;
+    auto probe = std::make_unique<GuardProbe>();
+    GuardProbe* probePointer = probe.get();
+    system.addModule("probe", std::move(probe));
+    system.process(BLOCK);
+    if (!probePointer->flushed || ScopedDenormalGuard::isActive()) {
+        std::printf("ModularSystem::process does not scope the denormal guard  FAILED\n");
+        ++failures;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
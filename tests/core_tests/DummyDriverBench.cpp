@@ -0,0 +1,153 @@
+// DummyDriverBench.cpp
+//
+// Realtime regression test on the dummy driver: a GraphProcessor with N
+// oscillator voices runs for a number of simulated periods on the same
+// code path JACK would use, and per-cycle render times are compared with
+// the period deadline. Fails when fewer cycles ran than asked or the xrun
+// ratio exceeds --max-xrun-ratio. The ratio depends on the machine: the
+// default ctest run passes --max-xrun-ratio 1 and only checks that the
+// driver ran; the deadline check is the benchmark-labelled test.
+// With --pipelined 1 the graph renders a period ahead on a worker thread
+// (PipelinedProcessor) and the worker's late cycles count as xruns too.
+// In a TINYSYNTH_RT_SANITIZER build any realtime violation also fails it.
+//
+//   dummy_driver_bench [--voices N] [--cycles N] [--block N] [--rate SR]
+//                      [--max-xrun-ratio R] [--pipelined 0|1]
+
+#include "core/DummyBackend.h"
+#include "core/GraphProcessor.h"
+#include "core/PipelinedProcessor.h"
+#include "core/RealtimeSanitizer.h"
+#include "modules/Oscillator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace tinysynth;
+
+namespace {
+
+struct Options {
+    unsigned int voices = 32;
+    std::uint64_t cycles = 3000;
+    unsigned int block = 64;
+    unsigned int sampleRate = 48000;
+    double maxXrunRatio = 0.05;
+    bool pipelined = false;
+};
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string arg = argv[i];
+        const char* value = argv[i + 1];
+        if (arg == "--voices") {
+            options.voices = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--cycles") {
+            options.cycles = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--block") {
+            options.block = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--rate") {
+            options.sampleRate = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--max-xrun-ratio") {
+            options.maxXrunRatio = std::strtod(value, nullptr);
+        } else if (arg == "--pipelined") {
+            options.pipelined = std::strtoul(value, nullptr, 10) != 0;
+        } else {
+            return false;
+        }
+    }
+    return argc % 2 == 1 && options.block > 0 && options.sampleRate > 0;
+}
+
+double percentile(std::vector<std::int64_t> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    const auto index = static_cast<std::size_t>(fraction * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index),
+                     values.end());
+    return static_cast<double>(values[index]);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "usage: dummy_driver_bench [--voices N] [--cycles N] [--block N] "
+                             "[--rate SR] [--max-xrun-ratio R] [--pipelined 0|1]\n");
+        return 2;
+    }
+
+    GraphProcessor graph(0, 2);
+    for (unsigned int v = 0; v < options.voices; ++v) {
+        const std::string name = "voice" + std::to_string(v);
+        auto oscillator = std::make_unique<SineOsc<float>>();
+        oscillator->setFrequency(110.0F * static_cast<float>(v + 1));
+        oscillator->setAmplitude(1.0F / static_cast<float>(options.voices));
+        graph.getSystem().addModule(name, std::move(oscillator));
+        graph.connectOutput(name, 0, v % 2);
+    }
+
+    DummyBackend::Config config;
+    config.sampleRate = options.sampleRate;
+    config.blockSize = options.block;
+    config.numCycles = options.cycles;
+    config.recordedCycles = options.cycles;
+    DummyBackend backend(config);
+    RealtimeSanitizer::startReporter();
+    PipelinedProcessor pipeline(graph, graph.getNumInputs(), graph.getNumOutputs(), {});
+    if (options.pipelined) {
+        backend.start(pipeline);
+    } else {
+        backend.start(graph);
+    }
+    backend.wait();
+    RealtimeSanitizer::stopReporter();
+    const std::uint64_t violations = RealtimeSanitizer::getViolationCount();
+
+    const DummyBackendStats& stats = backend.getStats();
+    const std::uint64_t lateCycles = options.pipelined ? pipeline.getLateCycles() : 0;
+    std::vector<std::int64_t> render;
+    std::vector<std::int64_t> wakeup;
+    for (const auto& cycle : backend.getCycles()) {
+        render.push_back(cycle.renderTime);
+        wakeup.push_back(cycle.wakeupLatency);
+    }
+    const double periodUs = 1e6 * options.block / options.sampleRate;
+    const double xrunRatio =
+        stats.cycles > 0
+            ? static_cast<double>(stats.xruns + lateCycles) / static_cast<double>(stats.cycles)
+            : 1.0;
+    std::printf("%u voices, %u frames at %u Hz (period %.1f us), %s%s\n", options.voices,
+                options.block, options.sampleRate, periodUs,
+                stats.realtimeScheduling ? "SCHED_FIFO" : "no realtime scheduling",
+                options.pipelined ? ", pipelined" : "");
+    std::printf("render  us: mean %.2f  p50 %.2f  p99 %.2f  max %.2f\n",
+                stats.meanRenderTime / 1e3, percentile(render, 0.5) / 1e3,
+                percentile(render, 0.99) / 1e3, static_cast<double>(stats.maxRenderTime) / 1e3);
+    std::printf("wakeup  us: p50 %.2f  p99 %.2f  max %.2f\n", percentile(wakeup, 0.5) / 1e3,
+                percentile(wakeup, 0.99) / 1e3,
+                static_cast<double>(stats.maxWakeupLatency) / 1e3);
+    std::printf("%llu cycles, %llu xruns + %llu late pipeline cycles (%.2f%%), "
+                "%llu periods skipped%s\n",
+                static_cast<unsigned long long>(stats.cycles),
+                static_cast<unsigned long long>(stats.xruns),
+                static_cast<unsigned long long>(lateCycles), 100.0 * xrunRatio,
+                static_cast<unsigned long long>(stats.skippedCycles),
+                xrunRatio > options.maxXrunRatio ? "  FAILED" : "");
+    const bool allCycles = stats.cycles == options.cycles;
+    if (!allCycles) {
+        std::printf("only %llu of %llu cycles ran  FAILED\n",
+                    static_cast<unsigned long long>(stats.cycles),
+                    static_cast<unsigned long long>(options.cycles));
+    }
+    if (RealtimeSanitizer::isEnabled()) {
+        std::printf("%llu realtime violations%s\n", static_cast<unsigned long long>(violations),
+                    violations > 0 ? "  FAILED" : "");
+    }
+    return xrunRatio > options.maxXrunRatio || violations > 0 || !allCycles ? 1 : 0;
+}
@@ -0,0 +1,300 @@
+// EmbeddedEngine.cpp
+//
+// The C ABI of the tinysynth_engine shared library, used the way a host
+// FFI uses it: SynthDef and module nodes, controls looked up once and sent
+// in batches on exact frames, frees, planar and interleaved rendering,
+// errors as statuses with a message, a node freed before its scheduled
+// start; then the cost of a control call (printed, not enforced).
+
+#include "core/TinySynthEngine.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace tinysynth::test;
+
+namespace {
+
+// SCgf v2 file with one def: tone(freq = 440, amp = 0.1), playing
+// SinOsc.ar(freq) * amp to bus 1
+std::vector<std::uint8_t> toneSynthDef() {
+    std::vector<std::uint8_t> bytes;
+    auto i8 = [&](int value) { bytes.push_back(static_cast<std::uint8_t>(value)); };
+    auto i16 = [&](int value) {
+        i8(value >> 8);
+        i8(value);
+    };
+    auto i32 = [&](std::int32_t value) {
+        i16(value >> 16);
+        i16(value & 0xFFFF);
+    };
+    auto f32 = [&](float value) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        i32(static_cast<std::int32_t>(bits));
+    };
+    auto pstring = [&](const std::string& value) {
+        i8(static_cast<int>(value.size()));
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    };
+    bytes.insert(bytes.end(), {'S', 'C', 'g', 'f'});
+    i32(2);
+    i16(1);
+    pstring("tone");
+    i32(2); // constants
+    f32(0.0F);
+    f32(1.0F);
+    i32(2); // parameters
+    f32(440.0F);
+    f32(0.1F);
+    i32(2);
+    pstring("freq");
+    i32(0);
+    pstring("amp");
+    i32(1);
+    i32(4); // UGens
+    pstring("Control");
+    i8(1);
+    i32(0);
+    i32(2);
+    i16(0);
+    i8(1);
+    i8(1);
+    pstring("SinOsc");
+    i8(2);
+    i32(2);
+    i32(1);
+    i16(0);
+    i32(0); // freq from Control output 0
+    i32(0);
+    i32(-1); // phase 0
+    i32(0);
+    i8(2);
+    pstring("BinaryOpUGen");
+    i8(2);
+    i32(2);
+    i32(1);
+    i16(2); // *
+    i32(1);
+    i32(0);
+    i32(0); // amp from Control output 1
+    i32(1);
+    i8(2);
+    pstring("Out");
+    i8(2);
+    i32(2);
+    i32(0);
+    i16(0);
+    i32(-1); // bus 1
+    i32(1);
+    i32(2);
+    i32(0);
+    i16(0); // variants
+    return bytes;
+}
+
+float peak(const std::vector<float>& samples, std::size_t begin, std::size_t end) {
+    float result = 0.0F;
+    for (std::size_t i = begin; i < end; ++i) {
+        result = std::max(result, std::fabs(samples[i]));
+    }
+    return result;
+}
+
+void checkNodes() {
+    constexpr std::uint32_t BLOCK = 128;
+    TinySynthEngine* engine = tinysynth_engine_create(0, 2, 48000, BLOCK);
+    expect(engine != nullptr, std::string("engine created: ") + tinysynth_last_error());
+    if (engine == nullptr) {
+        return;
+    }
+    const std::vector<std::uint8_t> def = toneSynthDef();
+    expect(tinysynth_synthdef_load(engine, def.data(), def.size()) == 1, "one SynthDef loaded");
+
+    // A SynthDef node at once, a module node on channel 0 scheduled at an
+    // odd frame inside the second block
+    const TinySynthControl toneControls[] = {{"freq", 220.0F}};
+    std::int32_t tone = 0;
+    expect(tinysynth_node_new(engine, "tone", 1000, toneControls, 1, TINYSYNTH_NOW, &tone) ==
+                   TINYSYNTH_OK &&
+               tone == 1000,
+           "SynthDef node");
+    const TinySynthControl sineControls[] = {{"frequency", 1000.0F}, {"amplitude", 0.5F}};
+    std::int32_t sine = 0;
+    expect(tinysynth_node_new(engine, "SineOsc", -1, sineControls, 2, 200, &sine) ==
+                   TINYSYNTH_OK &&
+               sine < 0,
+           "module node with an engine-picked ID");
+
+    // Planar render of four blocks in one call
+    std::vector<float> left(4 * BLOCK);
+    std::vector<float> right(4 * BLOCK);
+    float* outputs[] = {left.data(), right.data()};
+    expect(tinysynth_engine_render(engine, nullptr, outputs, 4 * BLOCK) == TINYSYNTH_OK,
+           "render");
+    expect(tinysynth_engine_frame(engine) == 4 * BLOCK, "frame count");
+    expect(std::fabs(peak(right, BLOCK, 4 * BLOCK) - 0.1F) < 0.01F, "tone on channel 1");
+    expect(peak(left, 0, 200) == 0.0F && left[200] == 0.0F && left[201] != 0.0F,
+           "module node starts on frame 200");
+
+    // Controls by index, in one batch, landing on frame 700
+    const std::int32_t amp = tinysynth_node_param_index(engine, tone, "amp");
+    const std::int32_t amplitude = tinysynth_node_param_index(engine, sine, "amplitude");
+    expect(amp >= 0 && amplitude >= 0, "control indices");
+    const TinySynthParamSet sets[] = {
+        {tone, static_cast<std::uint32_t>(amp), 0.0F},
+        {sine, static_cast<std::uint32_t>(amplitude), 0.0F},
+    };
+    expect(tinysynth_set_param_batch(engine, sets, 2, 700) == 2, "batch queued");
+    // Interleaved render of the next four blocks
+    std::vector<float> frames(8 * BLOCK);
+    expect(tinysynth_engine_render_interleaved(engine, nullptr, frames.data(), 4 * BLOCK) ==
+               TINYSYNTH_OK,
+           "interleaved render");
+    const std::size_t change = 700 - 4 * BLOCK;
+    bool before = false;
+    bool after = true;
+    for (std::size_t frame = 0; frame < 4 * BLOCK; ++frame) {
+        const bool silent = frames[2 * frame] == 0.0F && frames[2 * frame + 1] == 0.0F;
+        before = before || (frame < change && !silent);
+        after = after && (frame < change || silent);
+    }
+    expect(before && after, "batch lands on frame 700");
+
+    // Errors are statuses with a message, and send nothing
+    std::int32_t unused = 0;
+    expect(tinysynth_node_new(engine, "nothing", 2000, nullptr, 0, TINYSYNTH_NOW, &unused) ==
+               TINYSYNTH_ERROR_NOT_FOUND,
+           "unknown def");
+    expect(std::string(tinysynth_last_error()).find("nothing") != std::string::npos,
+           "error message names the def");
+    expect(tinysynth_node_new(engine, "SineOsc", 1000, nullptr, 0, TINYSYNTH_NOW, &unused) ==
+               TINYSYNTH_ERROR_INVALID_ARGUMENT,
+           "duplicate node");
+    const TinySynthParamSet bad[] = {{tone, static_cast<std::uint32_t>(amp), 1.0F},
+                                     {tone, 99, 1.0F}};
+    expect(tinysynth_set_param_batch(engine, bad, 2, TINYSYNTH_NOW) ==
+               TINYSYNTH_ERROR_NOT_FOUND,
+           "bad control index");
+    expect(tinysynth_node_param_index(engine, 4242, "amp") == TINYSYNTH_ERROR_NOT_FOUND,
+           "unknown node");
+    expect(tinysynth_set_param_batch(nullptr, sets, 2, TINYSYNTH_NOW) ==
+               TINYSYNTH_ERROR_INVALID_ARGUMENT,
+           "null engine");
+    expect(tinysynth_synthdef_load(engine, def.data(), 10) < 0, "truncated SynthDef");
+    expect(tinysynth_engine_create(0, 2, 0, BLOCK) == nullptr, "no engine without a rate");
+
+    // Both nodes freed on frame 1100; the tone is back on, so the free shows
+    const TinySynthParamSet on[] = {{tone, static_cast<std::uint32_t>(amp), 0.1F}};
+    expect(tinysynth_set_param_batch(engine, on, 1, TINYSYNTH_NOW) == 1, "tone back on");
+    const std::int32_t nodes[] = {tone, sine};
+    expect(tinysynth_node_free(engine, nodes, 2, 1100) == 2, "two nodes freed");
+    expect(tinysynth_node_param_index(engine, tone, "amp") == TINYSYNTH_ERROR_NOT_FOUND,
+           "freed node is gone");
+    expect(tinysynth_engine_render(engine, nullptr, outputs, 4 * BLOCK) == TINYSYNTH_OK,
+           "render after free");
+    const std::size_t freed = 1100 - 8 * BLOCK;
+    expect(peak(right, 0, freed) > 0.05F && peak(right, freed, 4 * BLOCK) == 0.0F,
+           "nodes freed on frame 1100");
+
+    TinySynthStats stats{};
+    expect(tinysynth_engine_stats(engine, &stats) == TINYSYNTH_OK, "stats");
+    expect(stats.frames == 12 * BLOCK && stats.failed == 0 && stats.late == 0,
+           "stats: " + std::to_string(stats.frames) + " frames, " +
+               std::to_string(stats.failed) + " failed, " + std::to_string(stats.late) +
+               " late");
+    tinysynth_engine_destroy(engine);
+}
+
+// A node freed at once before its scheduled start never plays, a control
+// sent at once waits for it, and its ID is taken until the removal has run
+void checkFreeBeforeStart() {
+    constexpr std::uint32_t BLOCK = 128;
+    TinySynthEngine* engine = tinysynth_engine_create(0, 2, 48000, BLOCK);
+    if (engine == nullptr) {
+        expect(false, "engine for an early free");
+        return;
+    }
+    std::int32_t node = 0;
+    expect(tinysynth_node_new(engine, "SineOsc", 500, nullptr, 0, 300, &node) == TINYSYNTH_OK,
+           "node scheduled on frame 300");
+    const std::int32_t amplitude = tinysynth_node_param_index(engine, node, "amplitude");
+    const TinySynthParamSet set[] = {{node, static_cast<std::uint32_t>(amplitude), 0.25F}};
+    expect(tinysynth_set_param_batch(engine, set, 1, TINYSYNTH_NOW) == 1,
+           "control before the start queued");
+    expect(tinysynth_node_free(engine, &node, 1, TINYSYNTH_NOW) == 1, "freed before its start");
+    std::int32_t unused = 0;
+    expect(tinysynth_node_new(engine, "SineOsc", 500, nullptr, 0, TINYSYNTH_NOW, &unused) ==
+               TINYSYNTH_ERROR_INVALID_ARGUMENT,
+           "ID taken until the removal has run");
+
+    std::vector<float> left(4 * BLOCK);
+    std::vector<float> right(4 * BLOCK);
+    float* outputs[] = {left.data(), right.data()};
+    tinysynth_engine_render(engine, nullptr, outputs, 4 * BLOCK);
+    expect(peak(left, 0, 4 * BLOCK) == 0.0F, "node freed before its start never plays");
+    TinySynthStats stats{};
+    tinysynth_engine_stats(engine, &stats);
+    expect(stats.failed == 0 && stats.late == 0,
+           "nothing rejected: " + std::to_string(stats.failed) + " failed");
+
+    expect(tinysynth_node_new(engine, "SineOsc", 500, nullptr, 0, TINYSYNTH_NOW, &unused) ==
+               TINYSYNTH_OK,
+           "ID reused after the removal");
+    tinysynth_engine_render(engine, nullptr, outputs, 4 * BLOCK);
+    expect(peak(left, 0, 4 * BLOCK) > 0.0F, "node under the reused ID plays");
+    tinysynth_engine_destroy(engine);
+}
+
+void checkLatency() {
+    // 64 voices; each call changes all of their frequencies
+    constexpr std::uint32_t VOICES = 64;
+    constexpr int CALLS = 2000;
+    constexpr std::uint32_t BLOCK = 256;
+    TinySynthEngine* engine = tinysynth_engine_create(0, 2, 48000, BLOCK);
+    if (engine == nullptr) {
+        expect(false, "latency engine");
+        return;
+    }
+    std::vector<TinySynthParamSet> sets;
+    for (std::uint32_t voice = 0; voice < VOICES; ++voice) {
+        std::int32_t node = 0;
+        tinysynth_node_new(engine, "SineOsc", static_cast<std::int32_t>(voice), nullptr, 0,
+                           TINYSYNTH_NOW, &node);
+        const std::int32_t param = tinysynth_node_param_index(engine, node, "frequency");
+        sets.push_back({node, static_cast<std::uint32_t>(param), 0.0F});
+    }
+    std::vector<float> block(2 * BLOCK);
+    double seconds = 0.0;
+    std::int64_t queued = 0;
+    for (int call = 0; call < CALLS; ++call) {
+        for (std::uint32_t voice = 0; voice < VOICES; ++voice) {
+            sets[voice].value = 100.0F + static_cast<float>((call + voice) % 500);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        queued += tinysynth_set_param_batch(engine, sets.data(), VOICES, TINYSYNTH_NOW);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        tinysynth_engine_render_interleaved(engine, nullptr, block.data(), BLOCK);
+    }
+    expect(queued == static_cast<std::int64_t>(CALLS) * VOICES, "every change queued");
+    std::printf("set_param_batch of %u changes: %.2f us per call, %.0f ns per change\n", VOICES,
+                seconds / CALLS * 1e6, seconds / (static_cast<double>(CALLS) * VOICES) * 1e9);
+    tinysynth_engine_destroy(engine);
+}
+
+} // namespace
+
+int main() {
+    expect(tinysynth_abi_version() == TINYSYNTH_ABI_VERSION, "ABI version");
+    checkNodes();
+    checkFreeBeforeStart();
+    checkLatency();
+    return finish("Embedded engine OK");
+}
@@ -0,0 +1,133 @@
+// GraphZeroCopy.cpp
+//
+// GraphProcessor binds the host's capture and playback buffers into the
+// graph: modules must read the capture buffers and, where a channel has a
+// single route, write the playback buffer in place. Checks the pointers the
+// modules see and the rendered samples, including mixed and shared routes.
+
+#include "core/GraphProcessor.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+constexpr unsigned int FRAMES = 64;
+
+// Scales its input and remembers the buffers it was handed
+class ProbeGain : public Module<float> {
+public:
+    explicit ProbeGain(float gain) : m_gain(gain) {}
+
+    void process(const std::vector<std::optional<float*>>& inputs, std::vector<float*>& outputs,
+                 unsigned int numFrames) override {
+        m_lastInput = inputs[0].value_or(nullptr);
+        m_lastOutput = outputs[0];
+        for (unsigned int i = 0; i < numFrames; ++i) {
+            outputs[0][i] = m_lastInput != nullptr ? m_gain * m_lastInput[i] : 0.0F;
+        }
+    }
+
+    [[nodiscard]] unsigned int getNumInputs() const override { return 1; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return 1; }
+    [[nodiscard]] std::string getInputName(unsigned int /*index*/) const override { return "in"; }
+    [[nodiscard]] std::string getOutputName(unsigned int /*index*/) const override {
+        return "out";
+    }
+    void setParameter(const std::string& /*name*/, float /*value*/) override {}
+    [[nodiscard]] float getParameter(const std::string& /*name*/) const override { return 0.0F; }
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override { return {}; }
+    [[nodiscard]] std::string getName() const override { return "ProbeGain"; }
+    [[nodiscard]] std::string getDescription() const override { return "Buffer probe"; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override { return nullptr; }
+    void reset() override {}
+
+    const float* m_lastInput = nullptr;
+    const float* m_lastOutput = nullptr;
+
+private:
+    float m_gain;
+};
+
+bool equals(const std::vector<float>& buffer, const std::vector<float>& expected) {
+    for (unsigned int i = 0; i < FRAMES; ++i) {
+        if (std::fabs(buffer[i] - expected[i]) > 1e-5F * (1.0F + std::fabs(expected[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main() {
+    GraphProcessor graph(2, 3);
+    auto makeProbe = [&](const std::string& name, float gain) {
+        auto module = std::make_unique<ProbeGain>(gain);
+        ProbeGain* probe = module.get();
+        graph.getSystem().addModule(name, std::move(module));
+        return probe;
+    };
+    ProbeGain* half = makeProbe("half", 0.5F);
+    ProbeGain* copy = makeProbe("copy", 1.0F);
+    ProbeGain* third = makeProbe("third", 1.0F / 3.0F);
+    {
+        auto lock = graph.lockGraph();
+        graph.getSystem().connect(GraphProcessor::INPUT_MODULE, 0, "half", 0);
+        graph.getSystem().connect(GraphProcessor::INPUT_MODULE, 1, "copy", 0);
+        graph.getSystem().connect(GraphProcessor::INPUT_MODULE, 0, "third", 0);
+    }
+    // out_1 <- half (only route), out_2 <- copy, out_3 <- copy + third
+    graph.connectOutput("half", 0, 0);
+    graph.connectOutput("copy", 0, 1);
+    graph.connectOutput("copy", 0, 2);
+    graph.connectOutput("third", 0, 2);
+    graph.prepare(48000, FRAMES);
+
+    std::vector<std::vector<float>> in(2, std::vector<float>(FRAMES));
+    std::vector<std::vector<float>> out(3, std::vector<float>(FRAMES, 0.0F));
+    for (unsigned int i = 0; i < FRAMES; ++i) {
+        in[0][i] = static_cast<float>(i);
+        in[1][i] = 100.0F - static_cast<float>(i);
+    }
+    const float* inputs[] = {in[0].data(), in[1].data()};
+    float* outputs[] = {out[0].data(), out[1].data(), out[2].data()};
+    graph.process(inputs, outputs, FRAMES);
+
+    expect(half->m_lastInput == in[0].data(), "capture buffer is read in place");
+    expect(copy->m_lastInput == in[1].data(), "second capture buffer is read in place");
+    expect(half->m_lastOutput == out[0].data(), "single route writes the playback buffer");
+    expect(copy->m_lastOutput == out[1].data(), "shared output is bound to its first channel");
+    expect(third->m_lastOutput != out[2].data(), "mixed channel is not bound");
+
+    std::vector<float> expected(FRAMES);
+    for (unsigned int i = 0; i < FRAMES; ++i) {
+        expected[i] = 0.5F * in[0][i];
+    }
+    expect(equals(out[0], expected), "out_1 samples");
+    expect(equals(out[1], in[1]), "out_2 samples");
+    for (unsigned int i = 0; i < FRAMES; ++i) {
+        expected[i] = in[1][i] + in[0][i] / 3.0F;
+    }
+    expect(equals(out[2], expected), "out_3 mix");
+
+    // Unrouting drops the binding; the module renders into its own buffer
+    graph.disconnectOutput("half", 0, 0);
+    for (auto& buffer : out) {
+        std::fill(buffer.begin(), buffer.end(), 0.0F);
+    }
+    graph.process(inputs, outputs, FRAMES);
+    expect(half->m_lastOutput != out[0].data(), "unrouted output is unbound");
+    expect(equals(out[0], std::vector<float>(FRAMES, 0.0F)), "unrouted channel is silent");
+    expect(equals(out[1], in[1]), "out_2 still renders");
+
+    return finish("zero-copy graph I/O OK");
+}
@@ -0,0 +1,195 @@
+// MidiInput.cpp
+//
+// MIDI input path: the byte parser (running status, realtime bytes inside
+// messages, system exclusive, messages split across events), voice
+// allocation, and a note reaching a GraphProcessor voice at the exact frame
+// of its offset, directly and through a PipelinedProcessor.
+
+#include "core/GraphProcessor.h"
+#include "core/MidiParser.h"
+#include "core/PipelinedProcessor.h"
+#include "core/VoiceAllocator.h"
+#include "modules/FilterModule.h"
+#include "modules/Oscillator.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+std::vector<MidiMessage> parseAll(MidiParser& parser, const std::vector<std::uint8_t>& bytes) {
+    std::vector<MidiMessage> messages;
+    parser.parse(bytes.data(), bytes.size(), 0,
+                 [&](const MidiMessage& message) { messages.push_back(message); });
+    return messages;
+}
+
+bool same(const MidiMessage& message, std::uint8_t status, std::uint8_t data1,
+          std::uint8_t data2) {
+    return message.status == status && message.data1 == data1 && message.data2 == data2;
+}
+
+void checkParser() {
+    MidiParser parser;
+    const auto messages = parseAll(parser, {
+                                               0x90, 0x3C, 0x64, // note on
+                                               0x3E, 0x64,       // running status
+                                               0x40, 0xF8, 0x50, // clock inside a message
+                                               0xF0, 0x7E, 0x01, 0xF7, // sysex
+                                               0x41, 0x10,       // no running status left
+                                               0xC1, 0x05, 0x06, // one data byte, running
+                                               0xB2, 0x07, 0x7F,
+                                           });
+    const bool counted = messages.size() == 7;
+    expect(counted, "parser message count " + std::to_string(messages.size()));
+    if (counted) {
+        expect(same(messages[0], 0x90, 0x3C, 0x64), "note on");
+        expect(same(messages[1], 0x90, 0x3E, 0x64), "running status note");
+        expect(same(messages[2], 0xF8, 0, 0), "realtime byte");
+        expect(same(messages[3], 0x90, 0x40, 0x50), "note around realtime byte");
+        expect(same(messages[4], 0xC1, 0x05, 0), "program change");
+        expect(same(messages[5], 0xC1, 0x06, 0), "running program change");
+        expect(same(messages[6], 0xB2, 0x07, 0x7F), "control change");
+        expect(messages[6].getType() == MidiMessage::ControlChange &&
+                   messages[6].getChannel() == 2,
+               "type and channel");
+    }
+
+    // A message split over two events
+    MidiParser split;
+    expect(parseAll(split, {0x80, 0x3C}).empty(), "partial message held");
+    const auto rest = parseAll(split, {0x00});
+    expect(rest.size() == 1 && same(rest[0], 0x80, 0x3C, 0x00), "split message");
+}
+
+void checkVoices() {
+    VoiceAllocator voices;
+    voices.setNumVoices(2);
+    expect(voices.noteOn(0, 60) == 0, "first voice");
+    expect(voices.noteOn(0, 62) == 1, "second voice");
+    expect(voices.noteOn(0, 64) == 0, "oldest voice stolen");
+    expect(voices.noteOn(0, 64) == 0, "repeated note retriggers");
+    expect(voices.noteOff(0, 62) == 1, "release");
+    expect(voices.noteOff(0, 60) == -1, "stolen note has no voice");
+    expect(voices.noteOn(0, 65) == 1, "free voice first");
+    expect(voices.noteOff(1, 65) == -1, "other channel");
+}
+
+constexpr unsigned int FRAMES = 64;
+
+// Renders `blocks` blocks, sending a note on and a controller at `offset`
+// of block 1, and returns the frame of the first sound in the output. A
+// pipeline's worker is waited for, so no period is late.
+int firstSound(AudioProcessor& processor, unsigned int offset, int blocks) {
+    auto* pipeline = dynamic_cast<PipelinedProcessor*>(&processor);
+    std::vector<float> output(FRAMES);
+    float* outputs[] = {output.data()};
+    for (int block = 0; block < blocks; ++block) {
+        if (block == 1) {
+            MidiMessage note;
+            note.status = 0x90;
+            note.data1 = 69;
+            note.data2 = 127;
+            note.offset = offset;
+            processor.receiveMidi(note);
+            MidiMessage volume;
+            volume.status = 0xB0;
+            volume.data1 = 7;
+            volume.data2 = 127;
+            volume.offset = offset;
+            processor.receiveMidi(volume);
+        }
+        std::fill(output.begin(), output.end(), 0.0F);
+        while (pipeline != nullptr && !pipeline->isIdle()) {
+            std::this_thread::yield();
+        }
+        processor.process(nullptr, outputs, FRAMES);
+        for (unsigned int i = 0; i < FRAMES; ++i) {
+            if (output[i] != 0.0F) {
+                return block * static_cast<int>(FRAMES) + static_cast<int>(i);
+            }
+        }
+    }
+    return -1;
+}
+
+void buildGraph(GraphProcessor& graph) {
+    for (int v = 0; v < 2; ++v) {
+        const std::string name = "v" + std::to_string(v);
+        auto oscillator = std::make_unique<SineOsc<float>>();
+        oscillator->setAmplitude(0.0F);
+        graph.getSystem().addModule(name, std::move(oscillator));
+        graph.connectOutput(name, 0, 0);
+    }
+    graph.setMidiVoices({"v0", "v1"});
+    graph.mapMidiController(-1, 7, "v1", "frequency", 100.0F, 300.0F);
+}
+
+void checkGraph() {
+    // Not a multiple of the default event granularity, which MIDI must not
+    // be rounded to
+    constexpr unsigned int OFFSET = 37;
+    static_assert(OFFSET % GraphProcessor::DEFAULT_EVENT_GRANULARITY != 0);
+    {
+        GraphProcessor graph(0, 1);
+        buildGraph(graph);
+        graph.prepare(48000, FRAMES);
+        const int frame = firstSound(graph, OFFSET, 3);
+        expect(frame == static_cast<int>(FRAMES + OFFSET),
+               "note starts at its frame, got " + std::to_string(frame));
+        auto* voice = graph.getSystem().getModule("v0");
+        expect(std::fabs(voice->getParameter("frequency") - 440.0F) < 1e-3F, "note frequency");
+        expect(voice->getParameter("amplitude") == 1.0F, "note velocity");
+        expect(graph.getSystem().getModule("v1")->getParameter("frequency") == 300.0F,
+               "mapped controller");
+        bool rejected = false;
+        try {
+            graph.mapMidiController(0, 1, "v0", "cutoff", 0.0F, 1.0F);
+        } catch (const std::invalid_argument&) {
+            rejected = true;
+        }
+        expect(rejected, "unknown parameter rejected");
+
+        // v0 and v1 are replaced by modules without their parameters, as a
+        // freed node's name is reused; notes and controllers skip them
+        graph.getSystem().removeModule("v0");
+        graph.getSystem().addModule("v0", std::make_unique<OnePoleFilter<float>>());
+        graph.getSystem().removeModule("v1");
+        graph.getSystem().addModule("v1", std::make_unique<OnePoleFilter<float>>());
+        graph.prepare(48000, FRAMES);
+        try {
+            firstSound(graph, OFFSET, 3);
+        } catch (const std::exception& error) {
+            expect(false, std::string("replaced voices: ") + error.what());
+        }
+    }
+    {
+        // One block later, at the same offset
+        GraphProcessor graph(0, 1);
+        buildGraph(graph);
+        PipelinedProcessor pipeline(graph, 0, 1, {});
+        pipeline.prepare(48000, FRAMES);
+        const int frame = firstSound(pipeline, OFFSET, 4);
+        expect(frame == static_cast<int>(2 * FRAMES + OFFSET),
+               "pipelined note starts a block later, got " + std::to_string(frame));
+    }
+}
+
+} // namespace
+
+int main() {
+    checkParser();
+    checkVoices();
+    checkGraph();
+    return finish("MIDI input OK");
+}
@@ -0,0 +1,484 @@
+// OscServer.cpp
+//
+// OSC control over loopback UDP: packet parsing and building, then a
+// server driving a GraphProcessor that a DummyBackend renders. Covers
+// /d_recv of a SynthDef file with a completion /s_new, module nodes, /n_set
+// by name and index, /n_free, /fail for bad commands, bundles run at their
+// time tag or counted late, a node freed before its bundle starts it, and
+// the command rate with /sync as flow control (50k messages per second is
+// the target; the rate is printed, not enforced). A node whose commands
+// cannot all be queued must fail whole.
+
+#include "core/DummyBackend.h"
+#include "core/GraphProcessor.h"
+#include "core/OscServer.h"
+#include "modules/Oscillator.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+// Renders the graph, keeps each channel's peak and counts the blocks
+class PeakMeter : public AudioProcessor {
+public:
+    explicit PeakMeter(GraphProcessor& graph) : m_graph(graph) {}
+
+    void prepare(unsigned int sampleRate, unsigned int maxBlockSize) override {
+        m_graph.prepare(sampleRate, maxBlockSize);
+    }
+    void process(const float* const* inputs, float* const* outputs,
+                 unsigned int numFrames) override {
+        m_graph.process(inputs, outputs, numFrames);
+        for (unsigned int c = 0; c < 2; ++c) {
+            float peak = 0.0F;
+            for (unsigned int i = 0; i < numFrames; ++i) {
+                peak = std::max(peak, std::fabs(outputs[c][i]));
+            }
+            if (peak > m_peaks[c].load(std::memory_order_relaxed)) {
+                m_peaks[c].store(peak, std::memory_order_relaxed);
+            }
+        }
+        m_blocks.fetch_add(1);
+    }
+
+    float takePeak(unsigned int channel) { return m_peaks[channel].exchange(0.0F); }
+    // Blocks fully rendered, replies to their commands included
+    std::uint64_t getBlocks() const { return m_blocks.load(); }
+
+private:
+    GraphProcessor& m_graph;
+    std::atomic<float> m_peaks[2] = {0.0F, 0.0F};
+    std::atomic<std::uint64_t> m_blocks{0};
+};
+
+// More routes than one producer's ring holds
+constexpr auto OUTPUTS = static_cast<unsigned int>(ControlEventBus::PRODUCER_QUEUE_SIZE);
+
+// Silence on any number of outputs
+class WideModule : public Module<float> {
+public:
+    explicit WideModule(unsigned int numOutputs) : m_numOutputs(numOutputs) {}
+
+    void process(const std::vector<std::optional<float*>>& /*inputs*/,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        for (float* output : outputs) {
+            std::fill(output, output + numFrames, 0.0F);
+        }
+    }
+    [[nodiscard]] unsigned int getNumInputs() const override { return 0; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return m_numOutputs; }
+    [[nodiscard]] std::string getInputName(unsigned int /*index*/) const override { return ""; }
+    [[nodiscard]] std::string getOutputName(unsigned int /*index*/) const override {
+        return "out";
+    }
+    void setParameter(const std::string& /*name*/, float /*value*/) override {}
+    [[nodiscard]] float getParameter(const std::string& /*name*/) const override { return 0.0F; }
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override { return {}; }
+    [[nodiscard]] std::string getName() const override { return "Wide"; }
+    [[nodiscard]] std::string getDescription() const override { return "Silence"; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override {
+        return std::make_unique<WideModule>(m_numOutputs);
+    }
+    void reset() override {}
+
+private:
+    unsigned int m_numOutputs;
+};
+
+class Client {
+public:
+    explicit Client(std::uint16_t port) {
+        m_socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+        m_server.sin_family = AF_INET;
+        m_server.sin_port = htons(port);
+        ::inet_pton(AF_INET, "127.0.0.1", &m_server.sin_addr);
+        timeval timeout{2, 0};
+        ::setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+    ~Client() { ::close(m_socket); }
+
+    void send(const std::vector<std::uint8_t>& packet) {
+        ::sendto(m_socket, packet.data(), packet.size(), 0,
+                 reinterpret_cast<const sockaddr*>(&m_server), sizeof(m_server));
+    }
+
+    // Waits for a reply with this address, skipping others; empty on timeout
+    std::vector<std::uint8_t> receive(std::string_view address) {
+        for (;;) {
+            std::vector<std::uint8_t> packet(65536);
+            const ssize_t size = ::recv(m_socket, packet.data(), packet.size(), 0);
+            if (size < 0) {
+                return {};
+            }
+            packet.resize(static_cast<std::size_t>(size));
+            OscMessage message;
+            if (message.parse(packet) && message.getAddress() == address) {
+                return packet;
+            }
+        }
+    }
+
+    bool sync(std::int32_t id) {
+        send(OscBuilder("/sync").add(id).bytes());
+        const auto packet = receive("/synced");
+        OscMessage message;
+        OscArgument argument;
+        auto arguments = (message.parse(packet), message.arguments());
+        return !packet.empty() && arguments.next(argument) && argument.asInt() == id;
+    }
+
+private:
+    int m_socket;
+    sockaddr_in m_server{};
+};
+
+// Polls until the condition holds; false if it still does not after two
+// seconds
+template <typename Condition>
+bool waitFor(Condition condition) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void checkPackets() {
+    const std::uint8_t blob[] = {1, 2, 3, 4, 5};
+    const auto bytes = OscBuilder("/test").add(7).add(0.5F).add("name").addBlob(blob).bytes();
+    OscMessage message;
+    expect(message.parse(bytes), "message parses");
+    expect(message.getAddress() == "/test" && message.getTypeTags() == "ifsb", "address and tags");
+    auto arguments = message.arguments();
+    OscArgument i;
+    OscArgument f;
+    OscArgument s;
+    OscArgument b;
+    const bool all = arguments.next(i) && arguments.next(f) && arguments.next(s) &&
+                     arguments.next(b) && arguments.atEnd();
+    expect(all && i.i == 7 && f.f == 0.5F && s.s == "name" && b.blob.size() == 5 &&
+               b.blob[4] == 5,
+           "arguments");
+    // Strings and blobs are views into the packet
+    expect(s.s.data() > reinterpret_cast<const char*>(bytes.data()) &&
+               s.s.data() < reinterpret_cast<const char*>(bytes.data() + bytes.size()),
+           "zero-copy string");
+
+    // A bundle holding a message and a nested bundle
+    const auto first = OscBuilder("/a").add(1).bytes();
+    const auto second = OscBuilder("/b").bytes();
+    std::vector<std::uint8_t> inner(osc::BUNDLE_TAG.begin(), osc::BUNDLE_TAG.end());
+    inner.insert(inner.end(), {0, 0, 0, 0, 0, 0, 0, 9});
+    inner.insert(inner.end(), {0, 0, 0, static_cast<std::uint8_t>(second.size())});
+    inner.insert(inner.end(), second.begin(), second.end());
+    std::vector<std::uint8_t> bundle(osc::BUNDLE_TAG.begin(), osc::BUNDLE_TAG.end());
+    bundle.insert(bundle.end(), {0, 0, 0, 0, 0, 0, 0, 5});
+    bundle.insert(bundle.end(), {0, 0, 0, static_cast<std::uint8_t>(first.size())});
+    bundle.insert(bundle.end(), first.begin(), first.end());
+    bundle.insert(bundle.end(), {0, 0, 0, static_cast<std::uint8_t>(inner.size())});
+    bundle.insert(bundle.end(), inner.begin(), inner.end());
+    std::string seen;
+    const bool parsed = parseOscPacket(bundle, [&](const OscMessage& m, std::uint64_t time) {
+        seen += std::string(m.getAddress()) + "@" + std::to_string(time) + " ";
+    });
+    expect(parsed && seen == "/a@5 /b@9 ", "bundle flattened: " + seen);
+
+    std::vector<std::uint8_t> truncated = bundle;
+    truncated.resize(truncated.size() - 4);
+    expect(!parseOscPacket(truncated, [](const OscMessage&, std::uint64_t) {}),
+           "truncated bundle rejected");
+    const std::uint8_t garbage[] = {'/', 'x', 0, 0, ',', 'i', 0, 0, 1};
+    expect(!message.parse(garbage), "unaligned message rejected");
+}
+
+// SCgf v2 file with one def: tone(freq = 440, amp = 0.1), playing
+// SinOsc.ar(freq) * amp to bus 1
+std::vector<std::uint8_t> toneSynthDef() {
+    std::vector<std::uint8_t> bytes;
+    auto i8 = [&](int value) { bytes.push_back(static_cast<std::uint8_t>(value)); };
+    auto i16 = [&](int value) {
+        i8(value >> 8);
+        i8(value);
+    };
+    auto i32 = [&](std::int32_t value) {
+        i16(value >> 16);
+        i16(value & 0xFFFF);
+    };
+    auto f32 = [&](float value) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        i32(static_cast<std::int32_t>(bits));
+    };
+    auto pstring = [&](const std::string& value) {
+        i8(static_cast<int>(value.size()));
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    };
+    bytes.insert(bytes.end(), {'S', 'C', 'g', 'f'});
+    i32(2);
+    i16(1);
+    pstring("tone");
+    i32(2); // constants
+    f32(0.0F);
+    f32(1.0F);
+    i32(2); // parameters
+    f32(440.0F);
+    f32(0.1F);
+    i32(2);
+    pstring("freq");
+    i32(0);
+    pstring("amp");
+    i32(1);
+    i32(4); // UGens
+    pstring("Control");
+    i8(1);
+    i32(0);
+    i32(2);
+    i16(0);
+    i8(1);
+    i8(1);
+    pstring("SinOsc");
+    i8(2);
+    i32(2);
+    i32(1);
+    i16(0);
+    i32(0); // freq from Control output 0
+    i32(0);
+    i32(-1); // phase 0
+    i32(0);
+    i8(2);
+    pstring("BinaryOpUGen");
+    i8(2);
+    i32(2);
+    i32(1);
+    i16(2); // *
+    i32(1);
+    i32(0);
+    i32(0); // amp from Control output 1
+    i32(1);
+    i8(2);
+    pstring("Out");
+    i8(2);
+    i32(2);
+    i32(0);
+    i16(0);
+    i32(-1); // bus 1
+    i32(1);
+    i32(2);
+    i32(0);
+    i16(0); // variants
+    return bytes;
+}
+
+void checkServer() {
+    GraphProcessor graph(0, 2);
+    graph.setEventGranularity(1);
+    SynthDefJIT jit;
+    OscServer::Config config;
+    config.port = 0;
+    OscServer server(graph, jit, config);
+    server.registerModule("SineOsc", [] { return std::make_unique<SineOsc<float>>(); });
+    server.start();
+
+    PeakMeter meter(graph);
+    DummyBackend::Config driverConfig;
+    DummyBackend driver(driverConfig);
+    driver.start(meter);
+
+    Client client(server.getPort());
+    auto node = [&](const std::string& name) {
+        auto lock = graph.lockGraph();
+        return graph.getSystem().getModule(name);
+    };
+
+    // The def arrives with a completion message starting a node of it
+    client.send(OscBuilder("/d_recv")
+                    .addBlob(toneSynthDef())
+                    .addBlob(OscBuilder("/s_new").add("tone").add(1000).add(0).add(0).add("freq")
+                                 .add(220.0F).bytes())
+                    .bytes());
+    expect(!client.receive("/done").empty(), "/d_recv done");
+    expect(client.sync(1), "sync after /d_recv");
+    expect(node("n1000") != nullptr && node("n1000")->getParameter("freq") == 220.0F,
+           "SynthDef node with initial control");
+    // Past the block the node started in, then a peak over whole blocks
+    auto renderBlocks = [&](std::uint64_t count) {
+        const std::uint64_t start = meter.getBlocks();
+        return waitFor([&] { return meter.getBlocks() >= start + count; });
+    };
+    expect(renderBlocks(2), "blocks rendered");
+    meter.takePeak(1);
+    expect(renderBlocks(4), "blocks rendered");
+    const float peak = meter.takePeak(1);
+    expect(std::fabs(peak - 0.1F) < 0.01F, "SynthDef plays to its Out bus, peak " +
+                                                std::to_string(peak));
+
+    // Controls by index; a module node on channel 0
+    client.send(OscBuilder("/n_set").add(1000).add(1).add(0.25F).bytes());
+    client.send(OscBuilder("/s_new").add("SineOsc").add(2000).add(0).add(1).add("frequency")
+                    .add(110).add("amplitude").add(0.5F).bytes());
+    expect(client.sync(2), "sync after /n_set");
+    expect(node("n1000")->getParameter("amp") == 0.25F, "control set by index");
+    expect(node("n2000") != nullptr && node("n2000")->getParameter("frequency") == 110.0F,
+           "module node");
+
+    // Errors answer /fail and change nothing
+    client.send(OscBuilder("/n_set").add(2000).add("cutoff").add(1.0F).bytes());
+    expect(!client.receive("/fail").empty(), "unknown control fails");
+    client.send(OscBuilder("/s_new").add("nothing").add(3000).bytes());
+    expect(!client.receive("/fail").empty(), "unknown def fails");
+    client.send(OscBuilder("/s_new").add("SineOsc").add(2000).bytes());
+    expect(!client.receive("/fail").empty(), "duplicate node fails");
+    client.send(OscBuilder("/bogus").bytes());
+    expect(!client.receive("/fail").empty(), "unknown command fails");
+
+    // Time-tagged bundles wait for their time; /sync does not wait for them
+    auto bundle = [](std::chrono::system_clock::time_point time,
+                     const std::vector<std::uint8_t>& message) {
+        std::vector<std::uint8_t> bytes(osc::BUNDLE_TAG.begin(), osc::BUNDLE_TAG.end());
+        const std::uint64_t tag = osc::toTimeTag(time);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            bytes.push_back(static_cast<std::uint8_t>(tag >> shift));
+        }
+        bytes.insert(bytes.end(), {0, 0, 0, static_cast<std::uint8_t>(message.size())});
+        bytes.insert(bytes.end(), message.begin(), message.end());
+        return bytes;
+    };
+    const auto soon = std::chrono::system_clock::now() + std::chrono::milliseconds(500);
+    client.send(bundle(soon, OscBuilder("/n_set").add(2000).add("frequency").add(777.0F).bytes()));
+    expect(client.sync(4), "sync with a bundle pending");
+    // Rendering runs ahead of the wall clock, by less than 100 ms
+    const float waiting = node("n2000")->getParameter("frequency");
+    expect(waiting == 110.0F ||
+               std::chrono::system_clock::now() >= soon - std::chrono::milliseconds(100),
+           "bundle waits for its time");
+    expect(waitFor([&] { return node("n2000")->getParameter("frequency") == 777.0F; }),
+           "bundle ran at its time");
+    const auto past = std::chrono::system_clock::now() - std::chrono::seconds(1);
+    client.send(bundle(past, OscBuilder("/n_set").add(2000).add("frequency").add(555.0F).bytes()));
+    expect(waitFor([&] { return node("n2000")->getParameter("frequency") == 555.0F; }),
+           "late bundle runs at once");
+    expect(server.getStats().late == 1, "late bundle counted");
+    const std::uint64_t tag = osc::toTimeTag(past);
+    // Nanoseconds are coarser than the 2^-32 s of a time tag
+    const auto roundTrip = static_cast<std::int64_t>(osc::toTimeTag(osc::toSystemTime(tag)) - tag);
+    expect(std::abs(roundTrip) <= 5, "time tag round trip");
+
+    // A node freed before its bundle starts it never plays, and its ID is
+    // free again once the removal has run. The /n_set bundled at the same
+    // time runs after both.
+    const auto later = std::chrono::system_clock::now() + std::chrono::milliseconds(100);
+    client.send(bundle(later, OscBuilder("/s_new").add("SineOsc").add(4000).add(0).add(1)
+                                  .bytes()));
+    client.send(OscBuilder("/n_free").add(4000).bytes());
+    client.send(bundle(later, OscBuilder("/n_set").add(2000).add("frequency").add(333.0F)
+                                  .bytes()));
+    expect(waitFor([&] { return node("n2000")->getParameter("frequency") == 333.0F; }),
+           "bundle after the freed node ran");
+    expect(node("n4000") == nullptr, "node freed before its start never plays");
+    // The server sees the removal's reply once that block is done
+    const std::uint64_t blocks = meter.getBlocks();
+    expect(waitFor([&] { return meter.getBlocks() > blocks; }), "block rendered");
+    expect(client.sync(5), "sync after the freed node");
+    client.send(OscBuilder("/s_new").add("SineOsc").add(4000).add(0).add(1).bytes());
+    expect(client.sync(6), "sync after reusing the ID");
+    expect(node("n4000") != nullptr, "ID of a node freed before its start reused");
+
+    // Rate: /n_set in bundles of 40, a /sync after every 25 bundles
+    constexpr int MESSAGES = 50000;
+    constexpr int PER_BUNDLE = 40;
+    const auto start = std::chrono::steady_clock::now();
+    int sent = 0;
+    bool synced = true;
+    for (int id = 100; sent < MESSAGES && synced; ++id) {
+        for (int b = 0; b < 25 && sent < MESSAGES; ++b) {
+            std::vector<std::uint8_t> bundle(osc::BUNDLE_TAG.begin(), osc::BUNDLE_TAG.end());
+            bundle.insert(bundle.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+            for (int m = 0; m < PER_BUNDLE; ++m, ++sent) {
+                const auto message = OscBuilder("/n_set").add(2000).add("frequency")
+                                         .add(static_cast<float>(sent)).bytes();
+                bundle.insert(bundle.end(), {0, 0, 0, static_cast<std::uint8_t>(message.size())});
+                bundle.insert(bundle.end(), message.begin(), message.end());
+            }
+            client.send(bundle);
+        }
+        synced = client.sync(id);
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    expect(synced, "every batch synced");
+    expect(node("n2000")->getParameter("frequency") == static_cast<float>(MESSAGES - 1),
+           "last /n_set applied");
+    std::printf("%d /n_set messages in %.3f s: %.0f messages/s\n", MESSAGES, seconds,
+                MESSAGES / seconds);
+
+    client.send(OscBuilder("/n_free").add(1000).add(2000).add(4000).bytes());
+    expect(client.sync(3), "sync after /n_free");
+    expect(node("n1000") == nullptr && node("n2000") == nullptr && node("n4000") == nullptr,
+           "nodes freed");
+
+    driver.stop();
+    server.stop();
+    const OscServerStats stats = server.getStats();
+    expect(stats.malformed == 0, "no malformed packets");
+    expect(stats.failed == 4, "four failures, got " + std::to_string(stats.failed));
+    const DummyBackendStats& driverStats = driver.getStats();
+    std::printf("%llu cycles, %llu xruns, max render %.1f us\n",
+                static_cast<unsigned long long>(driverStats.cycles),
+                static_cast<unsigned long long>(driverStats.xruns),
+                static_cast<double>(driverStats.maxRenderTime) / 1000.0);
+}
+
+// A node whose commands do not all fit in the engine's ring fails whole:
+// none of them is queued, so no node is left playing without its routes
+void checkWholeNode() {
+    constexpr unsigned int FRAMES = 64;
+    GraphProcessor graph(0, OUTPUTS);
+    graph.prepare(48000, FRAMES);
+    SynthDefJIT jit;
+    OscServer::Config config;
+    config.port = 0;
+    OscServer server(graph, jit, config);
+    server.registerModule("Wide", [] { return std::make_unique<WideModule>(OUTPUTS); });
+    server.start();
+
+    // Nothing renders meanwhile, so the ring cannot drain
+    Client client(server.getPort());
+    client.send(OscBuilder("/s_new").add("Wide").add(7000).bytes());
+    expect(!client.receive("/fail").empty(), "node wider than the ring fails");
+    server.stop();
+
+    std::vector<float> buffer(FRAMES);
+    std::vector<float*> outputs(OUTPUTS, buffer.data());
+    graph.process(nullptr, outputs.data(), FRAMES);
+    expect(graph.getSystem().getModule("n7000") == nullptr, "failed node not added");
+}
+
+} // namespace
+
+int main() {
+    checkPackets();
+    checkServer();
+    checkWholeNode();
+    return finish("OSC server OK");
+}
@@ -0,0 +1,172 @@
+// PipelinedRender.cpp
+//
+// PipelinedProcessor plays exactly what the wrapped graph renders directly,
+// one period later. The worker is then held up: late periods play silence,
+// but their inputs are still rendered in order and the graph's frame clock
+// stays with the host's; once the queue is full, dropped periods are
+// rendered from silence. Either way the output lines up with the direct
+// render again as soon as the worker catches up.
+
+#include "core/GraphProcessor.h"
+#include "core/PipelinedProcessor.h"
+#include "modules/Oscillator.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+constexpr unsigned int FRAMES = 64;
+constexpr unsigned int BLOCKS = 40;
+
+// Passes its input through and records it; waits while held
+class GateModule : public Module<float> {
+public:
+    GateModule(const std::atomic<bool>& hold, std::vector<float>& seen)
+        : m_hold(hold), m_seen(seen) {}
+
+    void process(const std::vector<std::optional<float*>>& inputs, std::vector<float*>& outputs,
+                 unsigned int numFrames) override {
+        while (m_hold.load()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        const float* input = inputs[0].value_or(nullptr);
+        for (unsigned int i = 0; i < numFrames; ++i) {
+            outputs[0][i] = input != nullptr ? input[i] : 0.0F;
+        }
+        m_seen.insert(m_seen.end(), outputs[0], outputs[0] + numFrames);
+    }
+
+    [[nodiscard]] unsigned int getNumInputs() const override { return 1; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return 1; }
+    [[nodiscard]] std::string getInputName(unsigned int /*index*/) const override { return "in"; }
+    [[nodiscard]] std::string getOutputName(unsigned int /*index*/) const override {
+        return "out";
+    }
+    void setParameter(const std::string& /*name*/, float /*value*/) override {}
+    [[nodiscard]] float getParameter(const std::string& /*name*/) const override { return 0.0F; }
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override { return {}; }
+    [[nodiscard]] std::string getName() const override { return "Gate"; }
+    [[nodiscard]] std::string getDescription() const override { return "Holds the worker"; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override { return nullptr; }
+    void reset() override {}
+
+private:
+    const std::atomic<bool>& m_hold;
+    std::vector<float>& m_seen;
+};
+
+// Capture channel 0 through the gate, plus a sine, into output 0
+struct Graph {
+    GraphProcessor processor{1, 1};
+    std::atomic<bool> hold{false};
+    std::vector<float> seen;
+
+    Graph() {
+        seen.reserve(BLOCKS * FRAMES);
+        processor.getSystem().addModule("gate", std::make_unique<GateModule>(hold, seen));
+        processor.getSystem().addModule("osc", std::make_unique<SineOsc<float>>());
+        processor.connectInput(0, "gate", 0);
+        processor.connectOutput("gate", 0, 0);
+        processor.connectOutput("osc", 0, 0);
+    }
+};
+
+std::vector<float> block(const std::vector<float>& samples, unsigned int index) {
+    return {samples.begin() + index * FRAMES, samples.begin() + (index + 1) * FRAMES};
+}
+
+void checkPipelined() {
+    std::vector<float> input(BLOCKS * FRAMES);
+    for (unsigned int i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<float>(i % 1000) / 1000.0F;
+    }
+    // Held for 3 periods from block 10, then for 6 from block 20, the last
+    // two of which find the queue full and are dropped
+    auto heldFor = [](unsigned int index) -> unsigned int {
+        return index == 10 ? 3 : index == 20 ? 6 : 0;
+    };
+    auto dropped = [](unsigned int index) { return index == 24 || index == 25; };
+
+    // The direct render sees what the pipeline's graph will: silence for
+    // the dropped periods
+    Graph direct;
+    direct.processor.prepare(48000, FRAMES);
+    std::vector<float> expected(BLOCKS * FRAMES);
+    for (unsigned int b = 0; b < BLOCKS; ++b) {
+        std::vector<float> in = dropped(b) ? std::vector<float>(FRAMES, 0.0F) : block(input, b);
+        const float* inputs[] = {in.data()};
+        float* outputs[] = {expected.data() + b * FRAMES};
+        direct.processor.process(inputs, outputs, FRAMES);
+    }
+
+    Graph pipelined;
+    PipelinedProcessor pipeline(pipelined.processor, 1, 1, {});
+    pipeline.prepare(48000, FRAMES);
+    std::vector<float> played(BLOCKS * FRAMES, 0.0F);
+    unsigned int release = 0;
+    for (unsigned int b = 0; b < BLOCKS; ++b) {
+        if (b == release) {
+            pipelined.hold = false;
+        }
+        if (!pipelined.hold) {
+            // Outside the held spans no period may be late
+            while (!pipeline.isIdle()) {
+                std::this_thread::yield();
+            }
+        }
+        if (heldFor(b) > 0) {
+            pipelined.hold = true;
+            release = b + heldFor(b);
+        }
+        const float* inputs[] = {input.data() + b * FRAMES};
+        float* outputs[] = {played.data() + b * FRAMES};
+        pipeline.process(inputs, outputs, FRAMES);
+    }
+    while (!pipeline.isIdle()) {
+        std::this_thread::yield();
+    }
+
+    // Periods 11-12 and 21-26 waited for the worker
+    auto silent = [](unsigned int index) {
+        return index == 0 || index == 11 || index == 12 || (index >= 21 && index <= 26);
+    };
+    for (unsigned int b = 0; b < BLOCKS; ++b) {
+        const std::vector<float> out = block(played, b);
+        if (silent(b)) {
+            expect(std::all_of(out.begin(), out.end(), [](float s) { return s == 0.0F; }),
+                   "period " + std::to_string(b) + " silent");
+        } else {
+            expect(out == block(expected, b - 1),
+                   "period " + std::to_string(b) + " plays the direct block before it");
+        }
+    }
+    expect(pipeline.getLateCycles() == 8,
+           "late cycles, got " + std::to_string(pipeline.getLateCycles()));
+    expect(pipeline.getDroppedBlocks() == 2,
+           "dropped blocks, got " + std::to_string(pipeline.getDroppedBlocks()));
+    expect(pipelined.processor.getFrameTime() == BLOCKS * FRAMES,
+           "graph clock keeps the host's, at " +
+               std::to_string(pipelined.processor.getFrameTime()));
+    expect(pipelined.seen == direct.seen, "every input frame rendered in order");
+}
+
+} // namespace
+
+int main() {
+    try {
+        checkPipelined();
+    } catch (const std::exception& error) {
+        expect(false, error.what());
+    }
+    return finish("Pipelined render OK");
+}
@@ -0,0 +1,135 @@
+// RealtimeMemoryCheck.cpp
+//
+// Sets up the realtime arena and checks that modules, ModularSystem buffers
+// and control-queue lanes are placed in it, that removing and re-adding
+// modules reuses arena memory instead of growing it, and that memory is
+// locked when RLIMIT_MEMLOCK allows. mlockall locks the whole process, so a
+// limit that covers the arena but not the resident set must be refused.
+// Where the limit is too small, initialise() must fail with an error and
+// the check continues with an unlocked arena.
+
+#include "core/GraphProcessor.h"
+#include "core/RealtimeMemory.h"
+#include "modules/Oscillator.h"
+#include "TestHarness.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+bool hasIpcLock() {
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    while (status >> key) {
+        if (key == "CapEff:") {
+            std::string mask;
+            status >> mask;
+            return (std::stoull(mask, nullptr, 16) >> 14 & 1ULL) != 0;
+        }
+        status.ignore(256, '\n');
+    }
+    return false;
+}
+
+// In a child, so this process keeps its limit: with RLIMIT_MEMLOCK covering
+// the arena and the headroom but not what is already resident, initialise()
+// must refuse. 0 when it does, 1 when it locks anyway, 2 when the process
+// may lock without limit.
+int refusesResidentSet(const RealtimeMemory::Config& config) {
+    const pid_t child = fork();
+    if (child == 0) {
+        rlimit limit{};
+        limit.rlim_cur = config.arenaBytes + config.lockHeadroomBytes;
+        limit.rlim_max = limit.rlim_cur;
+        setrlimit(RLIMIT_MEMLOCK, &limit);
+        try {
+            RealtimeMemory::initialise(config);
+        } catch (const std::runtime_error&) {
+            _exit(0);
+        }
+        _exit(hasIpcLock() ? 2 : 1);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+} // namespace
+
+int main() {
+    expect(RealtimeMemory::getResource() == std::pmr::new_delete_resource(),
+           "heap before initialise");
+
+    RealtimeMemory::Config config;
+    config.arenaBytes = std::size_t{16} << 20;
+    const int refused = refusesResidentSet(config);
+    std::printf("limit without room for the resident set: %s\n",
+                refused == 0 ? "refused" : refused == 2 ? "lifted by CAP_IPC_LOCK" : "accepted");
+    expect(refused != 1, "resident set counted against RLIMIT_MEMLOCK");
+    try {
+        RealtimeMemory::initialise(config);
+    } catch (const std::runtime_error& error) {
+        std::printf("memory locking unavailable: %s\n", error.what());
+        config.lockMemory = false;
+        RealtimeMemory::initialise(config);
+    }
+    bool again = false;
+    try {
+        RealtimeMemory::initialise(config);
+    } catch (const std::runtime_error&) {
+        again = true;
+    }
+    expect(again, "second initialise throws");
+
+    const RealtimeMemory::Usage start = RealtimeMemory::getUsage();
+    if (start.locked) {
+        expect(start.lockedBytes >= start.arenaBytes, "arena is locked");
+    }
+
+    GraphProcessor graph(0, 2);
+    ControlEventBus::Producer& source = graph.addControlSource("source");
+    expect(RealtimeMemory::contains(&source), "control lane in arena");
+    for (int v = 0; v < 8; ++v) {
+        const std::string name = "v" + std::to_string(v);
+        graph.getSystem().addModule(name, std::make_unique<SineOsc<float>>());
+        graph.connectOutput(name, 0, static_cast<unsigned int>(v % 2));
+        expect(RealtimeMemory::contains(graph.getSystem().getModule(name)), "module in arena");
+    }
+    constexpr unsigned int FRAMES = 256;
+    graph.prepare(48000, FRAMES);
+    std::vector<float> left(FRAMES);
+    std::vector<float> right(FRAMES);
+    float* outputs[] = {left.data(), right.data()};
+    graph.process(nullptr, outputs, FRAMES);
+    // v0 and v1 are bound to the host channels; v2 renders into its buffer
+    expect(RealtimeMemory::contains(graph.getSystem().getOutputBuffer("v2", 0)),
+           "module buffer in arena");
+
+    // Replacing modules recycles their storage
+    const std::size_t before = RealtimeMemory::getUsage().arenaUsed;
+    for (int round = 0; round < 1000; ++round) {
+        graph.getSystem().removeModule("v7");
+        graph.getSystem().addModule("v7", std::make_unique<SineOsc<float>>());
+    }
+    expect(RealtimeMemory::getUsage().arenaUsed == before, "arena reused");
+
+    std::thread worker([] { RealtimeMemory::prefaultStack(); });
+    worker.join();
+
+    const RealtimeMemory::Usage usage = RealtimeMemory::getUsage();
+    expect(usage.overflowAllocations == 0, "no heap overflow");
+    std::printf("%s\n", RealtimeMemory::describeUsage().c_str());
+    return finish("realtime memory OK");
+}
@@ -0,0 +1,136 @@
+// RealtimeSanitizerCheck.cpp
+//
+// Built only with TINYSYNTH_RT_SANITIZER. Commits each kind of realtime
+// violation inside a ScopedRealtimeContext and checks that every one is
+// counted, that exempt and non-realtime code is not, and that a realtime
+// render of the engine graph is clean.
+
+#include "core/GraphProcessor.h"
+#include "core/RealtimeSanitizer.h"
+#include "modules/Oscillator.h"
+#include "TestHarness.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <malloc.h>
+#include <mutex>
+#include <pthread.h>
+#include <semaphore.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+// Runs `what` on a realtime context and compares the violations it adds
+template <typename Function>
+void expectViolations(const char* name, std::uint64_t expected, Function&& what) {
+    const std::uint64_t before = RealtimeSanitizer::getViolationCount();
+    {
+        ScopedRealtimeContext realtime;
+        what();
+    }
+    const std::uint64_t found = RealtimeSanitizer::getViolationCount() - before;
+    expect(found == expected, std::string(name) + ": " + std::to_string(found) +
+                                  " violations, expected " + std::to_string(expected));
+}
+
+// volatile keeps the compiler from eliding the allocation
+void* volatile sink = nullptr;
+
+} // namespace
+
+int main() {
+    if (!RealtimeSanitizer::isEnabled()) {
+        std::printf("built without TINYSYNTH_RT_SANITIZER\n");
+        return 1;
+    }
+    RealtimeSanitizer::startReporter();
+    std::mutex mutex;
+
+    expectViolations("malloc", 1, [] { sink = std::malloc(64); });
+    expectViolations("free", 1, [] { std::free(sink); });
+    // Aligned allocations, released outside the context
+    expectViolations("aligned_alloc", 1, [] { sink = std::aligned_alloc(64, 64); });
+    std::free(sink);
+    expectViolations("posix_memalign", 1, [] {
+        void* pointer = nullptr;
+        if (posix_memalign(&pointer, 64, 64) == 0) {
+            sink = pointer;
+        }
+    });
+    std::free(sink);
+    expectViolations("memalign", 1, [] { sink = memalign(64, 64); });
+    std::free(sink);
+    expectViolations("mutex", 1, [&] { std::lock_guard<std::mutex> lock(mutex); });
+    expectViolations("try_lock", 0, [&] {
+        if (mutex.try_lock()) {
+            mutex.unlock();
+        }
+    });
+    pthread_mutex_t timedMutex = PTHREAD_MUTEX_INITIALIZER;
+    expectViolations("pthread_mutex_timedlock", 1, [&] {
+        timespec deadline{};
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        if (pthread_mutex_timedlock(&timedMutex, &deadline) == 0) {
+            pthread_mutex_unlock(&timedMutex);
+        }
+    });
+    // Times out at once: the deadline has passed
+    pthread_cond_t condition = PTHREAD_COND_INITIALIZER;
+    pthread_mutex_lock(&timedMutex);
+    expectViolations("pthread_cond_timedwait", 1, [&] {
+        timespec deadline{};
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        pthread_cond_timedwait(&condition, &timedMutex, &deadline);
+    });
+    pthread_mutex_unlock(&timedMutex);
+    // Posted first, so the wait returns at once
+    sem_t semaphore;
+    sem_init(&semaphore, 0, 1);
+    expectViolations("sem_wait", 1, [&] { sem_wait(&semaphore); });
+    sem_destroy(&semaphore);
+    expectViolations("usleep", 1, [] { usleep(1); });
+    expectViolations("clock_nanosleep", 1, [] {
+        const timespec duration{0, 1000};
+        clock_nanosleep(CLOCK_MONOTONIC, 0, &duration, nullptr);
+    });
+    // Allocating the exception object, the throw, and freeing the object
+    expectViolations("throw", 3, [] {
+        try {
+            throw 1;
+        } catch (int) {
+        }
+    });
+    expectViolations("exempt", 0, [] {
+        ScopedRealtimeExemption exempt;
+        sink = std::malloc(64);
+        std::free(sink);
+    });
+
+    // A running graph with parameter changes must stay clean
+    GraphProcessor graph(0, 2);
+    for (int v = 0; v < 4; ++v) {
+        const std::string name = "v" + std::to_string(v);
+        graph.getSystem().addModule(name, std::make_unique<SineOsc<float>>());
+        graph.connectOutput(name, 0, static_cast<unsigned int>(v % 2));
+    }
+    constexpr unsigned int FRAMES = 64;
+    graph.prepare(48000, FRAMES);
+    std::vector<float> left(FRAMES);
+    std::vector<float> right(FRAMES);
+    float* outputs[] = {left.data(), right.data()};
+    for (int block = 0; block < 100; ++block) {
+        graph.sendSetParameter("v1", "frequency", 220.0F + static_cast<float>(block));
+        expectViolations("graph block", 0,
+                         [&] { graph.process(nullptr, outputs, FRAMES); });
+        graph.collectReplies();
+    }
+
+    RealtimeSanitizer::stopReporter();
+    return finish("realtime sanitizer OK");
+}
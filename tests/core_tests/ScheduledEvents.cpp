@@ -0,0 +1,197 @@
+// ScheduledEvents.cpp
+//
+// Events sent ahead of time: the FrameClock locking onto a drifting,
+// jittery block clock and restarting after a jump; a scheduled control
+// source taking events out of order; and scheduled events landing on their
+// exact frame inside a block, or at the next block and counted when late.
+
+#include "core/ControlEventBus.h"
+#include "core/FrameClock.h"
+#include "core/GraphProcessor.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+// Outputs its level parameter, so the frame a change lands on is visible
+class LevelModule : public Module<float> {
+public:
+    void process(const std::vector<std::optional<float*>>& /*inputs*/,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        std::fill(outputs[0], outputs[0] + numFrames, m_level);
+    }
+    [[nodiscard]] unsigned int getNumInputs() const override { return 0; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return 1; }
+    [[nodiscard]] std::string getInputName(unsigned int /*index*/) const override { return ""; }
+    [[nodiscard]] std::string getOutputName(unsigned int /*index*/) const override {
+        return "out";
+    }
+    void setParameter(const std::string& /*name*/, float value) override { m_level = value; }
+    [[nodiscard]] float getParameter(const std::string& /*name*/) const override {
+        return m_level;
+    }
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override {
+        return {"level"};
+    }
+    [[nodiscard]] std::string getName() const override { return "Level"; }
+    [[nodiscard]] std::string getDescription() const override { return "Constant"; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override {
+        return std::make_unique<LevelModule>(*this);
+    }
+    void reset() override { m_level = 0.0F; }
+
+private:
+    float m_level = 0.0F;
+};
+
+void checkClock() {
+    constexpr unsigned int SAMPLE_RATE = 48000;
+    constexpr unsigned int BLOCK = 256;
+    // The card runs 50 ppm fast against the system clock
+    constexpr double ACTUAL_RATE = SAMPLE_RATE * (1.0 + 50e-6);
+    const FrameClock::TimePoint origin{std::chrono::seconds(1000)};
+    auto at = [&](double seconds) {
+        return origin + std::chrono::nanoseconds(static_cast<std::int64_t>(seconds * 1e9));
+    };
+
+    FrameClock clock;
+    expect(!clock.frameAt(origin).has_value(), "no estimate before the first block");
+    clock.reset(SAMPLE_RATE);
+    // Wakeups land up to 300 us late
+    std::uint32_t noise = 12345;
+    auto jitter = [&] {
+        noise = noise * 1664525U + 1013904223U;
+        return static_cast<double>(noise >> 8) / static_cast<double>(1U << 24) * 300e-6;
+    };
+    std::uint64_t frame = 0;
+    for (; frame < SAMPLE_RATE * 120ULL; frame += BLOCK) {
+        clock.update(frame, at(static_cast<double>(frame) / ACTUAL_RATE + jitter()));
+    }
+    const double rate = clock.getMeasuredSampleRate();
+    expect(std::fabs(rate - ACTUAL_RATE) < 0.5,
+           "measured rate " + std::to_string(rate) + " vs " + std::to_string(ACTUAL_RATE));
+    // A second ahead the prediction is off by much less than the jitter
+    // (14 frames) and the uncorrected drift (2.4 frames per second). The
+    // mean wakeup delay is part of the clock, as it is for every event.
+    const std::uint64_t target = frame + SAMPLE_RATE;
+    const auto predicted =
+        clock.frameAt(at(static_cast<double>(target) / ACTUAL_RATE + 150e-6));
+    const double error =
+        predicted ? std::fabs(static_cast<double>(*predicted) - static_cast<double>(target)) : 1e9;
+    expect(error <= 2.0, "prediction a second ahead off by " + std::to_string(error));
+    expect(clock.getRestarts() == 0, "no restarts while locked");
+
+    // The stream stalls for half a second: restart there, rate kept
+    const double stall = 0.5;
+    clock.update(frame, at(static_cast<double>(frame) / ACTUAL_RATE + stall));
+    expect(clock.getRestarts() == 1, "a jump restarts the loop");
+    const auto resumed = clock.frameAt(at(static_cast<double>(frame) / ACTUAL_RATE + stall));
+    expect(resumed && *resumed == frame, "restarted at the new stamp");
+    expect(std::fabs(clock.getMeasuredSampleRate() - rate) < 1e-6, "rate survives a restart");
+}
+
+void checkSchedule() {
+    ControlEventBus bus;
+    auto& scheduled = bus.addScheduledProducer("scheduled");
+    auto& immediate = bus.addProducer("immediate");
+    const std::uint64_t times[] = {300, 100, 200, 100};
+    for (std::size_t i = 0; i < 4; ++i) {
+        EngineCommand command = EngineCommand::setParameter("m", "p", static_cast<float>(i));
+        expect(scheduled.push(times[i], command), "scheduled push");
+    }
+    EngineCommand now = EngineCommand::setParameter("m", "p", -1.0F);
+    immediate.push(150, now);
+
+    std::vector<float> order;
+    std::vector<bool> exact;
+    auto record = [&](const ControlEvent& event, EngineReply& reply) {
+        order.push_back(event.command.value);
+        exact.push_back(event.sampleAccurate);
+        reply.status = EngineReply::Status::Done;
+    };
+    // Block [150, 250): the events at 100 are late, 150 and 200 are due
+    const unsigned int applied = bus.drain(150, 250, 16, record);
+    expect(applied == 4, "four events due, got " + std::to_string(applied));
+    expect(order == std::vector<float>{1.0F, 3.0F, -1.0F, 2.0F},
+           "time order, equal times in push order");
+    expect(exact == std::vector<bool>{true, true, false, true}, "scheduled events are exact");
+    expect(scheduled.getLateEvents() == 2, "two late events");
+    expect(immediate.getLateEvents() == 0, "immediate events are never late");
+    order.clear();
+    bus.drain(250, 350, 16, record);
+    expect(order == std::vector<float>{0.0F}, "the last event in its own block");
+    expect(scheduled.collectReplies() == 4, "every scheduled event replied");
+}
+
+void checkDispatch() {
+    constexpr unsigned int BLOCK = 256;
+    GraphProcessor graph(0, 1);
+    graph.setEventGranularity(64);
+    {
+        auto lock = graph.lockGraph();
+        graph.getSystem().addModule("level", std::make_unique<LevelModule>());
+    }
+    graph.connectOutput("level", 0, 0);
+    graph.prepare(48000, BLOCK);
+    auto& scheduled = graph.addScheduledControlSource("score");
+    auto& rounded = graph.addControlSource("rounded");
+
+    // Sent in reverse; each lands on its exact frame, while the ordinary
+    // source's event is rounded down to the granularity
+    const std::uint64_t frames[] = {1001, 517, 300};
+    for (std::size_t i = 0; i < 3; ++i) {
+        EngineCommand command =
+            EngineCommand::setParameter("level", "level", static_cast<float>(i + 1));
+        scheduled.push(frames[i], command);
+    }
+    EngineCommand coarse = EngineCommand::setParameter("level", "level", 9.0F);
+    rounded.push(1400, coarse);
+
+    std::vector<float> rendered;
+    std::vector<float> block(BLOCK);
+    float* outputs[] = {block.data()};
+    for (unsigned int b = 0; b < 8; ++b) {
+        graph.process(nullptr, outputs, BLOCK);
+        rendered.insert(rendered.end(), block.begin(), block.end());
+    }
+    auto changesAt = [&](std::size_t frame, float before, float after) {
+        return rendered[frame - 1] == before && rendered[frame] == after;
+    };
+    expect(changesAt(300, 0.0F, 3.0F), "event at frame 300");
+    expect(changesAt(517, 3.0F, 2.0F), "event at frame 517");
+    expect(changesAt(1001, 2.0F, 1.0F), "event at frame 1001");
+    expect(changesAt(1344, 1.0F, 9.0F), "unscheduled event rounded to 1344");
+
+    // Already past: runs at the next block and is counted
+    EngineCommand late = EngineCommand::setParameter("level", "level", 5.0F);
+    scheduled.push(10, late);
+    graph.process(nullptr, outputs, BLOCK);
+    expect(block[0] == 5.0F, "late event at the start of the block");
+    expect(scheduled.getLateEvents() == 1, "late event counted");
+    scheduled.collectReplies();
+    rounded.collectReplies();
+
+    // The graph stamps its clock at every block
+    expect(graph.getClock().frameAt(std::chrono::steady_clock::now()).has_value(),
+           "engine clock running");
+}
+
+} // namespace
+
+int main() {
+    checkClock();
+    checkSchedule();
+    checkDispatch();
+    return finish("Scheduled events OK");
+}
@@ -0,0 +1,254 @@
+// ScoreRender.cpp
+//
+// Non-realtime score rendering: a binary OSC score (size-prefixed bundles
+// with time tags from the start) streamed through the OSC server into a
+// GraphProcessor, commands landing on their exact sample, the render ending
+// at the last bundle, late and failed commands counted; a bundle with more
+// commands than the engine's rings hold, all on its frame; then an
+// hour-scale rate check on a busier score (printed, not enforced).
+
+#include "core/AudioFileReader.h"
+#include "core/NrtRenderer.h"
+#include "modules/Oscillator.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+// Outputs its level parameter, so the frame a change lands on is visible
+class LevelModule : public Module<float> {
+public:
+    void process(const std::vector<std::optional<float*>>& /*inputs*/,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        std::fill(outputs[0], outputs[0] + numFrames, m_level);
+    }
+    [[nodiscard]] unsigned int getNumInputs() const override { return 0; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return 1; }
+    [[nodiscard]] std::string getInputName(unsigned int /*index*/) const override { return ""; }
+    [[nodiscard]] std::string getOutputName(unsigned int /*index*/) const override {
+        return "out";
+    }
+    void setParameter(const std::string& /*name*/, float value) override { m_level = value; }
+    [[nodiscard]] float getParameter(const std::string& /*name*/) const override {
+        return m_level;
+    }
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override {
+        return {"level"};
+    }
+    [[nodiscard]] std::string getName() const override { return "Level"; }
+    [[nodiscard]] std::string getDescription() const override { return "Constant"; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override {
+        return std::make_unique<LevelModule>(*this);
+    }
+    void reset() override { m_level = 0.0F; }
+
+private:
+    float m_level = 0.0F;
+};
+
+// Writes a score one bundle at a time
+class ScoreWriter {
+public:
+    explicit ScoreWriter(const std::string& path) : m_file(path, std::ios::binary) {}
+
+    void add(double seconds, const std::vector<std::vector<std::uint8_t>>& messages) {
+        std::vector<std::uint8_t> bundle(osc::BUNDLE_TAG.begin(), osc::BUNDLE_TAG.end());
+        const auto whole = static_cast<std::uint64_t>(seconds);
+        const auto fraction =
+            static_cast<std::uint64_t>(std::ldexp(seconds - static_cast<double>(whole), 32));
+        appendUint64(bundle, (whole << 32) | fraction);
+        for (const auto& message : messages) {
+            appendUint32(bundle, static_cast<std::uint32_t>(message.size()));
+            bundle.insert(bundle.end(), message.begin(), message.end());
+        }
+        std::vector<std::uint8_t> size;
+        appendUint32(size, static_cast<std::uint32_t>(bundle.size()));
+        m_file.write(reinterpret_cast<const char*>(size.data()), 4);
+        m_file.write(reinterpret_cast<const char*>(bundle.data()),
+                     static_cast<std::streamsize>(bundle.size()));
+    }
+
+private:
+    static void appendUint32(std::vector<std::uint8_t>& bytes, std::uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            bytes.push_back(static_cast<std::uint8_t>(value >> shift));
+        }
+    }
+    static void appendUint64(std::vector<std::uint8_t>& bytes, std::uint64_t value) {
+        appendUint32(bytes, static_cast<std::uint32_t>(value >> 32));
+        appendUint32(bytes, static_cast<std::uint32_t>(value));
+    }
+
+    std::ofstream m_file;
+};
+
+std::vector<float> readChannel(const std::string& path, unsigned int channel,
+                               unsigned int numChannels) {
+    AudioFileReader reader(path);
+    std::vector<std::vector<float>> buffers(numChannels,
+                                            std::vector<float>(reader.getNumFrames()));
+    std::vector<float*> pointers;
+    for (auto& buffer : buffers) {
+        pointers.push_back(buffer.data());
+    }
+    reader.read(pointers.data(), static_cast<unsigned int>(reader.getNumFrames()));
+    return buffers[channel];
+}
+
+void checkExactRender(const std::filesystem::path& directory) {
+    const std::string scorePath = (directory / "exact.osc").string();
+    const std::string outputPath = (directory / "exact.wav").string();
+    {
+        ScoreWriter score(scorePath);
+        score.add(0.0, {});
+        // Level on channel 1 from 0.5 s, halved at 1.25 s, freed at 1.5 s
+        score.add(0.5, {OscBuilder("/s_new").add("Level").add(1000).add(0).add(0).add("out")
+                            .add(1).add("level").add(0.5F).bytes()});
+        score.add(1.25, {OscBuilder("/n_set").add(1000).add("level").add(0.25F).bytes()});
+        // Out of order: due at 1.0 s, runs late at the next block
+        score.add(1.0, {OscBuilder("/n_set").add(1000).add("level").add(0.75F).bytes()});
+        score.add(1.5, {OscBuilder("/n_free").add(1000).bytes(),
+                        OscBuilder("/n_set").add(42).add("level").add(1.0F).bytes()});
+        score.add(2.0, {});
+    }
+
+    GraphProcessor engine(0, 2);
+    SynthDefJIT jit;
+    OscServer server(engine, jit);
+    server.registerModule("Level", [] { return std::make_unique<LevelModule>(); });
+    NrtRenderer::Config config;
+    config.scorePath = scorePath;
+    config.outputPath = outputPath;
+    config.sampleRate = 48000;
+    config.blockSize = 112; // no event falls on a block boundary
+    NrtRenderer renderer(engine, server, config);
+    const NrtRenderStats stats = renderer.render();
+
+    expect(stats.frames == 96000, "render ends at the last bundle, " +
+                                      std::to_string(stats.frames) + " frames");
+    expect(stats.bundles == 6, "six bundles");
+    expect(stats.failed == 1, "the /n_set of a missing node failed");
+    expect(stats.late == 1, "the out-of-order bundle ran late");
+
+    const std::vector<float> left = readChannel(outputPath, 0, 2);
+    const std::vector<float> right = readChannel(outputPath, 1, 2);
+    expect(std::all_of(left.begin(), left.end(), [](float s) { return s == 0.0F; }),
+           "channel 0 silent");
+    auto changesAt = [&](std::size_t frame, float before, float after) {
+        return right.size() > frame && right[frame - 1] == before && right[frame] == after;
+    };
+    expect(changesAt(24000, 0.0F, 0.5F), "node starts at frame 24000");
+    // The late bundle was read once the render had reached the block
+    // holding 1.25 s, and ran at its start
+    expect(changesAt(59920, 0.5F, 0.75F), "late change at the next block");
+    expect(changesAt(60000, 0.75F, 0.25F), "control change at frame 60000");
+    expect(changesAt(72000, 0.25F, 0.0F), "node freed at frame 72000");
+}
+
+void checkLargeBundle(const std::filesystem::path& directory) {
+    // Three times the ring, so the schedule behind it fills as well
+    constexpr int COMMANDS = 3 * static_cast<int>(ControlEventBus::PRODUCER_QUEUE_SIZE);
+    const std::string scorePath = (directory / "large.osc").string();
+    const std::string outputPath = (directory / "large.wav").string();
+    {
+        ScoreWriter score(scorePath);
+        score.add(0.0, {});
+        score.add(0.25, {OscBuilder("/s_new").add("Level").add(1000).bytes()});
+        // The last of the changes at 0.5 s wins
+        std::vector<std::vector<std::uint8_t>> changes;
+        for (int i = 1; i <= COMMANDS; ++i) {
+            changes.push_back(OscBuilder("/n_set").add(1000).add("level")
+                                  .add(static_cast<float>(i) / COMMANDS).bytes());
+        }
+        score.add(0.5, changes);
+        score.add(0.75, {OscBuilder("/n_set").add(1000).add("level").add(0.5F).bytes()});
+        score.add(1.0, {});
+    }
+
+    GraphProcessor engine(0, 1);
+    SynthDefJIT jit;
+    OscServer server(engine, jit);
+    server.registerModule("Level", [] { return std::make_unique<LevelModule>(); });
+    NrtRenderer::Config config;
+    config.scorePath = scorePath;
+    config.outputPath = outputPath;
+    config.blockSize = 112;
+    NrtRenderer renderer(engine, server, config);
+    const NrtRenderStats stats = renderer.render();
+
+    expect(stats.failed == 0, "large bundle fits, " + std::to_string(stats.failed) +
+                                  " commands failed");
+    expect(stats.late == 0, "large bundle on time, " + std::to_string(stats.late) + " late");
+    const std::vector<float> output = readChannel(outputPath, 0, 1);
+    auto changesAt = [&](std::size_t frame, float before, float after) {
+        return output.size() > frame && output[frame - 1] == before && output[frame] == after;
+    };
+    expect(changesAt(24000, 0.0F, 1.0F), "large bundle lands on frame 24000");
+    expect(changesAt(36000, 1.0F, 0.5F), "bundle after it on frame 36000");
+}
+
+void checkRate(const std::filesystem::path& directory) {
+    // A minute of music: eight voices changing pitch ten times a second
+    constexpr double SECONDS = 60.0;
+    const std::string scorePath = (directory / "rate.osc").string();
+    const std::string outputPath = (directory / "rate.wav").string();
+    {
+        ScoreWriter score(scorePath);
+        std::vector<std::vector<std::uint8_t>> start;
+        for (int voice = 0; voice < 8; ++voice) {
+            start.push_back(OscBuilder("/s_new").add("SineOsc").add(voice).add(0).add(0)
+                                .add("frequency").add(110.0F * static_cast<float>(voice + 1))
+                                .add("amplitude").add(0.1F).bytes());
+        }
+        score.add(0.0, start);
+        for (int step = 1; step < static_cast<int>(SECONDS * 10); ++step) {
+            score.add(step / 10.0,
+                      {OscBuilder("/n_set").add(step % 8).add("frequency")
+                           .add(220.0F + static_cast<float>(step % 50) * 10.0F).bytes()});
+        }
+        score.add(SECONDS, {});
+    }
+
+    GraphProcessor engine(0, 2);
+    SynthDefJIT jit;
+    OscServer server(engine, jit);
+    server.registerModule("SineOsc", [] { return std::make_unique<SineOsc<float>>(); });
+    NrtRenderer::Config config;
+    config.scorePath = scorePath;
+    config.outputPath = outputPath;
+    config.blockSize = 256;
+    NrtRenderer renderer(engine, server, config);
+    const NrtRenderStats stats = renderer.render();
+    expect(stats.failed == 0 && stats.late == 0, "busy score runs clean");
+    expect(stats.frames == static_cast<std::uint64_t>(SECONDS * 48000), "busy score length");
+    std::printf("%.0f s score in %.3f s: %.0fx realtime, an hour in %.0f s\n", SECONDS,
+                stats.wallSeconds, stats.realtimeFactor, 3600.0 / stats.realtimeFactor);
+}
+
+} // namespace
+
+int main() {
+    const auto directory = std::filesystem::temp_directory_path() / "tinysynth_score_render";
+    std::filesystem::create_directories(directory);
+    try {
+        checkExactRender(directory);
+        checkLargeBundle(directory);
+        checkRate(directory);
+    } catch (const std::exception& error) {
+        expect(false, error.what());
+    }
+    std::filesystem::remove_all(directory);
+    return finish("Score render OK");
+}
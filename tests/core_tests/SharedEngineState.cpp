@@ -0,0 +1,275 @@
+// SharedEngineState.cpp
+//
+// Engine state in POSIX shared memory: node status following commands,
+// output meters per block, control buses written by a client (another
+// process, through fork) reaching a mapped parameter, and seqlock readers
+// never seeing a half-published block while the engine renders; then the
+// read rate (printed, not enforced).
+
+#include "core/GraphProcessor.h"
+#include "core/SharedEngineState.h"
+#include "modules/FilterModule.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+// Outputs its level parameter on every output
+class LevelModule : public Module<float> {
+public:
+    explicit LevelModule(unsigned int numOutputs = 1) : m_numOutputs(numOutputs) {}
+
+    void process(const std::vector<std::optional<float*>>& /*inputs*/,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        for (float* output : outputs) {
+            std::fill(output, output + numFrames, m_level);
+        }
+    }
+    [[nodiscard]] unsigned int getNumInputs() const override { return 0; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return m_numOutputs; }
+    [[nodiscard]] std::string getInputName(unsigned int /*index*/) const override { return ""; }
+    [[nodiscard]] std::string getOutputName(unsigned int index) const override {
+        return "out" + std::to_string(index);
+    }
+    void setParameter(const std::string& /*name*/, float value) override { m_level = value; }
+    [[nodiscard]] float getParameter(const std::string& /*name*/) const override {
+        return m_level;
+    }
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override {
+        return {"level"};
+    }
+    [[nodiscard]] std::string getName() const override { return "Level"; }
+    [[nodiscard]] std::string getDescription() const override { return "Constant"; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override {
+        return std::make_unique<LevelModule>(*this);
+    }
+    void reset() override { m_level = 0.0F; }
+
+private:
+    unsigned int m_numOutputs;
+    float m_level = 0.0F;
+};
+
+std::string segmentName(const std::string& what) {
+    return "/tinysynth_test_" + what + "_" + std::to_string(::getpid());
+}
+
+void checkState() {
+    constexpr unsigned int BLOCK = 64;
+    const std::string name = segmentName("state");
+    GraphProcessor graph(0, 2);
+    graph.prepare(48000, BLOCK);
+    auto shared = SharedEngineState::create(name, 48000, 2);
+    graph.setSharedState(shared.get());
+    auto client = SharedEngineState::open(name);
+    expect(client->getNumChannels() == 2 && client->getSampleRate() == 48000, "client header");
+
+    std::vector<float> left(BLOCK);
+    std::vector<float> right(BLOCK);
+    float* outputs[] = {left.data(), right.data()};
+    auto render = [&] {
+        std::fill(left.begin(), left.end(), 0.0F);
+        std::fill(right.begin(), right.end(), 0.0F);
+        graph.process(nullptr, outputs, BLOCK);
+    };
+
+    // A node added and routed by commands shows up with both flags
+    std::unique_ptr<Module<float>> module = std::make_unique<LevelModule>();
+    module->setParameter("level", 0.5F);
+    graph.sendAddModule("level", module);
+    graph.sendConnectOutput("level", 0, 1);
+    render();
+    SharedEngineSnapshot snapshot = client->read();
+    expect(snapshot.frame == BLOCK, "published frame");
+    expect(snapshot.nodes.size() == 2, "graph input and level listed");
+    const auto level = std::find_if(snapshot.nodes.begin(), snapshot.nodes.end(),
+                                    [](const SharedNodeStatus& node) {
+                                        return node.name == "level";
+                                    });
+    expect(level != snapshot.nodes.end() &&
+               level->flags == (SharedEngineLayout::NODE_ACTIVE | SharedEngineLayout::NODE_ROUTED),
+           "level node active and routed");
+    expect(snapshot.meters.size() == 2 && snapshot.meters[0].peak == 0.0F &&
+               snapshot.meters[1].peak == 0.5F && std::fabs(snapshot.meters[1].rms - 0.5F) < 1e-6F,
+           "meters of the block");
+
+    // A bus written by another process sets the mapped parameter
+    expect(client->getControlBus(3) == 0.0F, "buses start at 0");
+    graph.mapControlBus(3, "level", "level");
+    render();
+    expect(right[0] == 0.5F, "mapping alone changes nothing");
+    const pid_t child = ::fork();
+    if (child == 0) {
+        try {
+            auto other = SharedEngineState::open(name);
+            other->setControlBus(3, 0.25F);
+            SharedEngineLayout::Meter meters[2];
+            ::_exit(other->readMeters(meters) == 2 * BLOCK && meters[1].peak == 0.5F ? 0 : 1);
+        } catch (...) {
+            ::_exit(2);
+        }
+    }
+    int status = -1;
+    ::waitpid(child, &status, 0);
+    expect(WIFEXITED(status) && WEXITSTATUS(status) == 0, "client process read the meters");
+    render();
+    expect(right[0] == 0.25F && right[BLOCK - 1] == 0.25F, "bus applied at block start");
+    expect(client->read().meters[1].peak == 0.25F, "meters follow");
+    expect(client->getControlBus(9999) == 0.0F, "out-of-range bus reads 0");
+
+    // Unrouted, then removed
+    graph.sendDisconnectOutput("level", 0, 1);
+    render();
+    snapshot = client->read();
+    expect(std::any_of(snapshot.nodes.begin(), snapshot.nodes.end(),
+                       [](const SharedNodeStatus& node) {
+                           return node.name == "level" &&
+                                  node.flags == SharedEngineLayout::NODE_ACTIVE;
+                       }),
+           "unrouted node");
+    graph.sendRemoveModule("level");
+    render();
+    graph.collectReplies();
+    snapshot = client->read();
+    expect(snapshot.nodes.size() == 1 && snapshot.nodes[0].name == GraphProcessor::INPUT_MODULE,
+           "removed node gone");
+
+    // The bus mapping outlives the module; another one under the name,
+    // without the parameter, must not make the audio thread throw
+    std::unique_ptr<Module<float>> replacement = std::make_unique<OnePoleFilter<float>>();
+    graph.sendAddModule("level", replacement);
+    try {
+        render();
+        client->setControlBus(3, 0.75F);
+        render();
+    } catch (const std::exception& error) {
+        expect(false, std::string("bus to a replaced module: ") + error.what());
+    }
+    graph.collectReplies();
+
+    bool threw = false;
+    try {
+        SharedEngineState::open(segmentName("missing"));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    expect(threw, "opening a missing segment throws");
+    // Blocks would read a meter past the engine's outputs
+    auto wide = SharedEngineState::create(segmentName("wide"), 48000, 3);
+    threw = false;
+    try {
+        graph.setSharedState(wide.get());
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    expect(threw, "state wider than the engine rejected");
+    wide.reset();
+    graph.setSharedState(nullptr);
+    shared.reset();
+    threw = false;
+    try {
+        SharedEngineState::open(name);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    expect(threw, "segment unlinked with the engine");
+}
+
+void checkConsistency() {
+    // Eight channels carry the same level, which changes every block; a
+    // torn read would show two levels at once
+    constexpr unsigned int BLOCK = 32;
+    constexpr unsigned int CHANNELS = 8;
+    constexpr int BLOCKS = 200000;
+    const std::string name = segmentName("seqlock");
+    GraphProcessor graph(0, CHANNELS);
+    graph.prepare(48000, BLOCK);
+    auto shared = SharedEngineState::create(name, 48000, CHANNELS);
+    graph.setSharedState(shared.get());
+    {
+        auto lock = graph.lockGraph();
+        graph.getSystem().addModule("level", std::make_unique<LevelModule>(CHANNELS));
+    }
+    for (unsigned int channel = 0; channel < CHANNELS; ++channel) {
+        graph.connectOutput("level", channel, channel);
+    }
+    graph.mapControlBus(0, "level", "level");
+
+    std::atomic<bool> done{false};
+    std::uint64_t reads = 0;
+    std::uint64_t torn = 0;
+    std::uint64_t backwards = 0;
+    std::thread reader([&] {
+        auto client = SharedEngineState::open(name);
+        SharedEngineLayout::Meter meters[CHANNELS];
+        std::uint64_t lastFrame = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+            const std::uint64_t frame = client->readMeters(meters);
+            for (const auto& meter : meters) {
+                if (meter.peak != meters[0].peak || meter.rms != meters[0].rms) {
+                    ++torn;
+                    break;
+                }
+            }
+            // Block n publishes level n (mod 1000) at frame (n + 1) * BLOCK
+            if (frame > 0 && meters[0].peak != static_cast<float>((frame / BLOCK - 1) % 1000)) {
+                ++torn;
+            }
+            backwards += frame < lastFrame ? 1 : 0;
+            lastFrame = frame;
+            ++reads;
+        }
+    });
+
+    std::vector<std::vector<float>> buffers(CHANNELS, std::vector<float>(BLOCK));
+    std::vector<float*> outputs;
+    for (auto& buffer : buffers) {
+        outputs.push_back(buffer.data());
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (int block = 0; block < BLOCKS; ++block) {
+        shared->setControlBus(0, static_cast<float>(block % 1000));
+        for (auto& buffer : buffers) {
+            std::fill(buffer.begin(), buffer.end(), 0.0F);
+        }
+        graph.process(nullptr, outputs.data(), BLOCK);
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    done = true;
+    reader.join();
+    expect(torn == 0, std::to_string(torn) + " torn reads");
+    expect(backwards == 0, "frames never go back");
+    expect(reads > 0, "reader ran");
+    std::printf("%d blocks published in %.3f s while %llu meter reads ran (%.0f ns per read)\n",
+                BLOCKS, seconds, static_cast<unsigned long long>(reads),
+                reads > 0 ? seconds / static_cast<double>(reads) * 1e9 : 0.0);
+}
+
+} // namespace
+
+int main() {
+    try {
+        checkState();
+        checkConsistency();
+    } catch (const std::exception& error) {
+        expect(false, error.what());
+    }
+    return finish("Shared engine state OK");
+}
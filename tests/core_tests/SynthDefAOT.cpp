@@ -0,0 +1,120 @@
+// SynthDefAOT.cpp
+//
+// Ahead-of-time SynthDefs play what the JIT plays. tests/data/aot_voice.scsyndef
+// holds the def sclang writes for
+//   SynthDef(\aot_voice, { |freq = 220, cutoff = 1200, amp = 0.2, unused = 0|
+//       var sig = Saw.ar(freq) + SinOsc.ar(freq * 0.5) + (In.ar(0, 2)[0] * 0.1);
+//       Out.ar(0, LPF.ar(sig, Lag.kr(cutoff, 0.05)) * amp)
+//   })
+// CMake builds it with tinysynth_add_synthdef into a shared library, loaded
+// through AOTSynthDefLibrary, and a static one linked in here, both with
+// -Werror (the unused control and In channel must not leave unused
+// variables behind). Both must match the JIT sample for sample across
+// control changes and uneven block sizes.
+
+#include "core/AOTSynthDefLibrary.h"
+#include "core/NodeStatePool.h"
+#include "core/SynthDefJIT.h"
+#include "core/SynthDefLoader.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+extern "C" const TinySynthAOTSynthDef* tinysynth_synthdef_aot_voice(void);
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+constexpr unsigned int FRAMES = 48000;
+constexpr float SAMPLE_RATE = 48000.0F;
+
+// Blocks of 64, 17, 128 and 1 frames in turn; cutoff and freq change on
+// the way, so the kernels recompute their coefficients mid-render
+std::vector<float> render(const CompiledSynthDef& def) {
+    NodeStatePool pool(def.layout, 1);
+    SynthNode node{&def, pool.acquire()};
+    const std::size_t cutoff = *def.layout.controlOffset("cutoff");
+    const std::size_t freq = *def.layout.controlOffset("freq");
+
+    std::vector<float> out(FRAMES, 0.0F);
+    std::vector<float> in0(FRAMES);
+    std::vector<float> in1(FRAMES, 1.0F);
+    for (unsigned int i = 0; i < FRAMES; ++i) {
+        in0[i] = static_cast<float>(i % 480) / 480.0F;
+    }
+    static const unsigned int blocks[] = {64, 17, 128, 1};
+    unsigned int block = 0;
+    for (unsigned int frame = 0; frame < FRAMES; ++block) {
+        if (block == 100) {
+            node.setControl(cutoff, 3000.0F);
+        } else if (block == 200) {
+            node.setControl(freq, 330.0F);
+        }
+        const unsigned int frames = std::min(blocks[block % 4], FRAMES - frame);
+        const float* inputs[] = {in0.data() + frame, in1.data() + frame};
+        float* outputs[] = {out.data() + frame};
+        node.process(inputs, outputs, static_cast<std::int32_t>(frames), SAMPLE_RATE);
+        frame += frames;
+    }
+    pool.release(node.state);
+    return out;
+}
+
+void compare(const std::vector<float>& reference, const std::vector<float>& result,
+             const std::string& name) {
+    unsigned int differing = 0;
+    for (unsigned int i = 0; i < FRAMES; ++i) {
+        differing += reference[i] != result[i] ? 1 : 0;
+    }
+    expect(differing == 0, name + ": " + std::to_string(differing) + " samples differ");
+}
+
+void checkAOT() {
+    const auto loaded = SynthDefLoader().loadFile(AOT_VOICE_SCSYNDEF);
+    expect(loaded.size() == 1 && loaded[0].unsupported.empty(), "fixture loads");
+    if (loaded.size() != 1) {
+        return;
+    }
+    SynthDefJIT jit;
+    const auto jitted = jit.compile(loaded[0].synthDef);
+    const std::vector<float> reference = render(*jitted);
+    expect(std::any_of(reference.begin(), reference.end(),
+                       [](float sample) { return std::fabs(sample) > 0.05F; }),
+           "JIT plays");
+
+    AOTSynthDefLibrary library(AOT_VOICE_LIBRARY);
+    const auto shared = library.find("aot_voice");
+    expect(shared != nullptr, "shared library exports aot_voice");
+    expect(library.find("missing") == nullptr, "unknown def not found");
+    const auto linked = AOTSynthDefLibrary::adapt(*tinysynth_synthdef_aot_voice());
+
+    for (const auto& [def, name] : {std::pair{shared.get(), "shared"},
+                                    std::pair{linked.get(), "static"}}) {
+        if (def == nullptr) {
+            continue;
+        }
+        expect(def->layout.size() == jitted->layout.size(),
+               std::string(name) + ": state size matches the JIT");
+        expect(def->numInputs == jitted->numInputs && def->numInputs == 2 &&
+                   def->numOutputs == jitted->numOutputs && def->numOutputs == 1,
+               std::string(name) + ": buses match the JIT");
+        compare(reference, render(*def), name);
+    }
+}
+
+} // namespace
+
+int main() {
+    try {
+        checkAOT();
+    } catch (const std::exception& error) {
+        expect(false, error.what());
+    }
+    return finish("SynthDef AOT OK");
+}
@@ -0,0 +1,693 @@
+// SynthDefDifferential.cpp
+//
+// Differential harness for the SynthDef JIT. Every SynthDef is rendered
+// twice with identical parameters: block by block through a ModularSystem
+// built from the Oscillator, filter and envelope modules, and through
+// SynthDefJIT, which runs the kernel UGens (Phasor, OnePole, Lag, LowPass,
+// ADSR) from the bitcode kernel library. The outputs
+// are compared (max abs error and SNR) and the speedup is reported. Runs
+// headless; no JACK server is needed.
+//
+//   synthdef_differential [--graphs N] [--seed S] [--frames N] [--block N]
+//                         [--max-error E] [--min-snr DB] [--fast-math]
+//                         [file.scsyndef ...]
+//
+// Without files a corpus of N random graphs is generated. A def passes when
+// its max abs error is within --max-error or its SNR reaches --min-snr.
+// Exits non-zero when any def fails. --fast-math compiles with
+// SynthDefJITOptions::fastMath. Both sides render with denormals flushed,
+// as they would on the audio thread. Before the corpus, In and Out buses
+// past SynthDefCompiler::MAX_BUSES must fail to compile.
+
+#include "core/DenormalGuard.h"
+#include "core/ModularSystem.h"
+#include "core/NodeStatePool.h"
+#include "core/SynthDefJIT.h"
+#include "core/SynthDefLoader.h"
+#include "core/UGenRegistry.h"
+#include "modules/EnvelopeModule.h"
+#include "modules/FilterModule.h"
+#include "modules/Oscillator.h"
+#include "modules/Phasor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace tinysynth;
+
+namespace {
+
+constexpr unsigned int NUM_BUSES = 2;
+
+struct Options {
+    unsigned int graphs = 50;
+    unsigned int seed = 1;
+    unsigned int frames = 48000;
+    unsigned int block = 64;
+    float sampleRate = 48000.0F;
+    double maxError = 1e-4;
+    double minSnr = 100.0;
+    bool fastMath = false;
+    std::vector<std::string> files;
+};
+
+// ---------------------------------------------------------------------------
+// Interpreted equivalents of the non-oscillator UGens
+
+// Fills in the Module boilerplate; subclasses only process
+class GraphModule : public Module<float> {
+public:
+    GraphModule(std::string name, unsigned int numInputs, unsigned int numOutputs)
+        : m_name(std::move(name)), m_numInputs(numInputs), m_numOutputs(numOutputs) {}
+
+    [[nodiscard]] unsigned int getNumInputs() const override { return m_numInputs; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return m_numOutputs; }
+    [[nodiscard]] std::string getInputName(unsigned int index) const override {
+        return "in" + std::to_string(index);
+    }
+    [[nodiscard]] std::string getOutputName(unsigned int index) const override {
+        return "out" + std::to_string(index);
+    }
+    void setParameter(const std::string& /*name*/, float /*value*/) override {}
+    [[nodiscard]] float getParameter(const std::string& /*name*/) const override { return 0; }
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override { return {}; }
+    [[nodiscard]] std::string getName() const override { return m_name; }
+    [[nodiscard]] std::string getDescription() const override { return m_name; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override { return nullptr; }
+    void reset() override {}
+
+private:
+    std::string m_name;
+    unsigned int m_numInputs;
+    unsigned int m_numOutputs;
+};
+
+// Control: one constant output per channel
+class ControlModule : public GraphModule {
+public:
+    explicit ControlModule(std::vector<float> values)
+        : GraphModule("Control", 0, static_cast<unsigned int>(values.size())),
+          m_values(std::move(values)) {}
+
+    void process(const std::vector<std::optional<float*>>& /*inputs*/,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        for (std::size_t k = 0; k < outputs.size(); ++k) {
+            std::fill(outputs[k], outputs[k] + numFrames, m_values[k]);
+        }
+    }
+
+private:
+    std::vector<float> m_values;
+};
+
+// Pure arithmetic UGens; unconnected inputs read their parameter
+class ArithmeticModule : public GraphModule {
+public:
+    using Operation = std::function<float(const float*)>;
+
+    ArithmeticModule(const std::string& type, std::vector<float> parameters, Operation op)
+        : GraphModule(type, static_cast<unsigned int>(parameters.size()), 1),
+          m_parameters(std::move(parameters)), m_op(std::move(op)) {}
+
+    void process(const std::vector<std::optional<float*>>& inputs,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        std::vector<float> args(m_parameters.size());
+        for (unsigned int i = 0; i < numFrames; ++i) {
+            for (std::size_t k = 0; k < args.size(); ++k) {
+                args[k] = inputs[k] ? (*inputs[k])[i] : m_parameters[k];
+            }
+            outputs[0][i] = m_op(args.data());
+        }
+    }
+
+private:
+    std::vector<float> m_parameters;
+    Operation m_op;
+};
+
+// Phasor: frequency parameter plus the signal on its input, as in the kernel
+class PhasorModule : public GraphModule {
+public:
+    PhasorModule(float frequency, float sampleRate)
+        : GraphModule("Phasor", 1, 1), m_frequency(frequency), m_sampleRate(sampleRate) {}
+
+    void process(const std::vector<std::optional<float*>>& inputs,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        for (unsigned int i = 0; i < numFrames; ++i) {
+            const float frequency = inputs[0] ? m_frequency + (*inputs[0])[i] : m_frequency;
+            outputs[0][i] =
+                detail::phasorComputeSample<float, float>(m_phase, frequency / m_sampleRate, 1.0F);
+        }
+    }
+
+private:
+    float m_frequency;
+    float m_sampleRate;
+    float m_phase = 0.0F;
+};
+
+// In and Out talk to the host buffers, like the JIT's inputs/outputs arrays
+class InModule : public GraphModule {
+public:
+    InModule(const float* const* buses, unsigned int bus, unsigned int channels)
+        : GraphModule("In", 0, channels), m_buses(buses), m_bus(bus) {}
+
+    void process(const std::vector<std::optional<float*>>& /*inputs*/,
+                 std::vector<float*>& outputs, unsigned int numFrames) override {
+        for (std::size_t k = 0; k < outputs.size(); ++k) {
+            std::copy(m_buses[m_bus + k], m_buses[m_bus + k] + numFrames, outputs[k]);
+        }
+    }
+
+private:
+    const float* const* m_buses;
+    unsigned int m_bus;
+};
+
+class OutModule : public GraphModule {
+public:
+    OutModule(float* const* buses, unsigned int bus, unsigned int channels)
+        : GraphModule("Out", channels, 0), m_buses(buses), m_bus(bus) {}
+
+    void process(const std::vector<std::optional<float*>>& inputs,
+                 std::vector<float*>& /*outputs*/, unsigned int numFrames) override {
+        for (std::size_t k = 0; k < inputs.size(); ++k) {
+            if (inputs[k]) {
+                for (unsigned int i = 0; i < numFrames; ++i) {
+                    m_buses[m_bus + k][i] += (*inputs[k])[i];
+                }
+            }
+        }
+    }
+
+private:
+    float* const* m_buses;
+    unsigned int m_bus;
+};
+
+// ---------------------------------------------------------------------------
+// SynthDef -> ModularSystem
+
+float parameterOf(const UGenInstance& ugen, const UGenSpec& spec, unsigned int index) {
+    auto it = ugen.parameters.find(spec.inputNames[index]);
+    return it != ugen.parameters.end() ? it->second : spec.inputDefault(index);
+}
+
+float parameterOr(const UGenInstance& ugen, const std::string& name, float fallback) {
+    auto it = ugen.parameters.find(name);
+    return it != ugen.parameters.end() ? it->second : fallback;
+}
+
+std::unique_ptr<Module<float>> makeOscillator(const std::string& type) {
+    if (type == "SineOsc") {
+        return std::make_unique<SineOsc<float>>();
+    }
+    if (type == "SawOsc") {
+        return std::make_unique<SawOsc<float>>();
+    }
+    if (type == "TriangleOsc") {
+        return std::make_unique<TriangleOsc<float>>();
+    }
+    if (type == "SquareOsc") {
+        return std::make_unique<SquareOsc<float>>();
+    }
+    if (type == "PulseOsc") {
+        return std::make_unique<PulseOsc<float>>();
+    }
+    return nullptr;
+}
+
+bool connected(const SynthDef& def, const UGenInstance& ugen, unsigned int input) {
+    const auto& connections = def.getConnections();
+    return std::any_of(connections.begin(), connections.end(), [&](const Connection& c) {
+        return c.toUGen == ugen.instanceName && c.inputIndex == input;
+    });
+}
+
+std::unique_ptr<Module<float>> makeFilter(const std::string& type) {
+    if (type == "OnePole") {
+        return std::make_unique<OnePoleFilter<float>>();
+    }
+    if (type == "Lag") {
+        return std::make_unique<LagFilter<float>>();
+    }
+    if (type == "LowPass") {
+        return std::make_unique<LowPassFilter<float>>();
+    }
+    return nullptr;
+}
+
+// Returns nullptr when the def uses a UGen without a module equivalent
+std::unique_ptr<Module<float>> makeModule(const SynthDef& def, const UGenInstance& ugen,
+                                          const float* const* inputs,
+                                          float* const* outputs, float sampleRate) {
+    const UGenSpec* spec = UGenRegistry::builtin().find(ugen.ugenType);
+    if (spec == nullptr) {
+        return nullptr;
+    }
+    const std::string& type = ugen.ugenType;
+
+    if (auto oscillator = makeOscillator(type)) {
+        oscillator->setParameter("frequency", parameterOf(ugen, *spec, 0));
+        oscillator->setParameter("amplitude", parameterOf(ugen, *spec, 1));
+        oscillator->setParameter("phase", parameterOr(ugen, "phase", 0.0F));
+        return oscillator;
+    }
+    if (auto filter = makeFilter(type)) {
+        // The filter modules read 0 from an unconnected input
+        if (!connected(def, ugen, 0) && parameterOf(ugen, *spec, 0) != 0.0F) {
+            return nullptr;
+        }
+        filter->setParameter(spec->inputNames[1], parameterOf(ugen, *spec, 1));
+        return filter;
+    }
+    if (type == "ADSR") {
+        auto envelope = std::make_unique<EnvelopeModule<float>>();
+        for (unsigned int i = 0; i < spec->inputNames.size(); ++i) {
+            envelope->setParameter(spec->inputNames[i], parameterOf(ugen, *spec, i));
+        }
+        return envelope;
+    }
+    if (type == "Phasor") {
+        return std::make_unique<PhasorModule>(parameterOf(ugen, *spec, 0), sampleRate);
+    }
+    if (type == "Control") {
+        const auto first = static_cast<std::size_t>(parameterOr(ugen, "index", 0));
+        const auto channels = static_cast<std::size_t>(parameterOr(ugen, "numChannels", 1));
+        std::vector<float> values;
+        for (std::size_t k = 0; k < channels; ++k) {
+            values.push_back(def.getControls().at(first + k).defaultValue);
+        }
+        return std::make_unique<ControlModule>(std::move(values));
+    }
+    if (type == "In") {
+        return std::make_unique<InModule>(
+            inputs, static_cast<unsigned int>(parameterOr(ugen, "bus", 0)),
+            static_cast<unsigned int>(parameterOr(ugen, "numChannels", 1)));
+    }
+    if (type == "Out") {
+        unsigned int channels = 0;
+        for (const auto& conn : def.getConnections()) {
+            if (conn.toUGen == ugen.instanceName) {
+                channels = std::max(channels, conn.inputIndex + 1);
+            }
+        }
+        return std::make_unique<OutModule>(
+            outputs, static_cast<unsigned int>(parameterOr(ugen, "bus", 0)), channels);
+    }
+
+    std::vector<float> parameters;
+    for (unsigned int i = 0; i < spec->inputNames.size(); ++i) {
+        parameters.push_back(parameterOf(ugen, *spec, i));
+    }
+    ArithmeticModule::Operation op;
+    if (type == "Add") {
+        op = [](const float* x) { return x[0] + x[1]; };
+    } else if (type == "Sub") {
+        op = [](const float* x) { return x[0] - x[1]; };
+    } else if (type == "Mul") {
+        op = [](const float* x) { return x[0] * x[1]; };
+    } else if (type == "Div") {
+        op = [](const float* x) { return x[0] / x[1]; };
+    } else if (type == "MulAdd") {
+        op = [](const float* x) { return x[0] * x[1] + x[2]; };
+    } else {
+        return nullptr;
+    }
+    return std::make_unique<ArithmeticModule>(type, std::move(parameters), std::move(op));
+}
+
+std::unique_ptr<ModularSystem<float>> buildModularSystem(const SynthDef& def,
+                                                         const float* const* inputs,
+                                                         float* const* outputs,
+                                                         float sampleRate) {
+    auto system = std::make_unique<ModularSystem<float>>();
+    for (const auto& ugen : def.getUGens()) {
+        auto module = makeModule(def, ugen, inputs, outputs, sampleRate);
+        if (!module) {
+            return nullptr;
+        }
+        system->addModule(ugen.instanceName, std::move(module));
+    }
+    for (const auto& conn : def.getConnections()) {
+        system->connect(conn.fromUGen, conn.outputIndex, conn.toUGen, conn.inputIndex);
+    }
+    return system;
+}
+
+// ---------------------------------------------------------------------------
+// Random graphs
+
+// A filter fed by `input`, or, one time in five, a Phasor it modulates
+template <typename Uniform, typename Chance>
+void addKernelUGen(SynthDef& def, const std::string& name,
+                   const std::pair<std::string, unsigned int>& input, const std::string& filter,
+                   Uniform& uniform, Chance& chance) {
+    if (chance(0.2)) {
+        def.addUGen({"Phasor", name, {{"frequency", uniform(20.0F, 2000.0F)}}});
+        if (chance(0.5)) {
+            def.addConnection({input.first, input.second, name, 0});
+        }
+        return;
+    }
+    if (filter == "OnePole") {
+        def.addUGen({filter, name, {{"coef", uniform(-0.95F, 0.95F)}}});
+    } else if (filter == "Lag") {
+        def.addUGen({filter, name, {{"lagTime", uniform(0.0005F, 0.05F)}}});
+    } else {
+        def.addUGen({filter, name, {{"frequency", uniform(50.0F, 12000.0F)}}});
+        // The freq control: coefficients computed from a wired input
+        if (chance(0.3)) {
+            def.addConnection({"ctl", 0, name, 1});
+        }
+    }
+    def.addConnection({input.first, input.second, name, 0});
+}
+
+// ADSR gated by a Phasor - 0.5 square, so every stage runs; the gate is
+// bit-identical on both sides, so the stages switch on the same samples
+template <typename Uniform>
+void addEnvelope(SynthDef& def, const std::string& name, Uniform& uniform) {
+    def.addUGen({"Phasor", name + "clock", {{"frequency", uniform(2.0F, 40.0F)}}});
+    def.addUGen({"Sub", name + "gate", {{"b", 0.5F}}});
+    def.addUGen({"ADSR", name,
+                 {{"attack", uniform(0.0F, 0.02F)},
+                  {"decay", uniform(0.0F, 0.05F)},
+                  {"sustain", uniform(0.1F, 0.9F)},
+                  {"release", uniform(0.0F, 0.05F)}}});
+    def.addConnection({name + "clock", 0, name + "gate", 0});
+    def.addConnection({name + "gate", 0, name, 0});
+}
+
+SynthDef randomGraph(std::mt19937& rng, unsigned int number) {
+    auto uniform = [&](float lo, float hi) {
+        return std::uniform_real_distribution<float>(lo, hi)(rng);
+    };
+    auto chance = [&](double p) { return std::bernoulli_distribution(p)(rng); };
+    auto pick = [&](std::size_t n) {
+        return std::uniform_int_distribution<std::size_t>(0, n - 1)(rng);
+    };
+
+    SynthDef def;
+    def.setName("random" + std::to_string(number));
+    def.addControl({"freq", uniform(100.0F, 1000.0F)});
+    def.addControl({"amp", uniform(0.1F, 0.5F)});
+    def.addUGen({"Control", "ctl", {{"index", 0}, {"numChannels", 2}}});
+
+    // Signals available as inputs: (ugen, output)
+    std::vector<std::pair<std::string, unsigned int>> signals{{"ctl", 1}};
+    static const char* const oscillators[] = {"SineOsc", "SawOsc", "TriangleOsc",
+                                              "SquareOsc", "PulseOsc"};
+    static const char* const operators[] = {"Add", "Sub", "Mul", "Div", "MulAdd"};
+    static const char* const filters[] = {"OnePole", "Lag", "LowPass"};
+    auto signal = [&] { return signals[pick(signals.size())]; };
+
+    const auto count = 3 + pick(10);
+    for (std::size_t n = 0; n < count; ++n) {
+        const std::string name = "u" + std::to_string(n);
+        if (n > 0 && chance(0.25)) {
+            addKernelUGen(def, name, signal(), filters[pick(3)], uniform, chance);
+        } else if (n > 0 && chance(0.1)) {
+            addEnvelope(def, name, uniform);
+        } else if (n == 0 || chance(0.5)) {
+            const std::string type = oscillators[pick(5)];
+            def.addUGen({type, name,
+                         {{"frequency", uniform(50.0F, 2000.0F)},
+                          {"amplitude", uniform(0.2F, 1.0F)},
+                          {"phase", uniform(0.0F, 6.0F)}}});
+            if (chance(0.3)) {
+                const auto& [from, output] = signals[pick(signals.size())];
+                def.addConnection({from, output, name, 0});
+            } else if (chance(0.2)) {
+                def.addConnection({"ctl", 0, name, 0});
+                def.setParameter(name, "frequency", 0.0F);
+            }
+            if (chance(0.3)) {
+                const auto& [from, output] = signals[pick(signals.size())];
+                def.addConnection({from, output, name, 1});
+            }
+        } else {
+            const std::string type = operators[pick(5)];
+            const unsigned int arity = type == "MulAdd" ? 3 : 2;
+            def.addUGen({type, name, {}});
+            for (unsigned int i = 0; i < arity; ++i) {
+                // Divisors stay constant and away from zero
+                const bool divisor = type == "Div" && i == 1;
+                if (!divisor && (i == 0 || chance(0.5))) {
+                    const auto& [from, output] = signals[pick(signals.size())];
+                    def.addConnection({from, output, name, i});
+                } else {
+                    const std::string input = UGenRegistry::builtin().find(type)->inputNames[i];
+                    def.setParameter(name, input, divisor ? uniform(1.0F, 4.0F)
+                                                          : uniform(-1.0F, 1.0F));
+                }
+            }
+        }
+        signals.emplace_back(name, 0);
+    }
+
+    def.addUGen({"Out", "out", {{"bus", 0}}});
+    def.addConnection({signals.back().first, 0, "out", 0});
+    const auto& [from, output] = signals[1 + pick(signals.size() - 1)];
+    def.addConnection({from, output, "out", 1});
+    return def;
+}
+
+// ---------------------------------------------------------------------------
+// Comparison
+
+struct Result {
+    double maxError = 0.0;
+    double snr = std::numeric_limits<double>::infinity();
+    double moduleSeconds = 0.0;
+    double jitSeconds = 0.0;
+};
+
+using Buses = std::vector<std::vector<float>>;
+
+void clear(Buses& buses) {
+    for (auto& bus : buses) {
+        std::fill(bus.begin(), bus.end(), 0.0F);
+    }
+}
+
+std::vector<float*> pointers(Buses& buses) {
+    std::vector<float*> result;
+    for (auto& bus : buses) {
+        result.push_back(bus.data());
+    }
+    return result;
+}
+
+// Returns false when the def cannot be interpreted
+bool compare(const SynthDef& def, SynthDefJIT& jit, const Options& options, Result& result) {
+    // A quiet ramp on the input buses for defs that read them
+    Buses inputs(NUM_BUSES, std::vector<float>(options.block));
+    for (unsigned int k = 0; k < NUM_BUSES; ++k) {
+        for (unsigned int i = 0; i < options.block; ++i) {
+            inputs[k][i] = 0.01F * static_cast<float>(i + k) / static_cast<float>(options.block);
+        }
+    }
+    std::vector<const float*> inputPointers;
+    for (const auto& bus : inputs) {
+        inputPointers.push_back(bus.data());
+    }
+    Buses moduleOut(NUM_BUSES, std::vector<float>(options.block));
+    Buses jitOut(NUM_BUSES, std::vector<float>(options.block));
+    std::vector<float*> moduleOutPointers = pointers(moduleOut);
+    std::vector<float*> jitOutPointers = pointers(jitOut);
+
+    auto system = buildModularSystem(def, inputPointers.data(), moduleOutPointers.data(),
+                                     options.sampleRate);
+    if (!system) {
+        return false;
+    }
+    system->prepare(static_cast<unsigned int>(options.sampleRate), options.block);
+
+    auto compiled = jit.compile(def);
+    if (compiled->numInputs > NUM_BUSES || compiled->numOutputs > NUM_BUSES) {
+        throw std::runtime_error("reaches past the harness buses");
+    }
+    NodeStatePool pool(compiled->layout, 1);
+    SynthNode node{compiled.get(), pool.acquire()};
+
+    double signal = 0.0;
+    double noise = 0.0;
+    using Clock = std::chrono::steady_clock;
+    for (unsigned int done = 0; done < options.frames; done += options.block) {
+        const unsigned int frames = std::min(options.block, options.frames - done);
+        clear(moduleOut);
+        clear(jitOut);
+
+        auto start = Clock::now();
+        system->process(frames);
+        auto middle = Clock::now();
+        node.process(inputPointers.data(), jitOutPointers.data(),
+                     static_cast<std::int32_t>(frames), options.sampleRate);
+        auto end = Clock::now();
+        result.moduleSeconds += std::chrono::duration<double>(middle - start).count();
+        result.jitSeconds += std::chrono::duration<double>(end - middle).count();
+
+        for (unsigned int k = 0; k < NUM_BUSES; ++k) {
+            for (unsigned int i = 0; i < frames; ++i) {
+                const double reference = moduleOut[k][i];
+                const double error = std::fabs(reference - jitOut[k][i]);
+                result.maxError = std::max(result.maxError, error);
+                signal += reference * reference;
+                noise += error * error;
+            }
+        }
+    }
+    if (noise > 0.0) {
+        result.snr = 10.0 * std::log10(signal / noise);
+    }
+    return true;
+}
+
+// In and Out buses are baked into the code: out-of-range ones must be
+// rejected by the compiler, and the buses a def reaches reported
+unsigned int checkBusBounds(SynthDefJIT& jit) {
+    auto io = [](float inBus, float inChannels, float outBus) {
+        SynthDef def;
+        def.setName("buses");
+        def.addUGen({"In", "in", {{"bus", inBus}, {"numChannels", inChannels}}});
+        def.addUGen({"Out", "out", {{"bus", outBus}}});
+        def.addConnection({"in", 0, "out", 0});
+        def.addConnection({"in", 0, "out", 1});
+        return def;
+    };
+    unsigned int failures = 0;
+    auto expectRejected = [&](const SynthDef& def, const char* what) {
+        try {
+            jit.compile(def);
+        } catch (const std::runtime_error&) {
+            return;
+        }
+        std::printf("%-24s FAILED: %s compiled\n", "bus bounds", what);
+        ++failures;
+    };
+    const auto last = static_cast<float>(SynthDefCompiler::MAX_BUSES);
+    expectRejected(io(0.0F, 1.0F, last - 1.0F), "stereo Out on the last bus");
+    expectRejected(io(last, 1.0F, 0.0F), "In past the last bus");
+    expectRejected(io(0.0F, -1.0F, 0.0F), "negative channel count");
+    expectRejected(io(-1.0F, 1.0F, 0.0F), "negative bus");
+    expectRejected(io(0.5F, 1.0F, 0.0F), "fractional bus");
+    expectRejected(io(std::numeric_limits<float>::quiet_NaN(), 1.0F, 0.0F), "NaN bus");
+
+    const auto compiled = jit.compile(io(3.0F, 2.0F, last - 2.0F));
+    if (compiled->numInputs != 5 || compiled->numOutputs != SynthDefCompiler::MAX_BUSES) {
+        std::printf("%-24s FAILED: reports %u inputs, %u outputs\n", "bus bounds",
+                    compiled->numInputs, compiled->numOutputs);
+        ++failures;
+    }
+    return failures;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--fast-math") {
+            options.fastMath = true;
+            continue;
+        }
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* next = nullptr;
+        if (arg.rfind("--", 0) == 0 && (next = value()) == nullptr) {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        if (arg == "--graphs") {
+            options.graphs = static_cast<unsigned int>(std::strtoul(next, nullptr, 10));
+        } else if (arg == "--seed") {
+            options.seed = static_cast<unsigned int>(std::strtoul(next, nullptr, 10));
+        } else if (arg == "--frames") {
+            options.frames = static_cast<unsigned int>(std::strtoul(next, nullptr, 10));
+        } else if (arg == "--block") {
+            options.block = static_cast<unsigned int>(std::strtoul(next, nullptr, 10));
+        } else if (arg == "--max-error") {
+            options.maxError = std::strtod(next, nullptr);
+        } else if (arg == "--min-snr") {
+            options.minSnr = std::strtod(next, nullptr);
+        } else if (next != nullptr) {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        } else {
+            options.files.push_back(arg);
+        }
+    }
+    return options.block > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    std::vector<SynthDef> corpus;
+    if (options.files.empty()) {
+        std::mt19937 rng(options.seed);
+        for (unsigned int n = 0; n < options.graphs; ++n) {
+            corpus.push_back(randomGraph(rng, n));
+        }
+    } else {
+        SynthDefLoader loader(UGenRegistry::builtin());
+        for (const auto& file : options.files) {
+            for (auto& loaded : loader.loadFile(file)) {
+                if (loaded.unsupported.empty()) {
+                    corpus.push_back(std::move(loaded.synthDef));
+                } else {
+                    std::printf("%-24s skipped: unsupported UGens\n",
+                                loaded.synthDef.getName().c_str());
+                }
+            }
+        }
+    }
+
+    ScopedDenormalGuard denormalGuard;
+    SynthDefJIT jit(SynthDefJITOptions{.fastMath = options.fastMath});
+    unsigned int failures = checkBusBounds(jit);
+    unsigned int compared = 0;
+    double moduleTotal = 0.0;
+    double jitTotal = 0.0;
+    std::printf("%-24s %6s %12s %10s %9s\n", "synthdef", "ugens", "max error", "snr dB",
+                "speedup");
+    for (const auto& def : corpus) {
+        Result result;
+        try {
+            if (!compare(def, jit, options, result)) {
+                std::printf("%-24s skipped: no module equivalent\n", def.getName().c_str());
+                continue;
+            }
+        } catch (const std::exception& e) {
+            std::printf("%-24s FAILED: %s\n", def.getName().c_str(), e.what());
+            ++failures;
+            continue;
+        }
+        ++compared;
+        moduleTotal += result.moduleSeconds;
+        jitTotal += result.jitSeconds;
+        const bool pass = result.maxError <= options.maxError || result.snr >= options.minSnr;
+        if (!pass) {
+            ++failures;
+        }
+        std::printf("%-24s %6zu %12.3g %10.1f %8.1fx%s\n", def.getName().c_str(),
+                    def.getUGens().size(), result.maxError, result.snr,
+                    result.moduleSeconds / result.jitSeconds, pass ? "" : "  FAILED");
+    }
+
+    std::printf("%u compared, %u failed, overall speedup %.1fx\n", compared, failures,
+                jitTotal > 0.0 ? moduleTotal / jitTotal : 0.0);
+    return failures == 0 ? 0 : 1;
+}
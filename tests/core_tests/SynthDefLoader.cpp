@@ -0,0 +1,242 @@
+// SynthDefLoader.cpp
+//
+// SCgf v2 parsing: a def laid out as sclang writes
+//   SynthDef(\tone, { |freq = 440, amp = 0.1| Out.ar(0, SinOsc.ar(freq) * amp) })
+// read from memory, from a file and from a directory into the same graph;
+// unsupported UGens reported; and malformed files (bad header, a negative
+// def count, truncation at every byte, trailing bytes, constant, parameter,
+// UGen and output indices out of range) rejected with std::runtime_error
+// instead of being read out of bounds.
+
+#include "core/SynthDefLoader.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+// The fields of the tone def the malformed cases change
+struct ToneDef {
+    std::int32_t ampParamIndex = 1;
+    std::int32_t phaseConstant = 0;
+    std::int32_t freqOutput = 0;  // Control output read by SinOsc
+    std::int32_t ampSource = 0;   // UGen the * reads amp from
+    std::int32_t ampOutput = 1;
+    std::string mulName = "BinaryOpUGen";
+};
+
+class ScgfWriter {
+public:
+    void i8(int value) { m_bytes.push_back(static_cast<std::uint8_t>(value)); }
+    void i16(int value) {
+        i8(value >> 8);
+        i8(value);
+    }
+    void i32(std::int32_t value) {
+        i16(value >> 16);
+        i16(value & 0xFFFF);
+    }
+    void f32(float value) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        i32(static_cast<std::int32_t>(bits));
+    }
+    void pstring(const std::string& value) {
+        i8(static_cast<int>(value.size()));
+        m_bytes.insert(m_bytes.end(), value.begin(), value.end());
+    }
+    // name, rate, inputs as (UGen or -1, output or constant), outputs
+    void ugen(const std::string& name, int rate, int specialIndex,
+              const std::vector<std::pair<std::int32_t, std::int32_t>>& inputs,
+              int numOutputs) {
+        pstring(name);
+        i8(rate);
+        i32(static_cast<std::int32_t>(inputs.size()));
+        i32(numOutputs);
+        i16(specialIndex);
+        for (const auto& [source, index] : inputs) {
+            i32(source);
+            i32(index);
+        }
+        for (int output = 0; output < numOutputs; ++output) {
+            i8(rate);
+        }
+    }
+    [[nodiscard]] const std::vector<std::uint8_t>& bytes() const { return m_bytes; }
+
+private:
+    std::vector<std::uint8_t> m_bytes;
+};
+
+std::vector<std::uint8_t> toneFile(const ToneDef& tone = {}) {
+    ScgfWriter w;
+    w.i8('S');
+    w.i8('C');
+    w.i8('g');
+    w.i8('f');
+    w.i32(2);
+    w.i16(1);
+    w.pstring("tone");
+    w.i32(1); // constants
+    w.f32(0.0F);
+    w.i32(2); // parameters
+    w.f32(440.0F);
+    w.f32(0.1F);
+    w.i32(2);
+    w.pstring("freq");
+    w.i32(0);
+    w.pstring("amp");
+    w.i32(tone.ampParamIndex);
+    w.i32(4); // UGens
+    w.ugen("Control", 1, 0, {}, 2);
+    w.ugen("SinOsc", 2, 0, {{0, tone.freqOutput}, {-1, tone.phaseConstant}}, 1);
+    w.ugen(tone.mulName, 2, 2, {{1, 0}, {tone.ampSource, tone.ampOutput}}, 1);
+    w.ugen("Out", 2, 0, {{-1, 0}, {2, 0}}, 0);
+    w.i16(0); // variants
+    return w.bytes();
+}
+
+bool rejects(const std::vector<std::uint8_t>& bytes) {
+    try {
+        SynthDefLoader().parse(bytes);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+bool hasConnection(const SynthDef& def, const std::string& from, unsigned int output,
+                   const std::string& to, unsigned int input) {
+    const auto& connections = def.getConnections();
+    return std::any_of(connections.begin(), connections.end(), [&](const Connection& c) {
+        return c.fromUGen == from && c.outputIndex == output && c.toUGen == to &&
+               c.inputIndex == input;
+    });
+}
+
+void checkTone(const std::vector<LoadedSynthDef>& defs, const std::string& where) {
+    expect(defs.size() == 1, where + ": one def");
+    if (defs.size() != 1) {
+        return;
+    }
+    const SynthDef& def = defs[0].synthDef;
+    expect(defs[0].unsupported.empty(), where + ": everything supported");
+    expect(def.getName() == "tone", where + ": name");
+    const auto& controls = def.getControls();
+    expect(controls.size() == 2 && controls[0].name == "freq" &&
+               controls[0].defaultValue == 440.0F && controls[1].name == "amp" &&
+               controls[1].defaultValue == 0.1F,
+           where + ": controls");
+    std::vector<std::string> types;
+    for (const auto& ugen : def.getUGens()) {
+        types.push_back(ugen.ugenType);
+    }
+    expect(types == std::vector<std::string>{"Control", "SineOsc", "Mul", "Out"},
+           where + ": UGen types");
+    expect(def.getConnections().size() == 4, where + ": four wires");
+    expect(hasConnection(def, "Control_0", 0, "SineOsc_1", 0) &&
+               hasConnection(def, "SineOsc_1", 0, "Mul_2", 0) &&
+               hasConnection(def, "Control_0", 1, "Mul_2", 1),
+           where + ": wires");
+    const auto& sine = def.getUGens()[1].parameters;
+    expect(sine.count("phase") == 1 && sine.at("phase") == 0.0F, where + ": constant input");
+    expect(def.topologicalOrder().size() == 4, where + ": acyclic");
+}
+
+void checkRoundTrip() {
+    const std::vector<std::uint8_t> bytes = toneFile();
+    checkTone(SynthDefLoader().parse(bytes), "memory");
+
+    const auto directory = std::filesystem::temp_directory_path() /
+                           ("tinysynth_loader_" + std::to_string(::getpid()));
+    std::filesystem::create_directories(directory);
+    const auto path = directory / "tone.scsyndef";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(bytes.data()),
+                   static_cast<std::streamsize>(bytes.size()));
+    }
+    std::ofstream(directory / "notes.txt") << "not a SynthDef";
+    checkTone(SynthDefLoader().loadFile(path.string()), "file");
+    checkTone(SynthDefLoader().loadDirectory(directory.string()), "directory");
+    std::filesystem::remove_all(directory);
+
+    // A UGen without a tinysynth equivalent is dropped and named; the wire
+    // to it is dropped with it
+    ToneDef unknown;
+    unknown.mulName = "Pan2";
+    const auto loaded = SynthDefLoader().parse(toneFile(unknown));
+    expect(loaded.size() == 1 && loaded[0].unsupported == std::vector<std::string>{"Pan2"},
+           "unsupported UGen reported");
+    expect(loaded.size() == 1 && loaded[0].synthDef.getUGens().size() == 3,
+           "unsupported UGen dropped");
+}
+
+void checkMalformed() {
+    std::vector<std::uint8_t> bytes = toneFile();
+    std::vector<std::uint8_t> magic = bytes;
+    magic[0] = 'X';
+    expect(rejects(magic), "bad magic");
+    std::vector<std::uint8_t> version = bytes;
+    version[7] = 1;
+    expect(rejects(version), "version 1");
+    std::vector<std::uint8_t> count = bytes;
+    count[8] = 0xFF;
+    count[9] = 0xFF;
+    expect(rejects(count), "negative def count");
+    std::vector<std::uint8_t> trailing = bytes;
+    trailing.push_back(0);
+    expect(rejects(trailing), "trailing bytes after the last def");
+    bool allRejected = true;
+    for (std::size_t size = 0; size < bytes.size(); ++size) {
+        allRejected = allRejected &&
+                      rejects(std::vector<std::uint8_t>(bytes.begin(),
+                                                        bytes.begin() +
+                                                            static_cast<std::ptrdiff_t>(size)));
+    }
+    expect(allRejected, "every truncation rejected");
+
+    ToneDef tone;
+    tone.ampParamIndex = 2;
+    expect(rejects(toneFile(tone)), "parameter index out of range");
+    tone = {};
+    tone.phaseConstant = 1;
+    expect(rejects(toneFile(tone)), "constant index out of range");
+    tone = {};
+    tone.ampSource = 3;
+    expect(rejects(toneFile(tone)), "input from a later UGen");
+    tone = {};
+    tone.ampOutput = 2;
+    expect(rejects(toneFile(tone)), "Control has two outputs");
+    tone = {};
+    tone.freqOutput = -1;
+    expect(rejects(toneFile(tone)), "negative output index");
+    // Checked even when the reading UGen is dropped
+    tone = {};
+    tone.mulName = "Pan2";
+    tone.ampOutput = 7;
+    expect(rejects(toneFile(tone)), "out-of-range output read by a dropped UGen");
+}
+
+} // namespace
+
+int main() {
+    try {
+        checkRoundTrip();
+        checkMalformed();
+    } catch (const std::exception& error) {
+        expect(false, error.what());
+    }
+    return finish("SynthDef loader OK");
+}
@@ -0,0 +1,189 @@
+// SynthDefOptimizer.cpp
+//
+// Graph rewrites keep what a def plays: every def is rendered through the
+// JIT as written and as optimized, and the outputs must match sample for
+// sample. Duplicate pure UGens merge; stateful ones (noise, oscillators)
+// never do, so two noise sources stay uncorrelated; dead UGens go, while
+// defs that only play through ReplaceOut keep their whole graph.
+
+#include "core/NodeStatePool.h"
+#include "core/SynthDefJIT.h"
+#include "core/SynthDefOptimizer.h"
+#include "core/UGenRegistry.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace tinysynth;
+using namespace tinysynth::test;
+
+namespace {
+
+constexpr unsigned int FRAMES = 4096;
+constexpr unsigned int BLOCK = 64;
+constexpr float SAMPLE_RATE = 48000.0F;
+
+using Channels = std::vector<std::vector<float>>;
+
+Channels render(const SynthDef& def, bool optimizeGraph, unsigned int numOutputs) {
+    SynthDefJIT jit(SynthDefJITOptions{.optimizeGraph = optimizeGraph});
+    const auto compiled = jit.compile(def);
+    NodeStatePool pool(compiled->layout, 1);
+    SynthNode node{compiled.get(), pool.acquire()};
+    Channels out(numOutputs, std::vector<float>(FRAMES, 0.0F));
+    std::vector<float*> outputs(numOutputs);
+    for (unsigned int frame = 0; frame < FRAMES; frame += BLOCK) {
+        for (unsigned int channel = 0; channel < numOutputs; ++channel) {
+            outputs[channel] = out[channel].data() + frame;
+        }
+        node.process(nullptr, outputs.data(), BLOCK, SAMPLE_RATE);
+    }
+    pool.release(node.state);
+    return out;
+}
+
+bool silent(const std::vector<float>& samples) {
+    return std::all_of(samples.begin(), samples.end(), [](float s) { return s == 0.0F; });
+}
+
+unsigned int count(const SynthDef& def, const std::string& type) {
+    const auto& ugens = def.getUGens();
+    return static_cast<unsigned int>(std::count_if(
+        ugens.begin(), ugens.end(), [&](const UGenInstance& u) { return u.ugenType == type; }));
+}
+
+// Optimizes `def`, checks the stats, and compares both renders
+SynthDef checkPreserved(const SynthDef& def, const OptimizationStats& expected,
+                        unsigned int numOutputs) {
+    OptimizationStats stats;
+    SynthDef optimized = SynthDefOptimizer().optimize(def, &stats);
+    const std::string name = def.getName();
+    expect(stats.folded == expected.folded && stats.reduced == expected.reduced &&
+               stats.merged == expected.merged && stats.removed == expected.removed,
+           name + ": folded " + std::to_string(stats.folded) + ", reduced " +
+               std::to_string(stats.reduced) + ", merged " + std::to_string(stats.merged) +
+               ", removed " + std::to_string(stats.removed));
+    const Channels reference = render(def, false, numOutputs);
+    const Channels result = render(def, true, numOutputs);
+    expect(reference == result, name + ": optimized output differs");
+    expect(!silent(reference[0]), name + ": plays");
+    return optimized;
+}
+
+SynthDef sine(SynthDef def, const std::string& name, float frequency) {
+    def.addUGen({"SineOsc", name, {{"frequency", frequency}, {"amplitude", 1.0F}}});
+    return def;
+}
+
+void checkMerge() {
+    // sin * 0.5 computed twice, plus a constant gain 2 * 0.25 folded away
+    SynthDef def;
+    def.setName("duplicates");
+    def = sine(def, "sine", 220.0F);
+    def.addUGen({"Mul", "half1", {{"a", 0.0F}, {"b", 0.5F}}});
+    def.addUGen({"Mul", "half2", {{"a", 0.0F}, {"b", 0.5F}}});
+    def.addUGen({"Mul", "gain", {{"a", 2.0F}, {"b", 0.25F}}});
+    def.addUGen({"MulAdd", "sum", {{"in", 0.0F}, {"mul", 0.0F}, {"add", 0.0F}}});
+    def.addUGen({"Out", "out", {{"bus", 0.0F}}});
+    def.addConnection({"sine", 0, "half1", 0});
+    def.addConnection({"sine", 0, "half2", 0});
+    def.addConnection({"half1", 0, "sum", 0});
+    def.addConnection({"gain", 0, "sum", 1});
+    def.addConnection({"half2", 0, "sum", 2});
+    def.addConnection({"sum", 0, "out", 0});
+    const SynthDef optimized =
+        checkPreserved(def, {.folded = 1, .merged = 1}, 1);
+    expect(count(optimized, "Mul") == 1, "duplicates: one Mul left");
+}
+
+void checkStateful() {
+    // Identical inputs, but each noise source has its own state
+    SynthDef noise;
+    noise.setName("noise");
+    noise.addUGen({"WhiteNoise", "left", {}});
+    noise.addUGen({"WhiteNoise", "right", {}});
+    noise.addUGen({"Out", "out", {{"bus", 0.0F}}});
+    noise.addConnection({"left", 0, "out", 0});
+    noise.addConnection({"right", 0, "out", 1});
+    OptimizationStats stats;
+    const SynthDef optimized = SynthDefOptimizer().optimize(noise, &stats);
+    expect(stats.merged == 0 && count(optimized, "WhiteNoise") == 2, "noise sources kept apart");
+    const Channels out = render(noise, true, 2);
+    double left = 0.0;
+    double right = 0.0;
+    double product = 0.0;
+    for (unsigned int i = 0; i < FRAMES; ++i) {
+        left += out[0][i] * out[0][i];
+        right += out[1][i] * out[1][i];
+        product += out[0][i] * out[1][i];
+    }
+    const double correlation = product / std::sqrt(left * right);
+    expect(left > 0.0 && right > 0.0 && std::fabs(correlation) < 0.1,
+           "noise channels uncorrelated, correlation " + std::to_string(correlation));
+
+    // Two oscillators on the same frequency stay two oscillators
+    SynthDef oscillators;
+    oscillators.setName("oscillators");
+    oscillators = sine(oscillators, "a", 330.0F);
+    oscillators = sine(oscillators, "b", 330.0F);
+    oscillators.addUGen({"Out", "out", {{"bus", 0.0F}}});
+    oscillators.addConnection({"a", 0, "out", 0});
+    oscillators.addConnection({"b", 0, "out", 1});
+    checkPreserved(oscillators, {}, 2);
+}
+
+void checkDead() {
+    SynthDef def;
+    def.setName("dead");
+    def = sine(def, "heard", 440.0F);
+    def = sine(def, "unheard", 550.0F);
+    def.addUGen({"Mul", "unused", {{"a", 0.0F}, {"b", 0.3F}}});
+    def.addUGen({"Out", "out", {{"bus", 0.0F}}});
+    def.addConnection({"unheard", 0, "unused", 0});
+    def.addConnection({"heard", 0, "out", 0});
+    const SynthDef optimized = checkPreserved(def, {.removed = 2}, 1);
+    expect(optimized.getUGens().size() == 2, "dead: two UGens left");
+
+    // No Out: ReplaceOut is the side effect that keeps the graph alive
+    SynthDef replace;
+    replace.setName("replace");
+    replace = sine(replace, "tone", 440.0F);
+    replace.addUGen({"Mul", "gain", {{"a", 0.0F}, {"b", 0.5F}}});
+    replace.addUGen({"ReplaceOut", "out", {{"bus", 0.0F}}});
+    replace.addConnection({"tone", 0, "gain", 0});
+    replace.addConnection({"gain", 0, "out", 0});
+    const SynthDef kept = checkPreserved(replace, {}, 1);
+    expect(kept.getUGens().size() == 3, "ReplaceOut graph kept whole");
+
+    // Nothing at all to hear: emptied
+    SynthDef mute;
+    mute.setName("mute");
+    mute = sine(mute, "tone", 440.0F);
+    OptimizationStats stats;
+    expect(SynthDefOptimizer().optimize(mute, &stats).getUGens().empty() && stats.removed == 1,
+           "def without side effects emptied");
+
+    const UGenRegistry& registry = UGenRegistry::builtin();
+    const SCUGenMapping* replaceOut = registry.findSC("ReplaceOut", 0);
+    const SCUGenMapping* offsetOut = registry.findSC("OffsetOut", 0);
+    expect(replaceOut != nullptr && replaceOut->type == "ReplaceOut" && offsetOut != nullptr &&
+               offsetOut->type == "Out",
+           "ReplaceOut and OffsetOut load");
+}
+
+} // namespace
+
+int main() {
+    try {
+        checkMerge();
+        checkStateful();
+        checkDead();
+    } catch (const std::exception& error) {
+        expect(false, error.what());
+    }
+    return finish("SynthDef optimizer OK");
+}
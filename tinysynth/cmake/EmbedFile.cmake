@@ -0,0 +1,22 @@
+# Writes the bytes of INPUT into OUTPUT as a C++ source file defining
+#   extern "C" const unsigned char SYMBOL[];
+#   extern "C" const std::size_t SYMBOL_size;
+# Usage: cmake -DINPUT=<file> -DOUTPUT=<file.cpp> -DSYMBOL=<name> -P EmbedFile.cmake
+
+file(READ ${INPUT} content HEX)
+string(LENGTH "${content}" hexLength)
+math(EXPR size "${hexLength} / 2")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${content}")
+
+file(WRITE ${OUTPUT}
+"// Generated from ${INPUT} by EmbedFile.cmake, do not edit
+#include <cstddef>
+
+extern \"C\" {
+extern const unsigned char ${SYMBOL}[];
+extern const std::size_t ${SYMBOL}_size;
+}
+
+alignas(16) const unsigned char ${SYMBOL}[] = {${bytes}};
+const std::size_t ${SYMBOL}_size = ${size};
+")
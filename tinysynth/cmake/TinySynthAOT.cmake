@@ -0,0 +1,43 @@
+# TinySynthAOT.cmake
+#
+# tinysynth_add_synthdef(<target> <SHARED|STATIC> SCSYNDEF <file>
+#                        [SYNTHDEF <name>])
+#
+# Compiles the SynthDefs of a .scsyndef file ahead of time (see
+# SynthDefCodeGenerator) into a library exporting the C ABI of
+# core/TinySynthAOT.h. SHARED libraries load at runtime through
+# AOTSynthDefLibrary; STATIC ones link into hosts without LLVM.
+
+function(tinysynth_add_synthdef target type)
+    cmake_parse_arguments(ARG "" "SCSYNDEF;SYNTHDEF" "" ${ARGN})
+    if(NOT ARG_SCSYNDEF)
+        message(FATAL_ERROR "tinysynth_add_synthdef: SCSYNDEF is required")
+    endif()
+    get_filename_component(scsyndef ${ARG_SCSYNDEF} ABSOLUTE)
+
+    set(source ${CMAKE_CURRENT_BINARY_DIR}/${target}.cpp)
+    set(select)
+    if(ARG_SYNTHDEF)
+        set(select --synthdef ${ARG_SYNTHDEF})
+    endif()
+    add_custom_command(
+        OUTPUT ${source}
+        COMMAND synthdef_codegen ${scsyndef} ${select} -o ${source}
+        DEPENDS synthdef_codegen ${scsyndef}
+        COMMENT "Generating SynthDef source ${target}.cpp"
+    )
+
+    add_library(${target} ${type} ${source})
+    target_include_directories(${target} PRIVATE ${TINYSYNTH_SOURCE_DIR}/src)
+    set_target_properties(${target} PROPERTIES
+        POSITION_INDEPENDENT_CODE ON
+        CXX_VISIBILITY_PRESET hidden
+    )
+    # Keep the arithmetic identical to the JIT: no FMA contraction
+    if(CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang")
+        target_compile_options(${target} PRIVATE -ffp-contract=off)
+    endif()
+    if(UNIX)
+        target_link_libraries(${target} PRIVATE m)
+    endif()
+endfunction()
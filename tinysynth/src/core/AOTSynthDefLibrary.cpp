@@ -0,0 +1,58 @@
+// AOTSynthDefLibrary.cpp
+#include "AOTSynthDefLibrary.h"
+#include "SynthDefCodeGenerator.h"
+#include <dlfcn.h>
+#include <stdexcept>
+
+namespace tinysynth {
+
+AOTSynthDefLibrary::AOTSynthDefLibrary(const std::string &path)
+    : m_handle(dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL)) {
+  if (m_handle == nullptr) {
+    throw std::runtime_error("Failed to open SynthDef library " + path + ": " +
+                             dlerror());
+  }
+}
+
+AOTSynthDefLibrary::~AOTSynthDefLibrary() { dlclose(m_handle); }
+
+std::shared_ptr<const CompiledSynthDef>
+AOTSynthDefLibrary::find(const std::string &synthDefName) const {
+  using Accessor = const TinySynthAOTSynthDef *(*)();
+  const std::string symbol = SynthDefCodeGenerator::symbolName(synthDefName);
+  auto accessor = reinterpret_cast<Accessor>(dlsym(m_handle, symbol.c_str()));
+  if (accessor == nullptr) {
+    return nullptr;
+  }
+  return adapt(*accessor());
+}
+
+std::shared_ptr<const CompiledSynthDef>
+AOTSynthDefLibrary::adapt(const TinySynthAOTSynthDef &synthDef) {
+  if (synthDef.abiVersion != TINYSYNTH_AOT_ABI_VERSION) {
+    throw std::runtime_error("SynthDef " + std::string(synthDef.name) +
+                             " was built for AOT ABI version " +
+                             std::to_string(synthDef.abiVersion));
+  }
+
+  // Rebuilding the layout field by field reproduces the generated offsets
+  StateLayout layout;
+  for (std::uint32_t i = 0; i < synthDef.numFields; ++i) {
+    const TinySynthAOTField &field = synthDef.fields[i];
+    if (layout.addField(field.owner, field.name, field.initialValue) !=
+        field.offset) {
+      throw std::runtime_error("Unexpected state layout in SynthDef " +
+                               std::string(synthDef.name));
+    }
+  }
+  if (layout.size() != synthDef.stateSize) {
+    throw std::runtime_error("Unexpected state size in SynthDef " +
+                             std::string(synthDef.name));
+  }
+  CompiledSynthDef result{synthDef.name, synthDef.process, std::move(layout)};
+  result.numInputs = synthDef.numInputs;
+  result.numOutputs = synthDef.numOutputs;
+  return std::make_shared<const CompiledSynthDef>(std::move(result));
+}
+
+} // namespace tinysynth
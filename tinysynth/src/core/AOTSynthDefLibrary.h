@@ -0,0 +1,31 @@
+// AOTSynthDefLibrary.h
+#pragma once
+
+#include "SynthDefJIT.h"
+#include "TinySynthAOT.h"
+#include <memory>
+#include <string>
+
+namespace tinysynth {
+
+// A shared library of ahead-of-time compiled SynthDefs (see
+// SynthDefCodeGenerator). Its defs run through the same SynthNode and
+// NodeStatePool as JIT-compiled ones; the library must outlive them.
+class AOTSynthDefLibrary {
+public:
+    explicit AOTSynthDefLibrary(const std::string& path);
+    AOTSynthDefLibrary(const AOTSynthDefLibrary&) = delete;
+    AOTSynthDefLibrary& operator=(const AOTSynthDefLibrary&) = delete;
+    ~AOTSynthDefLibrary();
+
+    // nullptr when the library does not export the def
+    [[nodiscard]] std::shared_ptr<const CompiledSynthDef> find(const std::string& synthDefName) const;
+
+    // Adapts a descriptor, e.g. from a def linked statically into the host
+    static std::shared_ptr<const CompiledSynthDef> adapt(const TinySynthAOTSynthDef& synthDef);
+
+private:
+    void* m_handle = nullptr;
+};
+
+} // namespace tinysynth
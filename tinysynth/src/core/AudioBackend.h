@@ -0,0 +1,50 @@
+// AudioBackend.h
+#pragma once
+
+namespace tinysynth {
+
+struct MidiMessage;
+
+// What a backend drives once per block: the engine graph, a single
+// SynthDef, a test signal, ...
+class AudioProcessor {
+public:
+    virtual ~AudioProcessor() = default;
+
+    // Called by start(), off the audio thread, before the first block
+    virtual void prepare(unsigned int sampleRate, unsigned int maxBlockSize) = 0;
+
+    // Renders numFrames (at most maxBlockSize) samples. Outputs arrive
+    // zeroed, so processors may mix into them; inputs hold the backend's
+    // capture channels.
+    virtual void process(const float* const* inputs, float* const* outputs,
+                         unsigned int numFrames) = 0;
+
+    // Frames by which the outputs trail the inputs they were rendered
+    // from; backends report it to the host. Valid after prepare().
+    [[nodiscard]] virtual unsigned int getLatency() const { return 0; }
+
+    // MIDI input of backends that have it, on the audio thread, before the
+    // process() call for the block the message's offset refers to. Messages
+    // of one block arrive in time order.
+    virtual void receiveMidi(const MidiMessage& /*message*/) {}
+};
+
+// Source of the audio clock. Realtime backends (JACK) call the processor
+// from their own thread between start() and stop(); offline ones render
+// inside start() as fast as they can.
+class AudioBackend {
+public:
+    virtual ~AudioBackend() = default;
+
+    // The processor must outlive the backend's use of it, i.e. until stop()
+    virtual void start(AudioProcessor& processor) = 0;
+    virtual void stop() = 0;
+
+    [[nodiscard]] virtual unsigned int getSampleRate() const = 0;
+    [[nodiscard]] virtual unsigned int getBufferSize() const = 0;
+    [[nodiscard]] virtual unsigned int getNumInputs() const = 0;
+    [[nodiscard]] virtual unsigned int getNumOutputs() const = 0;
+};
+
+} // namespace tinysynth
@@ -0,0 +1,133 @@
+// AudioFileReader.cpp
+#include "AudioFileReader.h"
+#include "Interleave.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace tinysynth {
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little,
+              "WAV samples are read in host byte order");
+
+constexpr std::uint32_t UINT32_LIMIT = 0xFFFFFFFF;
+constexpr std::uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+constexpr std::uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+std::uint64_t little(const std::uint8_t *bytes, unsigned int size) {
+  std::uint64_t value = 0;
+  for (unsigned int i = 0; i < size; ++i) {
+    value |= std::uint64_t{bytes[i]} << (8 * i);
+  }
+  return value;
+}
+
+bool isTag(const std::uint8_t *bytes, const char *fourcc) {
+  return std::memcmp(bytes, fourcc, 4) == 0;
+}
+
+} // namespace
+
+AudioFileReader::AudioFileReader(const std::string &path) : m_path(path) {
+  m_file = std::fopen(path.c_str(), "rb");
+  if (m_file == nullptr) {
+    throw std::runtime_error("Failed to open " + path + " for reading");
+  }
+  try {
+    readHeader();
+  } catch (...) {
+    std::fclose(m_file);
+    m_file = nullptr;
+    throw;
+  }
+  m_samples.resize(static_cast<std::size_t>(CHUNK_FRAMES) * m_numChannels);
+  m_channelOffsets.resize(m_numChannels);
+}
+
+AudioFileReader::~AudioFileReader() {
+  if (m_file != nullptr) {
+    std::fclose(m_file);
+  }
+}
+
+void AudioFileReader::readHeader() {
+  const std::string invalid = m_path + " is not a WAV file";
+  std::uint8_t riff[12];
+  if (std::fread(riff, 1, sizeof(riff), m_file) != sizeof(riff) ||
+      !(isTag(riff, "RIFF") || isTag(riff, "RF64")) || !isTag(riff + 8, "WAVE")) {
+    throw std::runtime_error(invalid);
+  }
+
+  // ds64 comes first in RF64 and holds the data size the data chunk cannot
+  std::uint64_t ds64DataSize = 0;
+  bool haveFormat = false;
+  for (;;) {
+    std::uint8_t chunk[8];
+    if (std::fread(chunk, 1, sizeof(chunk), m_file) != sizeof(chunk)) {
+      throw std::runtime_error(m_path + " has no data chunk");
+    }
+    const std::uint64_t size = little(chunk + 4, 4);
+
+    if (isTag(chunk, "data")) {
+      if (!haveFormat) {
+        throw std::runtime_error(invalid);
+      }
+      const std::uint64_t dataSize = size == UINT32_LIMIT ? ds64DataSize : size;
+      m_numFrames = dataSize / (std::uint64_t{4} * m_numChannels);
+      return;
+    }
+
+    std::vector<std::uint8_t> body(static_cast<std::size_t>(size));
+    if (std::fread(body.data(), 1, body.size(), m_file) != body.size() ||
+        ((size & 1) != 0 && std::fseek(m_file, 1, SEEK_CUR) != 0)) {
+      throw std::runtime_error(invalid);
+    }
+    if (isTag(chunk, "ds64") && size >= 16) {
+      ds64DataSize = little(body.data() + 8, 8);
+    } else if (isTag(chunk, "fmt ") && size >= 16) {
+      std::uint16_t format = static_cast<std::uint16_t>(little(body.data(), 2));
+      if (format == WAVE_FORMAT_EXTENSIBLE && size >= 26) {
+        // The subformat GUID starts with the format tag
+        format = static_cast<std::uint16_t>(little(body.data() + 24, 2));
+      }
+      m_numChannels = static_cast<unsigned int>(little(body.data() + 2, 2));
+      m_sampleRate = static_cast<unsigned int>(little(body.data() + 4, 4));
+      const auto bits = static_cast<unsigned int>(little(body.data() + 14, 2));
+      if (format != WAVE_FORMAT_IEEE_FLOAT || bits != 32 || m_numChannels == 0) {
+        throw std::runtime_error(m_path + " is not 32-bit float audio");
+      }
+      haveFormat = true;
+    }
+  }
+}
+
+unsigned int AudioFileReader::read(float *const *channels,
+                                   unsigned int numFrames) {
+  unsigned int done = 0;
+  while (done < numFrames && m_framesRead < m_numFrames) {
+    const auto count = static_cast<unsigned int>(std::min<std::uint64_t>(
+        std::min(numFrames - done, CHUNK_FRAMES), m_numFrames - m_framesRead));
+    const std::size_t samples = static_cast<std::size_t>(count) * m_numChannels;
+    const std::size_t got =
+        std::fread(m_samples.data(), sizeof(float), samples, m_file);
+    const auto frames = static_cast<unsigned int>(got / m_numChannels);
+    for (unsigned int c = 0; c < m_numChannels; ++c) {
+      m_channelOffsets[c] = channels[c] + done;
+    }
+    deinterleave(m_samples.data(), m_numChannels, m_channelOffsets.data(),
+                 frames);
+    done += frames;
+    m_framesRead += frames;
+    if (frames < count) {
+      // Truncated file: what is there is all there is
+      m_numFrames = m_framesRead;
+      break;
+    }
+  }
+  return done;
+}
+
+} // namespace tinysynth
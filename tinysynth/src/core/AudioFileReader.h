@@ -0,0 +1,47 @@
+// AudioFileReader.h
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// Reads 32-bit float WAV/RF64 files, such as AudioFileWriter's, into planar
+// channel buffers. The counterpart of the writer for offline inputs; reads
+// are synchronous, so it is not for the audio thread.
+class AudioFileReader {
+public:
+    // Throws std::runtime_error when the file cannot be opened or is not
+    // 32-bit float PCM
+    explicit AudioFileReader(const std::string& path);
+    AudioFileReader(const AudioFileReader&) = delete;
+    AudioFileReader& operator=(const AudioFileReader&) = delete;
+    ~AudioFileReader();
+
+    // channels holds numChannels buffers of numFrames samples. Returns the
+    // frames read, fewer than numFrames only at the end of the file.
+    unsigned int read(float* const* channels, unsigned int numFrames);
+
+    [[nodiscard]] unsigned int getSampleRate() const { return m_sampleRate; }
+    [[nodiscard]] unsigned int getNumChannels() const { return m_numChannels; }
+    [[nodiscard]] std::uint64_t getNumFrames() const { return m_numFrames; }
+    [[nodiscard]] std::uint64_t getFramesRead() const { return m_framesRead; }
+
+private:
+    static constexpr unsigned int CHUNK_FRAMES = 16384;
+
+    void readHeader();
+
+    std::FILE* m_file = nullptr;
+    std::string m_path;
+    unsigned int m_sampleRate = 0;
+    unsigned int m_numChannels = 0;
+    std::uint64_t m_numFrames = 0;
+    std::uint64_t m_framesRead = 0;
+    std::vector<float> m_samples; // interleaved
+    std::vector<float*> m_channelOffsets;
+};
+
+} // namespace tinysynth
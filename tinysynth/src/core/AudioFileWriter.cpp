@@ -0,0 +1,213 @@
+// AudioFileWriter.cpp
+#include "AudioFileWriter.h"
+#include "Interleave.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+
+namespace tinysynth {
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little,
+              "WAV samples are written in host byte order");
+
+// RIFF/RF64 header, fmt (WAVE_FORMAT_IEEE_FLOAT), fact, data. The 28-byte
+// JUNK chunk reserves room for ds64, so a WAV can become RF64 in place.
+constexpr std::size_t HEADER_SIZE = 94;
+constexpr std::uint64_t UINT32_LIMIT = std::numeric_limits<std::uint32_t>::max();
+
+class HeaderBuilder {
+public:
+  void tag(std::size_t offset, const char *fourcc) {
+    std::copy(fourcc, fourcc + 4, m_bytes.begin() + offset);
+  }
+  void u16(std::size_t offset, std::uint16_t value) { put(offset, value, 2); }
+  void u32(std::size_t offset, std::uint64_t value) { put(offset, value, 4); }
+  void u64(std::size_t offset, std::uint64_t value) { put(offset, value, 8); }
+  [[nodiscard]] const std::array<std::uint8_t, HEADER_SIZE> &bytes() const {
+    return m_bytes;
+  }
+
+private:
+  void put(std::size_t offset, std::uint64_t value, unsigned int size) {
+    for (unsigned int i = 0; i < size; ++i) {
+      m_bytes[offset + i] = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+  }
+
+  std::array<std::uint8_t, HEADER_SIZE> m_bytes{};
+};
+
+} // namespace
+
+AudioFileWriter::AudioFileWriter(const std::string &path,
+                                 unsigned int sampleRate,
+                                 unsigned int numChannels,
+                                 AudioFileFormat format)
+    : m_path(path), m_sampleRate(sampleRate), m_numChannels(numChannels),
+      m_format(format), m_chunks(NUM_CHUNKS), m_channelOffsets(numChannels) {
+  if (numChannels == 0) {
+    throw std::invalid_argument("Audio file needs at least one channel");
+  }
+  for (auto &chunk : m_chunks) {
+    chunk.samples.resize(static_cast<std::size_t>(CHUNK_FRAMES) * numChannels);
+  }
+  m_file = std::fopen(path.c_str(), "wb");
+  if (m_file == nullptr) {
+    throw std::runtime_error("Failed to open " + path + " for writing");
+  }
+  try {
+    writeHeader();
+  } catch (...) {
+    std::fclose(m_file);
+    m_file = nullptr;
+    throw;
+  }
+  m_writer = std::thread(&AudioFileWriter::writerLoop, this);
+}
+
+AudioFileWriter::~AudioFileWriter() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void AudioFileWriter::write(const float *const *channels,
+                            unsigned int numFrames) {
+  unsigned int offset = 0;
+  while (offset < numFrames) {
+    // The producer owns the chunk at m_submitted until it submits it
+    Chunk &chunk = m_chunks[m_submitted % NUM_CHUNKS];
+    const unsigned int count =
+        std::min(numFrames - offset, CHUNK_FRAMES - chunk.frames);
+    float *destination =
+        chunk.samples.data() + static_cast<std::size_t>(chunk.frames) * m_numChannels;
+    for (unsigned int c = 0; c < m_numChannels; ++c) {
+      m_channelOffsets[c] = channels[c] + offset;
+    }
+    interleave(m_channelOffsets.data(), m_numChannels, destination, count);
+    chunk.frames += count;
+    offset += count;
+    if (chunk.frames == CHUNK_FRAMES) {
+      submitChunk();
+    }
+  }
+  m_framesWritten += numFrames;
+}
+
+void AudioFileWriter::submitChunk() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  ++m_submitted;
+  m_condition.notify_all();
+  // Wait until the next chunk in the ring has been written out
+  m_condition.wait(lock, [this] {
+    return m_submitted - m_completed < NUM_CHUNKS || !m_error.empty();
+  });
+  if (!m_error.empty()) {
+    throw std::runtime_error(m_error);
+  }
+}
+
+void AudioFileWriter::writerLoop() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_condition.wait(lock,
+                     [this] { return m_completed < m_submitted || m_closing; });
+    if (m_completed == m_submitted) {
+      return;
+    }
+    Chunk &chunk = m_chunks[m_completed % NUM_CHUNKS];
+    lock.unlock();
+    const std::size_t count =
+        static_cast<std::size_t>(chunk.frames) * m_numChannels;
+    const bool written =
+        std::fwrite(chunk.samples.data(), sizeof(float), count, m_file) == count;
+    chunk.frames = 0;
+    lock.lock();
+    if (!written && m_error.empty()) {
+      m_error = "Failed to write " + m_path;
+    }
+    ++m_completed;
+    m_condition.notify_all();
+  }
+}
+
+void AudioFileWriter::close() {
+  if (m_file == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_chunks[m_submitted % NUM_CHUNKS].frames > 0) {
+      ++m_submitted;
+    }
+    m_closing = true;
+  }
+  m_condition.notify_all();
+  m_writer.join();
+
+  std::string error = m_error;
+  if (error.empty()) {
+    try {
+      writeHeader();
+    } catch (const std::exception &e) {
+      error = e.what();
+    }
+  }
+  if (error.empty() && std::fflush(m_file) != 0) {
+    error = "Failed to write " + m_path;
+  }
+  if (std::fclose(m_file) != 0 && error.empty()) {
+    error = "Failed to close " + m_path;
+  }
+  m_file = nullptr;
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+}
+
+void AudioFileWriter::writeHeader() {
+  const std::uint64_t frameBytes = std::uint64_t{4} * m_numChannels;
+  const std::uint64_t dataSize = m_framesWritten * frameBytes;
+  const std::uint64_t riffSize = HEADER_SIZE - 8 + dataSize;
+  const bool rf64 = m_format == AudioFileFormat::RF64 || riffSize > UINT32_LIMIT;
+
+  HeaderBuilder header;
+  header.tag(0, rf64 ? "RF64" : "RIFF");
+  header.u32(4, rf64 ? UINT32_LIMIT : riffSize);
+  header.tag(8, "WAVE");
+  header.tag(12, rf64 ? "ds64" : "JUNK");
+  header.u32(16, 28);
+  if (rf64) {
+    header.u64(20, riffSize);
+    header.u64(28, dataSize);
+    header.u64(36, m_framesWritten);
+    header.u32(44, 0); // no table entries
+  }
+  header.tag(48, "fmt ");
+  header.u32(52, 18);
+  header.u16(56, 3); // WAVE_FORMAT_IEEE_FLOAT
+  header.u16(58, static_cast<std::uint16_t>(m_numChannels));
+  header.u32(60, m_sampleRate);
+  header.u32(64, m_sampleRate * frameBytes);
+  header.u16(68, static_cast<std::uint16_t>(frameBytes));
+  header.u16(70, 32);
+  header.u16(72, 0);
+  header.tag(74, "fact");
+  header.u32(78, 4);
+  header.u32(82, std::min(m_framesWritten, UINT32_LIMIT));
+  header.tag(86, "data");
+  header.u32(90, rf64 ? UINT32_LIMIT : dataSize);
+
+  if (std::fseek(m_file, 0, SEEK_SET) != 0 ||
+      std::fwrite(header.bytes().data(), 1, HEADER_SIZE, m_file) != HEADER_SIZE ||
+      std::fseek(m_file, 0, SEEK_END) != 0) {
+    throw std::runtime_error("Failed to write header of " + m_path);
+  }
+}
+
+} // namespace tinysynth
@@ -0,0 +1,73 @@
+// AudioFileWriter.h
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tinysynth {
+
+enum class AudioFileFormat {
+    Wav,  // becomes RF64 on close if the data outgrows the 4 GiB RIFF limit
+    RF64, // RF64 from the start (EBU Tech 3306)
+};
+
+// Streams 32-bit float audio to a WAV/RF64 file. write() interleaves into a
+// small ring of chunks and a writer thread does the file I/O, so rendering
+// only waits when the disk is a whole ring behind.
+class AudioFileWriter {
+public:
+    AudioFileWriter(const std::string& path, unsigned int sampleRate,
+                    unsigned int numChannels, AudioFileFormat format = AudioFileFormat::Wav);
+    AudioFileWriter(const AudioFileWriter&) = delete;
+    AudioFileWriter& operator=(const AudioFileWriter&) = delete;
+    ~AudioFileWriter();
+
+    // channels holds numChannels buffers of numFrames samples
+    void write(const float* const* channels, unsigned int numFrames);
+
+    // Flushes, finalizes the header and closes the file; throws on I/O
+    // errors. The destructor closes too but swallows errors.
+    void close();
+
+    [[nodiscard]] std::uint64_t getFramesWritten() const { return m_framesWritten; }
+
+private:
+    static constexpr unsigned int CHUNK_FRAMES = 16384;
+    static constexpr unsigned int NUM_CHUNKS = 4;
+
+    struct Chunk {
+        std::vector<float> samples; // interleaved
+        unsigned int frames = 0;
+    };
+
+    void writeHeader();
+    void finalizeHeader();
+    void submitChunk();
+    void writerLoop();
+
+    std::FILE* m_file = nullptr;
+    std::string m_path;
+    unsigned int m_sampleRate;
+    unsigned int m_numChannels;
+    AudioFileFormat m_format;
+    std::uint64_t m_framesWritten = 0;
+
+    std::vector<Chunk> m_chunks;
+    // write()'s channel pointers advanced to the frame being copied
+    std::vector<const float*> m_channelOffsets;
+    // Chunks handed to / finished by the writer thread, ever
+    std::uint64_t m_submitted = 0;
+    std::uint64_t m_completed = 0;
+    bool m_closing = false;
+    std::string m_error;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread m_writer;
+};
+
+} // namespace tinysynth
@@ -0,0 +1,122 @@
+// BatchedSynthGroup.h
+#pragma once
+
+#include "SynthDefJIT.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace tinysynth {
+
+// Runs every node of one SynthDef through its voice-batched kernel. Nodes are
+// packed into SoA blocks of `batchLanes` nodes; lanes without a node, or
+// with a paused one, are masked out and keep their state, so a partially
+// filled batch costs the same as a full one. All memory is allocated up
+// front; not thread-safe.
+//
+// The group is not part of the graph. GraphProcessor renders each node as
+// its own SynthDefNode module with its own routes and state block, so nodes
+// started through OscServer or the C API are never batched. The group is
+// for a host that allocates its own voices of one def and mixes their Out
+// buses together.
+class BatchedSynthGroup {
+public:
+    BatchedSynthGroup(std::shared_ptr<const CompiledSynthDef> def, std::size_t capacity)
+        : m_def(std::move(def)) {
+        if (!m_def || m_def->processBatch == nullptr) {
+            throw std::runtime_error("SynthDef was compiled without a batched variant");
+        }
+        m_lanes = m_def->batchLanes;
+        m_fullMask = (1u << m_lanes) - 1;
+        m_batchSize = m_def->layout.batchSize(m_lanes);
+
+        const std::size_t numBatches = (capacity + m_lanes - 1) / m_lanes;
+        m_masks.assign(numBatches, 0);
+        m_running.assign(numBatches, 0);
+        m_storage = static_cast<char*>(std::aligned_alloc(
+            m_def->layout.alignment(), m_batchSize * std::max<std::size_t>(numBatches, 1)));
+        if (m_storage == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+
+    BatchedSynthGroup(const BatchedSynthGroup&) = delete;
+    BatchedSynthGroup& operator=(const BatchedSynthGroup&) = delete;
+
+    ~BatchedSynthGroup() { std::free(m_storage); }
+
+    // Returns a node handle, or -1 when every lane is taken. Partially filled
+    // batches are topped up first to keep the number of kernel calls low.
+    int spawn() {
+        for (std::size_t batch = 0; batch < m_masks.size(); ++batch) {
+            const std::uint32_t freeLanes = ~m_masks[batch] & m_fullMask;
+            if (freeLanes == 0) {
+                continue;
+            }
+            const unsigned int lane = __builtin_ctz(freeLanes);
+            m_def->layout.initializeLane(batchState(batch), m_lanes, lane);
+            m_masks[batch] |= 1u << lane;
+            m_running[batch] |= 1u << lane;
+            ++m_size;
+            return static_cast<int>(batch * m_lanes + lane);
+        }
+        return -1;
+    }
+
+    void free(int node) {
+        std::uint32_t& mask = m_masks[node / m_lanes];
+        const std::uint32_t bit = 1u << (node % m_lanes);
+        if (mask & bit) {
+            mask &= ~bit;
+            m_running[node / m_lanes] &= ~bit;
+            --m_size;
+        }
+    }
+
+    // A paused node keeps its state and resumes where it stopped, like /n_run
+    void setRunning(int node, bool running) {
+        const std::size_t batch = node / m_lanes;
+        const std::uint32_t bit = 1u << (node % m_lanes);
+        if (m_masks[batch] & bit) {
+            m_running[batch] = running ? m_running[batch] | bit : m_running[batch] & ~bit;
+        }
+    }
+
+    // offset as returned by StateLayout::controlOffset
+    void setControl(int node, std::size_t offset, float value) {
+        auto* values = reinterpret_cast<float*>(batchState(node / m_lanes) + offset * m_lanes);
+        values[node % m_lanes] = value;
+    }
+
+    void process(const float* const* inputs, float* const* outputs,
+                 std::int32_t numFrames, float sampleRate) {
+        for (std::size_t batch = 0; batch < m_masks.size(); ++batch) {
+            if (m_running[batch] != 0) {
+                m_def->processBatch(batchState(batch), inputs, outputs, numFrames,
+                                    sampleRate, m_running[batch]);
+            }
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const { return m_size; }
+    [[nodiscard]] std::size_t capacity() const { return m_masks.size() * m_lanes; }
+    [[nodiscard]] unsigned int lanes() const { return m_lanes; }
+
+private:
+    std::shared_ptr<const CompiledSynthDef> m_def;
+    unsigned int m_lanes = 0;
+    std::uint32_t m_fullMask = 0;
+    std::size_t m_batchSize = 0;
+    std::size_t m_size = 0;
+    char* m_storage = nullptr;
+    std::vector<std::uint32_t> m_masks;   // lanes holding a node
+    std::vector<std::uint32_t> m_running; // of those, the ones not paused
+
+    char* batchState(std::size_t batch) { return m_storage + batch * m_batchSize; }
+};
+
+} // namespace tinysynth
@@ -0,0 +1,115 @@
+// ControlEventBus.cpp
+#include "ControlEventBus.h"
+#include <stdexcept>
+
+namespace tinysynth {
+
+namespace {
+
+// Heap order: the earliest time on top, equal times in push order
+bool later(const ControlEvent &a, const ControlEvent &b) {
+  if (a.time != b.time) {
+    return a.time > b.time;
+  }
+  return a.command.sequence > b.command.sequence;
+}
+
+} // namespace
+
+ControlEventBus::Producer::Producer(std::string name, bool replyToAll,
+                                    bool scheduled, bool sampleAccurate)
+    : m_name(std::move(name)), m_replyToAll(replyToAll),
+      m_scheduled(scheduled), m_sampleAccurate(scheduled || sampleAccurate) {
+  if (scheduled) {
+    m_schedule.reserve(SCHEDULE_SIZE);
+  }
+}
+
+const ControlEvent *ControlEventBus::Producer::next() {
+  if (!m_scheduled) {
+    return m_events.front();
+  }
+  // Takes in what arrived since the last look; the reserve keeps
+  // push_back from allocating
+  while (m_schedule.size() < SCHEDULE_SIZE) {
+    const ControlEvent *event = m_events.front();
+    if (event == nullptr) {
+      break;
+    }
+    m_schedule.push_back(*event);
+    std::push_heap(m_schedule.begin(), m_schedule.end(), later);
+    m_events.pop();
+  }
+  return m_schedule.empty() ? nullptr : &m_schedule.front();
+}
+
+void ControlEventBus::Producer::popNext() {
+  if (!m_scheduled) {
+    m_events.pop();
+    return;
+  }
+  std::pop_heap(m_schedule.begin(), m_schedule.end(), later);
+  m_schedule.pop_back();
+}
+
+std::size_t ControlEventBus::Producer::collectReplies(
+    const std::function<void(const EngineReply &)> &onReply) {
+  std::size_t count = 0;
+  EngineReply reply;
+  while (m_replies.tryPop(reply)) {
+    if (onReply) {
+      onReply(reply);
+    }
+    delete reply.garbage;
+    ++count;
+  }
+  return count;
+}
+
+ControlEventBus::~ControlEventBus() {
+  for (auto &producer : m_producers) {
+    if (!producer) {
+      continue;
+    }
+    ControlEvent event;
+    while (producer->m_events.tryPop(event)) {
+      producer->m_schedule.push_back(event);
+    }
+    for (const auto &pending : producer->m_schedule) {
+      if (pending.command.type == EngineCommand::Type::AddModule) {
+        delete pending.command.newModule;
+      }
+    }
+    producer->collectReplies();
+  }
+}
+
+ControlEventBus::Producer &ControlEventBus::addProducer(const std::string &name,
+                                                        bool replyToAll,
+                                                        bool sampleAccurate) {
+  return registerProducer(name, replyToAll, false, sampleAccurate);
+}
+
+ControlEventBus::Producer &
+ControlEventBus::addScheduledProducer(const std::string &name,
+                                      bool replyToAll) {
+  return registerProducer(name, replyToAll, true, true);
+}
+
+ControlEventBus::Producer &
+ControlEventBus::registerProducer(const std::string &name, bool replyToAll,
+                                  bool scheduled, bool sampleAccurate) {
+  std::lock_guard<std::mutex> lock(m_registerMutex);
+  const std::size_t index = m_numProducers.load(std::memory_order_relaxed);
+  if (index == MAX_PRODUCERS) {
+    throw std::runtime_error("Control event bus has no room for producer '" +
+                             name + "'");
+  }
+  m_producers[index].reset(
+      new Producer(name, replyToAll, scheduled, sampleAccurate));
+  // Publishes the new rings to the audio thread
+  m_numProducers.store(index + 1, std::memory_order_release);
+  return *m_producers[index];
+}
+
+} // namespace tinysynth
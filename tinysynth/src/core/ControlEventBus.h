@@ -0,0 +1,179 @@
+// ControlEventBus.h
+#pragma once
+
+#include "EngineCommand.h"
+#include "RealtimeMemory.h"
+#include "SpscQueue.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// A command stamped with the engine frame it takes effect at
+struct ControlEvent {
+    std::uint64_t time = 0;
+    EngineCommand command;
+    // Splits the block at exactly `time`, whatever the event granularity
+    bool sampleAccurate = false;
+};
+
+// Many-producer path into the audio thread. Every control source (GUI, OSC,
+// MIDI) registers its own Producer, a pair of SPSC rings, so pushing is
+// wait-free and sources never contend with each other. Once per block the
+// audio thread merges the producers' rings into one stream sorted by time.
+//
+// Times are engine frames (see GraphProcessor::getFrameTime). A producer's
+// events must be in time order: push() clamps an event to the time of the
+// one before it, so a source mixing scheduled and immediate events should
+// use two producers. Events at equal times run in registration order.
+//
+// A scheduled producer takes events in any order, for sources that send
+// ahead of time (OSC bundles). The audio thread moves its ring into a
+// preallocated binary heap, so its events still merge in time order and
+// run at their exact frame; one that is already past when the audio thread
+// reaches it runs at the start of the block and is counted as late.
+class ControlEventBus {
+public:
+    static constexpr std::size_t MAX_PRODUCERS = 16;
+    static constexpr std::size_t PRODUCER_QUEUE_SIZE = 4096;
+    // Events a scheduled producer can hold in the future; beyond it they
+    // wait in its ring
+    static constexpr std::size_t SCHEDULE_SIZE = 8192;
+
+    // Owned by the bus; used by exactly one thread
+    class Producer : public RealtimeAllocated {
+    public:
+        // Assigns the command's sequence; false when the ring is full
+        bool push(std::uint64_t time, EngineCommand& command) {
+            if (!m_scheduled) {
+                time = std::max(time, m_lastTime);
+            }
+            command.sequence = m_nextSequence;
+            if (!m_events.tryPush(ControlEvent{time, command, m_sampleAccurate})) {
+                return false;
+            }
+            m_lastTime = time;
+            ++m_nextSequence;
+            return true;
+        }
+
+        // Passes each reply to onReply, then deletes the module it returns.
+        // Returns the number of replies handled.
+        std::size_t collectReplies(const std::function<void(const EngineReply&)>& onReply = {});
+
+        // How many pushes in a row will succeed, at least
+        [[nodiscard]] std::size_t getFreeSpace() const { return m_events.space(); }
+        [[nodiscard]] const std::string& getName() const { return m_name; }
+        // Scheduled events that ran after their frame
+        [[nodiscard]] std::uint64_t getLateEvents() const {
+            return m_lateEvents.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend class ControlEventBus;
+
+        Producer(std::string name, bool replyToAll, bool scheduled, bool sampleAccurate);
+
+        // Audio thread: the next event due, nullptr when there is none
+        const ControlEvent* next();
+        void popNext();
+
+        std::string m_name;
+        bool m_replyToAll;
+        bool m_scheduled;
+        bool m_sampleAccurate;
+        SpscQueue<ControlEvent, PRODUCER_QUEUE_SIZE> m_events;
+        SpscQueue<EngineReply, PRODUCER_QUEUE_SIZE> m_replies;
+        // Scheduled producers only: a min-heap on time, then sequence
+        std::vector<ControlEvent> m_schedule;
+        std::uint64_t m_lastTime = 0;
+        std::uint32_t m_nextSequence = 1;
+        std::atomic<std::uint64_t> m_lateEvents{0};
+    };
+
+    ControlEventBus() = default;
+    ControlEventBus(const ControlEventBus&) = delete;
+    ControlEventBus& operator=(const ControlEventBus&) = delete;
+    // Deletes the modules still travelling in either direction
+    ~ControlEventBus();
+
+    // Safe while the audio thread drains. Without replyToAll a producer only
+    // hears about commands that were rejected, hand back a module or ask to
+    // be confirmed, so a high-rate source need not collect replies for every
+    // event. A
+    // sampleAccurate producer's events split the block at their exact frame
+    // (see ControlEvent), like a scheduled producer's. Throws once
+    // MAX_PRODUCERS exist.
+    Producer& addProducer(const std::string& name, bool replyToAll = true,
+                          bool sampleAccurate = false);
+    // The same for a producer whose events need not be in time order
+    Producer& addScheduledProducer(const std::string& name, bool replyToAll = true);
+
+    // Audio thread: passes the events due before `end`, at most `budget`, to
+    // apply(event, reply) in time order, and returns how many. apply sets the
+    // reply's status and garbage. A producer whose reply ring is full is
+    // skipped until it collects, so replies are never dropped. Scheduled
+    // events before `start` count as late.
+    template <typename Apply>
+    unsigned int drain(std::uint64_t start, std::uint64_t end, unsigned int budget,
+                       Apply&& apply);
+
+private:
+    Producer& registerProducer(const std::string& name, bool replyToAll, bool scheduled,
+                               bool sampleAccurate);
+
+    std::array<std::unique_ptr<Producer>, MAX_PRODUCERS> m_producers;
+    std::atomic<std::size_t> m_numProducers{0};
+    std::mutex m_registerMutex;
+};
+
+template <typename Apply>
+unsigned int ControlEventBus::drain(std::uint64_t start, std::uint64_t end, unsigned int budget,
+                                    Apply&& apply) {
+    const std::size_t numProducers = m_numProducers.load(std::memory_order_acquire);
+    unsigned int applied = 0;
+    while (applied < budget) {
+        // k-way merge: each ring (or schedule) is already sorted, so the
+        // earliest due event is at the front of one of them
+        Producer* source = nullptr;
+        const ControlEvent* event = nullptr;
+        for (std::size_t i = 0; i < numProducers; ++i) {
+            Producer& producer = *m_producers[i];
+            const ControlEvent* candidate = producer.next();
+            if (candidate == nullptr || candidate->time >= end || producer.m_replies.full()) {
+                continue;
+            }
+            if (event == nullptr || candidate->time < event->time) {
+                event = candidate;
+                source = &producer;
+            }
+        }
+        if (event == nullptr) {
+            break;
+        }
+
+        if (source->m_scheduled && event->time < start) {
+            source->m_lateEvents.fetch_add(1, std::memory_order_relaxed);
+        }
+        EngineReply reply;
+        reply.type = event->command.type;
+        reply.sequence = event->command.sequence;
+        const bool confirm = event->command.confirm;
+        apply(*event, reply);
+        source->popNext();
+        if (source->m_replyToAll || confirm || reply.status != EngineReply::Status::Done ||
+            reply.garbage != nullptr) {
+            source->m_replies.tryPush(reply);
+        }
+        ++applied;
+    }
+    return applied;
+}
+
+} // namespace tinysynth
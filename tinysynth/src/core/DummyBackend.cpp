@@ -0,0 +1,144 @@
+// DummyBackend.cpp
+#include "DummyBackend.h"
+#include "DenormalGuard.h"
+#include "RealtimeMemory.h"
+#include "RealtimeSanitizer.h"
+#include <algorithm>
+#include <cerrno>
+#include <functional>
+#include <pthread.h>
+#include <stdexcept>
+#include <time.h>
+
+namespace tinysynth {
+
+namespace {
+
+constexpr std::int64_t NANOSECONDS = 1000000000;
+
+std::int64_t now() {
+  timespec time{};
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return static_cast<std::int64_t>(time.tv_sec) * NANOSECONDS + time.tv_nsec;
+}
+
+void sleepUntil(std::int64_t deadline) {
+  timespec time{};
+  time.tv_sec = static_cast<time_t>(deadline / NANOSECONDS);
+  time.tv_nsec = static_cast<long>(deadline % NANOSECONDS);
+  // Restart after signals; the deadline is absolute so nothing drifts. Any
+  // other error returns at once: the cycle then runs late and is counted,
+  // rather than the driver spinning here
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) ==
+         EINTR) {
+  }
+}
+
+} // namespace
+
+DummyBackend::DummyBackend(Config config) : m_config(config) {
+  if (m_config.blockSize == 0 || m_config.sampleRate == 0) {
+    throw std::invalid_argument("Dummy driver needs a block size and a sample rate");
+  }
+}
+
+DummyBackend::~DummyBackend() { stop(); }
+
+void DummyBackend::start(AudioProcessor &processor) {
+  stop();
+  processor.prepare(m_config.sampleRate, m_config.blockSize);
+  m_stopRequested = false;
+  m_stats = {};
+  m_cycles.clear();
+  m_cycles.reserve(m_config.recordedCycles);
+  m_thread = std::thread(&DummyBackend::run, this, std::ref(processor));
+}
+
+void DummyBackend::stop() {
+  m_stopRequested = true;
+  wait();
+}
+
+void DummyBackend::wait() {
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void DummyBackend::run(AudioProcessor &processor) {
+  sched_param param{};
+  param.sched_priority = m_config.priority;
+  m_stats.realtimeScheduling =
+      pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+  RealtimeMemory::prefaultStack();
+
+  const unsigned int blockSize = m_config.blockSize;
+  std::vector<std::vector<float>> inputs(m_config.numInputs,
+                                         std::vector<float>(blockSize, 0.0F));
+  std::vector<std::vector<float>> outputs(m_config.numOutputs,
+                                          std::vector<float>(blockSize));
+  std::vector<const float *> inputPointers;
+  std::vector<float *> outputPointers;
+  for (auto &buffer : inputs) {
+    inputPointers.push_back(buffer.data());
+  }
+  for (auto &buffer : outputs) {
+    outputPointers.push_back(buffer.data());
+  }
+
+  ScopedDenormalGuard denormalGuard;
+  // Period k starts at start + k * blockSize / sampleRate, computed exactly
+  // so a long run does not drift from the simulated sample clock
+  const std::int64_t start = now();
+  const std::int64_t sampleRate = m_config.sampleRate;
+  auto periodStartOf = [&](std::int64_t period) {
+    const std::int64_t frames = period * blockSize;
+    return start + frames / sampleRate * NANOSECONDS +
+           frames % sampleRate * NANOSECONDS / sampleRate;
+  };
+  double totalRenderTime = 0.0;
+  std::int64_t period = 1;
+  while (!m_stopRequested &&
+         (m_config.numCycles == 0 || m_stats.cycles < m_config.numCycles)) {
+    const std::int64_t periodStart = periodStartOf(period);
+    sleepUntil(periodStart);
+    const std::int64_t wakeup = now();
+
+    for (auto &buffer : outputs) {
+      std::fill(buffer.begin(), buffer.end(), 0.0F);
+    }
+    {
+      ScopedRealtimeContext realtime;
+      processor.process(inputPointers.data(), outputPointers.data(),
+                        blockSize);
+    }
+    const std::int64_t finished = now();
+
+    const DummyCycle cycle{wakeup - periodStart, finished - wakeup};
+    if (m_cycles.size() < m_config.recordedCycles) {
+      m_cycles.push_back(cycle);
+    }
+    ++m_stats.cycles;
+    totalRenderTime += static_cast<double>(cycle.renderTime);
+    m_stats.maxWakeupLatency = std::max(m_stats.maxWakeupLatency, cycle.wakeupLatency);
+    m_stats.maxRenderTime = std::max(m_stats.maxRenderTime, cycle.renderTime);
+
+    // The deadline is the start of the next period, when a real device
+    // would need the buffer
+    ++period;
+    if (finished > periodStartOf(period)) {
+      ++m_stats.xruns;
+      // Like a driver restarting after an xrun: resume at the next
+      // period boundary instead of bursting to catch up
+      while (finished > periodStartOf(period)) {
+        ++period;
+        ++m_stats.skippedCycles;
+      }
+    }
+  }
+  if (m_stats.cycles > 0) {
+    m_stats.meanRenderTime = totalRenderTime / static_cast<double>(m_stats.cycles);
+  }
+}
+
+} // namespace tinysynth
@@ -0,0 +1,74 @@
+// DummyBackend.h
+#pragma once
+
+#include "AudioBackend.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace tinysynth {
+
+// Timing of one simulated period, in nanoseconds
+struct DummyCycle {
+    std::int64_t wakeupLatency; // from the period start to the callback
+    std::int64_t renderTime;    // inside AudioProcessor::process
+};
+
+struct DummyBackendStats {
+    std::uint64_t cycles = 0;
+    std::uint64_t xruns = 0;         // cycles that finished past their deadline
+    std::uint64_t skippedCycles = 0; // periods dropped to catch up after an xrun
+    std::int64_t maxWakeupLatency = 0;
+    std::int64_t maxRenderTime = 0;
+    double meanRenderTime = 0.0;
+    bool realtimeScheduling = false; // SCHED_FIFO was granted
+};
+
+// Null audio driver with a simulated clock: a SCHED_FIFO thread calls the
+// processor once per period on absolute CLOCK_MONOTONIC deadlines, exactly
+// like a JACK period but without hardware. A cycle is an xrun when its
+// render ends after the next period starts. For latency benchmarks and
+// realtime regression tests on headless machines.
+class DummyBackend : public AudioBackend {
+public:
+    struct Config {
+        unsigned int sampleRate = 48000;
+        unsigned int blockSize = 64;
+        unsigned int numInputs = 0;
+        unsigned int numOutputs = 2;
+        int priority = 70;             // SCHED_FIFO priority
+        std::uint64_t numCycles = 0;   // 0 runs until stop()
+        std::size_t recordedCycles = 0; // per-cycle timings kept, from the start
+    };
+
+    explicit DummyBackend(Config config);
+    DummyBackend(const DummyBackend&) = delete;
+    DummyBackend& operator=(const DummyBackend&) = delete;
+    ~DummyBackend() override;
+
+    void start(AudioProcessor& processor) override;
+    void stop() override;
+    // Blocks until numCycles have run (or stop() is called)
+    void wait();
+
+    [[nodiscard]] unsigned int getSampleRate() const override { return m_config.sampleRate; }
+    [[nodiscard]] unsigned int getBufferSize() const override { return m_config.blockSize; }
+    [[nodiscard]] unsigned int getNumInputs() const override { return m_config.numInputs; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return m_config.numOutputs; }
+
+    // Valid once the driver thread has finished (after wait() or stop())
+    [[nodiscard]] const DummyBackendStats& getStats() const { return m_stats; }
+    [[nodiscard]] const std::vector<DummyCycle>& getCycles() const { return m_cycles; }
+
+private:
+    void run(AudioProcessor& processor);
+
+    Config m_config;
+    std::atomic<bool> m_stopRequested{false};
+    std::thread m_thread;
+    DummyBackendStats m_stats;
+    std::vector<DummyCycle> m_cycles;
+};
+
+} // namespace tinysynth
@@ -0,0 +1,101 @@
+// EngineCommand.cpp
+#include "EngineCommand.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace tinysynth {
+
+namespace {
+
+void copyName(char (&destination)[EngineCommand::NAME_SIZE],
+              const std::string &name) {
+  if (name.size() >= EngineCommand::NAME_SIZE) {
+    throw std::invalid_argument("Name '" + name + "' is too long for a command");
+  }
+  std::memcpy(destination, name.c_str(), name.size() + 1);
+}
+
+EngineCommand makeCommand(EngineCommand::Type type, const std::string &module) {
+  EngineCommand command;
+  command.type = type;
+  copyName(command.module, module);
+  return command;
+}
+
+EngineCommand makeLink(EngineCommand::Type type, const std::string &fromModule,
+                       unsigned int outputIndex, const std::string &toModule,
+                       unsigned int inputIndex) {
+  EngineCommand command = makeCommand(type, fromModule);
+  copyName(command.target, toModule);
+  command.outputIndex = outputIndex;
+  command.inputIndex = inputIndex;
+  return command;
+}
+
+EngineCommand makeRoute(EngineCommand::Type type, const std::string &module,
+                        unsigned int outputIndex, unsigned int channel) {
+  EngineCommand command = makeCommand(type, module);
+  command.outputIndex = outputIndex;
+  command.inputIndex = channel;
+  return command;
+}
+
+} // namespace
+
+EngineCommand EngineCommand::addModule(const std::string &name,
+                                       Module<float> *module) {
+  EngineCommand command = makeCommand(Type::AddModule, name);
+  command.newModule = module;
+  return command;
+}
+
+EngineCommand EngineCommand::removeModule(const std::string &name) {
+  return makeCommand(Type::RemoveModule, name);
+}
+
+EngineCommand EngineCommand::connect(const std::string &fromModule,
+                                     unsigned int outputIndex,
+                                     const std::string &toModule,
+                                     unsigned int inputIndex) {
+  return makeLink(Type::Connect, fromModule, outputIndex, toModule, inputIndex);
+}
+
+EngineCommand EngineCommand::disconnect(const std::string &fromModule,
+                                        unsigned int outputIndex,
+                                        const std::string &toModule,
+                                        unsigned int inputIndex) {
+  return makeLink(Type::Disconnect, fromModule, outputIndex, toModule,
+                  inputIndex);
+}
+
+EngineCommand EngineCommand::connectOutput(const std::string &module,
+                                           unsigned int outputIndex,
+                                           unsigned int channel) {
+  return makeRoute(Type::ConnectOutput, module, outputIndex, channel);
+}
+
+EngineCommand EngineCommand::disconnectOutput(const std::string &module,
+                                              unsigned int outputIndex,
+                                              unsigned int channel) {
+  return makeRoute(Type::DisconnectOutput, module, outputIndex, channel);
+}
+
+EngineCommand EngineCommand::setParameter(const std::string &module,
+                                          const std::string &parameter,
+                                          float value) {
+  EngineCommand command = makeCommand(Type::SetParameter, module);
+  copyName(command.target, parameter);
+  command.value = value;
+  return command;
+}
+
+EngineCommand EngineCommand::midiMessage(const MidiMessage &message) {
+  EngineCommand command;
+  command.type = Type::Midi;
+  command.midi[0] = message.status;
+  command.midi[1] = message.data1;
+  command.midi[2] = message.data2;
+  return command;
+}
+
+} // namespace tinysynth
@@ -0,0 +1,73 @@
+// EngineCommand.h
+#pragma once
+
+#include "MidiParser.h"
+#include "Module.h"
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace tinysynth {
+
+// Fixed-size graph edit sent from a control thread to the audio thread (see
+// GraphProcessor::send). Names are stored inline so a record can be copied
+// through a lock-free ring; the builders throw std::invalid_argument for
+// names that do not fit.
+struct EngineCommand {
+    static constexpr std::size_t NAME_SIZE = 32; // including the terminator
+
+    enum class Type : std::uint8_t {
+        AddModule,        // module, newModule
+        RemoveModule,     // module
+        Connect,          // module.outputIndex -> target.inputIndex
+        Disconnect,       // module.outputIndex -> target.inputIndex
+        ConnectOutput,    // module.outputIndex -> output channel inputIndex
+        DisconnectOutput, // module.outputIndex -> output channel inputIndex
+        SetParameter,     // module, parameter `target` = value
+        Midi,             // midi: status and data bytes
+    };
+
+    Type type = Type::SetParameter;
+    std::uint32_t sequence = 0; // assigned by GraphProcessor::send
+    char module[NAME_SIZE] = {};
+    char target[NAME_SIZE] = {};
+    std::uint32_t outputIndex = 0;
+    std::uint32_t inputIndex = 0;
+    float value = 0.0F;
+    std::uint8_t midi[3] = {};
+    // Replied to even by a producer without replyToAll
+    bool confirm = false;
+    // AddModule only: ownership travels with the command
+    Module<float>* newModule = nullptr;
+
+    static EngineCommand addModule(const std::string& name, Module<float>* module);
+    static EngineCommand removeModule(const std::string& name);
+    static EngineCommand connect(const std::string& fromModule, unsigned int outputIndex,
+                                 const std::string& toModule, unsigned int inputIndex);
+    static EngineCommand disconnect(const std::string& fromModule, unsigned int outputIndex,
+                                    const std::string& toModule, unsigned int inputIndex);
+    static EngineCommand connectOutput(const std::string& module, unsigned int outputIndex,
+                                       unsigned int channel);
+    static EngineCommand disconnectOutput(const std::string& module, unsigned int outputIndex,
+                                          unsigned int channel);
+    static EngineCommand setParameter(const std::string& module, const std::string& parameter,
+                                      float value);
+    static EngineCommand midiMessage(const MidiMessage& message);
+};
+
+// Sent back by the audio thread for every command it applied or rejected.
+// `garbage` is a module the control thread must delete: the one removed,
+// or the one of a rejected AddModule.
+struct EngineReply {
+    enum class Status : std::uint8_t { Done, Rejected };
+
+    EngineCommand::Type type = EngineCommand::Type::SetParameter;
+    Status status = Status::Done;
+    std::uint32_t sequence = 0;
+    Module<float>* garbage = nullptr;
+};
+
+static_assert(std::is_trivially_copyable_v<EngineCommand>);
+static_assert(std::is_trivially_copyable_v<EngineReply>);
+
+} // namespace tinysynth
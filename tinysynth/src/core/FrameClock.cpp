@@ -0,0 +1,120 @@
+// FrameClock.cpp
+#include "FrameClock.h"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace tinysynth {
+
+namespace {
+
+constexpr double NANOSECONDS = 1e9;
+constexpr unsigned int FALLBACK_SAMPLE_RATE = 48000;
+// A stamp off by more than half its span, and at least this, is a jump
+constexpr double MIN_TOLERANCE = 2e6; // ns
+// Keeps the loop stable when blocks are long against the bandwidth
+constexpr double MAX_OMEGA = 0.5;
+// Real clocks drift by parts per million; anything past this is noise
+constexpr double MAX_DEVIATION = 0.01;
+
+double nanoseconds(FrameClock::TimePoint time) {
+  return static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          time.time_since_epoch())
+          .count());
+}
+
+} // namespace
+
+void FrameClock::reset(unsigned int sampleRate) {
+  m_nominalPeriod =
+      NANOSECONDS / (sampleRate > 0 ? sampleRate : FALLBACK_SAMPLE_RATE);
+  m_state = Estimate{0, 0.0, m_nominalPeriod};
+  m_locked = false;
+  // Period 0 marks the estimate unusable until the next block
+  publish(Estimate{0, 0.0, 0.0});
+}
+
+void FrameClock::update(std::uint64_t frame, TimePoint now) {
+  if (m_nominalPeriod == 0.0) {
+    reset(FALLBACK_SAMPLE_RATE);
+  }
+  const double time = nanoseconds(now);
+  if (m_locked && frame > m_state.frame) {
+    const auto frames = static_cast<double>(frame - m_state.frame);
+    const double span = frames * m_state.period;
+    const double predicted = m_state.time + span;
+    const double error = time - predicted;
+    if (std::fabs(error) <= std::max(span * 0.5, MIN_TOLERANCE)) {
+      // Second-order loop: the phase follows the stamp a little, the
+      // period a little less
+      const double omega =
+          std::min(2.0 * std::numbers::pi * m_bandwidth * span / NANOSECONDS,
+                   MAX_OMEGA);
+      m_state.time = predicted + std::numbers::sqrt2 * omega * error;
+      m_state.period =
+          std::clamp(m_state.period + omega * omega * error / frames,
+                     m_nominalPeriod * (1.0 - MAX_DEVIATION),
+                     m_nominalPeriod * (1.0 + MAX_DEVIATION));
+      m_state.frame = frame;
+      publish(m_state);
+      return;
+    }
+    m_restarts.fetch_add(1, std::memory_order_relaxed);
+  }
+  // (Re)start at this stamp, keeping the period learnt so far
+  m_state.frame = frame;
+  m_state.time = time;
+  m_locked = true;
+  publish(m_state);
+}
+
+std::optional<std::uint64_t> FrameClock::frameAt(TimePoint time) const {
+  const auto estimate = read();
+  if (!estimate) {
+    return std::nullopt;
+  }
+  const double frame = static_cast<double>(estimate->frame) +
+                       (nanoseconds(time) - estimate->time) / estimate->period;
+  return frame > 0.0 ? static_cast<std::uint64_t>(std::llround(frame)) : 0;
+}
+
+double FrameClock::getMeasuredSampleRate() const {
+  const auto estimate = read();
+  return estimate ? NANOSECONDS / estimate->period : 0.0;
+}
+
+void FrameClock::publish(const Estimate &estimate) {
+  // Odd while the fields change
+  const std::uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+  m_sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_frame.store(estimate.frame, std::memory_order_relaxed);
+  m_time.store(estimate.time, std::memory_order_relaxed);
+  m_period.store(estimate.period, std::memory_order_relaxed);
+  m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+std::optional<FrameClock::Estimate> FrameClock::read() const {
+  for (;;) {
+    const std::uint32_t before = m_sequence.load(std::memory_order_acquire);
+    if (before == 0) {
+      return std::nullopt;
+    }
+    if ((before & 1U) != 0) {
+      continue;
+    }
+    const Estimate estimate{m_frame.load(std::memory_order_relaxed),
+                            m_time.load(std::memory_order_relaxed),
+                            m_period.load(std::memory_order_relaxed)};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_sequence.load(std::memory_order_relaxed) == before) {
+      if (estimate.period <= 0.0) {
+        return std::nullopt;
+      }
+      return estimate;
+    }
+  }
+}
+
+} // namespace tinysynth
@@ -0,0 +1,73 @@
+// FrameClock.h
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace tinysynth {
+
+// Maps the system's monotonic clock to engine frames, so a wall-clock event
+// time (an OSC time tag) converts to the frame the audio clock reaches then.
+//
+// The audio thread stamps each block start with the time it was called. A
+// delay-locked loop (F. Adriaensen, "Using a DLL to filter time") smooths
+// the callback's wakeup jitter out of those stamps and tracks how fast the
+// audio clock really runs against the system clock, so conversions stay
+// tight over hours of drift. A stamp too far off the prediction (an xrun,
+// a stalled or offline backend) restarts the loop at that block.
+//
+// One audio thread writes; any thread reads through a seqlock.
+class FrameClock {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    // Loop bandwidth: lower rejects more jitter but follows drift slower
+    static constexpr double DEFAULT_BANDWIDTH = 0.1; // Hz
+
+    explicit FrameClock(double bandwidth = DEFAULT_BANDWIDTH) : m_bandwidth(bandwidth) {}
+    FrameClock(const FrameClock&) = delete;
+    FrameClock& operator=(const FrameClock&) = delete;
+
+    // Writer side: forget the loop state, e.g. for a new sample rate
+    void reset(unsigned int sampleRate);
+    // Writer side: the block starting at `frame` was called at `now`
+    void update(std::uint64_t frame, TimePoint now);
+
+    // The frame playing at `time`; empty before the first block
+    [[nodiscard]] std::optional<std::uint64_t> frameAt(TimePoint time) const;
+    // The audio clock's rate measured against the system clock; 0 before
+    // the first block
+    [[nodiscard]] double getMeasuredSampleRate() const;
+    // Times the loop restarted after a discontinuity
+    [[nodiscard]] std::uint64_t getRestarts() const {
+        return m_restarts.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Published estimate: `frame` plays at `time` (ns since the clock's
+    // epoch), one frame lasts `period` ns
+    struct Estimate {
+        std::uint64_t frame;
+        double time;
+        double period;
+    };
+
+    void publish(const Estimate& estimate);
+    [[nodiscard]] std::optional<Estimate> read() const;
+
+    double m_bandwidth;
+    // Writer state
+    Estimate m_state{0, 0.0, 0.0};
+    double m_nominalPeriod = 0.0;
+    bool m_locked = false;
+
+    std::atomic<std::uint32_t> m_sequence{0};
+    std::atomic<std::uint64_t> m_frame{0};
+    std::atomic<double> m_time{0.0};
+    std::atomic<double> m_period{0.0};
+    std::atomic<std::uint64_t> m_restarts{0};
+};
+
+} // namespace tinysynth
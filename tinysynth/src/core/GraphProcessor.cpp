@@ -0,0 +1,630 @@
+// GraphProcessor.cpp
+#include "GraphProcessor.h"
+#include "RealtimeSanitizer.h"
+#include "../modules/AudioEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+
+namespace tinysynth {
+
+namespace {
+
+// Source node exposing the capture channels of the current block
+class CaptureModule : public Module<float> {
+public:
+  explicit CaptureModule(const std::vector<const float *> &buffers)
+      : m_buffers(buffers) {}
+
+  void process(const std::vector<std::optional<float *>> & /*inputs*/,
+               std::vector<float *> &outputs,
+               unsigned int numFrames) override {
+    for (std::size_t channel = 0; channel < outputs.size(); ++channel) {
+      const float *buffer = m_buffers[channel];
+      if (outputs[channel] == buffer) {
+        // Bound to the capture buffer itself
+        continue;
+      }
+      if (buffer != nullptr) {
+        std::copy(buffer, buffer + numFrames, outputs[channel]);
+      } else {
+        std::fill(outputs[channel], outputs[channel] + numFrames, 0.0F);
+      }
+    }
+  }
+
+  [[nodiscard]] unsigned int getNumInputs() const override { return 0; }
+  [[nodiscard]] unsigned int getNumOutputs() const override {
+    return static_cast<unsigned int>(m_buffers.size());
+  }
+  [[nodiscard]] std::string getInputName(unsigned int /*index*/) const override {
+    return "";
+  }
+  [[nodiscard]] std::string getOutputName(unsigned int index) const override {
+    return "in_" + std::to_string(index + 1);
+  }
+  void setParameter(const std::string & /*name*/, float /*value*/) override {}
+  [[nodiscard]] float getParameter(const std::string & /*name*/) const override {
+    return 0.0F;
+  }
+  [[nodiscard]] std::vector<std::string> getParameterNames() const override {
+    return {};
+  }
+  [[nodiscard]] std::string getName() const override { return "GraphCapture"; }
+  [[nodiscard]] std::string getDescription() const override {
+    return "Backend capture channels";
+  }
+  [[nodiscard]] std::unique_ptr<Module<float>> clone() const override {
+    return std::make_unique<CaptureModule>(m_buffers);
+  }
+  void reset() override {}
+
+private:
+  const std::vector<const float *> &m_buffers;
+};
+
+} // namespace
+
+GraphProcessor::GraphProcessor(unsigned int numInputs, unsigned int numOutputs)
+    : m_numOutputs(numOutputs), m_captureBuffers(numInputs, nullptr),
+      m_control(m_events.addProducer("control")),
+      m_midi(m_events.addProducer("midi", false, true)) {
+  m_system.addModule(INPUT_MODULE,
+                     std::make_unique<CaptureModule>(m_captureBuffers));
+  for (unsigned int channel = 0; channel < numInputs; ++channel) {
+    m_inputSlots.push_back(m_system.getOutputBinding(INPUT_MODULE, channel));
+  }
+  m_directOutputs.reserve(numOutputs);
+  m_parameterName.reserve(EngineCommand::NAME_SIZE);
+}
+
+void GraphProcessor::connectOutput(const std::string &module,
+                                   unsigned int outputIndex,
+                                   unsigned int channel) {
+  if (channel >= m_numOutputs) {
+    throw std::runtime_error("Output channel " + std::to_string(channel) +
+                             " does not exist");
+  }
+  auto lock = lockGraph();
+  if (m_system.getModule(module) == nullptr) {
+    throw std::runtime_error("Module '" + module + "' does not exist.");
+  }
+  route(module.c_str(), outputIndex, channel);
+}
+
+void GraphProcessor::disconnectOutput(const std::string &module,
+                                      unsigned int outputIndex,
+                                      unsigned int channel) {
+  auto lock = lockGraph();
+  unroute(module.c_str(), outputIndex, channel);
+}
+
+void GraphProcessor::connectInput(unsigned int channel,
+                                  const std::string &module,
+                                  unsigned int inputIndex) {
+  if (channel >= getNumInputs()) {
+    throw std::runtime_error("Input channel " + std::to_string(channel) +
+                             " does not exist");
+  }
+  auto lock = lockGraph();
+  m_system.connect(INPUT_MODULE, channel, module, inputIndex);
+  m_system.updateProcessOrder();
+}
+
+void GraphProcessor::disconnectInput(unsigned int channel,
+                                     const std::string &module,
+                                     unsigned int inputIndex) {
+  auto lock = lockGraph();
+  m_system.disconnect(INPUT_MODULE, channel, module, inputIndex);
+  m_system.updateProcessOrder();
+}
+
+void GraphProcessor::route(const char *module, unsigned int outputIndex,
+                           unsigned int channel) {
+  m_routes.push_back({module, outputIndex, channel});
+  m_bindingsDirty = true;
+  if (m_shared != nullptr) {
+    m_shared->setNodeRouted(module, true);
+  }
+}
+
+void GraphProcessor::unroute(const char *module, unsigned int outputIndex,
+                             unsigned int channel) {
+  m_routes.erase(std::remove_if(m_routes.begin(), m_routes.end(),
+                                [&](const OutputRoute &route) {
+                                  return route.module == module &&
+                                         route.outputIndex == outputIndex &&
+                                         route.channel == channel;
+                                }),
+                 m_routes.end());
+  m_bindingsDirty = true;
+  if (m_shared != nullptr) {
+    m_shared->setNodeRouted(
+        module,
+        std::any_of(m_routes.begin(), m_routes.end(),
+                    [&](const OutputRoute &route) {
+                      return route.module == module;
+                    }));
+  }
+}
+
+bool GraphProcessor::send(EngineCommand &command) {
+  return m_control.push(0, command);
+}
+
+bool GraphProcessor::sendAddModule(const std::string &name,
+                                   std::unique_ptr<Module<float>> &module) {
+  EngineCommand command = EngineCommand::addModule(name, module.get());
+  // Prepared here so the audio thread only has to link it in
+  prepareModule(*module);
+  if (!send(command)) {
+    return false;
+  }
+  module.release();
+  return true;
+}
+
+bool GraphProcessor::sendRemoveModule(const std::string &name) {
+  EngineCommand command = EngineCommand::removeModule(name);
+  return send(command);
+}
+
+bool GraphProcessor::sendConnect(const std::string &fromModule,
+                                 unsigned int outputIndex,
+                                 const std::string &toModule,
+                                 unsigned int inputIndex) {
+  EngineCommand command =
+      EngineCommand::connect(fromModule, outputIndex, toModule, inputIndex);
+  return send(command);
+}
+
+bool GraphProcessor::sendDisconnect(const std::string &fromModule,
+                                    unsigned int outputIndex,
+                                    const std::string &toModule,
+                                    unsigned int inputIndex) {
+  EngineCommand command =
+      EngineCommand::disconnect(fromModule, outputIndex, toModule, inputIndex);
+  return send(command);
+}
+
+bool GraphProcessor::sendConnectOutput(const std::string &module,
+                                       unsigned int outputIndex,
+                                       unsigned int channel) {
+  EngineCommand command =
+      EngineCommand::connectOutput(module, outputIndex, channel);
+  return send(command);
+}
+
+bool GraphProcessor::sendDisconnectOutput(const std::string &module,
+                                          unsigned int outputIndex,
+                                          unsigned int channel) {
+  EngineCommand command =
+      EngineCommand::disconnectOutput(module, outputIndex, channel);
+  return send(command);
+}
+
+bool GraphProcessor::sendSetParameter(const std::string &module,
+                                      const std::string &parameter,
+                                      float value) {
+  EngineCommand command = EngineCommand::setParameter(module, parameter, value);
+  return send(command);
+}
+
+std::size_t GraphProcessor::collectReplies(
+    const std::function<void(const EngineReply &)> &onReply) {
+  return m_control.collectReplies(onReply);
+}
+
+void GraphProcessor::prepareModule(Module<float> &module) const {
+  const unsigned int sampleRate = m_sampleRate;
+  if (sampleRate > 0) {
+    module.prepare(sampleRate);
+  }
+}
+
+void GraphProcessor::checkParameter(const std::string &module,
+                                    const std::string &parameter) {
+  Module<float> *target = m_system.getModule(module);
+  if (target == nullptr) {
+    throw std::invalid_argument("No module '" + module + "'");
+  }
+  const auto names = target->getParameterNames();
+  if (std::find(names.begin(), names.end(), parameter) == names.end()) {
+    throw std::invalid_argument("Module '" + module + "' has no parameter '" +
+                                parameter + "'");
+  }
+}
+
+void GraphProcessor::setMidiVoices(const std::vector<std::string> &modules,
+                                   const std::string &frequencyParameter,
+                                   const std::string &gainParameter) {
+  auto lock = lockGraph();
+  for (const auto &module : modules) {
+    checkParameter(module, frequencyParameter);
+    checkParameter(module, gainParameter);
+  }
+  m_voiceModules = modules;
+  m_frequencyParameter = frequencyParameter;
+  m_gainParameter = gainParameter;
+  m_voices.setNumVoices(static_cast<unsigned int>(modules.size()));
+}
+
+void GraphProcessor::mapMidiController(int channel, unsigned int controller,
+                                       const std::string &module,
+                                       const std::string &parameter,
+                                       float minimum, float maximum) {
+  auto lock = lockGraph();
+  checkParameter(module, parameter);
+  m_controllerRoutes.push_back(
+      {channel, controller, module, parameter, minimum, maximum});
+}
+
+void GraphProcessor::setSharedState(SharedEngineState *state) {
+  // Blocks publish a meter for each of the state's channels
+  if (state != nullptr && state->getNumChannels() > m_numOutputs) {
+    throw std::invalid_argument(
+        "Shared state has " + std::to_string(state->getNumChannels()) +
+        " channels, the engine " + std::to_string(m_numOutputs) + " outputs");
+  }
+  auto lock = lockGraph();
+  m_shared = state;
+  if (state == nullptr) {
+    return;
+  }
+  for (const auto &name : m_system.getModuleNames()) {
+    state->addNode(name.c_str());
+  }
+  for (const auto &route : m_routes) {
+    state->setNodeRouted(route.module.c_str(), true);
+  }
+}
+
+void GraphProcessor::mapControlBus(unsigned int bus, const std::string &module,
+                                   const std::string &parameter) {
+  auto lock = lockGraph();
+  if (m_shared == nullptr ||
+      bus >= SharedEngineLayout::NUM_CONTROL_BUSES) {
+    throw std::invalid_argument("No shared control bus " +
+                                std::to_string(bus));
+  }
+  checkParameter(module, parameter);
+  // The bus's value now is not a change
+  m_busRoutes.push_back(
+      {bus, module, parameter, m_shared->getControlBus(bus)});
+}
+
+void GraphProcessor::applyControlBuses() {
+  for (auto &route : m_busRoutes) {
+    const float value = m_shared->getControlBus(route.bus);
+    if (value == route.value) {
+      continue;
+    }
+    route.value = value;
+    // The module may have been removed, or replaced by another, since
+    Module<float> *module = m_system.getModule(route.module);
+    if (module != nullptr) {
+      trySetParameter(*module, route.parameter, value);
+    }
+  }
+}
+
+void GraphProcessor::receiveMidi(const MidiMessage &message) {
+  // This thread also runs process(), so the frame time is the start of the
+  // block the offset refers to
+  const std::uint64_t time =
+      m_frameTime.load(std::memory_order_relaxed) + message.offset;
+  EngineCommand command = EngineCommand::midiMessage(message);
+  // A full ring drops the message
+  m_midi.push(time, command);
+}
+
+void GraphProcessor::setVoiceParameter(int voice, const std::string &parameter,
+                                       float value) {
+  if (voice < 0) {
+    return;
+  }
+  // The module may have been removed, or replaced by another, since
+  Module<float> *module =
+      m_system.getModule(m_voiceModules[static_cast<std::size_t>(voice)]);
+  if (module != nullptr) {
+    trySetParameter(*module, parameter, value);
+  }
+}
+
+bool GraphProcessor::trySetParameter(Module<float> &module,
+                                     const std::string &parameter,
+                                     float value) {
+  try {
+    module.setParameter(parameter, value);
+  } catch (const std::exception &) {
+    return false;
+  }
+  return true;
+}
+
+void GraphProcessor::applyMidi(const EngineCommand &command) {
+  MidiMessage message;
+  message.status = command.midi[0];
+  message.data1 = command.midi[1];
+  message.data2 = command.midi[2];
+  const unsigned int channel = message.getChannel();
+
+  switch (message.getType()) {
+  case MidiMessage::NoteOn:
+    if (message.data2 > 0) {
+      const int voice = m_voices.noteOn(channel, message.data1);
+      const float frequency =
+          440.0F * std::exp2((static_cast<float>(message.data1) - 69.0F) / 12.0F);
+      setVoiceParameter(voice, m_frequencyParameter, frequency);
+      setVoiceParameter(voice, m_gainParameter,
+                        static_cast<float>(message.data2) / 127.0F);
+      break;
+    }
+    // Velocity 0 is a note off
+    [[fallthrough]];
+  case MidiMessage::NoteOff:
+    setVoiceParameter(m_voices.noteOff(channel, message.data1), m_gainParameter,
+                      0.0F);
+    break;
+
+  case MidiMessage::ControlChange:
+    if (message.data1 == 123) {
+      // All notes off
+      for (unsigned int voice = 0; voice < m_voices.getNumVoices(); ++voice) {
+        setVoiceParameter(static_cast<int>(voice), m_gainParameter, 0.0F);
+      }
+      m_voices.releaseAll();
+    }
+    for (const auto &route : m_controllerRoutes) {
+      if (route.controller != message.data1 ||
+          (route.channel >= 0 && static_cast<unsigned int>(route.channel) != channel)) {
+        continue;
+      }
+      Module<float> *module = m_system.getModule(route.module);
+      if (module != nullptr) {
+        const float amount = static_cast<float>(message.data2) / 127.0F;
+        trySetParameter(*module, route.parameter,
+                        route.minimum + amount * (route.maximum - route.minimum));
+      }
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+EngineReply::Status GraphProcessor::apply(const EngineCommand &command,
+                                          Module<float> *&garbage) {
+  using Type = EngineCommand::Type;
+  if (command.type == Type::Midi) {
+    applyMidi(command);
+    return EngineReply::Status::Done;
+  }
+  if (command.type == Type::SetParameter) {
+    return applySetParameter(command);
+  }
+  // Views of the command's names; only a name the graph keeps is copied
+  const std::string_view module(command.module);
+  const bool exists = m_system.getModule(module) != nullptr;
+
+  // Structural edits that store names or resort the graph still allocate on
+  // the audio thread; the sort runs here so process() never does it lazily
+  ScopedRealtimeExemption exempt;
+  switch (command.type) {
+  case Type::AddModule:
+    if (exists || command.newModule == nullptr) {
+      garbage = command.newModule;
+      return EngineReply::Status::Rejected;
+    }
+    m_system.addModule(std::string(module),
+                       std::unique_ptr<Module<float>>(command.newModule));
+    m_system.updateProcessOrder();
+    if (m_shared != nullptr) {
+      m_shared->addNode(command.module);
+    }
+    return EngineReply::Status::Done;
+
+  case Type::RemoveModule:
+    if (!exists || module == INPUT_MODULE) {
+      return EngineReply::Status::Rejected;
+    }
+    m_routes.erase(std::remove_if(m_routes.begin(), m_routes.end(),
+                                  [&](const OutputRoute &route) {
+                                    return route.module == module;
+                                  }),
+                   m_routes.end());
+    m_bindingsDirty = true;
+    garbage = m_system.releaseModule(module).release();
+    m_system.updateProcessOrder();
+    if (m_shared != nullptr) {
+      m_shared->removeNode(command.module);
+    }
+    return EngineReply::Status::Done;
+
+  case Type::Connect: {
+    const std::string_view target(command.target);
+    if (!exists || m_system.getModule(target) == nullptr) {
+      return EngineReply::Status::Rejected;
+    }
+    m_system.connect(module, command.outputIndex, target, command.inputIndex);
+    try {
+      m_system.updateProcessOrder();
+    } catch (const std::runtime_error &) {
+      // Would close a cycle
+      m_system.disconnect(module, command.outputIndex, target,
+                          command.inputIndex);
+      return EngineReply::Status::Rejected;
+    }
+    return EngineReply::Status::Done;
+  }
+
+  case Type::Disconnect:
+    m_system.disconnect(module, command.outputIndex,
+                        std::string_view(command.target), command.inputIndex);
+    m_system.updateProcessOrder();
+    return EngineReply::Status::Done;
+
+  case Type::ConnectOutput:
+    if (!exists || command.inputIndex >= m_numOutputs) {
+      return EngineReply::Status::Rejected;
+    }
+    route(command.module, command.outputIndex, command.inputIndex);
+    return EngineReply::Status::Done;
+
+  case Type::DisconnectOutput:
+    unroute(command.module, command.outputIndex, command.inputIndex);
+    return EngineReply::Status::Done;
+
+  case Type::SetParameter:
+  case Type::Midi:
+    break;
+  }
+  return EngineReply::Status::Rejected;
+}
+
+EngineReply::Status
+GraphProcessor::applySetParameter(const EngineCommand &command) {
+  Module<float> *module = m_system.getModule(command.module);
+  if (module == nullptr) {
+    return EngineReply::Status::Rejected;
+  }
+  // Names fit the buffer reserved in the constructor, so this reuses it
+  m_parameterName.assign(command.target);
+  // A parameter the module does not have; the sender only learns of it here
+  return trySetParameter(*module, m_parameterName, command.value)
+             ? EngineReply::Status::Done
+             : EngineReply::Status::Rejected;
+}
+
+void GraphProcessor::prepare(unsigned int sampleRate,
+                             unsigned int maxBlockSize) {
+  AudioEngine::setSampleRate(sampleRate);
+  m_sampleRate = sampleRate;
+  m_clock.reset(sampleRate);
+  auto lock = lockGraph();
+  m_system.prepare(sampleRate, maxBlockSize);
+}
+
+void GraphProcessor::process(const float *const *inputs,
+                             float *const *outputs, unsigned int numFrames) {
+  const std::uint64_t blockStart = m_frameTime.load(std::memory_order_relaxed);
+  m_frameTime.store(blockStart + numFrames, std::memory_order_release);
+  m_clock.update(blockStart, std::chrono::steady_clock::now());
+
+  std::unique_lock<std::mutex> lock(m_graphMutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+  if (m_shared != nullptr) {
+    applyControlBuses();
+  }
+
+  // Render up to each event, so it takes effect at its frame within the
+  // granularity (scheduled events exactly); late events apply at the start
+  // of the block. A call without frames applies the events due now.
+  const unsigned int granularity = m_eventGranularity;
+  unsigned int rendered = 0;
+  m_events.drain(blockStart, blockStart + std::max(numFrames, 1U),
+                 m_commandBudget,
+                 [&](const ControlEvent &event, EngineReply &reply) {
+                   if (event.time > blockStart) {
+                     auto offset =
+                         static_cast<unsigned int>(event.time - blockStart);
+                     if (!event.sampleAccurate) {
+                       offset -= offset % granularity;
+                     }
+                     if (offset > rendered) {
+                       renderSpan(inputs, outputs, rendered, offset - rendered);
+                       rendered = offset;
+                     }
+                   }
+                   reply.status = apply(event.command, reply.garbage);
+                 });
+  if (rendered < numFrames) {
+    renderSpan(inputs, outputs, rendered, numFrames - rendered);
+  }
+  if (m_shared != nullptr && numFrames > 0) {
+    m_shared->publish(blockStart + numFrames, outputs, numFrames);
+  }
+}
+
+void GraphProcessor::updateBindings() {
+  // A channel fed by exactly one module output gets that output bound to
+  // its buffer; an output routed to several channels is bound to the first
+  // and mixed into the others
+  m_directOutputs.clear();
+  for (auto &route : m_routes) {
+    route.direct = false;
+  }
+  for (unsigned int channel = 0; channel < m_numOutputs; ++channel) {
+    OutputRoute *only = nullptr;
+    unsigned int count = 0;
+    for (auto &route : m_routes) {
+      if (route.channel == channel) {
+        only = &route;
+        ++count;
+      }
+    }
+    if (count != 1 || only->module == INPUT_MODULE) {
+      continue;
+    }
+    float **slot = m_system.getOutputBinding(only->module, only->outputIndex);
+    const bool claimed = std::any_of(
+        m_directOutputs.begin(), m_directOutputs.end(),
+        [&](const DirectOutput &direct) { return direct.slot == slot; });
+    if (slot != nullptr && !claimed) {
+      m_directOutputs.push_back({slot, channel});
+      only->direct = true;
+    }
+  }
+  m_bindingsVersion = m_system.getTopologyVersion();
+  m_bindingsDirty = false;
+}
+
+void GraphProcessor::renderSpan(const float *const *inputs,
+                                float *const *outputs, unsigned int offset,
+                                unsigned int numFrames) {
+  if (m_bindingsDirty || m_bindingsVersion != m_system.getTopologyVersion()) {
+    updateBindings();
+  }
+  for (std::size_t channel = 0; channel < m_captureBuffers.size(); ++channel) {
+    const float *input = inputs[channel];
+    m_captureBuffers[channel] = input != nullptr ? input + offset : nullptr;
+    // Modules only read their inputs, so the capture buffer is never written
+    *m_inputSlots[channel] = const_cast<float *>(m_captureBuffers[channel]);
+  }
+  for (const auto &direct : m_directOutputs) {
+    *direct.slot = outputs[direct.channel] + offset;
+  }
+
+  m_system.process(numFrames);
+
+  for (const auto &route : m_routes) {
+    if (route.direct) {
+      continue;
+    }
+    const float *source =
+        m_system.getOutputBuffer(route.module, route.outputIndex);
+    if (source == nullptr) {
+      continue;
+    }
+    float *destination = outputs[route.channel] + offset;
+    for (unsigned int i = 0; i < numFrames; ++i) {
+      destination[i] += source[i];
+    }
+  }
+
+  // Unbound between spans, so no slot points at a stale host buffer while
+  // commands edit the graph
+  for (float **slot : m_inputSlots) {
+    *slot = nullptr;
+  }
+  for (const auto &direct : m_directOutputs) {
+    *direct.slot = nullptr;
+  }
+}
+
+} // namespace tinysynth
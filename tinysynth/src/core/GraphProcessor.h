@@ -0,0 +1,238 @@
+// GraphProcessor.h
+#pragma once
+
+#include "AudioBackend.h"
+#include "ControlEventBus.h"
+#include "EngineCommand.h"
+#include "FrameClock.h"
+#include "MidiParser.h"
+#include "ModularSystem.h"
+#include "SharedEngineState.h"
+#include "VoiceAllocator.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// Renders a whole ModularSystem for an AudioBackend, so voices and
+// instruments are graph nodes and a backend's per-block cost stays constant
+// however many of them play.
+//
+// Capture channels are the outputs of the INPUT_MODULE node; module outputs
+// are routed to output channels, several routes to one channel mix. Both
+// ends are zero-copy where possible: the INPUT_MODULE outputs are bound to
+// the backend's capture buffers each block, and a module output that is the
+// only route to a channel is bound to that playback buffer, so the module
+// writes straight into the host's memory.
+//
+// While the backend runs, the graph is only edited through commands. The
+// send* calls are the path of one control thread (the GUI): each command
+// takes effect at the start of the next block and is answered on a return
+// ring, which also hands removed modules back so they are freed off the
+// realtime thread; drain it with collectReplies(). Other sources (OSC, MIDI)
+// register their own producer with addControlSource() and stamp events with
+// an engine frame; a block splits at event times, rounded down to the event
+// granularity. Scheduled sources (addScheduledControlSource) may send in any
+// order and split the block at their exact frame; getClock() converts a
+// system time to the frame they should carry. At most the command budget of
+// events is applied per block.
+// MIDI from the backend is one such source: receiveMidi() stamps each
+// message with its frame, and when the block reaches that exact frame,
+// whatever the granularity, a note drives a voice module and a controller
+// the parameters mapped to it.
+// With a SharedEngineState attached, each block publishes the output meters
+// into it, node status follows the commands that add, remove and route
+// modules, and control buses mapped to parameters are read at block start.
+// Direct edits (getSystem, connectOutput) must hold lockGraph(); a block that
+// finds the graph locked outputs silence.
+class GraphProcessor : public AudioProcessor {
+public:
+    static constexpr const char* INPUT_MODULE = "graph_in";
+    static constexpr unsigned int DEFAULT_COMMAND_BUDGET = 256;
+    static constexpr unsigned int DEFAULT_EVENT_GRANULARITY = 16;
+
+    GraphProcessor(unsigned int numInputs, unsigned int numOutputs);
+
+    [[nodiscard]] std::unique_lock<std::mutex> lockGraph() {
+        return std::unique_lock<std::mutex>(m_graphMutex);
+    }
+    ModularSystem<float>& getSystem() { return m_system; }
+
+    // Both lock the graph themselves
+    void connectOutput(const std::string& module, unsigned int outputIndex,
+                       unsigned int channel);
+    void disconnectOutput(const std::string& module, unsigned int outputIndex,
+                          unsigned int channel);
+    // Capture channel `channel` into a module input; the same as connecting
+    // the INPUT_MODULE output of that index
+    void connectInput(unsigned int channel, const std::string& module, unsigned int inputIndex);
+    void disconnectInput(unsigned int channel, const std::string& module,
+                         unsigned int inputIndex);
+
+    // Each returns false when the command ring is full. Names must be
+    // shorter than EngineCommand::NAME_SIZE.
+    bool send(EngineCommand& command);
+    // Takes the module only when the command was queued
+    bool sendAddModule(const std::string& name, std::unique_ptr<Module<float>>& module);
+    bool sendRemoveModule(const std::string& name);
+    bool sendConnect(const std::string& fromModule, unsigned int outputIndex,
+                     const std::string& toModule, unsigned int inputIndex);
+    bool sendDisconnect(const std::string& fromModule, unsigned int outputIndex,
+                        const std::string& toModule, unsigned int inputIndex);
+    bool sendConnectOutput(const std::string& module, unsigned int outputIndex,
+                           unsigned int channel);
+    bool sendDisconnectOutput(const std::string& module, unsigned int outputIndex,
+                              unsigned int channel);
+    bool sendSetParameter(const std::string& module, const std::string& parameter,
+                          float value);
+
+    // Replies to the send* commands; see ControlEventBus::Producer
+    std::size_t collectReplies(const std::function<void(const EngineReply&)>& onReply = {});
+
+    // A new timestamped event source, used by one thread. Modules it adds
+    // should go through prepareModule() first.
+    ControlEventBus::Producer& addControlSource(const std::string& name,
+                                                bool replyToAll = true) {
+        return m_events.addProducer(name, replyToAll);
+    }
+    // The same for events sent ahead of time, in any order
+    ControlEventBus::Producer& addScheduledControlSource(const std::string& name,
+                                                         bool replyToAll = true) {
+        return m_events.addScheduledProducer(name, replyToAll);
+    }
+    // Frames rendered so far, counting the block in progress; an event
+    // stamped with it lands at the start of the next block
+    [[nodiscard]] std::uint64_t getFrameTime() const {
+        return m_frameTime.load(std::memory_order_acquire);
+    }
+    // System time to engine frames, stamped at every block start
+    [[nodiscard]] const FrameClock& getClock() const { return m_clock; }
+    // Control thread: prepares a module for the running sample rate
+    void prepareModule(Module<float>& module) const;
+
+    // MIDI notes play these modules: a note sets frequencyParameter (Hz)
+    // and gainParameter (velocity / 127) of the voice it is allocated, and
+    // its release sets the gain to 0. Throws std::invalid_argument for a
+    // module or parameter that does not exist. Locks the graph.
+    void setMidiVoices(const std::vector<std::string>& modules,
+                       const std::string& frequencyParameter = "frequency",
+                       const std::string& gainParameter = "amplitude");
+    // Controller `controller` on `channel` (-1 for any) sets the parameter,
+    // 0..127 scaled to minimum..maximum. Throws like setMidiVoices and locks
+    // the graph.
+    void mapMidiController(int channel, unsigned int controller, const std::string& module,
+                           const std::string& parameter, float minimum, float maximum);
+
+    // Publishes into `state` from now on, listing the modules already in
+    // the graph; nullptr detaches. The state must outlive the attachment.
+    // Throws std::invalid_argument for a state with more channels than the
+    // engine has outputs. Locks the graph.
+    void setSharedState(SharedEngineState* state);
+    // Shared control bus `bus` sets the parameter whenever a client changes
+    // it. Throws like setMidiVoices, and without a shared state or for a
+    // bus out of range; locks the graph.
+    void mapControlBus(unsigned int bus, const std::string& module, const std::string& parameter);
+
+    void setCommandBudget(unsigned int budget) { m_commandBudget = budget; }
+    void setEventGranularity(unsigned int frames) { m_eventGranularity = std::max(frames, 1U); }
+
+    void prepare(unsigned int sampleRate, unsigned int maxBlockSize) override;
+    void process(const float* const* inputs, float* const* outputs,
+                 unsigned int numFrames) override;
+    void receiveMidi(const MidiMessage& message) override;
+
+    [[nodiscard]] unsigned int getNumInputs() const {
+        return static_cast<unsigned int>(m_captureBuffers.size());
+    }
+    [[nodiscard]] unsigned int getNumOutputs() const { return m_numOutputs; }
+
+private:
+    struct OutputRoute {
+        std::string module;
+        unsigned int outputIndex;
+        unsigned int channel;
+        // Rendered in place through a binding rather than mixed
+        bool direct = false;
+    };
+
+    struct DirectOutput {
+        float** slot;
+        unsigned int channel;
+    };
+
+    struct MidiControllerRoute {
+        int channel;
+        unsigned int controller;
+        std::string module;
+        std::string parameter;
+        float minimum;
+        float maximum;
+    };
+
+    struct ControlBusRoute {
+        unsigned int bus;
+        std::string module;
+        std::string parameter;
+        // Last value applied, so only changes reach the module
+        float value;
+    };
+
+    EngineReply::Status apply(const EngineCommand& command, Module<float>*& garbage);
+    // Neither allocates nor lets a module's throw out: an unknown module
+    // or parameter is Rejected
+    EngineReply::Status applySetParameter(const EngineCommand& command);
+    void applyMidi(const EngineCommand& command);
+    void setVoiceParameter(int voice, const std::string& parameter, float value);
+    // Audio thread: false when the module throws, e.g. because the name now
+    // belongs to a module without that parameter; the throw must not reach
+    // the backend's callback
+    static bool trySetParameter(Module<float>& module, const std::string& parameter,
+                                float value);
+    void checkParameter(const std::string& module, const std::string& parameter);
+    void renderSpan(const float* const* inputs, float* const* outputs, unsigned int offset,
+                    unsigned int numFrames);
+    void updateBindings();
+    void applyControlBuses();
+    // module is NUL-terminated, as in an EngineCommand, for the shared state
+    void route(const char* module, unsigned int outputIndex, unsigned int channel);
+    void unroute(const char* module, unsigned int outputIndex, unsigned int channel);
+
+    unsigned int m_numOutputs;
+    // Capture buffers of the current span, read by the INPUT_MODULE node
+    std::vector<const float*> m_captureBuffers;
+    ModularSystem<float> m_system;
+    std::vector<OutputRoute> m_routes;
+    std::mutex m_graphMutex;
+    // ModularSystem output slots of the INPUT_MODULE, one per capture channel
+    std::vector<float**> m_inputSlots;
+    std::vector<DirectOutput> m_directOutputs;
+    std::uint64_t m_bindingsVersion = 0;
+    bool m_bindingsDirty = true;
+
+    ControlEventBus m_events;
+    // The send* path
+    ControlEventBus::Producer& m_control;
+    // Fed by receiveMidi() on the audio thread; never replied to
+    ControlEventBus::Producer& m_midi;
+    // SetParameter names, copied into reserved capacity on the audio thread
+    std::string m_parameterName;
+    std::vector<std::string> m_voiceModules;
+    std::string m_frequencyParameter;
+    std::string m_gainParameter;
+    VoiceAllocator m_voices;
+    std::vector<MidiControllerRoute> m_controllerRoutes;
+    SharedEngineState* m_shared = nullptr;
+    std::vector<ControlBusRoute> m_busRoutes;
+    std::atomic<std::uint64_t> m_frameTime{0};
+    FrameClock m_clock;
+    std::atomic<unsigned int> m_sampleRate{0};
+    std::atomic<unsigned int> m_commandBudget{DEFAULT_COMMAND_BUDGET};
+    std::atomic<unsigned int> m_eventGranularity{DEFAULT_EVENT_GRANULARITY};
+};
+
+} // namespace tinysynth
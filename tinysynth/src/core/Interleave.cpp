@@ -0,0 +1,178 @@
+// Interleave.cpp
+#include "Interleave.h"
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#define TINYSYNTH_INTERLEAVE_SSE 1
+#endif
+
+namespace tinysynth {
+
+namespace {
+
+// Frames [begin, end) of channels [first, last)
+void interleaveScalar(const float *const *channels, unsigned int numChannels,
+                      float *destination, unsigned int first, unsigned int last,
+                      unsigned int begin, unsigned int end) {
+  for (unsigned int f = begin; f < end; ++f) {
+    float *frame = destination + static_cast<std::size_t>(f) * numChannels;
+    for (unsigned int c = first; c < last; ++c) {
+      frame[c] = channels[c][f];
+    }
+  }
+}
+
+void deinterleaveScalar(const float *source, unsigned int numChannels,
+                        float *const *channels, unsigned int first,
+                        unsigned int last, unsigned int begin,
+                        unsigned int end) {
+  for (unsigned int f = begin; f < end; ++f) {
+    const float *frame = source + static_cast<std::size_t>(f) * numChannels;
+    for (unsigned int c = first; c < last; ++c) {
+      channels[c][f] = frame[c];
+    }
+  }
+}
+
+#if defined(TINYSYNTH_INTERLEAVE_SSE)
+
+// Whole blocks of four frames; the caller does the rest
+constexpr unsigned int vectorFrames(unsigned int numFrames) {
+  return numFrames & ~3U;
+}
+
+void interleaveStereo(const float *const *channels, float *destination,
+                      unsigned int numFrames) {
+  const unsigned int end = vectorFrames(numFrames);
+  for (unsigned int f = 0; f < end; f += 4) {
+    const __m128 left = _mm_loadu_ps(channels[0] + f);
+    const __m128 right = _mm_loadu_ps(channels[1] + f);
+    _mm_storeu_ps(destination + 2 * f, _mm_unpacklo_ps(left, right));
+    _mm_storeu_ps(destination + 2 * f + 4, _mm_unpackhi_ps(left, right));
+  }
+  interleaveScalar(channels, 2, destination, 0, 2, end, numFrames);
+}
+
+void deinterleaveStereo(const float *source, float *const *channels,
+                        unsigned int numFrames) {
+  const unsigned int end = vectorFrames(numFrames);
+  for (unsigned int f = 0; f < end; f += 4) {
+    const __m128 low = _mm_loadu_ps(source + 2 * f);
+    const __m128 high = _mm_loadu_ps(source + 2 * f + 4);
+    _mm_storeu_ps(channels[0] + f,
+                  _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(channels[1] + f,
+                  _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  deinterleaveScalar(source, 2, channels, 0, 2, end, numFrames);
+}
+
+// Four frames of four channels are a 4x4 transpose. Channels is the count
+// when known at compile time (4, 8), so those loops unroll; 0 reads it
+// from numChannels. Channels past the last group of four are copied.
+template <unsigned int Channels>
+void interleaveQuads(const float *const *channels, unsigned int numChannels,
+                     float *destination, unsigned int numFrames) {
+  const unsigned int stride = Channels != 0 ? Channels : numChannels;
+  const unsigned int quads = stride & ~3U;
+  const unsigned int end = vectorFrames(numFrames);
+  for (unsigned int f = 0; f < end; f += 4) {
+    float *frame = destination + static_cast<std::size_t>(f) * stride;
+    for (unsigned int c = 0; c < quads; c += 4) {
+      __m128 r0 = _mm_loadu_ps(channels[c] + f);
+      __m128 r1 = _mm_loadu_ps(channels[c + 1] + f);
+      __m128 r2 = _mm_loadu_ps(channels[c + 2] + f);
+      __m128 r3 = _mm_loadu_ps(channels[c + 3] + f);
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(frame + c, r0);
+      _mm_storeu_ps(frame + stride + c, r1);
+      _mm_storeu_ps(frame + 2 * stride + c, r2);
+      _mm_storeu_ps(frame + 3 * stride + c, r3);
+    }
+    interleaveScalar(channels, stride, destination, quads, stride, f, f + 4);
+  }
+  interleaveScalar(channels, stride, destination, 0, stride, end, numFrames);
+}
+
+template <unsigned int Channels>
+void deinterleaveQuads(const float *source, unsigned int numChannels,
+                       float *const *channels, unsigned int numFrames) {
+  const unsigned int stride = Channels != 0 ? Channels : numChannels;
+  const unsigned int quads = stride & ~3U;
+  const unsigned int end = vectorFrames(numFrames);
+  for (unsigned int f = 0; f < end; f += 4) {
+    const float *frame = source + static_cast<std::size_t>(f) * stride;
+    for (unsigned int c = 0; c < quads; c += 4) {
+      __m128 r0 = _mm_loadu_ps(frame + c);
+      __m128 r1 = _mm_loadu_ps(frame + stride + c);
+      __m128 r2 = _mm_loadu_ps(frame + 2 * stride + c);
+      __m128 r3 = _mm_loadu_ps(frame + 3 * stride + c);
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(channels[c] + f, r0);
+      _mm_storeu_ps(channels[c + 1] + f, r1);
+      _mm_storeu_ps(channels[c + 2] + f, r2);
+      _mm_storeu_ps(channels[c + 3] + f, r3);
+    }
+    deinterleaveScalar(source, stride, channels, quads, stride, f, f + 4);
+  }
+  deinterleaveScalar(source, stride, channels, 0, stride, end, numFrames);
+}
+
+#endif
+
+} // namespace
+
+void interleave(const float *const *channels, unsigned int numChannels,
+                float *destination, unsigned int numFrames) {
+#if defined(TINYSYNTH_INTERLEAVE_SSE)
+  switch (numChannels) {
+  case 1:
+    break;
+  case 2:
+    interleaveStereo(channels, destination, numFrames);
+    return;
+  case 4:
+    interleaveQuads<4>(channels, numChannels, destination, numFrames);
+    return;
+  case 8:
+    interleaveQuads<8>(channels, numChannels, destination, numFrames);
+    return;
+  default:
+    if (numChannels > 4) {
+      interleaveQuads<0>(channels, numChannels, destination, numFrames);
+      return;
+    }
+  }
+#endif
+  interleaveScalar(channels, numChannels, destination, 0, numChannels, 0,
+                   numFrames);
+}
+
+void deinterleave(const float *source, unsigned int numChannels,
+                  float *const *channels, unsigned int numFrames) {
+#if defined(TINYSYNTH_INTERLEAVE_SSE)
+  switch (numChannels) {
+  case 1:
+    break;
+  case 2:
+    deinterleaveStereo(source, channels, numFrames);
+    return;
+  case 4:
+    deinterleaveQuads<4>(source, numChannels, channels, numFrames);
+    return;
+  case 8:
+    deinterleaveQuads<8>(source, numChannels, channels, numFrames);
+    return;
+  default:
+    if (numChannels > 4) {
+      deinterleaveQuads<0>(source, numChannels, channels, numFrames);
+      return;
+    }
+  }
+#endif
+  deinterleaveScalar(source, numChannels, channels, 0, numChannels, 0,
+                     numFrames);
+}
+
+} // namespace tinysynth
@@ -0,0 +1,19 @@
+// Interleave.h
+#pragma once
+
+namespace tinysynth {
+
+// Conversion between the engine's planar buffers (one per channel) and the
+// interleaved frames of audio files. Two, four and eight channels have
+// SSE kernels of their own; other counts transpose four channels at a time
+// and copy the rest. Neither allocates, so both may run on the audio thread.
+
+// destination receives numFrames frames of numChannels samples
+void interleave(const float* const* channels, unsigned int numChannels, float* destination,
+                unsigned int numFrames);
+
+// channels receive numFrames samples each from source's frames
+void deinterleave(const float* source, unsigned int numChannels, float* const* channels,
+                  unsigned int numFrames);
+
+} // namespace tinysynth
@@ -0,0 +1,270 @@
+// JackClient.cpp
+#include "JackClient.h"
+#include "DenormalGuard.h"
+#include "RealtimeMemory.h"
+#include "RealtimeSanitizer.h"
+#include <algorithm>
+#include <jack/midiport.h>
+#include <stdexcept>
+#include <thread>
+
+namespace tinysynth {
+
+namespace {
+
+jack_port_t *registerPort(jack_client_t *client, const std::string &name,
+                          const char *type, unsigned long flags) {
+  jack_port_t *port =
+      jack_port_register(client, name.c_str(), type, flags, 0);
+  if (port == nullptr) {
+    throw std::runtime_error("Failed to register JACK port " + name);
+  }
+  return port;
+}
+
+} // namespace
+
+JackClient::Ports JackClient::Ports::numbered(unsigned int numInputs,
+                                              unsigned int numOutputs) {
+  Ports ports;
+  for (unsigned int i = 0; i < numInputs; ++i) {
+    ports.inputs.push_back("in_" + std::to_string(i + 1));
+  }
+  for (unsigned int i = 0; i < numOutputs; ++i) {
+    ports.outputs.push_back("out_" + std::to_string(i + 1));
+  }
+  return ports;
+}
+
+JackClient::JackClient(const std::string &clientName, unsigned int numInputs,
+                       unsigned int numOutputs, bool midiInput)
+    : JackClient(clientName, [&] {
+        Ports ports = Ports::numbered(numInputs, numOutputs);
+        ports.midiInput = midiInput;
+        return ports;
+      }()) {}
+
+JackClient::JackClient(const std::string &clientName, const Ports &ports)
+    : m_connectPhysical(ports.connectPhysical),
+      m_captureBuffers(ports.inputs.size(), nullptr),
+      m_playbackBuffers(ports.outputs.size(), nullptr) {
+  m_client = jack_client_open(clientName.c_str(), JackNullOption, nullptr);
+  if (m_client == nullptr) {
+    throw std::runtime_error("Failed to open JACK client");
+  }
+
+  try {
+    for (const auto &name : ports.inputs) {
+      m_inputPorts.push_back(registerPort(m_client, name,
+                                          JACK_DEFAULT_AUDIO_TYPE,
+                                          JackPortIsInput));
+    }
+    for (const auto &name : ports.outputs) {
+      m_outputPorts.push_back(registerPort(m_client, name,
+                                           JACK_DEFAULT_AUDIO_TYPE,
+                                           JackPortIsOutput));
+    }
+    if (ports.midiInput) {
+      m_midiPort = registerPort(m_client, "midi_in", JACK_DEFAULT_MIDI_TYPE,
+                                JackPortIsInput);
+    }
+
+    if (jack_set_process_callback(m_client, process, this) != 0) {
+      throw std::runtime_error("Failed to set JACK process callback");
+    }
+    if (jack_set_latency_callback(m_client, latency, this) != 0) {
+      throw std::runtime_error("Failed to set JACK latency callback");
+    }
+    if (jack_set_thread_init_callback(m_client, threadInit, this) != 0) {
+      throw std::runtime_error("Failed to set JACK thread init callback");
+    }
+    if (jack_set_sample_rate_callback(m_client, sampleRateChanged, this) != 0 ||
+        jack_set_buffer_size_callback(m_client, bufferSizeChanged, this) != 0) {
+      throw std::runtime_error("Failed to set JACK format callbacks");
+    }
+    m_sampleRate = jack_get_sample_rate(m_client);
+    m_bufferSize = jack_get_buffer_size(m_client);
+    jack_on_shutdown(m_client, shutdown, this);
+  } catch (...) {
+    close();
+    throw;
+  }
+}
+
+JackClient::~JackClient() { close(); }
+
+void JackClient::threadInit(void * /*arg*/) {
+  // The process thread faults its stack in before the first period
+  RealtimeMemory::prefaultStack();
+}
+
+void JackClient::close() {
+  if (m_client != nullptr) {
+    jack_client_close(m_client);
+    m_client = nullptr;
+  }
+}
+
+void JackClient::start(AudioProcessor &processor) {
+  stop();
+  processor.prepare(getSampleRate(), getBufferSize());
+  m_preparedBlockSize = getBufferSize();
+  m_suspended = false;
+  m_processor = &processor;
+  if (jack_activate(m_client) != 0) {
+    m_processor = nullptr;
+    throw std::runtime_error("Failed to activate JACK client");
+  }
+  m_active = true;
+  // The processor's latency is known only now
+  jack_recompute_total_latencies(m_client);
+  if (m_connectPhysical) {
+    connectPhysicalPorts();
+  }
+}
+
+void JackClient::connectPhysicalPorts() {
+  // A port that cannot be connected stays unconnected; the user can still
+  // patch it by hand
+  const auto connect = [this](unsigned long flags,
+                              const std::vector<jack_port_t *> &own,
+                              bool capture) {
+    const char **physical = jack_get_ports(m_client, nullptr,
+                                           JACK_DEFAULT_AUDIO_TYPE,
+                                           JackPortIsPhysical | flags);
+    if (physical == nullptr) {
+      return;
+    }
+    for (std::size_t i = 0; i < own.size() && physical[i] != nullptr; ++i) {
+      const char *ownName = jack_port_name(own[i]);
+      jack_connect(m_client, capture ? physical[i] : ownName,
+                   capture ? ownName : physical[i]);
+    }
+    jack_free(physical);
+  };
+  // Physical capture ports are outputs of the system client
+  connect(JackPortIsOutput, m_inputPorts, true);
+  connect(JackPortIsInput, m_outputPorts, false);
+}
+
+void JackClient::stop() {
+  if (m_active) {
+    // Returns once the process callback can no longer run
+    jack_deactivate(m_client);
+    m_active = false;
+  }
+  m_processor = nullptr;
+}
+
+unsigned int JackClient::getSampleRate() const { return m_sampleRate; }
+
+unsigned int JackClient::getBufferSize() const { return m_bufferSize; }
+
+int JackClient::sampleRateChanged(jack_nframes_t sampleRate, void *arg) {
+  auto *self = static_cast<JackClient *>(arg);
+  if (self->m_sampleRate.exchange(sampleRate) != sampleRate) {
+    self->reprepare(sampleRate, self->m_preparedBlockSize);
+  }
+  return 0;
+}
+
+int JackClient::bufferSizeChanged(jack_nframes_t bufferSize, void *arg) {
+  auto *self = static_cast<JackClient *>(arg);
+  self->m_bufferSize = bufferSize;
+  // Shorter periods fit the buffers already there
+  if (bufferSize > self->m_preparedBlockSize) {
+    self->reprepare(self->m_sampleRate, bufferSize);
+  }
+  return 0;
+}
+
+void JackClient::reprepare(unsigned int sampleRate, unsigned int maxBlockSize) {
+  if (m_processor == nullptr) {
+    // start() prepares with the cached values
+    return;
+  }
+  // Pairs with the callback's m_inProcess store and m_suspended load: once
+  // this sees no cycle inside, every later cycle sees the suspension
+  m_suspended.store(true);
+  while (m_inProcess.load()) {
+    std::this_thread::yield();
+  }
+  m_processor->prepare(sampleRate, maxBlockSize);
+  m_preparedBlockSize = maxBlockSize;
+  m_suspended.store(false);
+}
+
+int JackClient::process(jack_nframes_t nframes, void *arg) {
+  ScopedDenormalGuard denormalGuard;
+  ScopedRealtimeContext realtime;
+  static_cast<JackClient *>(arg)->processAudio(nframes);
+  return 0;
+}
+
+void JackClient::shutdown(void * /*arg*/) {
+  // The server is gone; the destructor still closes the handle
+}
+
+void JackClient::latency(jack_latency_callback_mode_t mode, void *arg) {
+  // Ports on the far side of the processor see its latency on top of the
+  // worst latency on the near side
+  auto *self = static_cast<JackClient *>(arg);
+  const jack_nframes_t own =
+      self->m_processor != nullptr ? self->m_processor->getLatency() : 0;
+  const bool capture = mode == JackCaptureLatency;
+  const auto &from = capture ? self->m_inputPorts : self->m_outputPorts;
+  const auto &to = capture ? self->m_outputPorts : self->m_inputPorts;
+
+  jack_latency_range_t range{0, 0};
+  for (jack_port_t *port : from) {
+    jack_latency_range_t portRange;
+    jack_port_get_latency_range(port, mode, &portRange);
+    range.min = std::max(range.min, portRange.min);
+    range.max = std::max(range.max, portRange.max);
+  }
+  range.min += own;
+  range.max += own;
+  for (jack_port_t *port : to) {
+    jack_port_set_latency_range(port, mode, &range);
+  }
+}
+
+void JackClient::processAudio(jack_nframes_t nframes) {
+  for (std::size_t i = 0; i < m_inputPorts.size(); ++i) {
+    m_captureBuffers[i] = static_cast<const float *>(
+        jack_port_get_buffer(m_inputPorts[i], nframes));
+  }
+  for (std::size_t i = 0; i < m_outputPorts.size(); ++i) {
+    m_playbackBuffers[i] =
+        static_cast<float *>(jack_port_get_buffer(m_outputPorts[i], nframes));
+    std::fill(m_playbackBuffers[i], m_playbackBuffers[i] + nframes, 0.0F);
+  }
+
+  m_inProcess.store(true);
+  if (!m_suspended.load() && nframes <= m_preparedBlockSize) {
+    processMidi(nframes);
+    m_processor->process(m_captureBuffers.data(), m_playbackBuffers.data(),
+                         nframes);
+  }
+  m_inProcess.store(false);
+}
+
+void JackClient::processMidi(jack_nframes_t nframes) {
+  if (m_midiPort == nullptr) {
+    return;
+  }
+  void *buffer = jack_port_get_buffer(m_midiPort, nframes);
+  const jack_nframes_t count = jack_midi_get_event_count(buffer);
+  for (jack_nframes_t i = 0; i < count; ++i) {
+    jack_midi_event_t event;
+    if (jack_midi_event_get(&event, buffer, i) != 0) {
+      continue;
+    }
+    m_midiParser.parse(event.buffer, event.size, event.time,
+                       [this](const MidiMessage &message) {
+                         m_processor->receiveMidi(message);
+                       });
+  }
+}
+
+} // namespace tinysynth
@@ -0,0 +1,98 @@
+// JackClient.h
+#pragma once
+
+#include "AudioBackend.h"
+#include "MidiParser.h"
+#include <atomic>
+#include <jack/jack.h>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// Realtime backend: the engine's one JACK client, with a set of capture
+// and playback ports (in_1.., out_1.. unless named), channel i of the
+// processor being port i. Host the whole graph in
+// a single processor (see GraphProcessor) rather than opening a client per
+// voice, so JACK's per-period cost stays constant. The port buffers are
+// passed to the processor as they are; GraphProcessor binds them into the
+// graph instead of copying. With midiInput there is also a midi_in port;
+// its events are parsed in the callback and passed to the processor with
+// their frame offsets before the block renders.
+//
+// When the server changes its sample rate or grows its buffer size, the
+// processor is prepared again on JACK's notification thread while the
+// process callback outputs silence, and resumes at the next cycle; the
+// callback itself never allocates. A period longer than the processor was
+// prepared for is played as silence until that has happened.
+class JackClient : public AudioBackend {
+public:
+    struct Ports {
+        std::vector<std::string> inputs;
+        std::vector<std::string> outputs;
+        bool midiInput = false;
+        // start() connects the ports in order to the server's physical
+        // capture and playback ports, as far as there are any
+        bool connectPhysical = false;
+
+        // in_1..in_N, out_1..out_N
+        static Ports numbered(unsigned int numInputs, unsigned int numOutputs);
+    };
+
+    JackClient(const std::string& clientName, const Ports& ports);
+    JackClient(const std::string& clientName, unsigned int numInputs,
+               unsigned int numOutputs, bool midiInput = false);
+    JackClient(const JackClient&) = delete;
+    JackClient& operator=(const JackClient&) = delete;
+    ~JackClient() override;
+
+    void start(AudioProcessor& processor) override;
+    void stop() override;
+
+    [[nodiscard]] unsigned int getSampleRate() const override;
+    [[nodiscard]] unsigned int getBufferSize() const override;
+    [[nodiscard]] unsigned int getNumInputs() const override {
+        return static_cast<unsigned int>(m_inputPorts.size());
+    }
+    [[nodiscard]] unsigned int getNumOutputs() const override {
+        return static_cast<unsigned int>(m_outputPorts.size());
+    }
+
+private:
+    static int process(jack_nframes_t nframes, void* arg);
+    static void shutdown(void* arg);
+    static void latency(jack_latency_callback_mode_t mode, void* arg);
+    static void threadInit(void* arg);
+    static int sampleRateChanged(jack_nframes_t sampleRate, void* arg);
+    static int bufferSizeChanged(jack_nframes_t bufferSize, void* arg);
+    void processAudio(jack_nframes_t nframes);
+    void processMidi(jack_nframes_t nframes);
+    void connectPhysicalPorts();
+    // Notification thread: suspends the process callback, prepares the
+    // processor and resumes it
+    void reprepare(unsigned int sampleRate, unsigned int maxBlockSize);
+    void close();
+
+    jack_client_t* m_client = nullptr;
+    AudioProcessor* m_processor = nullptr;
+    bool m_active = false;
+    bool m_connectPhysical = false;
+    // Cached from the server and its callbacks, so no cycle queries it
+    std::atomic<unsigned int> m_sampleRate{0};
+    std::atomic<unsigned int> m_bufferSize{0};
+    // Largest period the processor is prepared for
+    std::atomic<unsigned int> m_preparedBlockSize{0};
+    // Handshake for reprepare(): the callback skips the processor while
+    // suspended, and reprepare() waits until no cycle is inside it
+    std::atomic<bool> m_suspended{false};
+    std::atomic<bool> m_inProcess{false};
+    std::vector<jack_port_t*> m_inputPorts;
+    std::vector<jack_port_t*> m_outputPorts;
+    jack_port_t* m_midiPort = nullptr;
+    // Running status carries over between events and periods
+    MidiParser m_midiParser;
+    std::vector<const float*> m_captureBuffers;
+    std::vector<float*> m_playbackBuffers;
+};
+
+} // namespace tinysynth
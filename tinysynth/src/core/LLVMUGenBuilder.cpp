@@ -0,0 +1,73 @@
+// LLVMUGenBuilder.cpp
+#include "LLVMUGenBuilder.h"
+#include "../utils/Constants.h"
+#include <llvm/IR/Intrinsics.h>
+
+namespace tinysynth {
+
+namespace {
+constexpr double PI = Constants<double>::piConstant;
+constexpr double TWO_PI = Constants<double>::twoPiConstant;
+} // namespace
+
+LLVMUGenBuilder::LLVMUGenBuilder(llvm::IRBuilder<> &builder)
+    : m_builder(builder) {}
+
+llvm::Value *LLVMUGenBuilder::constant(llvm::Value *like, double value) {
+  return llvm::ConstantFP::get(like->getType(), value);
+}
+
+llvm::Value *LLVMUGenBuilder::buildSineOsc(llvm::Value *phase) {
+  return m_builder.CreateUnaryIntrinsic(llvm::Intrinsic::sin, phase);
+}
+
+llvm::Value *LLVMUGenBuilder::buildSawOsc(llvm::Value *phase) {
+  // phase / pi - 1
+  return m_builder.CreateFSub(
+      m_builder.CreateFMul(phase, constant(phase, 1.0 / PI)),
+      constant(phase, 1.0));
+}
+
+llvm::Value *LLVMUGenBuilder::buildTriangleOsc(llvm::Value *phase) {
+  // phase < pi ? -1 + 2 phase / pi : 3 - 2 phase / pi
+  llvm::Value *scaled = m_builder.CreateFMul(phase, constant(phase, 2.0 / PI));
+  llvm::Value *rising = m_builder.CreateFSub(scaled, constant(phase, 1.0));
+  llvm::Value *falling = m_builder.CreateFSub(constant(phase, 3.0), scaled);
+  llvm::Value *firstHalf =
+      m_builder.CreateFCmpOLT(phase, constant(phase, PI));
+  return m_builder.CreateSelect(firstHalf, rising, falling);
+}
+
+llvm::Value *LLVMUGenBuilder::buildPulseOsc(llvm::Value *phase) {
+  llvm::Value *firstHalf =
+      m_builder.CreateFCmpOLT(phase, constant(phase, PI));
+  return m_builder.CreateSelect(firstHalf, constant(phase, 1.0),
+                                constant(phase, -1.0));
+}
+
+llvm::Value *LLVMUGenBuilder::buildWaveform(const std::string &ugenType,
+                                            llvm::Value *phase) {
+  if (ugenType == "SineOsc") {
+    return buildSineOsc(phase);
+  }
+  if (ugenType == "SawOsc") {
+    return buildSawOsc(phase);
+  }
+  if (ugenType == "TriangleOsc") {
+    return buildTriangleOsc(phase);
+  }
+  if (ugenType == "PulseOsc" || ugenType == "SquareOsc") {
+    return buildPulseOsc(phase);
+  }
+  return nullptr;
+}
+
+llvm::Value *LLVMUGenBuilder::addPhaseAccumulation(llvm::Value *phase,
+                                                   llvm::Value *increment) {
+  llvm::Value *next = m_builder.CreateFAdd(phase, increment);
+  llvm::Value *wrapped = m_builder.CreateFSub(next, constant(next, TWO_PI));
+  llvm::Value *overflow = m_builder.CreateFCmpOGE(next, constant(next, TWO_PI));
+  return m_builder.CreateSelect(overflow, wrapped, next);
+}
+
+} // namespace tinysynth
@@ -9,21 +9,28 @@
 
 namespace tinysynth {
 
+// Emits the per-sample oscillator code of a fused SynthDef loop at the
+// builder's insert point. Phases are in radians, [0, 2pi). Every method
+// works on float scalars and float vectors alike.
 class LLVMUGenBuilder {
 public:
-    LLVMUGenBuilder();
+    explicit LLVMUGenBuilder(llvm::IRBuilder<>& builder);
 
-    std::unique_ptr<llvm::Module> buildSineOsc();
-    std::unique_ptr<llvm::Module> buildSawOsc();
-    std::unique_ptr<llvm::Module> buildTriangleOsc();
-    std::unique_ptr<llvm::Module> buildPulseOsc();
+    llvm::Value* buildSineOsc(llvm::Value* phase);
+    llvm::Value* buildSawOsc(llvm::Value* phase);
+    llvm::Value* buildTriangleOsc(llvm::Value* phase);
+    llvm::Value* buildPulseOsc(llvm::Value* phase);
+
+    // Dispatches on the UGen type name; returns nullptr for non-oscillators
+    llvm::Value* buildWaveform(const std::string& ugenType, llvm::Value* phase);
+
+    // Returns phase + increment wrapped back into [0, 2pi)
+    llvm::Value* addPhaseAccumulation(llvm::Value* phase, llvm::Value* increment);
 
 private:
-    std::unique_ptr<llvm::LLVMContext> m_context;
-    std::unique_ptr<llvm::IRBuilder<>> m_builder;
+    llvm::IRBuilder<>& m_builder;
 
-    llvm::Function* createProcessFunction(llvm::Module* module);
-    void addPhaseAccumulation(llvm::Function* func);
+    llvm::Value* constant(llvm::Value* like, double value);
 };
 
-} // namespace tinysynth
\ No newline at end of file
+} // namespace tinysynth
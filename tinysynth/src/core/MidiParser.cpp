@@ -0,0 +1,90 @@
+// MidiParser.cpp
+#include "MidiParser.h"
+
+namespace tinysynth {
+
+namespace {
+
+// Data bytes following a status byte
+std::uint8_t dataLength(std::uint8_t status) {
+  if (status < 0xF0) {
+    const std::uint8_t type = status & 0xF0;
+    return type == MidiMessage::ProgramChange ||
+                   type == MidiMessage::ChannelPressure
+               ? 1
+               : 2;
+  }
+  switch (status) {
+  case 0xF1: // time code quarter frame
+  case 0xF3: // song select
+    return 1;
+  case 0xF2: // song position
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+} // namespace
+
+bool MidiParser::feed(std::uint8_t byte, MidiMessage &message) {
+  if (byte >= 0xF8) {
+    // Realtime: a message of its own, leaving any other state alone
+    message.status = byte;
+    message.data1 = 0;
+    message.data2 = 0;
+    return true;
+  }
+
+  if ((byte & 0x80) != 0) {
+    m_count = 0;
+    if (byte == 0xF0) {
+      m_sysex = true;
+      m_status = 0;
+      return false;
+    }
+    m_sysex = false;
+    if (byte == 0xF7) {
+      m_status = 0;
+      return false;
+    }
+    m_expected = dataLength(byte);
+    if (byte >= 0xF0 && m_expected == 0) {
+      // Tune request; like all system common it cancels running status
+      m_status = 0;
+      message.status = byte;
+      message.data1 = 0;
+      message.data2 = 0;
+      return true;
+    }
+    m_status = byte;
+    return false;
+  }
+
+  // Data byte
+  if (m_sysex || m_status == 0) {
+    return false;
+  }
+  m_data[m_count++] = byte;
+  if (m_count < m_expected) {
+    return false;
+  }
+  message.status = m_status;
+  message.data1 = m_data[0];
+  message.data2 = m_expected > 1 ? m_data[1] : 0;
+  m_count = 0;
+  if (m_status >= 0xF0) {
+    // Only channel messages run on
+    m_status = 0;
+  }
+  return true;
+}
+
+void MidiParser::reset() {
+  m_status = 0;
+  m_count = 0;
+  m_expected = 0;
+  m_sysex = false;
+}
+
+} // namespace tinysynth
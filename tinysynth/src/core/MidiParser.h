@@ -0,0 +1,68 @@
+// MidiParser.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tinysynth {
+
+// One complete MIDI message, `offset` frames into the block it arrived in
+struct MidiMessage {
+    std::uint32_t offset = 0;
+    std::uint8_t status = 0;
+    std::uint8_t data1 = 0;
+    std::uint8_t data2 = 0;
+
+    enum Type : std::uint8_t {
+        NoteOff = 0x80,
+        NoteOn = 0x90,
+        PolyPressure = 0xA0,
+        ControlChange = 0xB0,
+        ProgramChange = 0xC0,
+        ChannelPressure = 0xD0,
+        PitchBend = 0xE0,
+        System = 0xF0,
+    };
+
+    [[nodiscard]] Type getType() const {
+        return static_cast<Type>(status < 0xF0 ? status & 0xF0 : System);
+    }
+    [[nodiscard]] unsigned int getChannel() const { return status & 0x0F; }
+};
+
+// Byte-stream MIDI parser for the audio thread: no allocation, and state
+// (running status, a message split across events) carries over between
+// calls. Channel messages may omit a repeated status byte; system common
+// messages cancel running status, realtime bytes (clock, start, ...) may
+// appear anywhere and pass through, and system exclusive is skipped.
+class MidiParser {
+public:
+    // Feeds one byte; true when it completed a message, stored in `message`
+    // with offset left unchanged
+    bool feed(std::uint8_t byte, MidiMessage& message);
+
+    // Passes every message completed by `data` to onMessage, stamped with
+    // `offset`
+    template <typename OnMessage>
+    void parse(const std::uint8_t* data, std::size_t size, std::uint32_t offset,
+               OnMessage&& onMessage) {
+        MidiMessage message;
+        message.offset = offset;
+        for (std::size_t i = 0; i < size; ++i) {
+            if (feed(data[i], message)) {
+                onMessage(static_cast<const MidiMessage&>(message));
+            }
+        }
+    }
+
+    void reset();
+
+private:
+    std::uint8_t m_status = 0; // running status, 0 when there is none
+    std::uint8_t m_data[2] = {};
+    std::uint8_t m_count = 0;
+    std::uint8_t m_expected = 0;
+    bool m_sysex = false;
+};
+
+} // namespace tinysynth
@@ -19,4 +19,7 @@ bool validateModuleName(const std::string &name) {
     return !name.empty();
 }
 
+template class ModularSystem<float>;
+template class ModularSystem<double>;
+
 } // namespace tinysynth
@@ -2,11 +2,17 @@
 #ifndef MODULARSYSTEM_H
 #define MODULARSYSTEM_H
 
+#include "DenormalGuard.h"
 #include "Module.h"
+#include "RealtimeMemory.h"
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -25,15 +31,23 @@ template <typename sample_type> class ModularSystem {
     void addModule(const std::string &name, std::unique_ptr<Module<sample_type>> module);
 
     // Remove a module from the system
-    void removeModule(const std::string &name);
+    void removeModule(std::string_view name);
+
+    // Remove a module and its connections but hand it to the caller, e.g.
+    // to be destroyed on another thread; looks up without copying the name
+    std::unique_ptr<Module<sample_type>> releaseModule(std::string_view name);
 
     // Connect two modules
-    void connect(const std::string &fromModule, unsigned int outputIndex,
-                 const std::string &toModule, unsigned int inputIndex);
+    void connect(std::string_view fromModule, unsigned int outputIndex,
+                 std::string_view toModule, unsigned int inputIndex);
+
+    // Disconnect two modules; looks up without copying the names
+    void disconnect(std::string_view fromModule, unsigned int outputIndex,
+                    std::string_view toModule, unsigned int inputIndex);
 
-    // Disconnect two modules
-    void disconnect(const std::string &fromModule, unsigned int outputIndex,
-                    const std::string &toModule, unsigned int inputIndex);
+    // Prepares every module and sizes the buffers, so process() calls of
+    // up to maxFrames do not allocate
+    void prepare(unsigned int sampleRate, unsigned int maxFrames);
 
     // Process audio through the entire system
     void process(unsigned int numFrames);
@@ -41,21 +55,77 @@ template <typename sample_type> class ModularSystem {
     // Get a list of all module names
     [[nodiscard]] std::vector<std::string> getModuleNames() const;
 
-    // Get a pointer to a specific module
-    Module<sample_type> *getModule(const std::string &name);
+    // Get a pointer to a specific module; looks up without copying the name
+    Module<sample_type> *getModule(std::string_view name);
+
+    // Sorts the modules so every source runs before its destinations;
+    // process() does this lazily. Throws if the connections contain a cycle.
+    void updateProcessOrder();
+
+    // Output of a module from the last process() call; nullptr if the module
+    // or output does not exist or has not been processed yet
+    [[nodiscard]] const sample_type *getOutputBuffer(const std::string &name,
+                                                     unsigned int outputIndex) const;
+
+    // Slot that redirects a module output to caller memory: while it holds
+    // a pointer, process() has the module write that output there and its
+    // readers read it from there, so a host can bind device buffers without
+    // a copy. The slot lives as long as the module; nullptr if the module or
+    // output does not exist.
+    sample_type **getOutputBinding(const std::string &name, unsigned int outputIndex);
+
+    // Changes whenever a module or connection is added or removed
+    [[nodiscard]] std::uint64_t getTopologyVersion() const { return m_topologyVersion; }
 
   private:
 
     struct Connection {
         std::string fromModule;
-        std::vector<unsigned int> outputIndices;
+        unsigned int outputIndex;
         std::string toModule;
-        std::vector<unsigned int> inputIndices;
+        unsigned int inputIndex;
     };
 
-    std::unordered_map<std::string, std::unique_ptr<Module<sample_type>>> m_modules;
+    struct StringHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view value) const {
+            return std::hash<std::string_view>{}(value);
+        }
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<Module<sample_type>>, StringHash,
+                       std::equal_to<>>
+        m_modules;
     std::vector<Connection> m_connections;
-    std::vector<std::vector<sample_type>> m_audioBuffers;
+    // Buffers are only allocated by whichever thread runs the graph, so
+    // their pool takes no lock; it draws on the realtime arena when there
+    // is one
+    RealtimePool m_bufferPool;
+    // One buffer per module output, keyed by module name
+    using BufferList = std::pmr::vector<std::pmr::vector<sample_type>>;
+    std::unordered_map<std::string, BufferList, StringHash, std::equal_to<>> m_audioBuffers;
+    // Caller memory replacing those buffers, null when unbound
+    std::unordered_map<std::string, std::vector<sample_type *>, StringHash, std::equal_to<>>
+        m_outputBindings;
+    std::uint64_t m_topologyVersion = 0;
+
+    [[nodiscard]] sample_type *boundOutput(const std::string &name,
+                                           unsigned int outputIndex) const {
+        auto it = m_outputBindings.find(name);
+        return it != m_outputBindings.end() && outputIndex < it->second.size()
+                   ? it->second[outputIndex]
+                   : nullptr;
+    }
+    // Modules sorted so every source runs before its destinations
+    std::vector<std::string> m_processOrder;
+    bool m_orderDirty = true;
+    // Per-module pointer lists reused by process(), sized in prepare()
+    std::vector<std::optional<sample_type *>> m_inputScratch;
+    std::vector<sample_type *> m_outputScratch;
+    // Largest block from prepare(); modules added later get buffers this big
+    unsigned int m_maxFrames = 0;
+
+    void reserveBuffers(const std::string &name, const Module<sample_type> &module);
 };
 
 template <typename sample_type>
@@ -64,46 +134,73 @@ void ModularSystem<sample_type>::addModule(const std::string &name,
     if (m_modules.find(name) != m_modules.end()) {
         throw std::runtime_error("Module with name '" + name + "' already exists.");
     }
+    m_outputBindings[name].assign(module->getNumOutputs(), nullptr);
+    m_audioBuffers.try_emplace(name, &m_bufferPool);
+    if (m_maxFrames > 0) {
+        reserveBuffers(name, *module);
+    }
     m_modules[name] = std::move(module);
+    m_orderDirty = true;
+    ++m_topologyVersion;
 }
 
 template <typename sample_type>
-void ModularSystem<sample_type>::removeModule(const std::string &name) {
+void ModularSystem<sample_type>::removeModule(std::string_view name) {
+    releaseModule(name);
+}
+
+template <typename sample_type>
+std::unique_ptr<Module<sample_type>>
+ModularSystem<sample_type>::releaseModule(std::string_view name) {
     auto it = m_modules.find(name);
     if (it == m_modules.end()) {
-        throw std::runtime_error("Module with name '" + name + "' does not exist.");
+        throw std::runtime_error("Module with name '" + std::string(name) +
+                                 "' does not exist.");
     }
 
     // Remove all connections involving this module
     m_connections.erase(std::remove_if(m_connections.begin(), m_connections.end(),
-                                       [&name](const Connection &conn) {
+                                       [name](const Connection &conn) {
                                            return conn.fromModule == name ||
                                                   conn.toModule == name;
                                        }),
                         m_connections.end());
 
+    std::unique_ptr<Module<sample_type>> module = std::move(it->second);
     m_modules.erase(it);
+    if (auto buffers = m_audioBuffers.find(name); buffers != m_audioBuffers.end()) {
+        m_audioBuffers.erase(buffers);
+    }
+    if (auto bindings = m_outputBindings.find(name); bindings != m_outputBindings.end()) {
+        m_outputBindings.erase(bindings);
+    }
+    m_orderDirty = true;
+    ++m_topologyVersion;
+    return module;
 }
 
 template <typename sample_type>
-void ModularSystem<sample_type>::connect(const std::string &fromModule,
+void ModularSystem<sample_type>::connect(std::string_view fromModule,
                                          unsigned int outputIndex,
-                                         const std::string &toModule,
+                                         std::string_view toModule,
                                          unsigned int inputIndex) {
     if (m_modules.find(fromModule) == m_modules.end()) {
-        throw std::runtime_error("Module '" + fromModule + "' does not exist.");
+        throw std::runtime_error("Module '" + std::string(fromModule) + "' does not exist.");
     }
     if (m_modules.find(toModule) == m_modules.end()) {
-        throw std::runtime_error("Module '" + toModule + "' does not exist.");
+        throw std::runtime_error("Module '" + std::string(toModule) + "' does not exist.");
     }
 
-    m_connections.push_back({fromModule, outputIndex, toModule, inputIndex});
+    m_connections.push_back(
+        {std::string(fromModule), outputIndex, std::string(toModule), inputIndex});
+    m_orderDirty = true;
+    ++m_topologyVersion;
 }
 
 template <typename sample_type>
-void ModularSystem<sample_type>::disconnect(const std::string &fromModule,
+void ModularSystem<sample_type>::disconnect(std::string_view fromModule,
                                             unsigned int outputIndex,
-                                            const std::string &toModule,
+                                            std::string_view toModule,
                                             unsigned int inputIndex) {
     auto it = std::find_if(
         m_connections.begin(), m_connections.end(), [&](const Connection &conn) {
@@ -113,40 +210,116 @@ void ModularSystem<sample_type>::disconnect(const std::string &fromModule,
 
     if (it != m_connections.end()) {
         m_connections.erase(it);
+        m_orderDirty = true;
+        ++m_topologyVersion;
     }
 }
 
+template <typename sample_type>
+void ModularSystem<sample_type>::updateProcessOrder() {
+    // Kahn's algorithm; ties are broken by name so the order is stable
+    std::unordered_map<std::string, unsigned int> pending;
+    for (const auto &[name, _] : m_modules) {
+        pending[name] = 0;
+    }
+    for (const auto &conn : m_connections) {
+        ++pending[conn.toModule];
+    }
+
+    std::vector<std::string> ready;
+    for (const auto &[name, count] : pending) {
+        if (count == 0) {
+            ready.push_back(name);
+        }
+    }
+
+    m_processOrder.clear();
+    while (!ready.empty()) {
+        std::sort(ready.begin(), ready.end(), std::greater<>());
+        std::string name = std::move(ready.back());
+        ready.pop_back();
+        for (const auto &conn : m_connections) {
+            if (conn.fromModule == name && --pending[conn.toModule] == 0) {
+                ready.push_back(conn.toModule);
+            }
+        }
+        m_processOrder.push_back(std::move(name));
+    }
+
+    if (m_processOrder.size() != m_modules.size()) {
+        throw std::runtime_error("Module connections contain a cycle.");
+    }
+    m_orderDirty = false;
+}
+
+template <typename sample_type>
+void ModularSystem<sample_type>::prepare(unsigned int sampleRate, unsigned int maxFrames) {
+    m_maxFrames = maxFrames;
+    if (m_orderDirty) {
+        updateProcessOrder();
+    }
+    for (const auto &[name, module] : m_modules) {
+        module->prepare(sampleRate);
+        reserveBuffers(name, *module);
+    }
+}
+
+template <typename sample_type>
+void ModularSystem<sample_type>::reserveBuffers(const std::string &name,
+                                                const Module<sample_type> &module) {
+    auto &buffers =
+        m_audioBuffers.try_emplace(name, &m_bufferPool).first->second;
+    buffers.resize(module.getNumOutputs());
+    for (auto &buffer : buffers) {
+        buffer.reserve(m_maxFrames);
+    }
+    m_inputScratch.reserve(module.getNumInputs());
+    m_outputScratch.reserve(module.getNumOutputs());
+}
+
 template <typename sample_type>
 void ModularSystem<sample_type>::process(unsigned int numFrames) {
-    // Resize audio buffers if necessary
-    m_audioBuffers.resize(m_modules.size());
-    for (auto &buffer : m_audioBuffers) {
-        buffer.resize(numFrames);
+    ScopedDenormalGuard denormalGuard;
+    if (m_orderDirty) {
+        updateProcessOrder();
     }
 
-    // Process each module
+    // Resize audio buffers if necessary
     for (const auto &[name, module] : m_modules) {
-        std::vector<std::optional<sample_type *>> inputs;
-        std::vector<sample_type *> outputs;
+        auto &buffers = m_audioBuffers[name];
+        buffers.resize(module->getNumOutputs());
+        for (auto &buffer : buffers) {
+            buffer.resize(numFrames);
+        }
+    }
+
+    // Process each module after the modules feeding it
+    for (const auto &name : m_processOrder) {
+        auto &module = m_modules.at(name);
+        auto &inputs = m_inputScratch;
+        auto &outputs = m_outputScratch;
 
         // Prepare inputs
-        inputs.resize(module->getNumInputs(), std::nullopt);
+        inputs.assign(module->getNumInputs(), std::nullopt);
+        outputs.clear();
 
         // Set up connections
         for (const auto &conn : m_connections) {
-            if (conn.toModule == name) {
-                auto fromModuleIt = m_modules.find(conn.fromModule);
-                if (fromModuleIt != m_modules.end()) {
-                    auto bufferIndex = std::distance(m_modules.begin(), fromModuleIt);
-                    inputs[conn.inputIndex] = m_audioBuffers[bufferIndex].data();
+            if (conn.toModule == name && conn.inputIndex < inputs.size()) {
+                auto &sourceBuffers = m_audioBuffers[conn.fromModule];
+                if (conn.outputIndex < sourceBuffers.size()) {
+                    sample_type *bound = boundOutput(conn.fromModule, conn.outputIndex);
+                    inputs[conn.inputIndex] =
+                        bound != nullptr ? bound : sourceBuffers[conn.outputIndex].data();
                 }
             }
         }
 
         // Prepare outputs
-        auto moduleIndex = std::distance(m_modules.begin(), m_modules.find(name));
-        for (unsigned int i = 0; i < module->getNumOutputs(); ++i) {
-            outputs.push_back(m_audioBuffers[moduleIndex].data());
+        auto &buffers = m_audioBuffers[name];
+        for (unsigned int i = 0; i < buffers.size(); ++i) {
+            sample_type *bound = boundOutput(name, i);
+            outputs.push_back(bound != nullptr ? bound : buffers[i].data());
         }
 
         // Process the module
@@ -165,7 +338,7 @@ std::vector<std::string> ModularSystem<sample_type>::getModuleNames() const {
 }
 
 template <typename sample_type>
-Module<sample_type> *ModularSystem<sample_type>::getModule(const std::string &name) {
+Module<sample_type> *ModularSystem<sample_type>::getModule(std::string_view name) {
     auto it = m_modules.find(name);
     if (it == m_modules.end()) {
         return nullptr;
@@ -173,6 +346,28 @@ Module<sample_type> *ModularSystem<sample_type>::getModule(const std::string &na
     return it->second.get();
 }
 
+template <typename sample_type>
+const sample_type *
+ModularSystem<sample_type>::getOutputBuffer(const std::string &name,
+                                            unsigned int outputIndex) const {
+    auto it = m_audioBuffers.find(name);
+    if (it == m_audioBuffers.end() || outputIndex >= it->second.size()) {
+        return nullptr;
+    }
+    const sample_type *bound = boundOutput(name, outputIndex);
+    return bound != nullptr ? bound : it->second[outputIndex].data();
+}
+
+template <typename sample_type>
+sample_type **ModularSystem<sample_type>::getOutputBinding(const std::string &name,
+                                                           unsigned int outputIndex) {
+    auto it = m_outputBindings.find(name);
+    if (it == m_outputBindings.end() || outputIndex >= it->second.size()) {
+        return nullptr;
+    }
+    return &it->second[outputIndex];
+}
+
 // Explicit template instantiation for the types we'll use
 extern template class ModularSystem<float>;
 extern template class ModularSystem<double>;
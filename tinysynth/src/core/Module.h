@@ -0,0 +1,11 @@
+// Module.h
+#pragma once
+
+#include "UGen.h"
+
+namespace tinysynth {
+
+// The block-processing units ModularSystem wires together
+template <typename sample_type> using Module = UGen<sample_type>;
+
+} // namespace tinysynth
@@ -0,0 +1,59 @@
+// NodeStatePool.h
+#pragma once
+
+#include "StateLayout.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace tinysynth {
+
+// Fixed-capacity pool of state blocks for one compiled SynthDef. All memory
+// is allocated up front, so acquire()/release() are safe on the audio thread.
+// Not thread-safe: use it from the thread that spawns and frees nodes.
+class NodeStatePool {
+public:
+    NodeStatePool(const StateLayout& layout, std::size_t capacity)
+        : m_layout(layout), m_blockSize(layout.size()), m_capacity(capacity) {
+        const std::size_t bytes = m_blockSize * std::max<std::size_t>(capacity, 1);
+        m_storage = static_cast<char*>(std::aligned_alloc(layout.alignment(), bytes));
+        if (m_storage == nullptr) {
+            throw std::bad_alloc();
+        }
+        m_free.reserve(capacity);
+        for (std::size_t i = capacity; i > 0; --i) {
+            m_free.push_back(m_storage + (i - 1) * m_blockSize);
+        }
+    }
+
+    NodeStatePool(const NodeStatePool&) = delete;
+    NodeStatePool& operator=(const NodeStatePool&) = delete;
+
+    ~NodeStatePool() { std::free(m_storage); }
+
+    // Returns an initialised block, or nullptr when the pool is exhausted
+    void* acquire() {
+        if (m_free.empty()) {
+            return nullptr;
+        }
+        void* block = m_free.back();
+        m_free.pop_back();
+        m_layout.initialize(block);
+        return block;
+    }
+
+    void release(void* block) { m_free.push_back(static_cast<char*>(block)); }
+
+    [[nodiscard]] std::size_t available() const { return m_free.size(); }
+    [[nodiscard]] std::size_t capacity() const { return m_capacity; }
+
+private:
+    StateLayout m_layout; // a copy: the pool may outlive the def it came from
+    std::size_t m_blockSize;
+    std::size_t m_capacity;
+    char* m_storage = nullptr;
+    std::vector<char*> m_free;
+};
+
+} // namespace tinysynth
@@ -0,0 +1,203 @@
+// NrtRenderer.cpp
+#include "NrtRenderer.h"
+#include "AudioFileReader.h"
+#include "DenormalGuard.h"
+#include "OscPacket.h"
+#include "RealtimeSanitizer.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace tinysynth {
+
+namespace {
+
+// Larger packets are a corrupt size field rather than a real bundle
+constexpr std::uint32_t MAX_PACKET = 64 << 20;
+
+// Prints /fail replies, the only ones a score cannot act on
+void printFailure(std::span<const std::uint8_t> packet) {
+  OscMessage message;
+  if (!message.parse(packet) || message.getAddress() != "/fail") {
+    return;
+  }
+  auto arguments = message.arguments();
+  OscArgument command;
+  OscArgument error;
+  if (arguments.next(command) && arguments.next(error) && command.isString() &&
+      error.isString()) {
+    std::fprintf(stderr, "FAILURE %.*s %.*s\n",
+                 static_cast<int>(command.s.size()), command.s.data(),
+                 static_cast<int>(error.s.size()), error.s.data());
+  }
+}
+
+} // namespace
+
+OscScoreReader::OscScoreReader(const std::string &path) : m_path(path) {
+  m_file = std::fopen(path.c_str(), "rb");
+  if (m_file == nullptr) {
+    throw std::runtime_error("Cannot open score " + path);
+  }
+}
+
+OscScoreReader::~OscScoreReader() {
+  if (m_file != nullptr) {
+    std::fclose(m_file);
+  }
+}
+
+bool OscScoreReader::next() {
+  std::uint8_t header[4];
+  const std::size_t read = std::fread(header, 1, sizeof(header), m_file);
+  if (read == 0) {
+    return false;
+  }
+  const std::uint32_t size =
+      read == sizeof(header) ? osc::readUint32(header) : 0;
+  if (size < 16 || size > MAX_PACKET) {
+    throw std::runtime_error("Corrupt packet size in score " + m_path);
+  }
+  m_packet.resize(size);
+  if (std::fread(m_packet.data(), 1, size, m_file) != size) {
+    throw std::runtime_error("Truncated packet in score " + m_path);
+  }
+  const std::string_view tag(reinterpret_cast<const char *>(m_packet.data()),
+                             osc::BUNDLE_TAG.size());
+  if (tag != osc::BUNDLE_TAG) {
+    throw std::runtime_error("Score " + m_path + " holds a packet that is "
+                             "not a bundle");
+  }
+  m_timeTag = osc::readUint64(m_packet.data() + 8);
+  return true;
+}
+
+std::uint64_t OscScoreReader::getFrame(unsigned int sampleRate) const {
+  // Whole seconds, then the 32-bit fraction rounded
+  const std::uint64_t seconds = m_timeTag >> 32;
+  const std::uint64_t fraction = m_timeTag & 0xFFFFFFFF;
+  return seconds * sampleRate + ((fraction * sampleRate + (1ULL << 31)) >> 32);
+}
+
+NrtRenderer::NrtRenderer(GraphProcessor &engine, OscServer &server,
+                         Config config)
+    : m_engine(engine), m_server(server), m_config(std::move(config)) {
+  if (m_config.blockSize == 0 || m_config.sampleRate == 0) {
+    throw std::invalid_argument(
+        "Score render needs a block size and a sample rate");
+  }
+}
+
+NrtRenderStats NrtRenderer::render() {
+  using Clock = std::chrono::steady_clock;
+  const auto renderStart = Clock::now();
+  OscScoreReader score(m_config.scorePath);
+  std::unique_ptr<AudioFileReader> reader;
+  if (!m_config.inputPath.empty()) {
+    reader = std::make_unique<AudioFileReader>(m_config.inputPath);
+    if (reader->getNumChannels() != m_engine.getNumInputs()) {
+      throw std::invalid_argument(
+          m_config.inputPath + " has " +
+          std::to_string(reader->getNumChannels()) + " channels, not " +
+          std::to_string(m_engine.getNumInputs()));
+    }
+  }
+
+  m_engine.prepare(m_config.sampleRate, m_config.blockSize);
+  m_engine.setCommandBudget(std::numeric_limits<unsigned int>::max());
+  AudioFileWriter writer(m_config.outputPath, m_config.sampleRate,
+                         m_engine.getNumOutputs(), m_config.format);
+  m_server.setReplyHandler(printFailure);
+  const OscServerStats before = m_server.getStats();
+
+  const unsigned int blockSize = m_config.blockSize;
+  std::vector<std::vector<float>> inputs(m_engine.getNumInputs(),
+                                         std::vector<float>(blockSize, 0.0F));
+  std::vector<std::vector<float>> outputs(m_engine.getNumOutputs(),
+                                          std::vector<float>(blockSize));
+  std::vector<const float *> inputPointers;
+  std::vector<float *> readPointers;
+  std::vector<float *> outputPointers;
+  for (auto &buffer : inputs) {
+    inputPointers.push_back(buffer.data());
+    readPointers.push_back(buffer.data());
+  }
+  for (auto &buffer : outputs) {
+    outputPointers.push_back(buffer.data());
+  }
+
+  ScopedDenormalGuard denormalGuard;
+  std::uint64_t done = 0;
+  auto renderBlock = [&](unsigned int numFrames) {
+    for (auto &buffer : outputs) {
+      std::fill(buffer.begin(), buffer.begin() + numFrames, 0.0F);
+    }
+    if (reader != nullptr) {
+      const unsigned int read = reader->read(readPointers.data(), numFrames);
+      for (auto &buffer : inputs) {
+        std::fill(buffer.begin() + read, buffer.begin() + numFrames, 0.0F);
+      }
+    }
+    {
+      ScopedRealtimeContext realtime;
+      m_engine.process(inputPointers.data(), outputPointers.data(), numFrames);
+    }
+    writer.write(outputPointers.data(), numFrames);
+    done += numFrames;
+  };
+
+  // Score frames count from the engine's current frame
+  const std::uint64_t origin = m_engine.getFrameTime();
+  NrtRenderStats stats;
+  std::uint64_t end = 0;
+  std::uint64_t frame = 0;
+  // A bundle that fills the engine's rings: render up to its frame, then
+  // apply what is queued without rendering further
+  m_server.setFlushHandler([&] {
+    while (done < frame) {
+      renderBlock(static_cast<unsigned int>(
+          std::min<std::uint64_t>(blockSize, frame - done)));
+    }
+    ScopedRealtimeContext realtime;
+    m_engine.process(inputPointers.data(), outputPointers.data(), 0);
+  });
+  // The handler refers to this frame's locals, also when a file error
+  // ends the render
+  struct FlushReset {
+    OscServer &server;
+    ~FlushReset() { server.setFlushHandler({}); }
+  } flushReset{m_server};
+  while (score.next()) {
+    // Whole blocks up to the one holding the bundle, which then splits at
+    // its exact frame
+    frame = score.getFrame(m_config.sampleRate);
+    while (done + blockSize <= frame) {
+      renderBlock(blockSize);
+    }
+    m_server.execute(score.getPacket(), origin + frame);
+    ++stats.bundles;
+    end = std::max(end, frame);
+  }
+  while (done < end) {
+    renderBlock(static_cast<unsigned int>(
+        std::min<std::uint64_t>(blockSize, end - done)));
+  }
+  m_server.collectReplies();
+  writer.close();
+
+  const OscServerStats after = m_server.getStats();
+  stats.frames = done;
+  stats.failed = after.failed - before.failed;
+  stats.late = after.late - before.late;
+  stats.wallSeconds =
+      std::chrono::duration<double>(Clock::now() - renderStart).count();
+  const double audioSeconds = static_cast<double>(done) /
+                              static_cast<double>(m_config.sampleRate);
+  stats.realtimeFactor =
+      stats.wallSeconds > 0.0 ? audioSeconds / stats.wallSeconds : 0.0;
+  return stats;
+}
+
+} // namespace tinysynth
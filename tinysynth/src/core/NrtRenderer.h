@@ -0,0 +1,88 @@
+// NrtRenderer.h
+#pragma once
+
+#include "AudioFileWriter.h"
+#include "GraphProcessor.h"
+#include "OscServer.h"
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// Streams a binary OSC score, the format of scsynth's -N mode: each packet
+// is a big-endian int32 size followed by an OSC bundle, whose time tag is
+// the time from the start of the piece (32.32 fixed-point seconds), in
+// order. Only one packet is in memory at a time.
+class OscScoreReader {
+public:
+    // Throws std::runtime_error when the file cannot be opened
+    explicit OscScoreReader(const std::string& path);
+    OscScoreReader(const OscScoreReader&) = delete;
+    OscScoreReader& operator=(const OscScoreReader&) = delete;
+    ~OscScoreReader();
+
+    // Reads the next bundle; false at the end of the file. Throws
+    // std::runtime_error for a truncated packet or one that is no bundle.
+    bool next();
+
+    // The bundle next() read, valid until the next call
+    [[nodiscard]] std::span<const std::uint8_t> getPacket() const { return m_packet; }
+    [[nodiscard]] std::uint64_t getTimeTag() const { return m_timeTag; }
+    // The time tag as a frame at sampleRate, rounded to the nearest
+    [[nodiscard]] std::uint64_t getFrame(unsigned int sampleRate) const;
+
+private:
+    std::FILE* m_file = nullptr;
+    std::string m_path;
+    std::vector<std::uint8_t> m_packet;
+    std::uint64_t m_timeTag = 0;
+};
+
+struct NrtRenderStats {
+    std::uint64_t frames = 0;
+    std::uint64_t bundles = 0;
+    std::uint64_t failed = 0; // commands answered with /fail
+    std::uint64_t late = 0;   // commands of out-of-order bundles, run late
+    double wallSeconds = 0.0;
+    double realtimeFactor = 0.0; // audio duration / wallSeconds
+};
+
+// Non-realtime rendering of a score: reads it bundle by bundle, renders
+// the engine up to each bundle's time as fast as the CPU allows, has the
+// OSC server run the bundle's commands on their exact frame, and streams
+// the output to a WAV/RF64 file. The render ends at the last bundle's
+// time, so scores end with an empty bundle at the length they want. No
+// audio device, thread or wall clock is involved, and no command budget:
+// every command due in a block runs on its frame, and a bundle larger than
+// the engine's rings is applied in parts, all on the bundle's frame.
+//
+// The engine must be fresh and the server not started; both must outlive
+// the renderer. Inputs play inputPath, with as many channels as the engine
+// has inputs. /fail replies are printed to stderr.
+class NrtRenderer {
+public:
+    struct Config {
+        std::string scorePath;
+        std::string inputPath;
+        std::string outputPath;
+        unsigned int sampleRate = 48000;
+        unsigned int blockSize = 64;
+        AudioFileFormat format = AudioFileFormat::Wav;
+    };
+
+    NrtRenderer(GraphProcessor& engine, OscServer& server, Config config);
+
+    // Throws std::runtime_error for file errors and std::invalid_argument
+    // for a mismatched input file
+    NrtRenderStats render();
+
+private:
+    GraphProcessor& m_engine;
+    OscServer& m_server;
+    Config m_config;
+};
+
+} // namespace tinysynth
@@ -0,0 +1,97 @@
+// OfflineBackend.cpp
+#include "OfflineBackend.h"
+#include "AudioFileReader.h"
+#include "DenormalGuard.h"
+#include "RealtimeSanitizer.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+OfflineBackend::OfflineBackend(Config config) : m_config(std::move(config)) {
+  if (m_config.blockSize == 0 || m_config.sampleRate == 0) {
+    throw std::invalid_argument(
+        "Offline render needs a block size and a sample rate");
+  }
+}
+
+void OfflineBackend::start(AudioProcessor &processor) {
+  using Clock = std::chrono::steady_clock;
+  m_stopRequested = false;
+  m_stats = {};
+
+  std::unique_ptr<AudioFileReader> reader;
+  if (!m_config.inputPath.empty()) {
+    reader = std::make_unique<AudioFileReader>(m_config.inputPath);
+    if (reader->getNumChannels() != m_config.numInputs) {
+      throw std::invalid_argument(
+          m_config.inputPath + " has " +
+          std::to_string(reader->getNumChannels()) + " channels, not " +
+          std::to_string(m_config.numInputs));
+    }
+  }
+
+  processor.prepare(m_config.sampleRate, m_config.blockSize);
+  AudioFileWriter writer(m_config.path, m_config.sampleRate,
+                         m_config.numOutputs, m_config.format);
+
+  const unsigned int blockSize = m_config.blockSize;
+  std::vector<std::vector<float>> inputs(m_config.numInputs,
+                                         std::vector<float>(blockSize, 0.0F));
+  std::vector<std::vector<float>> outputs(m_config.numOutputs,
+                                          std::vector<float>(blockSize));
+  std::vector<const float *> inputPointers;
+  std::vector<float *> readPointers;
+  std::vector<float *> outputPointers;
+  for (auto &buffer : inputs) {
+    inputPointers.push_back(buffer.data());
+    readPointers.push_back(buffer.data());
+  }
+  for (auto &buffer : outputs) {
+    outputPointers.push_back(buffer.data());
+  }
+
+  ScopedDenormalGuard denormalGuard;
+  Clock::duration processTime{};
+  const auto renderStart = Clock::now();
+  std::uint64_t done = 0;
+  while (done < m_config.numFrames && !m_stopRequested) {
+    const auto numFrames = static_cast<unsigned int>(
+        std::min<std::uint64_t>(blockSize, m_config.numFrames - done));
+    for (auto &buffer : outputs) {
+      std::fill(buffer.begin(), buffer.begin() + numFrames, 0.0F);
+    }
+    if (reader != nullptr) {
+      const unsigned int read = reader->read(readPointers.data(), numFrames);
+      for (auto &buffer : inputs) {
+        std::fill(buffer.begin() + read, buffer.begin() + numFrames, 0.0F);
+      }
+    }
+    const auto blockStart = Clock::now();
+    {
+      // Only the render is checked; the writer may block
+      ScopedRealtimeContext realtime;
+      processor.process(inputPointers.data(), outputPointers.data(),
+                        numFrames);
+    }
+    processTime += Clock::now() - blockStart;
+    writer.write(outputPointers.data(), numFrames);
+    done += numFrames;
+  }
+  writer.close();
+
+  m_stats.frames = done;
+  m_stats.processSeconds = std::chrono::duration<double>(processTime).count();
+  m_stats.wallSeconds =
+      std::chrono::duration<double>(Clock::now() - renderStart).count();
+  const double audioSeconds =
+      static_cast<double>(done) / static_cast<double>(m_config.sampleRate);
+  m_stats.realtimeFactor =
+      m_stats.wallSeconds > 0.0 ? audioSeconds / m_stats.wallSeconds : 0.0;
+}
+
+} // namespace tinysynth
@@ -0,0 +1,57 @@
+// OfflineBackend.h
+#pragma once
+
+#include "AudioBackend.h"
+#include "AudioFileWriter.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace tinysynth {
+
+struct OfflineRenderStats {
+    std::uint64_t frames = 0;
+    double processSeconds = 0.0; // inside AudioProcessor::process
+    double wallSeconds = 0.0;    // whole render, file I/O included
+    double realtimeFactor = 0.0; // audio duration / wallSeconds
+};
+
+// Faster-than-realtime backend: start() renders numFrames in a tight loop
+// at the configured block size and streams the output to a WAV/RF64 file,
+// for bounces, CI audio tests and benchmarks without a JACK server.
+// Inputs play inputPath, a float WAV/RF64 file with numInputs channels,
+// and are silent past its end or without one.
+class OfflineBackend : public AudioBackend {
+public:
+    struct Config {
+        std::string path;
+        std::string inputPath;
+        std::uint64_t numFrames = 0;
+        unsigned int sampleRate = 48000;
+        unsigned int blockSize = 64;
+        unsigned int numInputs = 0;
+        unsigned int numOutputs = 2;
+        AudioFileFormat format = AudioFileFormat::Wav;
+    };
+
+    explicit OfflineBackend(Config config);
+
+    // Returns when the render is complete or stop() was called
+    void start(AudioProcessor& processor) override;
+    // Thread-safe; ends a running render after the current block
+    void stop() override { m_stopRequested = true; }
+
+    [[nodiscard]] unsigned int getSampleRate() const override { return m_config.sampleRate; }
+    [[nodiscard]] unsigned int getBufferSize() const override { return m_config.blockSize; }
+    [[nodiscard]] unsigned int getNumInputs() const override { return m_config.numInputs; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return m_config.numOutputs; }
+
+    [[nodiscard]] const OfflineRenderStats& getStats() const { return m_stats; }
+
+private:
+    Config m_config;
+    std::atomic<bool> m_stopRequested{false};
+    OfflineRenderStats m_stats;
+};
+
+} // namespace tinysynth
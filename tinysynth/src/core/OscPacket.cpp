@@ -0,0 +1,243 @@
+// OscPacket.cpp
+#include "OscPacket.h"
+#include <bit>
+#include <cstring>
+#include <string>
+
+namespace tinysynth {
+
+namespace {
+
+// OSC strings are NUL-terminated and padded to four bytes. Returns the
+// string and moves position past its padding, or returns false.
+bool readString(std::span<const std::uint8_t> data, std::size_t &position,
+                std::string_view &string) {
+  const auto *begin = reinterpret_cast<const char *>(data.data()) + position;
+  const std::size_t available = data.size() - position;
+  const void *terminator = std::memchr(begin, '\0', available);
+  if (terminator == nullptr) {
+    return false;
+  }
+  const auto length =
+      static_cast<std::size_t>(static_cast<const char *>(terminator) - begin);
+  const std::size_t padded = (length + 4) & ~std::size_t{3};
+  if (padded > available) {
+    return false;
+  }
+  string = std::string_view(begin, length);
+  position += padded;
+  return true;
+}
+
+void writeUint32(std::vector<std::uint8_t> &bytes, std::uint32_t value) {
+  bytes.push_back(static_cast<std::uint8_t>(value >> 24));
+  bytes.push_back(static_cast<std::uint8_t>(value >> 16));
+  bytes.push_back(static_cast<std::uint8_t>(value >> 8));
+  bytes.push_back(static_cast<std::uint8_t>(value));
+}
+
+void writeString(std::vector<std::uint8_t> &bytes, std::string_view string) {
+  bytes.insert(bytes.end(), string.begin(), string.end());
+  // At least one NUL, then up to the next multiple of four
+  do {
+    bytes.push_back(0);
+  } while (bytes.size() % 4 != 0);
+}
+
+} // namespace
+
+float OscArgument::asFloat() const {
+  switch (type) {
+  case 'i':
+    return static_cast<float>(i);
+  case 'f':
+    return f;
+  case 'h':
+    return static_cast<float>(h);
+  case 'd':
+    return static_cast<float>(d);
+  default:
+    return 0.0F;
+  }
+}
+
+std::int32_t OscArgument::asInt() const {
+  switch (type) {
+  case 'i':
+    return i;
+  case 'f':
+    return static_cast<std::int32_t>(f);
+  case 'h':
+    return static_cast<std::int32_t>(h);
+  case 'd':
+    return static_cast<std::int32_t>(d);
+  default:
+    return 0;
+  }
+}
+
+bool OscMessage::parse(std::span<const std::uint8_t> data) {
+  std::size_t position = 0;
+  if (data.size() % 4 != 0 || !readString(data, position, m_address) ||
+      m_address.empty() || m_address[0] != '/') {
+    return false;
+  }
+  // A message without type tags is allowed by OSC 1.0 and has no arguments
+  m_typeTags = {};
+  if (position < data.size()) {
+    std::string_view tags;
+    if (!readString(data, position, tags) || tags.empty() || tags[0] != ',') {
+      return false;
+    }
+    m_typeTags = tags.substr(1);
+  }
+  m_arguments = data.subspan(position);
+  return true;
+}
+
+bool OscMessage::Reader::next(OscArgument &argument) {
+  if (atEnd()) {
+    return false;
+  }
+  const char type = m_tags[m_tag];
+  const std::size_t available = m_data.size() - m_position;
+  const std::uint8_t *bytes = m_data.data() + m_position;
+  argument = OscArgument{};
+  argument.type = type;
+  switch (type) {
+  case 'i':
+  case 'f':
+  case 'c':
+  case 'r':
+  case 'm':
+    if (available < 4) {
+      return false;
+    }
+    argument.i = static_cast<std::int32_t>(osc::readUint32(bytes));
+    if (type == 'f') {
+      argument.f = std::bit_cast<float>(osc::readUint32(bytes));
+    }
+    m_position += 4;
+    break;
+  case 'h':
+  case 't':
+  case 'd':
+    if (available < 8) {
+      return false;
+    }
+    argument.h = static_cast<std::int64_t>(osc::readUint64(bytes));
+    if (type == 'd') {
+      argument.d = std::bit_cast<double>(osc::readUint64(bytes));
+    }
+    m_position += 8;
+    break;
+  case 's':
+  case 'S':
+    if (!readString(m_data, m_position, argument.s)) {
+      return false;
+    }
+    break;
+  case 'b': {
+    if (available < 4) {
+      return false;
+    }
+    const std::size_t size = osc::readUint32(bytes);
+    const std::size_t padded = (size + 3) & ~std::size_t{3};
+    if (padded > available - 4) {
+      return false;
+    }
+    argument.blob = m_data.subspan(m_position + 4, size);
+    m_position += 4 + padded;
+    break;
+  }
+  case 'T':
+  case 'F':
+  case 'N':
+  case 'I':
+    // No data; T and F read as 1 and 0
+    argument.i = type == 'T' ? 1 : 0;
+    break;
+  default:
+    return false;
+  }
+  ++m_tag;
+  return true;
+}
+
+OscBuilder::OscBuilder(std::string_view address) : m_address(address) {}
+
+OscBuilder &OscBuilder::add(std::int32_t value) {
+  m_typeTags.push_back('i');
+  writeUint32(m_arguments, static_cast<std::uint32_t>(value));
+  return *this;
+}
+
+OscBuilder &OscBuilder::add(float value) {
+  m_typeTags.push_back('f');
+  writeUint32(m_arguments, std::bit_cast<std::uint32_t>(value));
+  return *this;
+}
+
+OscBuilder &OscBuilder::add(std::string_view value) {
+  m_typeTags.push_back('s');
+  writeString(m_arguments, value);
+  return *this;
+}
+
+OscBuilder &OscBuilder::addBlob(std::span<const std::uint8_t> value) {
+  m_typeTags.push_back('b');
+  writeUint32(m_arguments, static_cast<std::uint32_t>(value.size()));
+  m_arguments.insert(m_arguments.end(), value.begin(), value.end());
+  while (m_arguments.size() % 4 != 0) {
+    m_arguments.push_back(0);
+  }
+  return *this;
+}
+
+std::vector<std::uint8_t> OscBuilder::bytes() const {
+  std::vector<std::uint8_t> bytes;
+  writeString(bytes, m_address);
+  std::string tags(",");
+  tags.append(m_typeTags.begin(), m_typeTags.end());
+  writeString(bytes, tags);
+  bytes.insert(bytes.end(), m_arguments.begin(), m_arguments.end());
+  return bytes;
+}
+
+namespace osc {
+
+namespace {
+
+// Seconds from the NTP epoch (1900) to the Unix epoch
+constexpr std::int64_t NTP_UNIX_OFFSET = 2208988800;
+constexpr std::int64_t NANOSECONDS = 1000000000;
+
+} // namespace
+
+std::chrono::system_clock::time_point toSystemTime(std::uint64_t timeTag) {
+  const auto seconds =
+      static_cast<std::int64_t>(timeTag >> 32) - NTP_UNIX_OFFSET;
+  const auto fraction =
+      ((timeTag & 0xFFFFFFFF) * static_cast<std::uint64_t>(NANOSECONDS)) >> 32;
+  return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::seconds(seconds) +
+          std::chrono::nanoseconds(static_cast<std::int64_t>(fraction))));
+}
+
+std::uint64_t toTimeTag(std::chrono::system_clock::time_point time) {
+  const auto nanoseconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          time.time_since_epoch())
+          .count();
+  const auto seconds =
+      static_cast<std::uint64_t>(nanoseconds / NANOSECONDS + NTP_UNIX_OFFSET);
+  const auto fraction =
+      (static_cast<std::uint64_t>(nanoseconds % NANOSECONDS) << 32) /
+      static_cast<std::uint64_t>(NANOSECONDS);
+  return (seconds << 32) | fraction;
+}
+
+} // namespace osc
+
+} // namespace tinysynth
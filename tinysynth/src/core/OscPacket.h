@@ -0,0 +1,150 @@
+// OscPacket.h
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tinysynth {
+
+// One OSC 1.0 argument. Strings and blobs point into the packet they were
+// read from.
+struct OscArgument {
+    char type = 'N';
+    std::int32_t i = 0;
+    float f = 0.0F;
+    std::int64_t h = 0;
+    double d = 0.0;
+    std::string_view s;
+    std::span<const std::uint8_t> blob;
+
+    [[nodiscard]] bool isNumber() const {
+        return type == 'i' || type == 'f' || type == 'h' || type == 'd';
+    }
+    [[nodiscard]] bool isString() const { return type == 's' || type == 'S'; }
+    // Numeric arguments converted; 0 for anything else
+    [[nodiscard]] float asFloat() const;
+    [[nodiscard]] std::int32_t asInt() const;
+};
+
+// A message read in place from a packet buffer: nothing is copied, so the
+// buffer must outlive it.
+class OscMessage {
+public:
+    // False for a malformed message
+    bool parse(std::span<const std::uint8_t> data);
+
+    [[nodiscard]] std::string_view getAddress() const { return m_address; }
+    // Without the leading ','
+    [[nodiscard]] std::string_view getTypeTags() const { return m_typeTags; }
+
+    // Reads the arguments in order
+    class Reader {
+    public:
+        // False at the end or at a malformed argument
+        bool next(OscArgument& argument);
+        [[nodiscard]] bool atEnd() const { return m_tag == m_tags.size(); }
+
+    private:
+        friend class OscMessage;
+        Reader(std::string_view tags, std::span<const std::uint8_t> data)
+            : m_tags(tags), m_data(data) {}
+
+        std::string_view m_tags;
+        std::span<const std::uint8_t> m_data;
+        std::size_t m_tag = 0;
+        std::size_t m_position = 0;
+    };
+
+    [[nodiscard]] Reader arguments() const { return Reader(m_typeTags, m_arguments); }
+
+private:
+    std::string_view m_address;
+    std::string_view m_typeTags;
+    std::span<const std::uint8_t> m_arguments;
+};
+
+// OSC time tag meaning "now"
+constexpr std::uint64_t OSC_IMMEDIATELY = 1;
+
+// Passes every message of a packet to onMessage(message, timeTag), bundles
+// flattened in order; messages outside any bundle get OSC_IMMEDIATELY.
+// Returns false if any part was malformed; the well-formed messages before
+// it are still delivered.
+template <typename OnMessage>
+bool parseOscPacket(std::span<const std::uint8_t> data, OnMessage&& onMessage,
+                    std::uint64_t timeTag = OSC_IMMEDIATELY);
+
+// Builds a message: OscBuilder("/n_set").add(1000).add("freq").add(440.0F)
+class OscBuilder {
+public:
+    explicit OscBuilder(std::string_view address);
+
+    OscBuilder& add(std::int32_t value);
+    OscBuilder& add(float value);
+    OscBuilder& add(std::string_view value);
+    OscBuilder& add(const char* value) { return add(std::string_view(value)); }
+    OscBuilder& addBlob(std::span<const std::uint8_t> value);
+
+    [[nodiscard]] std::vector<std::uint8_t> bytes() const;
+
+private:
+    std::string m_address;
+    std::vector<char> m_typeTags;
+    std::vector<std::uint8_t> m_arguments;
+};
+
+namespace osc {
+
+// OSC data is big-endian
+inline std::uint32_t readUint32(const std::uint8_t* bytes) {
+    return (std::uint32_t{bytes[0]} << 24) | (std::uint32_t{bytes[1]} << 16) |
+           (std::uint32_t{bytes[2]} << 8) | std::uint32_t{bytes[3]};
+}
+
+inline std::uint64_t readUint64(const std::uint8_t* bytes) {
+    return (std::uint64_t{readUint32(bytes)} << 32) | readUint32(bytes + 4);
+}
+
+constexpr std::string_view BUNDLE_TAG{"#bundle\0", 8};
+
+// Time tags are NTP times: 32.32 fixed-point seconds since 1900
+std::chrono::system_clock::time_point toSystemTime(std::uint64_t timeTag);
+std::uint64_t toTimeTag(std::chrono::system_clock::time_point time);
+
+} // namespace osc
+
+template <typename OnMessage>
+bool parseOscPacket(std::span<const std::uint8_t> data, OnMessage&& onMessage,
+                    std::uint64_t timeTag) {
+    if (data.size() >= 16 &&
+        std::string_view(reinterpret_cast<const char*>(data.data()), 8) == osc::BUNDLE_TAG) {
+        const std::uint64_t bundleTime = osc::readUint64(data.data() + 8);
+        std::size_t position = 16;
+        while (position < data.size()) {
+            if (data.size() - position < 4) {
+                return false;
+            }
+            const std::uint32_t size = osc::readUint32(data.data() + position);
+            position += 4;
+            if (size > data.size() - position || size % 4 != 0 ||
+                !parseOscPacket(data.subspan(position, size), onMessage, bundleTime)) {
+                return false;
+            }
+            position += size;
+        }
+        return true;
+    }
+    OscMessage message;
+    if (!message.parse(data)) {
+        return false;
+    }
+    onMessage(static_cast<const OscMessage&>(message), timeTag);
+    return true;
+}
+
+} // namespace tinysynth
@@ -0,0 +1,507 @@
+// OscServer.cpp
+#include "OscServer.h"
+#include "SynthDefLoader.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace tinysynth {
+
+namespace {
+
+// Largest UDP payload
+constexpr std::size_t MAX_PACKET = 65536;
+// How often an idle server thread looks at replies and stop()
+constexpr int POLL_MILLISECONDS = 5;
+// A push waits this long for room in the engine's ring before failing
+constexpr auto PUSH_TIMEOUT = std::chrono::seconds(1);
+// Bursts of this many bytes queue in the socket rather than being dropped
+constexpr int RECEIVE_BUFFER_BYTES = 4 << 20;
+
+std::string describe(EngineCommand::Type type) {
+  switch (type) {
+  case EngineCommand::Type::AddModule:
+    return "/s_new";
+  case EngineCommand::Type::RemoveModule:
+    return "/n_free";
+  case EngineCommand::Type::SetParameter:
+    return "/n_set";
+  default:
+    return "/s_new";
+  }
+}
+
+std::runtime_error socketError(const std::string &what) {
+  return std::runtime_error("OSC server: " + what + ": " +
+                            std::strerror(errno));
+}
+
+} // namespace
+
+OscServer::OscServer(GraphProcessor &engine, SynthDefJIT &jit, Config config)
+    : m_engine(engine), m_jit(jit), m_config(std::move(config)),
+      m_commands(engine.addControlSource("osc")),
+      m_scheduled(engine.addScheduledControlSource("osc-scheduled")),
+      m_receiveBuffer(MAX_PACKET) {}
+
+OscServer::~OscServer() { stop(); }
+
+void OscServer::registerModule(const std::string &defName,
+                               ModuleFactory factory) {
+  std::lock_guard<std::mutex> lock(m_definitionsMutex);
+  m_definitions[defName] = Definition{nullptr, {}, std::move(factory)};
+}
+
+void OscServer::addSynthDef(const SynthDef &synthDef) {
+  // Compiling takes a while; only the table update holds the lock
+  Definition definition{m_jit.compile(synthDef), SynthDefBuses::of(synthDef),
+                        nullptr};
+  std::lock_guard<std::mutex> lock(m_definitionsMutex);
+  m_definitions[synthDef.getName()] = std::move(definition);
+}
+
+void OscServer::start() {
+  stop();
+  m_socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (m_socket < 0) {
+    throw socketError("socket");
+  }
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(m_config.port);
+  const int size = RECEIVE_BUFFER_BYTES;
+  ::setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  if (::inet_pton(AF_INET, m_config.bindAddress.c_str(), &address.sin_addr) !=
+          1 ||
+      ::bind(m_socket, reinterpret_cast<const sockaddr *>(&address),
+             sizeof(address)) != 0) {
+    const auto error = socketError("cannot bind " + m_config.bindAddress +
+                                   ":" + std::to_string(m_config.port));
+    ::close(m_socket);
+    m_socket = -1;
+    throw error;
+  }
+  socklen_t length = sizeof(address);
+  ::getsockname(m_socket, reinterpret_cast<sockaddr *>(&address), &length);
+  m_port = ntohs(address.sin_port);
+
+  m_running = true;
+  m_thread = std::thread(&OscServer::run, this);
+}
+
+void OscServer::stop() {
+  if (m_thread.joinable()) {
+    m_running = false;
+    m_thread.join();
+  }
+  if (m_socket >= 0) {
+    ::close(m_socket);
+    m_socket = -1;
+  }
+}
+
+OscServerStats OscServer::getStats() const {
+  OscServerStats stats;
+  stats.packets = m_packets;
+  stats.messages = m_messages;
+  stats.malformed = m_malformed;
+  stats.failed = m_failed;
+  stats.late = m_scheduled.getLateEvents();
+  return stats;
+}
+
+void OscServer::run() {
+  pollfd descriptor{m_socket, POLLIN, 0};
+  while (m_running) {
+    if (::poll(&descriptor, 1, POLL_MILLISECONDS) > 0) {
+      // Replies already back decide these packets: a node removed by then
+      // has given up its ID
+      collectReplies();
+      // Take everything queued before looking at replies again
+      for (;;) {
+        sockaddr_in client{};
+        socklen_t length = sizeof(client);
+        const ssize_t received = ::recvfrom(
+            m_socket, m_receiveBuffer.data(), m_receiveBuffer.size(),
+            MSG_DONTWAIT, reinterpret_cast<sockaddr *>(&client), &length);
+        if (received < 0) {
+          break;
+        }
+        ++m_packets;
+        handlePacket({m_receiveBuffer.data(), static_cast<std::size_t>(received)},
+                     client);
+      }
+    }
+    collectReplies();
+  }
+}
+
+void OscServer::handlePacket(std::span<const std::uint8_t> packet,
+                             const sockaddr_in &client) {
+  const bool parsed = parseOscPacket(
+      packet, [&](const OscMessage &message, std::uint64_t timeTag) {
+        m_time = m_fixedTime ? m_fixedTime : frameOf(timeTag);
+        handleMessage(message, client);
+        m_time.reset();
+      });
+  if (!parsed) {
+    ++m_malformed;
+  }
+}
+
+void OscServer::execute(std::span<const std::uint8_t> packet,
+                        std::uint64_t frame) {
+  collectReplies();
+  m_fixedTime = frame;
+  handlePacket(packet, sockaddr_in{});
+  m_fixedTime.reset();
+}
+
+std::optional<std::uint64_t> OscServer::frameOf(std::uint64_t timeTag) const {
+  if (timeTag == OSC_IMMEDIATELY) {
+    return std::nullopt;
+  }
+  // Time tags are wall-clock times, the engine clock runs on the monotonic
+  // clock; the offset between the two is taken now
+  const auto wait =
+      osc::toSystemTime(timeTag) - std::chrono::system_clock::now();
+  return m_engine.getClock().frameAt(
+      std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(wait));
+}
+
+void OscServer::handleMessage(const OscMessage &message,
+                              const sockaddr_in &client) {
+  ++m_messages;
+  const std::string_view address = message.getAddress();
+  try {
+    if (address == "/n_set") {
+      setControls(message.arguments(), client);
+    } else if (address == "/s_new") {
+      newSynth(message.arguments(), client);
+    } else if (address == "/n_free") {
+      freeNodes(message.arguments(), client);
+    } else if (address == "/d_recv") {
+      receiveSynthDefs(message.arguments(), client);
+    } else if (address == "/sync") {
+      sync(message.arguments(), client);
+    } else {
+      fail(client, address, "Command not found");
+    }
+  } catch (const std::exception &error) {
+    fail(client, address, error.what());
+  }
+}
+
+void OscServer::newSynth(OscMessage::Reader arguments,
+                         const sockaddr_in &client) {
+  OscArgument defName;
+  if (!arguments.next(defName) || !defName.isString()) {
+    throw std::invalid_argument("missing SynthDef name");
+  }
+  OscArgument argument;
+  std::int32_t node = -1;
+  if (arguments.next(argument)) {
+    node = argument.asInt();
+  }
+  // addAction and target: the graph has no groups
+  arguments.next(argument);
+  arguments.next(argument);
+  if (node < 0) {
+    node = m_nextAutoNode--;
+  }
+  if (m_nodes.count(node) != 0) {
+    throw std::invalid_argument("duplicate node ID " + std::to_string(node));
+  }
+
+  Definition definition;
+  {
+    std::lock_guard<std::mutex> lock(m_definitionsMutex);
+    const auto found = m_definitions.find(std::string(defName.s));
+    if (found == m_definitions.end()) {
+      throw std::invalid_argument("SynthDef " + std::string(defName.s) +
+                                  " not found");
+    }
+    definition = found->second;
+  }
+  std::unique_ptr<Module<float>> module;
+  if (definition.synthDef) {
+    module =
+        std::make_unique<SynthDefNode>(definition.synthDef, definition.buses);
+  } else {
+    module = definition.factory();
+  }
+
+  // Controls are set before the node is sent, so it starts with them
+  Node record;
+  record.module = nodeName(node);
+  record.parameters = module->getParameterNames();
+  unsigned int firstChannel = 0;
+  OscArgument control;
+  OscArgument value;
+  while (arguments.next(control) && arguments.next(value)) {
+    std::string name;
+    if (control.isString()) {
+      name = control.s;
+    } else {
+      const auto index = static_cast<std::size_t>(control.asInt());
+      if (index >= record.parameters.size()) {
+        throw std::invalid_argument("control index " + std::to_string(index) +
+                                    " out of range");
+      }
+      name = record.parameters[index];
+    }
+    if (name == "out" && definition.factory) {
+      firstChannel = static_cast<unsigned int>(std::max(0, value.asInt()));
+      continue;
+    }
+    if (std::find(record.parameters.begin(), record.parameters.end(), name) ==
+        record.parameters.end()) {
+      throw std::invalid_argument("unknown control " + name);
+    }
+    module->setParameter(name, value.asFloat());
+  }
+  m_engine.prepareModule(*module);
+
+  const unsigned int numOutputs =
+      firstChannel < m_engine.getNumOutputs()
+          ? std::min(module->getNumOutputs(),
+                     m_engine.getNumOutputs() - firstChannel)
+          : 0;
+  const unsigned int numInputs =
+      definition.synthDef
+          ? std::min(module->getNumInputs(), m_engine.getNumInputs())
+          : 0;
+  // A node left without its routes would play on unheard
+  reserve(m_time ? m_scheduled : m_commands, 1 + numOutputs + numInputs);
+  const std::string name = record.module;
+  EngineCommand add = EngineCommand::addModule(name, module.get());
+  push(add, node, client);
+  module.release(); // owned by the command now
+  if (m_time) {
+    record.startFrame = m_time;
+    record.addSequence = add.sequence;
+  }
+  m_nodes.emplace(node, std::move(record));
+  for (unsigned int output = 0; output < numOutputs; ++output) {
+    EngineCommand route =
+        EngineCommand::connectOutput(name, output, firstChannel + output);
+    push(route, node, client);
+  }
+  if (definition.synthDef) {
+    for (unsigned int input = 0; input < numInputs; ++input) {
+      EngineCommand capture = EngineCommand::connect(
+          GraphProcessor::INPUT_MODULE, input, name, input);
+      push(capture, node, client);
+    }
+  }
+}
+
+void OscServer::setControls(OscMessage::Reader arguments,
+                            const sockaddr_in &client) {
+  OscArgument argument;
+  if (!arguments.next(argument)) {
+    throw std::invalid_argument("missing node ID");
+  }
+  const std::int32_t node = argument.asInt();
+  const auto found = m_nodes.find(node);
+  if (found == m_nodes.end() || found->second.freed) {
+    throw std::invalid_argument("Node " + std::to_string(node) + " not found");
+  }
+  const Node &record = found->second;
+  OscArgument control;
+  OscArgument value;
+  while (arguments.next(control) && arguments.next(value)) {
+    const std::string *name = nullptr;
+    if (control.isString()) {
+      const auto match = std::find(record.parameters.begin(),
+                                   record.parameters.end(), control.s);
+      name = match != record.parameters.end() ? &*match : nullptr;
+    } else {
+      const auto index = static_cast<std::size_t>(control.asInt());
+      name = index < record.parameters.size() ? &record.parameters[index]
+                                              : nullptr;
+    }
+    // Unknown controls would throw on the audio thread; they stop here
+    if (name == nullptr) {
+      throw std::invalid_argument("unknown control on node " +
+                                  std::to_string(node));
+    }
+    EngineCommand command =
+        EngineCommand::setParameter(record.module, *name, value.asFloat());
+    push(command, node, client);
+  }
+}
+
+void OscServer::freeNodes(OscMessage::Reader arguments,
+                          const sockaddr_in &client) {
+  OscArgument argument;
+  while (arguments.next(argument)) {
+    const std::int32_t node = argument.asInt();
+    const auto found = m_nodes.find(node);
+    if (found == m_nodes.end() || found->second.freed) {
+      fail(client, "/n_free", "Node " + std::to_string(node) + " not found");
+      continue;
+    }
+    // The module comes back in a reply and is deleted by collectReplies
+    EngineCommand command = EngineCommand::removeModule(found->second.module);
+    push(command, node, client);
+    if (found->second.startFrame) {
+      // Removed at its start frame at the earliest; until then the ID is
+      // taken, or a new node under it would be the one removed
+      found->second.freed = true;
+    } else {
+      m_nodes.erase(found);
+    }
+  }
+}
+
+void OscServer::receiveSynthDefs(OscMessage::Reader arguments,
+                                 const sockaddr_in &client) {
+  OscArgument data;
+  if (!arguments.next(data) || data.type != 'b') {
+    throw std::invalid_argument("missing SynthDef data");
+  }
+  SynthDefLoader loader;
+  for (const auto &loaded : loader.parse(data.blob)) {
+    addSynthDef(loaded.synthDef);
+  }
+  // An optional completion message runs once the defs are in
+  OscArgument completion;
+  if (arguments.next(completion) && completion.type == 'b') {
+    handlePacket(completion.blob, client);
+  }
+  reply(client, OscBuilder("/done").add("/d_recv").bytes());
+}
+
+void OscServer::sync(OscMessage::Reader arguments, const sockaddr_in &client) {
+  OscArgument id;
+  arguments.next(id);
+  if (m_pending.empty()) {
+    reply(client, OscBuilder("/synced").add(id.asInt()).bytes());
+    return;
+  }
+  m_syncs.push_back({m_pending.back().sequence, id.asInt(), client});
+}
+
+void OscServer::push(EngineCommand &command, std::int32_t node,
+                     const sockaddr_in &client) {
+  // Immediate commands go at time 0, which the bus clamps to the next block
+  std::optional<std::uint64_t> time = m_time;
+  const auto found = m_nodes.find(node);
+  if (found != m_nodes.end() && found->second.startFrame &&
+      (!time || *time < *found->second.startFrame)) {
+    // Run before the node's AddModule, it would find no node
+    time = found->second.startFrame;
+  }
+  ControlEventBus::Producer &producer = time ? m_scheduled : m_commands;
+  reserve(producer, 1);
+  // Only this thread pushes, so the space reserve() saw is still there
+  producer.push(time.value_or(0), command);
+  const Pending pending{command.sequence, command.type, node, client};
+  if (time) {
+    m_scheduledPending.emplace(command.sequence, pending);
+  } else {
+    m_pending.push_back(pending);
+  }
+}
+
+void OscServer::reserve(ControlEventBus::Producer &producer,
+                        std::size_t count) {
+  if (producer.getFreeSpace() < count && m_fixedTime && m_flushHandler) {
+    // Nothing else runs the engine under execute(): have it apply what is
+    // queued, which frees the ring, rather than wait for a block
+    collectReplies();
+    m_flushHandler();
+    collectReplies();
+  }
+  const auto deadline = std::chrono::steady_clock::now() + PUSH_TIMEOUT;
+  while (producer.getFreeSpace() < count && !m_fixedTime) {
+    collectReplies();
+    if (std::chrono::steady_clock::now() > deadline) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  if (producer.getFreeSpace() < count) {
+    throw std::runtime_error("engine command queue full");
+  }
+}
+
+void OscServer::collectReplies() {
+  m_commands.collectReplies([this](const EngineReply &reply) {
+    // Replies come back in the order the commands were pushed
+    while (!m_pending.empty() && m_pending.front().sequence <= reply.sequence) {
+      const Pending pending = m_pending.front();
+      m_pending.pop_front();
+      if (pending.sequence == reply.sequence) {
+        checkReply(pending, reply);
+      }
+    }
+    while (!m_syncs.empty() && m_syncs.front().sequence <= reply.sequence) {
+      this->reply(m_syncs.front().client,
+                  OscBuilder("/synced").add(m_syncs.front().id).bytes());
+      m_syncs.pop_front();
+    }
+  });
+  m_scheduled.collectReplies([this](const EngineReply &reply) {
+    const auto found = m_scheduledPending.find(reply.sequence);
+    if (found == m_scheduledPending.end()) {
+      return;
+    }
+    const Pending pending = found->second;
+    m_scheduledPending.erase(found);
+    checkReply(pending, reply);
+    const auto record = m_nodes.find(pending.node);
+    if (record == m_nodes.end()) {
+      return;
+    }
+    if (pending.type == EngineCommand::Type::AddModule &&
+        record->second.addSequence == pending.sequence) {
+      // Started: later commands need not wait for it
+      record->second.startFrame.reset();
+    } else if (pending.type == EngineCommand::Type::RemoveModule &&
+               record->second.freed) {
+      m_nodes.erase(record);
+    }
+  });
+}
+
+void OscServer::checkReply(const Pending &pending, const EngineReply &reply) {
+  if (reply.status != EngineReply::Status::Rejected) {
+    return;
+  }
+  if (pending.type == EngineCommand::Type::AddModule) {
+    m_nodes.erase(pending.node);
+  }
+  fail(pending.client, describe(pending.type),
+       "Node " + std::to_string(pending.node) + " rejected");
+}
+
+void OscServer::reply(const sockaddr_in &client,
+                      const std::vector<std::uint8_t> &packet) {
+  if (m_replyHandler) {
+    m_replyHandler(packet);
+    return;
+  }
+  ::sendto(m_socket, packet.data(), packet.size(), 0,
+           reinterpret_cast<const sockaddr *>(&client), sizeof(client));
+}
+
+void OscServer::fail(const sockaddr_in &client, std::string_view command,
+                     const std::string &message) {
+  ++m_failed;
+  reply(client, OscBuilder("/fail").add(command).add(message).bytes());
+}
+
+std::string OscServer::nodeName(std::int32_t node) {
+  return "n" + std::to_string(node);
+}
+
+} // namespace tinysynth
@@ -0,0 +1,201 @@
+// OscServer.h
+#pragma once
+
+#include "GraphProcessor.h"
+#include "OscPacket.h"
+#include "SynthDefJIT.h"
+#include "SynthDefNode.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <netinet/in.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace tinysynth {
+
+struct OscServerStats {
+    std::uint64_t packets = 0;
+    std::uint64_t messages = 0;
+    std::uint64_t malformed = 0; // packets that did not parse
+    std::uint64_t failed = 0;    // commands answered with /fail
+    std::uint64_t late = 0;      // bundled commands that ran after their time
+};
+
+// UDP Open Sound Control server with a subset of the scsynth command set,
+// the protocol Klarenz drives the engine with:
+//
+//   /s_new   defName nodeID addAction target [control value ...]
+//   /n_set   nodeID control value [control value ...]
+//   /n_free  nodeID [nodeID ...]
+//   /d_recv  SynthDef file bytes [completion message]
+//   /sync    id                  answered with /synced once all before it
+//                                have reached the audio thread
+//
+// defName is a SynthDef received with /d_recv (or addSynthDef) or a module
+// type registered with registerModule. A SynthDef node's Out bus i plays to
+// output channel i and its In bus i reads capture channel i; a module's
+// outputs start at the channel of an "out" control, default 0. Nodes form
+// a flat graph, so addAction and target are accepted but ignored; a
+// negative nodeID asks the server for one. Controls are names or indices,
+// values ints or floats. Errors are answered with /fail command message.
+//
+// Packets are read on the server's own thread, decoded in place from the
+// receive buffer and forwarded as EngineCommands through a control source
+// of the GraphProcessor, so the audio thread only ever sees its lock-free
+// rings. Node commands in a bundle with a time tag go to a scheduled
+// source instead, stamped with the frame the engine clock reaches at that
+// time, and run on that exact frame; a bundle that arrives late runs at
+// the next block and counts in the stats. Like scsynth, /sync waits for
+// immediate commands only, and /d_recv always runs at once.
+class OscServer {
+public:
+    static constexpr std::uint16_t DEFAULT_PORT = 57110;
+
+    using ModuleFactory = std::function<std::unique_ptr<Module<float>>()>;
+    using ReplyHandler = std::function<void(std::span<const std::uint8_t> packet)>;
+    using FlushHandler = std::function<void()>;
+
+    struct Config {
+        // 0 binds a free port; see getPort
+        std::uint16_t port = DEFAULT_PORT;
+        // Loopback only unless told otherwise
+        std::string bindAddress = "127.0.0.1";
+    };
+
+    // The engine and the JIT must outlive the server
+    OscServer(GraphProcessor& engine, SynthDefJIT& jit, Config config);
+    OscServer(GraphProcessor& engine, SynthDefJIT& jit) : OscServer(engine, jit, Config{}) {}
+    OscServer(const OscServer&) = delete;
+    OscServer& operator=(const OscServer&) = delete;
+    ~OscServer();
+
+    // Before start()
+    void registerModule(const std::string& defName, ModuleFactory factory);
+    // Compiles a SynthDef for /s_new, replacing one of the same name. Safe
+    // while the server runs.
+    void addSynthDef(const SynthDef& synthDef);
+
+    // Binds the socket and starts the server thread; throws
+    // std::runtime_error when the socket cannot be bound
+    void start();
+    void stop();
+
+    // Without start(), for non-realtime rendering, which reads a score and
+    // drives the engine on one thread: runs a packet on the caller's
+    // thread, its node commands at engine frame `frame` whatever its time
+    // tags say. Replies go to the reply handler.
+    void execute(std::span<const std::uint8_t> packet, std::uint64_t frame);
+    // Without start(): handles the engine's replies so far
+    void collectReplies();
+    // Replies go here instead of back over UDP; before start() or execute()
+    void setReplyHandler(ReplyHandler handler) { m_replyHandler = std::move(handler); }
+    // For execute(): called when a packet holds more commands than the
+    // engine's rings take, to run the engine up to the packet's frame and
+    // apply what is queued (see NrtRenderer). Without one, such a packet
+    // fails at once.
+    void setFlushHandler(FlushHandler handler) { m_flushHandler = std::move(handler); }
+
+    [[nodiscard]] std::uint16_t getPort() const { return m_port; }
+    [[nodiscard]] OscServerStats getStats() const;
+
+private:
+    // A /s_new def: a compiled SynthDef or a module type
+    struct Definition {
+        std::shared_ptr<const CompiledSynthDef> synthDef;
+        SynthDefBuses buses;
+        ModuleFactory factory;
+    };
+
+    // What the server knows of a node it created
+    struct Node {
+        std::string module;
+        std::vector<std::string> parameters;
+        // While a scheduled AddModule is on its way: its frame and sequence.
+        // Commands for the node go no earlier than that frame.
+        std::optional<std::uint64_t> startFrame;
+        std::uint32_t addSequence = 0;
+        // Freed before it started; the ID stays taken until the removal
+        // has run
+        bool freed = false;
+    };
+
+    // A command on its way to the audio thread
+    struct Pending {
+        std::uint32_t sequence;
+        EngineCommand::Type type;
+        std::int32_t node;
+        sockaddr_in client;
+    };
+
+    struct Sync {
+        std::uint32_t sequence; // answered once this one has been
+        std::int32_t id;
+        sockaddr_in client;
+    };
+
+    void run();
+    void handlePacket(std::span<const std::uint8_t> packet, const sockaddr_in& client);
+    // The engine frame of a time tag; empty for "immediately" or while the
+    // engine clock is not running
+    [[nodiscard]] std::optional<std::uint64_t> frameOf(std::uint64_t timeTag) const;
+    void handleMessage(const OscMessage& message, const sockaddr_in& client);
+    void newSynth(OscMessage::Reader arguments, const sockaddr_in& client);
+    void setControls(OscMessage::Reader arguments, const sockaddr_in& client);
+    void freeNodes(OscMessage::Reader arguments, const sockaddr_in& client);
+    void receiveSynthDefs(OscMessage::Reader arguments, const sockaddr_in& client);
+    void sync(OscMessage::Reader arguments, const sockaddr_in& client);
+    // Pushes with back-pressure: waits while the engine's ring is full, or
+    // under execute() flushes the engine. A command for a node that has not
+    // started yet is scheduled at its start frame if it would run earlier.
+    void push(EngineCommand& command, std::int32_t node, const sockaddr_in& client);
+    // The same back-pressure until `count` pushes in a row will succeed, so
+    // a command that takes several pushes is sent whole or not at all
+    void reserve(ControlEventBus::Producer& producer, std::size_t count);
+    // Answers a rejected command with /fail
+    void checkReply(const Pending& pending, const EngineReply& reply);
+    void reply(const sockaddr_in& client, const std::vector<std::uint8_t>& packet);
+    void fail(const sockaddr_in& client, std::string_view command, const std::string& message);
+    [[nodiscard]] static std::string nodeName(std::int32_t node);
+
+    GraphProcessor& m_engine;
+    SynthDefJIT& m_jit;
+    Config m_config;
+    ControlEventBus::Producer& m_commands;
+    ControlEventBus::Producer& m_scheduled;
+    int m_socket = -1;
+    std::uint16_t m_port = 0;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    ReplyHandler m_replyHandler;
+    FlushHandler m_flushHandler;
+
+    std::mutex m_definitionsMutex;
+    std::unordered_map<std::string, Definition> m_definitions;
+    // Server thread only
+    std::unordered_map<std::int32_t, Node> m_nodes;
+    std::int32_t m_nextAutoNode = -2;
+    // Frame the message being handled runs at; empty runs it at once
+    std::optional<std::uint64_t> m_time;
+    // Set by execute(): the frame of every message
+    std::optional<std::uint64_t> m_fixedTime;
+    std::deque<Pending> m_pending;
+    // Scheduled replies come back in time order, not sequence order
+    std::unordered_map<std::uint32_t, Pending> m_scheduledPending;
+    std::deque<Sync> m_syncs;
+    std::vector<std::uint8_t> m_receiveBuffer;
+
+    std::atomic<std::uint64_t> m_packets{0};
+    std::atomic<std::uint64_t> m_messages{0};
+    std::atomic<std::uint64_t> m_malformed{0};
+    std::atomic<std::uint64_t> m_failed{0};
+};
+
+} // namespace tinysynth
@@ -0,0 +1,193 @@
+// PipelinedProcessor.cpp
+#include "PipelinedProcessor.h"
+#include "DenormalGuard.h"
+#include "RealtimeMemory.h"
+#include "RealtimeSanitizer.h"
+#include <algorithm>
+#include <pthread.h>
+#include <stdexcept>
+
+namespace tinysynth {
+
+PipelinedProcessor::PipelinedProcessor(AudioProcessor &processor,
+                                       unsigned int numInputs,
+                                       unsigned int numOutputs, Config config)
+    : m_processor(processor), m_config(config), m_numInputs(numInputs),
+      m_numOutputs(numOutputs) {
+  if (sem_init(&m_wake, 0, 0) != 0) {
+    throw std::runtime_error("Failed to create the pipeline semaphore");
+  }
+}
+
+PipelinedProcessor::~PipelinedProcessor() {
+  stopWorker();
+  sem_destroy(&m_wake);
+}
+
+void PipelinedProcessor::prepare(unsigned int sampleRate,
+                                 unsigned int maxBlockSize) {
+  stopWorker();
+  m_processor.prepare(sampleRate, maxBlockSize);
+  m_maxBlockSize = maxBlockSize;
+
+  for (auto &block : m_blocks) {
+    block.inputs.assign(m_numInputs, std::vector<float>(maxBlockSize, 0.0F));
+    block.outputs.assign(m_numOutputs, std::vector<float>(maxBlockSize, 0.0F));
+    block.inputPointers.clear();
+    block.outputPointers.clear();
+    for (auto &buffer : block.inputs) {
+      block.inputPointers.push_back(buffer.data());
+    }
+    for (auto &buffer : block.outputs) {
+      block.outputPointers.push_back(buffer.data());
+    }
+    block.numFrames = 0;
+    block.silentFrames = 0;
+    block.midiCount = 0;
+  }
+  m_silence.assign(maxBlockSize, 0.0F);
+  m_silentInputs.assign(m_numInputs, m_silence.data());
+  // Nothing rendered yet: the first period plays silence
+  m_incomingMidiCount = 0;
+  m_droppedFrames = 0;
+  m_submitted = 0;
+  m_completed = 0;
+  m_cycles = 0;
+  m_lateCycles = 0;
+  m_droppedBlocks = 0;
+  startWorker();
+}
+
+unsigned int PipelinedProcessor::getLatency() const {
+  return m_maxBlockSize + m_processor.getLatency();
+}
+
+void PipelinedProcessor::receiveMidi(const MidiMessage &message) {
+  if (m_incomingMidiCount < m_incomingMidi.size()) {
+    m_incomingMidi[m_incomingMidiCount++] = message;
+  }
+}
+
+void PipelinedProcessor::process(const float *const *inputs,
+                                 float *const *outputs,
+                                 unsigned int numFrames) {
+  const std::uint64_t cycle = ++m_cycles;
+  const std::uint64_t submitted = m_submitted.load(std::memory_order_relaxed);
+  const std::uint64_t completed = m_completed.load(std::memory_order_acquire);
+
+  // This period plays the block the previous callback handed over, once
+  // the worker has finished everything up to it. Outputs arrive zeroed, so
+  // a late period, or a block of another size, plays silence.
+  bool onTime = false;
+  if (completed == submitted && submitted > 0) {
+    const Block &last = m_blocks[(submitted - 1) % MAX_QUEUED_BLOCKS];
+    onTime = last.cycle + 1 == cycle;
+    if (onTime && last.numFrames == numFrames) {
+      for (unsigned int channel = 0; channel < m_numOutputs; ++channel) {
+        std::copy_n(last.outputs[channel].data(), numFrames, outputs[channel]);
+      }
+    }
+  }
+  if (!onTime && cycle > 1) {
+    ++m_lateCycles;
+  }
+
+  if (submitted - completed == MAX_QUEUED_BLOCKS) {
+    // No room: the worker renders these frames from silence before the
+    // next block, and this period's MIDI goes with that block
+    m_droppedFrames += numFrames;
+    ++m_droppedBlocks;
+    return;
+  }
+  // Blocks up to `completed` are done, so this slot is free
+  Block &block = m_blocks[submitted % MAX_QUEUED_BLOCKS];
+  for (unsigned int channel = 0; channel < m_numInputs; ++channel) {
+    float *destination = block.inputs[channel].data();
+    if (inputs != nullptr && inputs[channel] != nullptr) {
+      std::copy_n(inputs[channel], numFrames, destination);
+    } else {
+      std::fill_n(destination, numFrames, 0.0F);
+    }
+  }
+  block.numFrames = numFrames;
+  block.silentFrames = m_droppedFrames;
+  block.cycle = cycle;
+  std::copy_n(m_incomingMidi.begin(), m_incomingMidiCount, block.midi.begin());
+  block.midiCount = m_incomingMidiCount;
+  m_incomingMidiCount = 0;
+  m_droppedFrames = 0;
+  // Publishes the block to the worker
+  m_submitted.store(submitted + 1, std::memory_order_release);
+  sem_post(&m_wake);
+}
+
+void PipelinedProcessor::startWorker() {
+  m_stopRequested = false;
+  m_worker = std::thread(&PipelinedProcessor::run, this);
+}
+
+void PipelinedProcessor::stopWorker() {
+  if (!m_worker.joinable()) {
+    return;
+  }
+  m_stopRequested = true;
+  sem_post(&m_wake);
+  m_worker.join();
+  // Drop a wakeup the worker did not consume
+  while (sem_trywait(&m_wake) == 0) {
+  }
+}
+
+void PipelinedProcessor::render(Block &block) {
+  // Dropped periods keep the wrapped clock in step with the host's
+  while (block.silentFrames > 0) {
+    const auto frames = static_cast<unsigned int>(
+        std::min<std::uint64_t>(block.silentFrames, m_maxBlockSize));
+    for (auto &buffer : block.outputs) {
+      std::fill_n(buffer.data(), frames, 0.0F);
+    }
+    m_processor.process(m_silentInputs.data(), block.outputPointers.data(),
+                        frames);
+    block.silentFrames -= frames;
+  }
+  for (auto &buffer : block.outputs) {
+    std::fill_n(buffer.data(), block.numFrames, 0.0F);
+  }
+  for (std::size_t i = 0; i < block.midiCount; ++i) {
+    m_processor.receiveMidi(block.midi[i]);
+  }
+  m_processor.process(block.inputPointers.data(), block.outputPointers.data(),
+                      block.numFrames);
+}
+
+void PipelinedProcessor::run() {
+  sched_param param{};
+  param.sched_priority = m_config.priority;
+  m_realtime = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+  if (m_config.cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(m_config.cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+  RealtimeMemory::prefaultStack();
+
+  ScopedDenormalGuard denormalGuard;
+  std::uint64_t completed = m_completed.load(std::memory_order_relaxed);
+  while (true) {
+    while (sem_wait(&m_wake) != 0) {
+    }
+    if (m_stopRequested) {
+      break;
+    }
+    // One wakeup per block, but a late worker finds several queued
+    const std::uint64_t submitted = m_submitted.load(std::memory_order_acquire);
+    ScopedRealtimeContext realtime;
+    while (completed < submitted) {
+      render(m_blocks[completed % MAX_QUEUED_BLOCKS]);
+      m_completed.store(++completed, std::memory_order_release);
+    }
+  }
+}
+
+} // namespace tinysynth
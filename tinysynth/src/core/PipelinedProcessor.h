@@ -0,0 +1,120 @@
+// PipelinedProcessor.h
+#pragma once
+
+#include "AudioBackend.h"
+#include "MidiParser.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <semaphore.h>
+#include <thread>
+#include <vector>
+
+namespace tinysynth {
+
+// Renders another processor one period ahead on a realtime worker thread.
+// Each backend callback only copies out the block the worker finished
+// during the previous period, hands it this period's inputs and wakes it,
+// so the wrapped graph gets almost a whole period of compute instead of
+// what is left of the callback, for exactly one period of added latency.
+//
+// The wrapped processor (usually a GraphProcessor) is only ever called from
+// the worker. Its frame clock runs one period ahead of the backend's, so
+// control events stamped with GraphProcessor::getFrameTime() still land on
+// the frame they name; sources stamping from the host clock must add
+// getLatency(). If the worker has not finished when the next callback
+// arrives, that period plays silence and counts as a late cycle, but its
+// inputs and MIDI still queue behind the block in flight: the worker renders
+// every period in order, drops the output of those it finished too late
+// and so keeps its clock with the host's. Only a worker more than
+// MAX_QUEUED_BLOCKS periods behind has periods rendered from silence, and
+// their MIDI goes with the next block.
+//
+// For realtime backends; offline rendering gains nothing from it.
+class PipelinedProcessor : public AudioProcessor {
+public:
+    // MIDI messages carried per block; more are dropped
+    static constexpr std::size_t MAX_MIDI_PER_BLOCK = 256;
+    // Periods the worker may fall behind by before inputs are dropped
+    static constexpr std::size_t MAX_QUEUED_BLOCKS = 4;
+
+    struct Config {
+        int priority = 60; // SCHED_FIFO priority of the worker
+        int cpu = -1;      // core to pin the worker to, -1 for any
+    };
+
+    PipelinedProcessor(AudioProcessor& processor, unsigned int numInputs,
+                       unsigned int numOutputs, Config config);
+    PipelinedProcessor(const PipelinedProcessor&) = delete;
+    PipelinedProcessor& operator=(const PipelinedProcessor&) = delete;
+    ~PipelinedProcessor() override;
+
+    // Starts (or restarts) the worker
+    void prepare(unsigned int sampleRate, unsigned int maxBlockSize) override;
+    void process(const float* const* inputs, float* const* outputs,
+                 unsigned int numFrames) override;
+    [[nodiscard]] unsigned int getLatency() const override;
+    void receiveMidi(const MidiMessage& message) override;
+
+    [[nodiscard]] std::uint64_t getCycles() const { return m_cycles.load(); }
+    [[nodiscard]] std::uint64_t getLateCycles() const { return m_lateCycles.load(); }
+    // Periods the queue had no room for, rendered from silence
+    [[nodiscard]] std::uint64_t getDroppedBlocks() const { return m_droppedBlocks.load(); }
+    // Whether the worker was granted SCHED_FIFO
+    [[nodiscard]] bool isRealtime() const { return m_realtime.load(); }
+    // Whether the worker has rendered every block handed to it; a caller
+    // that waits for this before each process() never sees a late cycle
+    [[nodiscard]] bool isIdle() const {
+        return m_completed.load(std::memory_order_acquire) ==
+               m_submitted.load(std::memory_order_acquire);
+    }
+
+private:
+    // One period on its way through the worker
+    struct Block {
+        std::vector<std::vector<float>> inputs;
+        std::vector<std::vector<float>> outputs;
+        std::vector<const float*> inputPointers;
+        std::vector<float*> outputPointers;
+        unsigned int numFrames = 0;
+        // Frames of dropped periods to render from silence first
+        std::uint64_t silentFrames = 0;
+        // The callback that handed it over; played by the next one only
+        std::uint64_t cycle = 0;
+        std::array<MidiMessage, MAX_MIDI_PER_BLOCK> midi;
+        std::size_t midiCount = 0;
+    };
+
+    void startWorker();
+    void stopWorker();
+    void run();
+    void render(Block& block);
+
+    AudioProcessor& m_processor;
+    Config m_config;
+    unsigned int m_numInputs;
+    unsigned int m_numOutputs;
+    unsigned int m_maxBlockSize = 0;
+    std::array<Block, MAX_QUEUED_BLOCKS> m_blocks;
+    // Inputs of the periods rendered from silence
+    std::vector<float> m_silence;
+    std::vector<const float*> m_silentInputs;
+    // Callback only: MIDI for the next block, frames dropped since the last
+    std::array<MidiMessage, MAX_MIDI_PER_BLOCK> m_incomingMidi;
+    std::size_t m_incomingMidiCount = 0;
+    std::uint64_t m_droppedFrames = 0;
+
+    sem_t m_wake;
+    std::thread m_worker;
+    // Blocks handed to the worker and blocks it finished; the difference
+    // is the queue
+    std::atomic<std::uint64_t> m_submitted{0};
+    std::atomic<std::uint64_t> m_completed{0};
+    std::atomic<bool> m_stopRequested{false};
+    std::atomic<bool> m_realtime{false};
+    std::atomic<std::uint64_t> m_cycles{0};
+    std::atomic<std::uint64_t> m_lateCycles{0};
+    std::atomic<std::uint64_t> m_droppedBlocks{0};
+};
+
+} // namespace tinysynth
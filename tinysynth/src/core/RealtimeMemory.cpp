@@ -0,0 +1,337 @@
+// RealtimeMemory.cpp
+#include "RealtimeMemory.h"
+#include <algorithm>
+#include <alloca.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace tinysynth {
+
+namespace {
+
+// Bump allocator over the locked mapping; the pools on top recycle the
+// blocks they serve, so this never needs to
+class ArenaResource : public std::pmr::memory_resource {
+public:
+  ArenaResource(unsigned char *begin, std::size_t size)
+      : m_begin(begin), m_size(size) {}
+
+  [[nodiscard]] bool contains(const void *pointer) const {
+    const auto *byte = static_cast<const unsigned char *>(pointer);
+    return byte >= m_begin && byte < m_begin + m_size;
+  }
+  [[nodiscard]] std::size_t getSize() const { return m_size; }
+  [[nodiscard]] std::size_t getUsed() const {
+    return m_used.load(std::memory_order_relaxed);
+  }
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    std::size_t used = m_used.load(std::memory_order_relaxed);
+    std::size_t offset = 0;
+    do {
+      const auto address = reinterpret_cast<std::uintptr_t>(m_begin) + used;
+      offset = used + (alignment - address % alignment) % alignment;
+      if (offset + bytes > m_size) {
+        throw std::bad_alloc();
+      }
+    } while (!m_used.compare_exchange_weak(used, offset + bytes,
+                                           std::memory_order_relaxed));
+    return m_begin + offset;
+  }
+  void do_deallocate(void * /*pointer*/, std::size_t /*bytes*/,
+                     std::size_t /*alignment*/) override {}
+  [[nodiscard]] bool
+  do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  unsigned char *m_begin;
+  std::size_t m_size;
+  std::atomic<std::size_t> m_used{0};
+};
+
+std::atomic<std::uint64_t> overflowCount{0};
+
+// The arena, then the heap once it is full: still locked under MCL_FUTURE,
+// but not prefaulted
+class UpstreamResource : public std::pmr::memory_resource {
+public:
+  explicit UpstreamResource(ArenaResource &arena) : m_arena(arena) {}
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    try {
+      return m_arena.allocate(bytes, alignment);
+    } catch (const std::bad_alloc &) {
+      overflowCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *pointer, std::size_t bytes,
+                     std::size_t alignment) override {
+    if (!m_arena.contains(pointer)) {
+      std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+  }
+  [[nodiscard]] bool
+  do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+  ArenaResource &m_arena;
+};
+
+// Created once and never destroyed, so objects released during static
+// destruction still find them
+ArenaResource *arena = nullptr;
+UpstreamResource *upstream = nullptr;
+// Shared by the control threads that build and destroy modules, lanes and
+// node state; the audio thread never allocates from it
+std::pmr::unsynchronized_pool_resource *pool = nullptr;
+std::mutex poolMutex;
+std::atomic<bool> initialised{false};
+std::size_t stackBytes = 0;
+bool locked = false;
+std::mutex initialiseMutex;
+
+// Modules and buffers are pooled and recycled. Larger blocks, such as
+// control-queue lanes, are bumped straight from the arena and not reused;
+// they are few and live as long as the engine.
+std::pmr::pool_options poolOptions() {
+  std::pmr::pool_options options;
+  options.largest_required_pool_block = std::size_t{64} << 10;
+  options.max_blocks_per_chunk = 64;
+  return options;
+}
+
+std::size_t memlockLimit() {
+  rlimit limit{};
+  getrlimit(RLIMIT_MEMLOCK, &limit);
+  return limit.rlim_cur == RLIM_INFINITY
+             ? SIZE_MAX
+             : static_cast<std::size_t>(limit.rlim_cur);
+}
+
+std::string formatBytes(std::size_t bytes) {
+  if (bytes == SIZE_MAX) {
+    return "unlimited";
+  }
+  if (bytes < (std::size_t{1} << 20)) {
+    return std::to_string(bytes >> 10) + " KiB";
+  }
+  return std::to_string(bytes >> 20) + " MiB";
+}
+
+// The rest of a /proc/self/status line, empty where it is not available
+std::string processStatus(const std::string &field) {
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    if (key == field) {
+      std::string value;
+      status >> value;
+      return value;
+    }
+    status.ignore(256, '\n');
+  }
+  return {};
+}
+
+// A /proc/self/status size such as VmLck, 0 where it is not available
+std::size_t statusBytes(const std::string &field) {
+  const std::string kilobytes = processStatus(field);
+  return kilobytes.empty() ? 0 : std::stoull(kilobytes) << 10;
+}
+
+// CAP_IPC_LOCK lifts RLIMIT_MEMLOCK
+bool canLockUnlimited() {
+  constexpr unsigned long long CAP_IPC_LOCK = 14;
+  const std::string effective = processStatus("CapEff:");
+  return !effective.empty() &&
+         (std::stoull(effective, nullptr, 16) >> CAP_IPC_LOCK & 1ULL) != 0;
+}
+
+// Raises the soft limit towards the hard one when that is what it takes
+void raiseMemlockLimit(std::size_t needed) {
+  rlimit limit{};
+  if (getrlimit(RLIMIT_MEMLOCK, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY ||
+      limit.rlim_cur >= needed) {
+    return;
+  }
+  limit.rlim_cur = limit.rlim_max == RLIM_INFINITY
+                       ? RLIM_INFINITY
+                       : std::max<rlim_t>(limit.rlim_cur, limit.rlim_max);
+  setrlimit(RLIMIT_MEMLOCK, &limit);
+}
+
+[[noreturn]] void failLocking(const std::string &what, int error) {
+  throw std::runtime_error(
+      what + ": " + std::strerror(error) + " (RLIMIT_MEMLOCK is " +
+      formatBytes(memlockLimit()) +
+      "; raise it with `ulimit -l` or memlock in /etc/security/limits.conf, "
+      "or start without memory locking)");
+}
+
+} // namespace
+
+void RealtimeMemory::initialise(const Config &config) {
+  std::lock_guard<std::mutex> lock(initialiseMutex);
+  if (initialised) {
+    throw std::runtime_error("Realtime memory is already initialised");
+  }
+
+  const auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  const std::size_t arenaBytes =
+      (config.arenaBytes + pageSize - 1) / pageSize * pageSize;
+  if (config.lockMemory) {
+    // mlockall locks the whole process, not just the arena
+    const std::size_t resident = statusBytes("VmRSS:");
+    const std::size_t needed =
+        resident + arenaBytes + config.lockHeadroomBytes;
+    raiseMemlockLimit(needed);
+    const std::size_t limit = memlockLimit();
+    if (limit < needed && !canLockUnlimited()) {
+      throw std::runtime_error(
+          "RLIMIT_MEMLOCK is " + formatBytes(limit) + ", too small to lock " +
+          formatBytes(resident) + " resident, a " + formatBytes(arenaBytes) +
+          " realtime arena and " + formatBytes(config.lockHeadroomBytes) +
+          " of headroom; raise it with `ulimit -l` or memlock in "
+          "/etc/security/limits.conf, or use a smaller arena");
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      failLocking("mlockall failed", errno);
+    }
+  }
+
+  void *mapping = mmap(nullptr, arenaBytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (mapping == MAP_FAILED) {
+    const int error = errno;
+    if (config.lockMemory) {
+      munlockall();
+      failLocking("Failed to map a locked realtime arena", error);
+    }
+    throw std::runtime_error(std::string("Failed to map the realtime arena: ") +
+                             std::strerror(error));
+  }
+  // MAP_POPULATE is only a hint; write every page so none is shared zero
+  auto *bytes = static_cast<unsigned char *>(mapping);
+  for (std::size_t offset = 0; offset < arenaBytes; offset += pageSize) {
+    bytes[offset] = 0;
+  }
+
+  arena = new ArenaResource(bytes, arenaBytes);
+  upstream = new UpstreamResource(*arena);
+  pool = new std::pmr::unsynchronized_pool_resource(poolOptions(), arena);
+  stackBytes = config.stackBytes;
+  locked = config.lockMemory;
+  initialised.store(true, std::memory_order_release);
+}
+
+bool RealtimeMemory::isInitialised() {
+  return initialised.load(std::memory_order_acquire);
+}
+
+std::pmr::memory_resource *RealtimeMemory::getResource() {
+  return isInitialised() ? static_cast<std::pmr::memory_resource *>(upstream)
+                         : std::pmr::new_delete_resource();
+}
+
+void *RealtimeMemory::allocate(std::size_t size, std::size_t alignment) {
+  if (isInitialised()) {
+    try {
+      std::lock_guard<std::mutex> lock(poolMutex);
+      return pool->allocate(size, alignment);
+    } catch (const std::bad_alloc &) {
+      // Arena exhausted: the heap, as for UpstreamResource
+      overflowCount.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  return ::operator new(size, std::align_val_t(alignment));
+}
+
+void RealtimeMemory::deallocate(void *pointer, std::size_t size,
+                                std::size_t alignment) {
+  if (pointer == nullptr) {
+    return;
+  }
+  if (isInitialised() && arena->contains(pointer)) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    pool->deallocate(pointer, size, alignment);
+  } else {
+    ::operator delete(pointer, size, std::align_val_t(alignment));
+  }
+}
+
+bool RealtimeMemory::contains(const void *pointer) {
+  return isInitialised() && arena->contains(pointer);
+}
+
+// Not inlined, so the alloca is released on return
+__attribute__((noinline)) void RealtimeMemory::prefaultStack() {
+  if (!isInitialised()) {
+    return;
+  }
+  // Stay clear of the guard page on threads with small stacks
+  std::size_t bytes = stackBytes;
+  pthread_attr_t attributes;
+  if (pthread_getattr_np(pthread_self(), &attributes) == 0) {
+    std::size_t size = 0;
+    pthread_attr_getstacksize(&attributes, &size);
+    pthread_attr_destroy(&attributes);
+    const std::size_t reserve = std::size_t{64} << 10;
+    bytes = std::min(bytes, size > reserve ? size - reserve : 0);
+  }
+  const auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  auto *stack = static_cast<volatile unsigned char *>(alloca(bytes));
+  for (std::size_t offset = 0; offset < bytes; offset += pageSize) {
+    stack[offset] = 0;
+  }
+}
+
+RealtimeMemory::Usage RealtimeMemory::getUsage() {
+  Usage usage;
+  if (isInitialised()) {
+    usage.arenaBytes = arena->getSize();
+    usage.arenaUsed = arena->getUsed();
+  }
+  usage.overflowAllocations = overflowCount.load(std::memory_order_relaxed);
+  usage.lockedBytes = statusBytes("VmLck:");
+  usage.residentBytes = statusBytes("VmRSS:");
+  usage.memlockLimit = memlockLimit();
+  usage.locked = locked;
+  return usage;
+}
+
+std::string RealtimeMemory::describeUsage() {
+  const Usage usage = getUsage();
+  if (!isInitialised()) {
+    return "realtime memory: not initialised";
+  }
+  std::string text = "realtime memory: arena " + formatBytes(usage.arenaUsed) +
+                     " of " + formatBytes(usage.arenaBytes) + " used, ";
+  text += usage.locked ? formatBytes(usage.lockedBytes) + " locked (limit " +
+                             formatBytes(usage.memlockLimit) + ")"
+                       : std::string("not locked");
+  text += ", " + formatBytes(usage.residentBytes) + " resident";
+  if (usage.overflowAllocations > 0) {
+    text += ", " + std::to_string(usage.overflowAllocations) +
+            " allocations overflowed to the heap";
+  }
+  return text;
+}
+
+RealtimePool::RealtimePool()
+    : std::pmr::unsynchronized_pool_resource(poolOptions(),
+                                             RealtimeMemory::getResource()) {}
+
+} // namespace tinysynth
@@ -0,0 +1,100 @@
+// RealtimeMemory.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <string>
+
+namespace tinysynth {
+
+// Engine startup option that keeps page faults off the audio path. The
+// first touch of a buffer, a module's state or a thread's stack otherwise
+// faults a page in on the audio thread, which shows up as xruns in the
+// first seconds after a patch loads. initialise() locks the process's
+// current and future memory (mlockall) and maps a prefaulted arena; module
+// instances, ModularSystem buffers and control-queue storage are then
+// carved from it, and the audio and worker threads prefault their stacks
+// on entry. Before initialise() everything comes from the heap as usual.
+//
+// Objects are built and destroyed on control threads and share one locked
+// pool. What the audio thread allocates, such as a graph's buffers, comes
+// from a RealtimePool owned by that graph, which takes no lock.
+class RealtimeMemory {
+public:
+    struct Config {
+        std::size_t arenaBytes = std::size_t{64} << 20;
+        // Stack each audio or worker thread touches on entry
+        std::size_t stackBytes = std::size_t{256} << 10;
+        // mlockall(MCL_CURRENT | MCL_FUTURE)
+        bool lockMemory = true;
+        // RLIMIT_MEMLOCK must cover this on top of the resident set and the
+        // arena: MCL_FUTURE also locks later heap growth and every new
+        // thread's whole stack mapping
+        std::size_t lockHeadroomBytes = std::size_t{64} << 20;
+    };
+
+    struct Usage {
+        std::size_t arenaBytes = 0;
+        std::size_t arenaUsed = 0;
+        // Allocations the full arena sent to the heap instead
+        std::uint64_t overflowAllocations = 0;
+        std::size_t lockedBytes = 0;   // VmLck of the process
+        std::size_t residentBytes = 0; // VmRSS of the process
+        std::size_t memlockLimit = 0; // soft RLIMIT_MEMLOCK, SIZE_MAX if unlimited
+        bool locked = false;
+    };
+
+    // Control thread, once, before the patch is loaded. Throws
+    // std::runtime_error when RLIMIT_MEMLOCK is too small for the resident
+    // set, the arena and the headroom together, or locking fails; the
+    // process is left as it was.
+    static void initialise(const Config& config);
+    static bool isInitialised();
+
+    // Upstream for pools: chunks bumped from the arena, which are not
+    // reused once returned, and the heap when it is full or before
+    // initialise()
+    static std::pmr::memory_resource* getResource();
+
+    // From the pool shared by control threads; takes its lock
+    static void* allocate(std::size_t size, std::size_t alignment);
+    static void deallocate(void* pointer, std::size_t size, std::size_t alignment);
+    // Whether pointer lies in the arena
+    static bool contains(const void* pointer);
+
+    // Called on entry by audio and worker threads; no-op before initialise()
+    static void prefaultStack();
+
+    static Usage getUsage();
+    // One line for startup logs
+    static std::string describeUsage();
+};
+
+// Pool for one thread at a time, such as the buffers of the graph the audio
+// thread renders; no lock, chunks from the arena when there is one
+class RealtimePool : public std::pmr::unsynchronized_pool_resource {
+public:
+    RealtimePool();
+};
+
+// Base for objects built on the control thread and touched by the audio
+// thread, so their storage comes from the realtime arena
+class RealtimeAllocated {
+public:
+    static void* operator new(std::size_t size) {
+        return RealtimeMemory::allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    }
+    static void* operator new(std::size_t size, std::align_val_t alignment) {
+        return RealtimeMemory::allocate(size, static_cast<std::size_t>(alignment));
+    }
+    static void operator delete(void* pointer, std::size_t size) {
+        RealtimeMemory::deallocate(pointer, size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    }
+    static void operator delete(void* pointer, std::size_t size, std::align_val_t alignment) {
+        RealtimeMemory::deallocate(pointer, size, static_cast<std::size_t>(alignment));
+    }
+};
+
+} // namespace tinysynth
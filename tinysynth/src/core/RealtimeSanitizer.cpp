@@ -0,0 +1,394 @@
+// RealtimeSanitizer.cpp
+#include "RealtimeSanitizer.h"
+
+#ifdef TINYSYNTH_RT_SANITIZER
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <time.h>
+#include <typeinfo>
+#include <unistd.h>
+
+// glibc's own allocator entry points, so the interceptors need no dlsym
+extern "C" {
+void *__libc_malloc(size_t size);
+void __libc_free(void *pointer);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+namespace tinysynth {
+
+namespace {
+
+constexpr std::size_t REPORT_SLOTS = 256;
+constexpr int MAX_FRAMES = 32;
+
+enum SlotState : int { Free, Writing, Ready };
+
+struct Report {
+  std::atomic<int> state{Free};
+  RealtimeSanitizer::Violation violation;
+  const char *call;
+  long thread;
+  int numFrames;
+  void *frames[MAX_FRAMES];
+};
+
+std::array<Report, REPORT_SLOTS> reports;
+std::atomic<std::uint64_t> nextSlot{0};
+std::atomic<std::uint64_t> violationCount{0};
+std::atomic<std::uint64_t> droppedCount{0};
+
+std::thread reporter;
+std::atomic<bool> reporterStop{false};
+
+// Initial-exec TLS is never allocated lazily, so reading it inside malloc
+// cannot recurse into malloc
+__attribute__((tls_model("initial-exec"))) thread_local int realtimeDepth = 0;
+__attribute__((tls_model("initial-exec"))) thread_local int exemptionDepth = 0;
+// Set while recording, so the recorder's own calls are not checked
+__attribute__((tls_model("initial-exec"))) thread_local bool recording = false;
+
+bool checking() {
+  return realtimeDepth > 0 && exemptionDepth == 0 && !recording;
+}
+
+const char *describe(RealtimeSanitizer::Violation violation) {
+  switch (violation) {
+  case RealtimeSanitizer::Violation::Allocation:
+    return "heap allocation";
+  case RealtimeSanitizer::Violation::Deallocation:
+    return "heap release";
+  case RealtimeSanitizer::Violation::MutexLock:
+    return "mutex lock";
+  case RealtimeSanitizer::Violation::BlockingCall:
+    return "blocking call";
+  case RealtimeSanitizer::Violation::Throw:
+    return "exception thrown";
+  }
+  return "violation";
+}
+
+// Audio thread: no allocation, no locks, no output
+void record(RealtimeSanitizer::Violation violation, const char *call) {
+  recording = true;
+  violationCount.fetch_add(1, std::memory_order_relaxed);
+  Report &report =
+      reports[nextSlot.fetch_add(1, std::memory_order_relaxed) % REPORT_SLOTS];
+  int expected = Free;
+  if (report.state.compare_exchange_strong(expected, Writing,
+                                           std::memory_order_acquire)) {
+    report.violation = violation;
+    report.call = call;
+    report.thread = syscall(SYS_gettid);
+    report.numFrames = backtrace(report.frames, MAX_FRAMES);
+    report.state.store(Ready, std::memory_order_release);
+  } else {
+    // The reporter has fallen a whole ring behind
+    droppedCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  recording = false;
+}
+
+void printReports() {
+  for (auto &report : reports) {
+    if (report.state.load(std::memory_order_acquire) != Ready) {
+      continue;
+    }
+    std::fprintf(stderr,
+                 "==realtime sanitizer== %s (%s) on realtime thread %ld\n",
+                 describe(report.violation), report.call, report.thread);
+    std::fflush(stderr);
+    backtrace_symbols_fd(report.frames, report.numFrames, STDERR_FILENO);
+    report.state.store(Free, std::memory_order_release);
+  }
+}
+
+void runReporter() {
+  while (!reporterStop.load(std::memory_order_acquire)) {
+    printReports();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  printReports();
+}
+
+template <typename Function> Function resolve(const char *name) {
+  return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+
+using AlignedAlloc = void *(*)(size_t, size_t);
+using PosixMemalign = int (*)(void **, size_t, size_t);
+using MutexLock = int (*)(pthread_mutex_t *);
+using MutexTimedLock = int (*)(pthread_mutex_t *, const timespec *);
+using CondWait = int (*)(pthread_cond_t *, pthread_mutex_t *);
+using CondTimedWait = int (*)(pthread_cond_t *, pthread_mutex_t *,
+                              const timespec *);
+using SemWait = int (*)(sem_t *);
+using Read = ssize_t (*)(int, void *, size_t);
+using Write = ssize_t (*)(int, const void *, size_t);
+using Poll = int (*)(pollfd *, nfds_t, int);
+using NanoSleep = int (*)(const timespec *, timespec *);
+using ClockNanoSleep = int (*)(clockid_t, int, const timespec *, timespec *);
+using USleep = int (*)(useconds_t);
+using CxaThrow = void (*)(void *, std::type_info *, void (*)(void *));
+
+AlignedAlloc realAlignedAlloc = nullptr;
+PosixMemalign realPosixMemalign = nullptr;
+MutexLock realMutexLock = nullptr;
+MutexTimedLock realMutexTimedLock = nullptr;
+CondWait realCondWait = nullptr;
+CondTimedWait realCondTimedWait = nullptr;
+SemWait realSemWait = nullptr;
+Read realRead = nullptr;
+Write realWrite = nullptr;
+Poll realPoll = nullptr;
+NanoSleep realNanoSleep = nullptr;
+ClockNanoSleep realClockNanoSleep = nullptr;
+USleep realUSleep = nullptr;
+CxaThrow realThrow = nullptr;
+
+// Resolved before main; the interceptors also resolve on first use in case
+// something calls them during static initialisation
+__attribute__((constructor)) void initialise() {
+  realAlignedAlloc = resolve<AlignedAlloc>("aligned_alloc");
+  realPosixMemalign = resolve<PosixMemalign>("posix_memalign");
+  realMutexLock = resolve<MutexLock>("pthread_mutex_lock");
+  realMutexTimedLock = resolve<MutexTimedLock>("pthread_mutex_timedlock");
+  realCondWait = resolve<CondWait>("pthread_cond_wait");
+  realCondTimedWait = resolve<CondTimedWait>("pthread_cond_timedwait");
+  realSemWait = resolve<SemWait>("sem_wait");
+  realRead = resolve<Read>("read");
+  realWrite = resolve<Write>("write");
+  realPoll = resolve<Poll>("poll");
+  realNanoSleep = resolve<NanoSleep>("nanosleep");
+  realClockNanoSleep = resolve<ClockNanoSleep>("clock_nanosleep");
+  realUSleep = resolve<USleep>("usleep");
+  realThrow = resolve<CxaThrow>("__cxa_throw");
+  // backtrace() loads the unwinder on first use, which allocates
+  void *frames[1];
+  backtrace(frames, 1);
+}
+
+template <typename Function>
+Function real(Function &function, const char *name) {
+  if (function == nullptr) {
+    function = resolve<Function>(name);
+  }
+  return function;
+}
+
+} // namespace
+
+ScopedRealtimeContext::ScopedRealtimeContext() { ++realtimeDepth; }
+ScopedRealtimeContext::~ScopedRealtimeContext() { --realtimeDepth; }
+
+ScopedRealtimeExemption::ScopedRealtimeExemption() { ++exemptionDepth; }
+ScopedRealtimeExemption::~ScopedRealtimeExemption() { --exemptionDepth; }
+
+void RealtimeSanitizer::startReporter() {
+  if (reporter.joinable()) {
+    return;
+  }
+  reporterStop = false;
+  reporter = std::thread(runReporter);
+  static bool registered = false;
+  if (!registered) {
+    std::atexit(stopReporter);
+    registered = true;
+  }
+}
+
+void RealtimeSanitizer::stopReporter() {
+  if (!reporter.joinable()) {
+    return;
+  }
+  reporterStop = true;
+  reporter.join();
+  const std::uint64_t dropped = droppedCount.load();
+  if (dropped > 0) {
+    std::fprintf(stderr,
+                 "==realtime sanitizer== %llu violations not shown (report "
+                 "ring full)\n",
+                 static_cast<unsigned long long>(dropped));
+  }
+}
+
+std::uint64_t RealtimeSanitizer::getViolationCount() {
+  return violationCount.load();
+}
+
+} // namespace tinysynth
+
+using tinysynth::RealtimeSanitizer;
+
+// Interceptors. A definition in the executable takes precedence over the C
+// library's, so every call in the process passes through these.
+extern "C" {
+
+void *malloc(size_t size) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::Allocation, "malloc");
+  }
+  return __libc_malloc(size);
+}
+
+void free(void *pointer) {
+  if (pointer != nullptr && tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::Deallocation, "free");
+  }
+  __libc_free(pointer);
+}
+
+void *calloc(size_t count, size_t size) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::Allocation, "calloc");
+  }
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::Allocation, "realloc");
+  }
+  return __libc_realloc(pointer, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::Allocation, "memalign");
+  }
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::Allocation,
+                      "aligned_alloc");
+  }
+  return tinysynth::real(tinysynth::realAlignedAlloc, "aligned_alloc")(
+      alignment, size);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::Allocation,
+                      "posix_memalign");
+  }
+  return tinysynth::real(tinysynth::realPosixMemalign, "posix_memalign")(
+      pointer, alignment, size);
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::MutexLock,
+                      "pthread_mutex_lock");
+  }
+  return tinysynth::real(tinysynth::realMutexLock, "pthread_mutex_lock")(mutex);
+}
+
+int pthread_mutex_timedlock(pthread_mutex_t *mutex, const timespec *deadline) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::MutexLock,
+                      "pthread_mutex_timedlock");
+  }
+  return tinysynth::real(tinysynth::realMutexTimedLock,
+                         "pthread_mutex_timedlock")(mutex, deadline);
+}
+
+int pthread_cond_wait(pthread_cond_t *condition, pthread_mutex_t *mutex) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::BlockingCall,
+                      "pthread_cond_wait");
+  }
+  return tinysynth::real(tinysynth::realCondWait, "pthread_cond_wait")(
+      condition, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t *condition, pthread_mutex_t *mutex,
+                           const timespec *deadline) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::BlockingCall,
+                      "pthread_cond_timedwait");
+  }
+  return tinysynth::real(tinysynth::realCondTimedWait,
+                         "pthread_cond_timedwait")(condition, mutex, deadline);
+}
+
+int sem_wait(sem_t *semaphore) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::BlockingCall, "sem_wait");
+  }
+  return tinysynth::real(tinysynth::realSemWait, "sem_wait")(semaphore);
+}
+
+ssize_t read(int fd, void *buffer, size_t size) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::BlockingCall, "read");
+  }
+  return tinysynth::real(tinysynth::realRead, "read")(fd, buffer, size);
+}
+
+ssize_t write(int fd, const void *buffer, size_t size) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::BlockingCall, "write");
+  }
+  return tinysynth::real(tinysynth::realWrite, "write")(fd, buffer, size);
+}
+
+int poll(pollfd *fds, nfds_t count, int timeout) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::BlockingCall, "poll");
+  }
+  return tinysynth::real(tinysynth::realPoll, "poll")(fds, count, timeout);
+}
+
+int nanosleep(const timespec *duration, timespec *remaining) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::BlockingCall, "nanosleep");
+  }
+  return tinysynth::real(tinysynth::realNanoSleep, "nanosleep")(duration,
+                                                                remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const timespec *duration,
+                    timespec *remaining) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::BlockingCall,
+                      "clock_nanosleep");
+  }
+  return tinysynth::real(tinysynth::realClockNanoSleep, "clock_nanosleep")(
+      clock, flags, duration, remaining);
+}
+
+int usleep(useconds_t microseconds) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::BlockingCall, "usleep");
+  }
+  return tinysynth::real(tinysynth::realUSleep, "usleep")(microseconds);
+}
+
+[[noreturn]] void __cxa_throw(void *thrown, std::type_info *type,
+                              void (*destructor)(void *)) {
+  if (tinysynth::checking()) {
+    tinysynth::record(RealtimeSanitizer::Violation::Throw, "__cxa_throw");
+  }
+  tinysynth::real(tinysynth::realThrow, "__cxa_throw")(thrown, type,
+                                                       destructor);
+  __builtin_unreachable();
+}
+
+} // extern "C"
+
+#endif // TINYSYNTH_RT_SANITIZER
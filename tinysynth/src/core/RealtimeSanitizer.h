@@ -0,0 +1,93 @@
+// RealtimeSanitizer.h
+#pragma once
+
+#include <cstdint>
+
+namespace tinysynth {
+
+// Debug build mode (-DTINYSYNTH_RT_SANITIZER=ON) that catches code which is
+// not realtime safe on the audio threads: heap allocation (aligned too) and
+// release, pthread mutex locks, blocking waits and syscalls (sleeps,
+// semaphores, condition variables, read/write, poll, ...) and C++ throws.
+// Backends open a ScopedRealtimeContext around every call into the
+// processor; an intercepted call inside one is recorded with a
+// backtrace into a lock-free ring and printed by a reporter thread, so the
+// audio thread itself never formats or writes anything. The intercepted
+// call then proceeds, so a run collects every violation instead of dying
+// at the first.
+//
+// Without the option every type here is an empty no-op.
+class RealtimeSanitizer {
+public:
+    enum class Violation : std::uint8_t {
+        Allocation,
+        Deallocation,
+        MutexLock,
+        BlockingCall,
+        Throw,
+    };
+
+    static constexpr bool isEnabled() {
+#ifdef TINYSYNTH_RT_SANITIZER
+        return true;
+#else
+        return false;
+#endif
+    }
+
+#ifdef TINYSYNTH_RT_SANITIZER
+    // Starts the reporter thread; violations before that are kept
+    // (up to the ring size) and printed once it runs
+    static void startReporter();
+    // Prints what is still queued, then stops the reporter
+    static void stopReporter();
+    // Violations recorded so far, including those dropped on a full ring
+    static std::uint64_t getViolationCount();
+#else
+    static void startReporter() {}
+    static void stopReporter() {}
+    static std::uint64_t getViolationCount() { return 0; }
+#endif
+};
+
+#ifdef TINYSYNTH_RT_SANITIZER
+
+// Marks the current thread as realtime for the scope's lifetime; nests
+class ScopedRealtimeContext {
+public:
+    ScopedRealtimeContext();
+    ~ScopedRealtimeContext();
+    ScopedRealtimeContext(const ScopedRealtimeContext&) = delete;
+    ScopedRealtimeContext& operator=(const ScopedRealtimeContext&) = delete;
+};
+
+// Suspends checking inside a realtime context, for paths that are known
+// not to be realtime safe yet and accepted as such
+class ScopedRealtimeExemption {
+public:
+    ScopedRealtimeExemption();
+    ~ScopedRealtimeExemption();
+    ScopedRealtimeExemption(const ScopedRealtimeExemption&) = delete;
+    ScopedRealtimeExemption& operator=(const ScopedRealtimeExemption&) = delete;
+};
+
+#else
+
+class ScopedRealtimeContext {
+public:
+    // User-provided, so an unused scope does not warn
+    ScopedRealtimeContext() {}
+    ScopedRealtimeContext(const ScopedRealtimeContext&) = delete;
+    ScopedRealtimeContext& operator=(const ScopedRealtimeContext&) = delete;
+};
+
+class ScopedRealtimeExemption {
+public:
+    ScopedRealtimeExemption() {}
+    ScopedRealtimeExemption(const ScopedRealtimeExemption&) = delete;
+    ScopedRealtimeExemption& operator=(const ScopedRealtimeExemption&) = delete;
+};
+
+#endif
+
+} // namespace tinysynth
@@ -0,0 +1,347 @@
+// SharedEngineState.cpp
+#include "SharedEngineState.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace tinysynth {
+
+namespace {
+
+using Layout = SharedEngineLayout;
+constexpr std::size_t NAME_WORDS = Layout::NAME_SIZE / 8;
+
+static_assert(std::atomic_ref<std::uint32_t>::is_always_lock_free &&
+                  std::atomic_ref<std::uint64_t>::is_always_lock_free &&
+                  std::atomic_ref<float>::is_always_lock_free,
+              "shared fields must be lock-free to be shared between processes");
+
+template <typename T> T load(const T &field) {
+  return std::atomic_ref<T>(const_cast<T &>(field))
+      .load(std::memory_order_relaxed);
+}
+
+template <typename T> void store(T &field, T value) {
+  std::atomic_ref<T>(field).store(value, std::memory_order_relaxed);
+}
+
+// NUL-padded and truncated to NAME_SIZE - 1 characters
+void packName(const char *name, std::uint64_t (&words)[NAME_WORDS]) {
+  char bytes[Layout::NAME_SIZE] = {};
+  std::memcpy(bytes, name, strnlen(name, Layout::NAME_SIZE - 1));
+  std::memcpy(words, bytes, sizeof(bytes));
+}
+
+// A writer that stays in the same write this long has died in it
+constexpr auto WRITER_TIMEOUT = std::chrono::seconds(1);
+
+// Runs copy() until it saw no write, the reader side of the seqlock. A
+// busy writer only delays the reader; the sequence staying on one odd
+// value is what gives a dead one away.
+template <typename Copy>
+void readConsistent(const std::uint32_t &field, Copy &&copy) {
+  using Clock = std::chrono::steady_clock;
+  std::atomic_ref<std::uint32_t> sequence(const_cast<std::uint32_t &>(field));
+  std::uint32_t stuckAt = 0;
+  Clock::time_point stuckSince;
+  while (true) {
+    const std::uint32_t before = sequence.load(std::memory_order_acquire);
+    if ((before & 1U) == 0) {
+      copy();
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence.load(std::memory_order_relaxed) == before) {
+        return;
+      }
+      continue;
+    }
+    const Clock::time_point now = Clock::now();
+    if (before != stuckAt) {
+      stuckAt = before;
+      stuckSince = now;
+    } else if (now - stuckSince > WRITER_TIMEOUT) {
+      throw std::runtime_error("Shared engine state: the engine stopped while "
+                               "publishing");
+    }
+    // Lets a writer preempted mid-write on this core finish
+    std::this_thread::yield();
+  }
+}
+
+std::runtime_error shmError(const std::string &what, const std::string &name) {
+  return std::runtime_error("Shared engine state " + name + ": " + what +
+                            ": " + std::strerror(errno));
+}
+
+Layout *map(int descriptor, const std::string &name) {
+  void *address = ::mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, descriptor, 0);
+  ::close(descriptor);
+  if (address == MAP_FAILED) {
+    throw shmError("mmap", name);
+  }
+  return static_cast<Layout *>(address);
+}
+
+} // namespace
+
+SharedEngineState::SharedEngineState(std::string name, Layout *layout,
+                                     bool owner)
+    : m_name(std::move(name)), m_layout(layout), m_owner(owner) {}
+
+SharedEngineState::~SharedEngineState() {
+  ::munmap(m_layout, sizeof(Layout));
+  if (m_owner) {
+    ::shm_unlink(m_name.c_str());
+  }
+}
+
+std::unique_ptr<SharedEngineState>
+SharedEngineState::create(const std::string &name, unsigned int sampleRate,
+                          unsigned int numChannels) {
+  // A segment left by an engine that crashed is replaced, not reused
+  ::shm_unlink(name.c_str());
+  const int descriptor =
+      ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (descriptor < 0) {
+    throw shmError("shm_open", name);
+  }
+  if (::ftruncate(descriptor, sizeof(Layout)) != 0) {
+    const auto error = shmError("ftruncate", name);
+    ::close(descriptor);
+    ::shm_unlink(name.c_str());
+    throw error;
+  }
+  Layout *layout = nullptr;
+  try {
+    layout = map(descriptor, name);
+  } catch (const std::runtime_error &) {
+    ::shm_unlink(name.c_str());
+    throw;
+  }
+  // The new segment is zeroed; magic goes last, so a client that opens it
+  // early sees a complete header or none
+  layout->version = Layout::VERSION;
+  layout->sampleRate = sampleRate;
+  layout->numChannels =
+      std::min<unsigned int>(numChannels, Layout::MAX_CHANNELS);
+  std::atomic_ref<std::uint32_t>(layout->magic)
+      .store(Layout::MAGIC, std::memory_order_release);
+  return std::unique_ptr<SharedEngineState>(
+      new SharedEngineState(name, layout, true));
+}
+
+std::unique_ptr<SharedEngineState>
+SharedEngineState::open(const std::string &name) {
+  const int descriptor = ::shm_open(name.c_str(), O_RDWR, 0);
+  if (descriptor < 0) {
+    throw shmError("shm_open", name);
+  }
+  struct stat status {};
+  if (::fstat(descriptor, &status) != 0 ||
+      static_cast<std::size_t>(status.st_size) < sizeof(Layout)) {
+    ::close(descriptor);
+    throw std::runtime_error("Shared engine state " + name +
+                             " is too small for this version");
+  }
+  Layout *layout = map(descriptor, name);
+  if (std::atomic_ref<std::uint32_t>(layout->magic)
+              .load(std::memory_order_acquire) != Layout::MAGIC ||
+      layout->version != Layout::VERSION) {
+    ::munmap(layout, sizeof(Layout));
+    throw std::runtime_error("Shared engine state " + name +
+                             " has another layout version");
+  }
+  return std::unique_ptr<SharedEngineState>(
+      new SharedEngineState(name, layout, false));
+}
+
+void SharedEngineState::setControlBus(unsigned int bus, float value) {
+  if (bus < Layout::NUM_CONTROL_BUSES) {
+    store(m_layout->controlBuses[bus], value);
+  }
+}
+
+float SharedEngineState::getControlBus(unsigned int bus) const {
+  return bus < Layout::NUM_CONTROL_BUSES ? load(m_layout->controlBuses[bus])
+                                         : 0.0F;
+}
+
+SharedEngineSnapshot SharedEngineState::read() const {
+  SharedEngineSnapshot snapshot;
+  snapshot.meters.resize(m_layout->numChannels);
+  std::vector<Layout::Node> nodes;
+  nodes.reserve(Layout::MAX_NODES);
+  readConsistent(m_layout->sequence, [&] {
+    snapshot.frame = load(m_layout->frame);
+    for (std::size_t channel = 0; channel < snapshot.meters.size();
+         ++channel) {
+      snapshot.meters[channel] = {load(m_layout->meters[channel].peak),
+                                  load(m_layout->meters[channel].rms)};
+    }
+    const std::uint32_t numNodes = std::min<std::uint32_t>(
+        load(m_layout->numNodes), Layout::MAX_NODES);
+    nodes.resize(numNodes);
+    for (std::uint32_t slot = 0; slot < numNodes; ++slot) {
+      const Layout::Node &node = m_layout->nodes[slot];
+      for (std::size_t word = 0; word < NAME_WORDS; ++word) {
+        nodes[slot].name[word] = load(node.name[word]);
+      }
+      nodes[slot].flags = load(node.flags);
+    }
+  });
+
+  for (const Layout::Node &node : nodes) {
+    if ((node.flags & Layout::NODE_ACTIVE) == 0) {
+      continue;
+    }
+    char name[Layout::NAME_SIZE];
+    std::memcpy(name, node.name, sizeof(name));
+    name[Layout::NAME_SIZE - 1] = '\0';
+    snapshot.nodes.push_back({name, node.flags});
+  }
+  return snapshot;
+}
+
+std::uint64_t
+SharedEngineState::readMeters(std::span<Layout::Meter> meters) const {
+  const std::size_t count =
+      std::min<std::size_t>(meters.size(), m_layout->numChannels);
+  std::uint64_t frame = 0;
+  readConsistent(m_layout->sequence, [&] {
+    frame = load(m_layout->frame);
+    for (std::size_t channel = 0; channel < count; ++channel) {
+      meters[channel] = {load(m_layout->meters[channel].peak),
+                         load(m_layout->meters[channel].rms)};
+    }
+  });
+  return frame;
+}
+
+void SharedEngineState::beginWrite() {
+  // Odd while the fields change
+  std::atomic_ref<std::uint32_t> sequence(m_layout->sequence);
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SharedEngineState::endWrite() {
+  std::atomic_ref<std::uint32_t> sequence(m_layout->sequence);
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+}
+
+int SharedEngineState::findNode(const char *name) const {
+  std::uint64_t words[NAME_WORDS];
+  packName(name, words);
+  // The writer reads its own fields, so plain loads would do; load() keeps
+  // every access to shared memory atomic
+  const std::uint32_t numNodes = load(m_layout->numNodes);
+  for (std::uint32_t slot = 0; slot < numNodes; ++slot) {
+    const Layout::Node &node = m_layout->nodes[slot];
+    if ((load(node.flags) & Layout::NODE_ACTIVE) != 0 &&
+        std::equal(std::begin(words), std::end(words), std::begin(node.name),
+                   [](std::uint64_t a, const std::uint64_t &b) {
+                     return a == load(b);
+                   })) {
+      return static_cast<int>(slot);
+    }
+  }
+  return -1;
+}
+
+void SharedEngineState::addNode(const char *name) {
+  if (findNode(name) >= 0) {
+    return;
+  }
+  // The first free slot, so numNodes only grows past the live nodes
+  const std::uint32_t numNodes = load(m_layout->numNodes);
+  std::uint32_t slot = 0;
+  while (slot < numNodes &&
+         (load(m_layout->nodes[slot].flags) & Layout::NODE_ACTIVE) != 0) {
+    ++slot;
+  }
+  if (slot == Layout::MAX_NODES) {
+    return; // the table is full; the node runs unlisted
+  }
+  std::uint64_t words[NAME_WORDS];
+  packName(name, words);
+  beginWrite();
+  Layout::Node &node = m_layout->nodes[slot];
+  for (std::size_t word = 0; word < NAME_WORDS; ++word) {
+    store(node.name[word], words[word]);
+  }
+  store(node.flags, Layout::NODE_ACTIVE);
+  if (slot == numNodes) {
+    store(m_layout->numNodes, numNodes + 1);
+  }
+  endWrite();
+}
+
+void SharedEngineState::removeNode(const char *name) {
+  const int slot = findNode(name);
+  if (slot < 0) {
+    return;
+  }
+  beginWrite();
+  store(m_layout->nodes[slot].flags, std::uint32_t{0});
+  // Trailing free slots leave the table
+  std::uint32_t numNodes = load(m_layout->numNodes);
+  while (numNodes > 0 &&
+         load(m_layout->nodes[numNodes - 1].flags) == 0) {
+    --numNodes;
+  }
+  store(m_layout->numNodes, numNodes);
+  endWrite();
+}
+
+void SharedEngineState::setNodeRouted(const char *name, bool routed) {
+  const int slot = findNode(name);
+  if (slot < 0) {
+    return;
+  }
+  beginWrite();
+  store(m_layout->nodes[slot].flags,
+        Layout::NODE_ACTIVE | (routed ? Layout::NODE_ROUTED : 0U));
+  endWrite();
+}
+
+void SharedEngineState::publish(std::uint64_t frame,
+                                const float *const *outputs,
+                                unsigned int numFrames) {
+  // Measured before the write starts, so readers retry for as short as
+  // possible
+  std::array<Layout::Meter, Layout::MAX_CHANNELS> meters{};
+  const std::uint32_t numChannels = m_layout->numChannels;
+  for (std::uint32_t channel = 0; channel < numChannels; ++channel) {
+    float peak = 0.0F;
+    float sum = 0.0F;
+    for (unsigned int i = 0; i < numFrames; ++i) {
+      const float sample = outputs[channel][i];
+      peak = std::max(peak, std::fabs(sample));
+      sum += sample * sample;
+    }
+    meters[channel] = {
+        peak, numFrames > 0 ? std::sqrt(sum / static_cast<float>(numFrames))
+                            : 0.0F};
+  }
+  beginWrite();
+  store(m_layout->frame, frame);
+  for (std::uint32_t channel = 0; channel < numChannels; ++channel) {
+    store(m_layout->meters[channel].peak, meters[channel].peak);
+    store(m_layout->meters[channel].rms, meters[channel].rms);
+  }
+  endWrite();
+}
+
+} // namespace tinysynth
@@ -0,0 +1,132 @@
+// SharedEngineState.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// Layout of the shared-memory segment. Plain fixed-size fields at fixed
+// offsets, so any process and language can map and read it; C++ accesses
+// every field atomically through std::atomic_ref.
+//
+// The engine is the only writer of everything from `sequence` to the node
+// table, published with a seqlock: `sequence` is odd while the engine
+// writes, and a reader's copy is consistent when it read the same even
+// value before and after it. Control buses belong to clients: each is a
+// single float that any process may store at any time, and the engine
+// loads at every block start.
+struct SharedEngineLayout {
+    static constexpr std::uint32_t MAGIC = 0x54535348; // "TSSH"
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::size_t NUM_CONTROL_BUSES = 4096;
+    static constexpr std::size_t MAX_CHANNELS = 64;
+    static constexpr std::size_t MAX_NODES = 1024;
+    // Graph module names, including the terminator
+    static constexpr std::size_t NAME_SIZE = 32;
+
+    // Node flags; a free slot has none
+    static constexpr std::uint32_t NODE_ACTIVE = 1;
+    static constexpr std::uint32_t NODE_ROUTED = 2; // plays to an output channel
+
+    // Of the last block on an output channel
+    struct Meter {
+        float peak;
+        float rms;
+    };
+
+    struct Node {
+        // NUL-padded name, in words so it is copied atomically
+        std::uint64_t name[NAME_SIZE / 8];
+        std::uint32_t flags;
+        std::uint32_t reserved;
+    };
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t sampleRate;
+    std::uint32_t numChannels;
+    std::uint32_t sequence;
+    // Node slots in use are below this
+    std::uint32_t numNodes;
+    // Frames rendered when the meters were taken
+    std::uint64_t frame;
+    Meter meters[MAX_CHANNELS];
+    Node nodes[MAX_NODES];
+    // Client-written, on a cache line of their own
+    alignas(64) float controlBuses[NUM_CONTROL_BUSES];
+};
+
+struct SharedNodeStatus {
+    std::string name;
+    std::uint32_t flags = 0;
+};
+
+struct SharedEngineSnapshot {
+    std::uint64_t frame = 0;
+    std::vector<SharedEngineLayout::Meter> meters;
+    std::vector<SharedNodeStatus> nodes; // active ones only
+};
+
+// Engine state in a POSIX shared-memory segment, so external processes
+// (Klarenz, monitors) read meters and node status and write control buses
+// at memory speed, with no messages and nothing for the engine to wait on.
+// The engine creates the segment and publishes into it from the audio
+// thread (see GraphProcessor::setSharedState); clients open it by name.
+class SharedEngineState {
+public:
+    // Engine side: creates the segment `name` ("/tinysynth"), replacing a
+    // stale one, and unlinks it on destruction. Throws std::runtime_error.
+    static std::unique_ptr<SharedEngineState> create(const std::string& name,
+                                                     unsigned int sampleRate,
+                                                     unsigned int numChannels);
+    // Client side: maps an engine's segment; throws std::runtime_error when
+    // there is none or its layout is another version
+    static std::unique_ptr<SharedEngineState> open(const std::string& name);
+
+    SharedEngineState(const SharedEngineState&) = delete;
+    SharedEngineState& operator=(const SharedEngineState&) = delete;
+    ~SharedEngineState();
+
+    // Any process; out-of-range buses are ignored and read 0
+    void setControlBus(unsigned int bus, float value);
+    [[nodiscard]] float getControlBus(unsigned int bus) const;
+
+    // A consistent copy of the engine's state, retried while the engine
+    // writes. Allocates; readMeters does not. Both throw
+    // std::runtime_error if the engine died in the middle of a write.
+    [[nodiscard]] SharedEngineSnapshot read() const;
+    // Copies up to meters.size() channel meters and returns the frame
+    std::uint64_t readMeters(std::span<SharedEngineLayout::Meter> meters) const;
+
+    [[nodiscard]] unsigned int getSampleRate() const { return m_layout->sampleRate; }
+    [[nodiscard]] unsigned int getNumChannels() const { return m_layout->numChannels; }
+    [[nodiscard]] const std::string& getName() const { return m_name; }
+
+    // Engine side, with the graph locked, so there is a single writer: the
+    // audio thread, or a control thread while it holds lockGraph(). None of
+    // them allocate or block; names longer than NAME_SIZE - 1 are truncated.
+    void addNode(const char* name);
+    void removeNode(const char* name);
+    void setNodeRouted(const char* name, bool routed);
+    // Meters of the block just rendered, and the frame after it
+    void publish(std::uint64_t frame, const float* const* outputs, unsigned int numFrames);
+
+private:
+    SharedEngineState(std::string name, SharedEngineLayout* layout, bool owner);
+
+    void beginWrite();
+    void endWrite();
+    // Slot of a node name, or -1
+    [[nodiscard]] int findNode(const char* name) const;
+
+    std::string m_name;
+    SharedEngineLayout* m_layout;
+    bool m_owner;
+};
+
+} // namespace tinysynth
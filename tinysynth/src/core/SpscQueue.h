@@ -0,0 +1,97 @@
+// SpscQueue.h
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace tinysynth {
+
+// Bounded lock-free ring for exactly one producer and one consumer thread.
+// Records are copied in and out, so neither side ever allocates or blocks.
+// The two indices live on separate cache lines, and each side keeps a
+// cached copy of the other's index so it only touches the shared line when
+// the ring looks full (producer) or empty (consumer).
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscQueue capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "SpscQueue records are copied raw");
+
+public:
+    // Producer side; false when the ring is full
+    bool tryPush(const T& value) {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache == Capacity) {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache == Capacity) {
+                return false;
+            }
+        }
+        m_slots[tail & MASK] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false when the ring is empty
+    bool tryPop(T& value) {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache) {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache) {
+                return false;
+            }
+        }
+        value = m_slots[head & MASK];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: the oldest record without removing it, nullptr when
+    // the ring is empty. Valid until the next pop.
+    const T* front() {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache) {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache) {
+                return nullptr;
+            }
+        }
+        return &m_slots[head & MASK];
+    }
+
+    // Consumer side: drops the record front() returned
+    void pop() {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Producer side: whether the next tryPush would fail
+    [[nodiscard]] bool full() const {
+        return m_tail.load(std::memory_order_relaxed) -
+                   m_head.load(std::memory_order_acquire) ==
+               Capacity;
+    }
+
+    // Producer side: how many pushes in a row will succeed, at least
+    [[nodiscard]] std::size_t space() const {
+        return Capacity - (m_tail.load(std::memory_order_relaxed) -
+                           m_head.load(std::memory_order_acquire));
+    }
+
+    static constexpr std::size_t capacity() { return Capacity; }
+
+private:
+    static constexpr std::size_t MASK = Capacity - 1;
+    static constexpr std::size_t CACHE_LINE = 64;
+
+    // Consumer-owned line
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_head{0};
+    std::size_t m_tailCache = 0;
+    // Producer-owned line
+    alignas(CACHE_LINE) std::atomic<std::size_t> m_tail{0};
+    std::size_t m_headCache = 0;
+    alignas(CACHE_LINE) std::array<T, Capacity> m_slots{};
+};
+
+} // namespace tinysynth
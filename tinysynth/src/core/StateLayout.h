@@ -0,0 +1,86 @@
+// StateLayout.h
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+struct StateField {
+    std::string owner; // UGen instance name, empty for synth-level controls
+    std::string name;
+    std::size_t offset; // in bytes from the start of the state block
+    float initialValue;
+};
+
+// Layout of the per-node state block a compiled SynthDef reads and writes.
+// Every field is a float; the block is cache-line aligned so nodes never
+// share a line.
+class StateLayout {
+public:
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    std::size_t addField(const std::string& owner, const std::string& name,
+                         float initialValue) {
+        const std::size_t offset = m_image.size() * sizeof(float);
+        m_fields.push_back({owner, name, offset, initialValue});
+        m_image.push_back(initialValue);
+        return offset;
+    }
+
+    [[nodiscard]] std::optional<std::size_t> offsetOf(const std::string& owner,
+                                                      const std::string& name) const {
+        for (const auto& field : m_fields) {
+            if (field.owner == owner && field.name == name) {
+                return field.offset;
+            }
+        }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] std::optional<std::size_t> controlOffset(const std::string& name) const {
+        return offsetOf("", name);
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        const std::size_t bytes = m_image.size() * sizeof(float);
+        const std::size_t rounded = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        return std::max(ALIGNMENT, rounded);
+    }
+
+    [[nodiscard]] std::size_t alignment() const { return ALIGNMENT; }
+
+    [[nodiscard]] const std::vector<StateField>& fields() const { return m_fields; }
+
+    // Writes the initial state into a block of at least size() bytes
+    void initialize(void* block) const {
+        const std::size_t bytes = m_image.size() * sizeof(float);
+        std::memcpy(block, m_image.data(), bytes);
+        std::memset(static_cast<char*>(block) + bytes, 0, size() - bytes);
+    }
+
+    // Size of a SoA block holding `lanes` nodes (see compileBatched)
+    [[nodiscard]] std::size_t batchSize(unsigned int lanes) const {
+        const std::size_t bytes = m_image.size() * sizeof(float) * lanes;
+        const std::size_t rounded = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        return std::max(ALIGNMENT, rounded);
+    }
+
+    // Resets one lane of a SoA block to the initial state
+    void initializeLane(void* block, unsigned int lanes, unsigned int lane) const {
+        auto* values = static_cast<float*>(block);
+        for (std::size_t field = 0; field < m_image.size(); ++field) {
+            values[field * lanes + lane] = m_image[field];
+        }
+    }
+
+private:
+    std::vector<StateField> m_fields;
+    std::vector<float> m_image;
+};
+
+} // namespace tinysynth
@@ -0,0 +1,76 @@
+// SynthDef.cpp
+#include "SynthDef.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace tinysynth {
+
+void SynthDef::addUGen(const UGenInstance &ugen) { m_ugens.push_back(ugen); }
+
+void SynthDef::addConnection(const Connection &connection) {
+  m_connections.push_back(connection);
+}
+
+void SynthDef::addControl(const ControlSpec &control) {
+  m_controls.push_back(control);
+}
+
+void SynthDef::setParameter(const std::string &ugenName,
+                            const std::string &paramName, float value) {
+  auto it = std::find_if(m_ugens.begin(), m_ugens.end(),
+                         [&](const UGenInstance &ugen) {
+                           return ugen.instanceName == ugenName;
+                         });
+  if (it == m_ugens.end()) {
+    throw std::runtime_error("UGen '" + ugenName + "' does not exist.");
+  }
+  it->parameters[paramName] = value;
+}
+
+void SynthDef::reserve(std::size_t numUGens, std::size_t numConnections) {
+  m_ugens.reserve(numUGens);
+  m_connections.reserve(numConnections);
+}
+
+std::vector<std::size_t> SynthDef::topologicalOrder() const {
+  std::unordered_map<std::string, std::size_t> indices;
+  for (std::size_t i = 0; i < m_ugens.size(); ++i) {
+    indices[m_ugens[i].instanceName] = i;
+  }
+
+  std::vector<std::vector<std::size_t>> consumers(m_ugens.size());
+  std::vector<std::size_t> pending(m_ugens.size(), 0);
+  for (const auto &conn : m_connections) {
+    auto from = indices.find(conn.fromUGen);
+    auto to = indices.find(conn.toUGen);
+    if (from == indices.end() || to == indices.end()) {
+      throw std::runtime_error("Connection references unknown UGen: " +
+                               conn.fromUGen + " -> " + conn.toUGen);
+    }
+    consumers[from->second].push_back(to->second);
+    ++pending[to->second];
+  }
+
+  // Kahn's algorithm; ready UGens keep their declaration order
+  std::vector<std::size_t> order;
+  order.reserve(m_ugens.size());
+  for (std::size_t i = 0; i < m_ugens.size(); ++i) {
+    if (pending[i] == 0) {
+      order.push_back(i);
+    }
+  }
+  for (std::size_t next = 0; next < order.size(); ++next) {
+    for (std::size_t consumer : consumers[order[next]]) {
+      if (--pending[consumer] == 0) {
+        order.push_back(consumer);
+      }
+    }
+  }
+  if (order.size() != m_ugens.size()) {
+    throw std::runtime_error("SynthDef '" + m_name + "' contains a cycle");
+  }
+  return order;
+}
+
+} // namespace tinysynth
@@ -20,18 +20,36 @@ struct Connection {
     unsigned int inputIndex;
 };
 
+// Named synth-level control (the argument list of an scsynth SynthDef)
+struct ControlSpec {
+    std::string name;
+    float defaultValue;
+};
+
 class SynthDef {
 public:
     void addUGen(const UGenInstance& ugen);
     void addConnection(const Connection& connection);
+    void addControl(const ControlSpec& control);
     void setParameter(const std::string& ugenName, const std::string& paramName, float value);
-    
+    void reserve(std::size_t numUGens, std::size_t numConnections);
+
+    // Indices into getUGens() such that every UGen follows its inputs.
+    // Throws if the connections form a cycle.
+    [[nodiscard]] std::vector<std::size_t> topologicalOrder() const;
+
+    void setName(const std::string& name) { m_name = name; }
+    const std::string& getName() const { return m_name; }
+
     const std::vector<UGenInstance>& getUGens() const { return m_ugens; }
     const std::vector<Connection>& getConnections() const { return m_connections; }
+    const std::vector<ControlSpec>& getControls() const { return m_controls; }
 
 private:
+    std::string m_name;
     std::vector<UGenInstance> m_ugens;
     std::vector<Connection> m_connections;
+    std::vector<ControlSpec> m_controls;
 };
 
-} // namespace tinysynth
\ No newline at end of file
+} // namespace tinysynth
@@ -0,0 +1,454 @@
+// SynthDefCodeGenerator.cpp
+#include "SynthDefCodeGenerator.h"
+#include "SynthDefCompiler.h"
+#include "UGenRegistry.h"
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace tinysynth {
+
+namespace {
+
+float parameterOr(const UGenInstance &ugen, const std::string &name,
+                  float fallback) {
+  auto it = ugen.parameters.find(name);
+  return it != ugen.parameters.end() ? it->second : fallback;
+}
+
+bool isOscillator(const std::string &type) {
+  return type == "SineOsc" || type == "SawOsc" || type == "TriangleOsc" ||
+         type == "SquareOsc" || type == "PulseOsc";
+}
+
+std::string sanitize(const std::string &name) {
+  std::string result = name;
+  for (char &c : result) {
+    const bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                       (c >= '0' && c <= '9') || c == '_';
+    if (!valid) {
+      c = '_';
+    }
+  }
+  return result;
+}
+
+// Float literal that reads back as exactly `value`
+std::string literal(float value) {
+  if (std::isnan(value)) {
+    return "std::numeric_limits<float>::quiet_NaN()";
+  }
+  if (std::isinf(value)) {
+    return value > 0 ? "std::numeric_limits<float>::infinity()"
+                     : "-std::numeric_limits<float>::infinity()";
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+  std::string text = buffer;
+  if (text.find_first_of(".e") == std::string::npos) {
+    text += ".0";
+  }
+  return text + "F";
+}
+
+std::string quoted(const std::string &text) {
+  std::string result = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+    }
+    if (static_cast<unsigned char>(c) < 0x20) {
+      char escape[8];
+      std::snprintf(escape, sizeof(escape), "\\%03o", c);
+      result += escape;
+    } else {
+      result += c;
+    }
+  }
+  return result + "\"";
+}
+
+// Emits one SynthDef. Mirrors SynthDefCompiler::compileUGen statement for
+// statement, so AOT and JIT builds round every sample the same way.
+class Emitter {
+public:
+  Emitter(const SynthDef &synthDef, const StateLayout &layout)
+      : m_synthDef(synthDef), m_layout(layout),
+        m_registry(UGenRegistry::builtin()) {
+    const auto &ugens = synthDef.getUGens();
+    for (std::size_t i = 0; i < ugens.size(); ++i) {
+      m_indices[ugens[i].instanceName] = i;
+    }
+    for (const auto &conn : synthDef.getConnections()) {
+      m_wires[conn.toUGen][conn.inputIndex] = {conn.fromUGen, conn.outputIndex};
+      m_read.insert({conn.fromUGen, conn.outputIndex});
+    }
+  }
+
+  bool usesKernels() const { return m_usesKernels; }
+
+  void emit(std::ostream &out) {
+    const auto &ugens = m_synthDef.getUGens();
+    for (std::size_t i : m_synthDef.topologicalOrder()) {
+      emitUGen(ugens[i], i);
+    }
+
+    const std::string name = sanitize(m_synthDef.getName());
+    out << "namespace synthdef_" << name << " {\n\n";
+    emitState(out);
+    out << "void process(void *statePointer,\n"
+        << "             [[maybe_unused]] const float *const *inputs,\n"
+        << "             [[maybe_unused]] float *const *outputs,\n"
+        << "             std::int32_t numFrames,\n"
+        << "             [[maybe_unused]] float sampleRate) {\n"
+        << "  State &state = *static_cast<State *>(statePointer);\n"
+        << m_prologue.str() << "  for (std::int32_t i = 0; i < numFrames; ++i) {\n"
+        << m_body.str() << "  }\n"
+        << m_epilogue.str() << "}\n\n"
+        << "void initialize(void *statePointer) { new (statePointer) State(); }\n\n";
+    emitDescriptor(out);
+    out << "} // namespace synthdef_" << name << "\n\n";
+  }
+
+private:
+  const SynthDef &m_synthDef;
+  const StateLayout &m_layout;
+  const UGenRegistry &m_registry;
+  std::unordered_map<std::string, std::size_t> m_indices;
+  std::unordered_map<std::string,
+                     std::map<unsigned int, std::pair<std::string, unsigned int>>>
+      m_wires;
+  std::ostringstream m_prologue;
+  std::ostringstream m_body;
+  std::ostringstream m_epilogue;
+  // Outputs some wire reads; the others get no variable, so the generated
+  // code builds warning-free
+  std::set<std::pair<std::string, unsigned int>> m_read;
+  std::set<unsigned int> m_inputBuffers;
+  std::set<unsigned int> m_inputPointers;
+  std::set<unsigned int> m_outputBuffers;
+  bool m_usesKernels = false;
+
+  // State members: controls are c<k>, UGen fields u<index>_<field>, and
+  // kernel state is one array u<index> so kernels can index it
+  std::string member(const StateField &field) const {
+    if (field.owner.empty()) {
+      return "c" + std::to_string(controlIndex(field.name));
+    }
+    const std::size_t index = m_indices.at(field.owner);
+    if (isKernelState(field)) {
+      return "u" + std::to_string(index);
+    }
+    return "u" + std::to_string(index) + "_" + sanitize(field.name);
+  }
+
+  bool isKernelState(const StateField &field) const {
+    if (field.owner.empty()) {
+      return false;
+    }
+    const auto &ugen = m_synthDef.getUGens()[m_indices.at(field.owner)];
+    const UGenSpec *spec = m_registry.find(ugen.ugenType);
+    return spec != nullptr && !spec->kernel.empty();
+  }
+
+  std::size_t controlIndex(const std::string &name) const {
+    const auto &controls = m_synthDef.getControls();
+    for (std::size_t k = 0; k < controls.size(); ++k) {
+      if (controls[k].name == name) {
+        return k;
+      }
+    }
+    throw std::runtime_error("Unknown control: " + name);
+  }
+
+  bool isRead(const UGenInstance &ugen, unsigned int output) const {
+    return m_read.count({ugen.instanceName, output}) != 0;
+  }
+
+  static std::string value(std::size_t index, unsigned int output) {
+    return "v" + std::to_string(index) + "_" + std::to_string(output);
+  }
+
+  void emitState(std::ostream &out) const {
+    out << "struct alignas(" << m_layout.alignment() << ") State {\n";
+    std::string previous;
+    for (const auto &field : m_layout.fields()) {
+      const std::string name = member(field);
+      if (name == previous) {
+        continue;
+      }
+      previous = name;
+      const std::string comment =
+          field.owner.empty() ? field.name : field.owner + "." + field.name;
+      if (isKernelState(field)) {
+        std::vector<const StateField *> slots;
+        for (const auto &other : m_layout.fields()) {
+          if (other.owner == field.owner) {
+            slots.push_back(&other);
+          }
+        }
+        out << "  float " << name << "[" << slots.size() << "] = {";
+        for (std::size_t k = 0; k < slots.size(); ++k) {
+          out << (k == 0 ? "" : ", ") << literal(slots[k]->initialValue);
+        }
+        out << "}; // " << field.owner << "\n";
+      } else {
+        out << "  float " << name << " = " << literal(field.initialValue)
+            << "; // " << comment << "\n";
+      }
+    }
+    out << "};\n";
+    out << "static_assert(sizeof(State) == " << m_layout.size() << ");\n";
+    previous.clear();
+    for (const auto &field : m_layout.fields()) {
+      const std::string name = member(field);
+      if (name != previous) {
+        out << "static_assert(offsetof(State, " << name << ") == " << field.offset
+            << ");\n";
+        previous = name;
+      }
+    }
+    out << "\n";
+  }
+
+  void emitDescriptor(std::ostream &out) const {
+    const auto &fields = m_layout.fields();
+    if (!fields.empty()) {
+      out << "const TinySynthAOTField FIELDS[] = {\n";
+      for (const auto &field : fields) {
+        out << "    {" << quoted(field.owner) << ", " << quoted(field.name) << ", "
+            << field.offset << ", " << literal(field.initialValue) << "},\n";
+      }
+      out << "};\n\n";
+    }
+    out << "const TinySynthAOTSynthDef SYNTHDEF = {\n"
+        << "    TINYSYNTH_AOT_ABI_VERSION, " << quoted(m_synthDef.getName()) << ",\n"
+        << "    sizeof(State), alignof(State), " << fields.size() << ", "
+        << (fields.empty() ? "nullptr" : "FIELDS") << ",\n"
+        << "    &initialize, &process, "
+        << (m_inputBuffers.empty() ? 0 : *m_inputBuffers.rbegin() + 1) << ", "
+        << (m_outputBuffers.empty() ? 0 : *m_outputBuffers.rbegin() + 1)
+        << "};\n\n";
+  }
+
+  std::string input(const UGenInstance &ugen, const UGenSpec &spec,
+                    unsigned int index) const {
+    const std::string name = index < spec.inputNames.size()
+                                 ? spec.inputNames[index]
+                                 : "in" + std::to_string(index);
+    const float parameter = parameterOr(ugen, name, spec.inputDefault(index));
+
+    auto ugenWires = m_wires.find(ugen.instanceName);
+    if (ugenWires == m_wires.end()) {
+      return literal(parameter);
+    }
+    auto wire = ugenWires->second.find(index);
+    if (wire == ugenWires->second.end()) {
+      return literal(parameter);
+    }
+    const auto &[fromUGen, outputIndex] = wire->second;
+    const std::string signal = value(m_indices.at(fromUGen), outputIndex);
+
+    switch (spec.inputMode(index)) {
+    case InputMode::Add:
+      return parameter == 0.0F ? signal
+                               : "(" + literal(parameter) + " + " + signal + ")";
+    case InputMode::Multiply:
+      return parameter == 1.0F ? signal
+                               : "(" + literal(parameter) + " * " + signal + ")";
+    case InputMode::Replace:
+      break;
+    }
+    return signal;
+  }
+
+  void emitUGen(const UGenInstance &ugen, std::size_t index) {
+    const std::string &type = ugen.ugenType;
+    const UGenSpec *spec = m_registry.find(type);
+    if (spec == nullptr) {
+      throw std::runtime_error("Unknown UGen type: " + type);
+    }
+    auto in = [&](unsigned int i) { return input(ugen, *spec, i); };
+    const std::string out = value(index, 0);
+    m_body << "    // " << ugen.instanceName << " (" << type << ")\n";
+
+    if (type == "Control") {
+      const auto first = static_cast<std::size_t>(parameterOr(ugen, "index", 0));
+      const auto channels =
+          static_cast<std::size_t>(parameterOr(ugen, "numChannels", 1));
+      for (std::size_t k = 0; k < channels; ++k) {
+        const auto &controls = m_synthDef.getControls();
+        if (first + k >= controls.size()) {
+          throw std::runtime_error("Control index out of range in " +
+                                   ugen.instanceName);
+        }
+        // Controls are block-rate: read once before the loop
+        if (isRead(ugen, static_cast<unsigned int>(k))) {
+          m_prologue << "  const float " << value(index, k) << " = state.c"
+                     << first + k << ";\n";
+        }
+      }
+    } else if (type == "In") {
+      const unsigned int bus = SynthDefCompiler::busParameter(ugen, "bus", 0);
+      const unsigned int channels =
+          SynthDefCompiler::busParameter(ugen, "numChannels", 1);
+      SynthDefCompiler::checkBusRange(ugen, bus, channels);
+      for (unsigned int k = 0; k < channels; ++k) {
+        // Counted even when unread: the JIT reports the same buses
+        m_inputBuffers.insert(bus + k);
+        if (!isRead(ugen, k)) {
+          continue;
+        }
+        if (m_inputPointers.insert(bus + k).second) {
+          m_prologue << "  const float *const in" << bus + k << " = inputs["
+                     << bus + k << "];\n";
+        }
+        m_body << "    const float " << value(index, k) << " = in" << bus + k
+               << "[i];\n";
+      }
+    } else if (type == "Out" || type == "ReplaceOut") {
+      const unsigned int bus = SynthDefCompiler::busParameter(ugen, "bus", 0);
+      unsigned int channels =
+          SynthDefCompiler::busParameter(ugen, "numChannels", 0);
+      auto ugenWires = m_wires.find(ugen.instanceName);
+      if (ugenWires != m_wires.end() && !ugenWires->second.empty()) {
+        channels = std::max(channels, ugenWires->second.rbegin()->first + 1);
+      }
+      SynthDefCompiler::checkBusRange(ugen, bus, channels);
+      for (unsigned int k = 0; k < channels; ++k) {
+        if (m_outputBuffers.insert(bus + k).second) {
+          m_prologue << "  float *const out" << bus + k << " = outputs["
+                     << bus + k << "];\n";
+        }
+        m_body << "    out" << bus + k << "[i] " << (type == "Out" ? "+=" : "=")
+               << " " << in(k) << ";\n";
+      }
+    } else if (isOscillator(type)) {
+      const std::string phase = "p" + std::to_string(index);
+      const std::string field = "state.u" + std::to_string(index) + "_phase";
+      m_prologue << "  float " << phase << " = " << field << ";\n";
+      m_epilogue << "  " << field << " = " << phase << ";\n";
+
+      std::string waveform;
+      if (type == "SineOsc") {
+        waveform = "std::sin(" + phase + ")";
+      } else if (type == "SawOsc") {
+        waveform = "(" + phase + " * OSC_ONE_OVER_PI - 1.0F)";
+      } else if (type == "TriangleOsc") {
+        waveform = "(" + phase + " < OSC_PI ? " + phase +
+                   " * OSC_TWO_OVER_PI - 1.0F : 3.0F - " + phase +
+                   " * OSC_TWO_OVER_PI)";
+      } else {
+        waveform = "(" + phase + " < OSC_PI ? 1.0F : -1.0F)";
+      }
+      if (isRead(ugen, 0)) {
+        m_body << "    const float " << out << " = " << in(1) << " * "
+               << waveform << ";\n";
+      }
+      m_body << "    " << phase << " += (" << in(0)
+             << " * OSC_TWO_PI) / sampleRate;\n"
+             << "    " << phase << " = " << phase << " >= OSC_TWO_PI ? " << phase
+             << " - OSC_TWO_PI : " << phase << ";\n";
+    } else if (spec->pure && !isRead(ugen, 0)) {
+      // Nothing to compute
+    } else if (type == "Add" || type == "Sub" || type == "Mul" ||
+               type == "Div") {
+      const char op = type == "Add"   ? '+'
+                      : type == "Sub" ? '-'
+                      : type == "Mul" ? '*'
+                                      : '/';
+      m_body << "    const float " << out << " = " << in(0) << " " << op << " "
+             << in(1) << ";\n";
+    } else if (type == "MulAdd") {
+      m_body << "    const float " << out << " = " << in(0) << " * " << in(1)
+             << " + " << in(2) << ";\n";
+    } else if (!spec->kernel.empty()) {
+      m_usesKernels = true;
+      std::string args = "nullptr";
+      if (!spec->inputNames.empty()) {
+        args = "a" + std::to_string(index);
+        m_body << "    const float " << args << "[] = {";
+        for (unsigned int i = 0; i < spec->inputNames.size(); ++i) {
+          m_body << (i == 0 ? "" : ", ") << in(i);
+        }
+        m_body << "};\n";
+      }
+      const std::string stateArray =
+          spec->kernelState.empty() ? "nullptr"
+                                    : "state.u" + std::to_string(index);
+      // Called for its state even when nothing reads the sample
+      m_body << "    "
+             << (isRead(ugen, 0) ? "const float " + out + " = " : "")
+             << spec->kernel << "(" << stateArray << ", 1, " << args
+             << ", sampleRate);\n";
+    } else {
+      throw std::runtime_error("No code generator for UGen type: " + type);
+    }
+  }
+};
+
+} // namespace
+
+std::string SynthDefCodeGenerator::symbolName(const std::string &synthDefName) {
+  return "tinysynth_synthdef_" + sanitize(synthDefName);
+}
+
+std::string SynthDefCodeGenerator::generate(const SynthDef &synthDef) const {
+  return generate(std::vector<SynthDef>{synthDef});
+}
+
+std::string
+SynthDefCodeGenerator::generate(const std::vector<SynthDef> &synthDefs) const {
+  std::ostringstream defs;
+  std::ostringstream exports;
+  bool usesKernels = false;
+  std::set<std::string> symbols;
+  for (const auto &unoptimized : synthDefs) {
+    // Same graph the JIT would compile
+    const SynthDef synthDef = m_optimizer.optimize(unoptimized);
+    const std::string symbol = symbolName(synthDef.getName());
+    if (!symbols.insert(symbol).second) {
+      throw std::runtime_error("SynthDef names collide in symbol " + symbol);
+    }
+    const StateLayout layout = SynthDefCompiler::buildStateLayout(synthDef);
+    Emitter emitter(synthDef, layout);
+    emitter.emit(defs);
+    usesKernels = usesKernels || emitter.usesKernels();
+    exports << "extern \"C\" TINYSYNTH_AOT_EXPORT const TinySynthAOTSynthDef *\n"
+            << symbol << "(void) {\n"
+            << "  return &synthdef_" << sanitize(synthDef.getName())
+            << "::SYNTHDEF;\n}\n\n";
+  }
+
+  std::ostringstream out;
+  out << "// Generated by tinysynth's SynthDefCodeGenerator. Do not edit.\n"
+      << "#include \"core/TinySynthAOT.h\"\n"
+      << "#include <cmath>\n"
+      << "#include <cstddef>\n"
+      << "#include <cstdint>\n"
+      << "#include <limits>\n"
+      << "#include <new>\n";
+  if (usesKernels) {
+    out << "\n#define TINYSYNTH_KERNEL static inline\n"
+        << "#include \"kernels/UGenKernels.cpp\"\n";
+  }
+  out << "\nnamespace {\n\n"
+      << "// Oscillator constants, rounded to float exactly as the JIT does\n"
+      << "[[maybe_unused]] constexpr float OSC_PI =\n"
+         "    static_cast<float>(3.14159265358979323846);\n"
+      << "[[maybe_unused]] constexpr float OSC_TWO_PI =\n"
+         "    static_cast<float>(6.28318530717958647692);\n"
+      << "[[maybe_unused]] constexpr float OSC_ONE_OVER_PI =\n"
+         "    static_cast<float>(1.0 / 3.14159265358979323846);\n"
+      << "[[maybe_unused]] constexpr float OSC_TWO_OVER_PI =\n"
+         "    static_cast<float>(2.0 / 3.14159265358979323846);\n\n"
+      << defs.str() << "} // namespace\n\n"
+      << exports.str();
+  return out.str();
+}
+
+} // namespace tinysynth
@@ -0,0 +1,28 @@
+// SynthDefCodeGenerator.h
+#pragma once
+
+#include "SynthDef.h"
+#include "SynthDefOptimizer.h"
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// Ahead-of-time backend: writes SynthDefs as a C++ source file with the same
+// fused per-sample loop the JIT builds, for targets that cannot ship LLVM.
+// The file only needs the tinysynth source tree on its include path (for
+// TinySynthAOT.h and the UGen kernels) and exports the C ABI of
+// TinySynthAOT.h; cmake/TinySynthAOT.cmake builds it into a library.
+class SynthDefCodeGenerator {
+public:
+    std::string generate(const SynthDef& synthDef) const;
+    std::string generate(const std::vector<SynthDef>& synthDefs) const;
+
+    // Exported accessor for a SynthDef name, tinysynth_synthdef_<name>
+    static std::string symbolName(const std::string& synthDefName);
+
+private:
+    SynthDefOptimizer m_optimizer;
+};
+
+} // namespace tinysynth
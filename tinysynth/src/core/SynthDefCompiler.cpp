@@ -1,34 +1,287 @@
 // SynthDefCompiler.cpp
 #include "SynthDefCompiler.h"
+#include "UGenKernels.h"
+#include "UGenRegistry.h"
+#include "../utils/Constants.h"
+#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
 #include <llvm/IR/Constants.h>
-#include <llvm/IR/LegacyPassManager.h>
-#include <llvm/Linker/Linker.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <cmath>
 
 namespace tinysynth {
 
+// Everything the per-UGen emitters need while the body of the sample loop
+// is being generated. Code that only has to run once per block goes to
+// `prologue`, which inserts before the branch into the loop.
+struct SynthDefCompiler::FrameContext {
+  const SynthDef &synthDef;
+  const StateLayout &layout;
+  const UGenRegistry &registry;
+  llvm::IRBuilder<> prologue;
+  llvm::Type *sampleType; // float, or <lanes x float> when batched
+  unsigned int lanes;
+  llvm::Value *state;
+  llvm::Value *inputs;
+  llvm::Value *outputs;
+  llvm::Value *frame = nullptr;
+  llvm::Value *sampleRate = nullptr;
+  llvm::Value *rate = nullptr;       // sampleRate as a sampleType
+  llvm::Value *laneMask = nullptr;   // <lanes x i1>, batched only
+  bool usesKernels = false;
+
+  // Output values of the UGens emitted so far, by instance name
+  std::unordered_map<std::string, std::vector<llvm::Value *>> values{};
+  // (toUGen, inputIndex) -> (fromUGen, outputIndex)
+  std::unordered_map<std::string,
+                     std::unordered_map<unsigned int,
+                                        std::pair<std::string, unsigned int>>>
+      wires{};
+  // Loop-carried state: the local copy and its offset in the state block
+  std::vector<std::pair<llvm::AllocaInst *, std::size_t>> carried{};
+  // Batched: every UGen state field and its value on entry, restored for
+  // the lanes outside the mask on exit
+  std::vector<std::pair<llvm::Value *, llvm::Value *>> laneState{};
+  std::unordered_map<unsigned int, llvm::Value *> inputBuffers{};
+  std::unordered_map<unsigned int, llvm::Value *> outputBuffers{};
+
+  // Batched state is SoA: each scalar field becomes `lanes` adjacent floats
+  [[nodiscard]] std::size_t fieldOffset(std::size_t offset) const {
+    return offset * lanes;
+  }
+
+  llvm::Value *statePointer(std::size_t offset) {
+    llvm::Value *bytes = prologue.CreateConstInBoundsGEP1_64(
+        prologue.getInt8Ty(), state, fieldOffset(offset));
+    return prologue.CreateBitCast(bytes, sampleType->getPointerTo());
+  }
+
+  // Stack slot in the entry block, where mem2reg and SROA can see it
+  llvm::AllocaInst *createLocal(llvm::Type *type, unsigned int count = 1) {
+    llvm::BasicBlock &entry =
+        prologue.GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> entryBuilder(&entry, entry.begin());
+    return entryBuilder.CreateAlloca(type, entryBuilder.getInt32(count));
+  }
+
+  llvm::Value *bufferPointer(llvm::Value *array, unsigned int channel,
+                             std::unordered_map<unsigned int, llvm::Value *> &cache) {
+    auto it = cache.find(channel);
+    if (it != cache.end()) {
+      return it->second;
+    }
+    // Buses are shared by all lanes, so buffers always hold scalar samples
+    llvm::Type *bufferType = sampleType->getScalarType()->getPointerTo();
+    llvm::Value *slot =
+        prologue.CreateConstInBoundsGEP1_32(bufferType, array, channel);
+    llvm::Value *buffer = prologue.CreateLoad(bufferType, slot);
+    cache[channel] = buffer;
+    return buffer;
+  }
+};
+
+namespace {
+
+float parameterOr(const UGenInstance &ugen, const std::string &name,
+                  float fallback) {
+  auto it = ugen.parameters.find(name);
+  return it != ugen.parameters.end() ? it->second : fallback;
+}
+
+bool isOscillator(const std::string &type) {
+  return type == "SineOsc" || type == "SawOsc" || type == "TriangleOsc" ||
+         type == "SquareOsc" || type == "PulseOsc";
+}
+
+} // namespace
+
 SynthDefCompiler::SynthDefCompiler()
-    : m_context(std::make_unique<llvm::LLVMContext>()),
+    : m_ownedContext(std::make_unique<llvm::LLVMContext>()),
+      m_context(m_ownedContext.get()),
+      m_builder(std::make_unique<llvm::IRBuilder<>>(*m_context)),
+      m_ugenBuilder(*m_builder), m_optimizer() {}
+
+SynthDefCompiler::SynthDefCompiler(llvm::LLVMContext &context)
+    : m_context(&context),
       m_builder(std::make_unique<llvm::IRBuilder<>>(*m_context)),
-      m_ugenBuilder() {}
+      m_ugenBuilder(*m_builder), m_optimizer() {}
+
+StateLayout SynthDefCompiler::buildStateLayout(const SynthDef &synthDef) {
+  StateLayout layout;
+  // Synth-level controls come first so /n_set style writes are cheap
+  for (const auto &control : synthDef.getControls()) {
+    layout.addField("", control.name, control.defaultValue);
+  }
+  const UGenRegistry &registry = UGenRegistry::builtin();
+  for (const auto &ugen : synthDef.getUGens()) {
+    if (isOscillator(ugen.ugenType)) {
+      layout.addField(ugen.instanceName, "phase",
+                      parameterOr(ugen, "phase", 0.0F));
+    } else if (const UGenSpec *spec = registry.find(ugen.ugenType)) {
+      // Kernel state is contiguous, in kernelState order. A parameter seeds
+      // a field of its name (Phasor's phase) unless it is an input: Lag's
+      // lagTime slot holds the last lagTime seen, which must start unseen
+      for (const auto &field : spec->kernelState) {
+        const auto &inputs = spec->inputNames;
+        const bool input =
+            std::find(inputs.begin(), inputs.end(), field) != inputs.end();
+        layout.addField(ugen.instanceName, field,
+                        input ? 0.0F : parameterOr(ugen, field, 0.0F));
+      }
+    }
+  }
+  return layout;
+}
 
-std::unique_ptr<llvm::Module>
-SynthDefCompiler::compile(const SynthDef &synthDef) {
-  auto module = std::make_unique<llvm::Module>("SynthDef", *m_context);
+SynthDefModule SynthDefCompiler::compile(const SynthDef &synthDef,
+                                         const std::string &processName) {
+  return compileModule(synthDef, processName, 1);
+}
+
+SynthDefModule SynthDefCompiler::compileBatched(const SynthDef &synthDef,
+                                                unsigned int lanes,
+                                                const std::string &processName) {
+  if (lanes != 4 && lanes != 8 && lanes != 16) {
+    throw std::invalid_argument("Batch width must be 4, 8 or 16 lanes");
+  }
+  return compileModule(synthDef, processName, lanes);
+}
+
+SynthDefModule SynthDefCompiler::compileModule(const SynthDef &unoptimized,
+                                               const std::string &processName,
+                                               unsigned int lanes) {
+  // Shrink the graph before any IR is generated
+  const SynthDef synthDef = m_graphOptimization
+                                ? m_optimizer.optimize(unoptimized)
+                                : unoptimized;
+
+  SynthDefModule result{
+      std::make_unique<llvm::Module>(
+          synthDef.getName().empty() ? "SynthDef" : synthDef.getName(),
+          *m_context),
+      processName, buildStateLayout(synthDef)};
+  llvm::Module *module = result.module.get();
+  if (m_dataLayout) {
+    module->setDataLayout(*m_dataLayout);
+  }
 
   // Create the main process function
-  llvm::Function *mainFunc = createMainProcessFunction(module.get(), synthDef);
+  llvm::Function *mainFunc =
+      createMainProcessFunction(module, processName, lanes > 1);
+  auto *args = mainFunc->arg_begin();
+  llvm::Value *numFrames = args + 3;
+  llvm::Value *sampleRate = args + 4;
 
-  // Compile each UGen
-  for (const auto &ugen : synthDef.getUGens()) {
-    compileUGen(ugen, module.get());
+  llvm::BasicBlock *entry = &mainFunc->getEntryBlock();
+  llvm::BasicBlock *header =
+      llvm::BasicBlock::Create(*m_context, "loop", mainFunc);
+  llvm::BasicBlock *body = llvm::BasicBlock::Create(*m_context, "body", mainFunc);
+  llvm::BasicBlock *exit = llvm::BasicBlock::Create(*m_context, "exit", mainFunc);
+
+  // One lane per node in batched mode; every sample value becomes a vector
+  llvm::Type *sampleType = m_builder->getFloatTy();
+  if (lanes > 1) {
+    sampleType = llvm::FixedVectorType::get(sampleType, lanes);
+  }
+
+  m_builder->SetInsertPoint(entry);
+  llvm::Value *rate = sampleRate;
+  llvm::Value *laneMask = nullptr;
+  if (lanes > 1) {
+    rate = m_builder->CreateVectorSplat(lanes, sampleRate);
+    // Lane l is active when bit l of the mask argument is set
+    std::vector<llvm::Constant *> bits;
+    for (unsigned int l = 0; l < lanes; ++l) {
+      bits.push_back(m_builder->getInt32(1U << l));
+    }
+    llvm::Value *mask = m_builder->CreateVectorSplat(lanes, args + 5);
+    laneMask = m_builder->CreateICmpNE(
+        m_builder->CreateAnd(mask, llvm::ConstantVector::get(bits)),
+        llvm::Constant::getNullValue(mask->getType()), "active");
+  }
+  llvm::Instruction *enterLoop = m_builder->CreateBr(header);
+
+  FrameContext frame{.synthDef = synthDef,
+                     .layout = result.layout,
+                     .registry = UGenRegistry::builtin(),
+                     .prologue = llvm::IRBuilder<>(enterLoop),
+                     .sampleType = sampleType,
+                     .lanes = lanes,
+                     .state = args,
+                     .inputs = args + 1,
+                     .outputs = args + 2,
+                     .sampleRate = sampleRate,
+                     .rate = rate,
+                     .laneMask = laneMask};
+  if (lanes > 1) {
+    // Controls are only written by the host
+    for (const auto &field : result.layout.fields()) {
+      if (!field.owner.empty()) {
+        llvm::Value *pointer = frame.statePointer(field.offset);
+        frame.laneState.emplace_back(
+            pointer, frame.prologue.CreateLoad(sampleType, pointer));
+      }
+    }
   }
 
-  // Connect UGens
-  connectUGens(synthDef.getConnections(), module.get());
+  m_builder->SetInsertPoint(header);
+  llvm::PHINode *index = m_builder->CreatePHI(m_builder->getInt32Ty(), 2, "i");
+  index->addIncoming(m_builder->getInt32(0), entry);
+  m_builder->CreateCondBr(m_builder->CreateICmpSLT(index, numFrames), body,
+                          exit);
+
+  m_builder->SetInsertPoint(body);
+  frame.frame = index;
+
+  // Connect UGens, then compile each one in dependency order
+  connectUGens(synthDef.getConnections(), frame);
+  const auto &ugens = synthDef.getUGens();
+  for (std::size_t i : synthDef.topologicalOrder()) {
+    compileUGen(ugens[i], frame);
+  }
+
+  for (const auto &[bus, _] : frame.inputBuffers) {
+    result.numInputs = std::max(result.numInputs, bus + 1);
+  }
+  for (const auto &[bus, _] : frame.outputBuffers) {
+    result.numOutputs = std::max(result.numOutputs, bus + 1);
+  }
+
+  llvm::Value *next = m_builder->CreateAdd(index, m_builder->getInt32(1));
+  index->addIncoming(next, m_builder->GetInsertBlock());
+  m_builder->CreateBr(header);
+
+  // Write loop-carried state back for the next block
+  m_builder->SetInsertPoint(exit);
+  for (const auto &[local, offset] : frame.carried) {
+    llvm::Value *value =
+        m_builder->CreateLoad(local->getAllocatedType(), local);
+    llvm::Value *bytes = m_builder->CreateConstInBoundsGEP1_64(
+        m_builder->getInt8Ty(), frame.state, frame.fieldOffset(offset));
+    m_builder->CreateStore(
+        value, m_builder->CreateBitCast(bytes, frame.sampleType->getPointerTo()));
+  }
+  // Lanes outside the mask have run along; put their state back, so a
+  // paused node resumes where it stopped
+  for (const auto &[field, initial] : frame.laneState) {
+    llvm::Value *current = m_builder->CreateLoad(frame.sampleType, field);
+    m_builder->CreateStore(
+        m_builder->CreateSelect(frame.laneMask, current, initial), field);
+  }
+  m_builder->CreateRetVoid();
+
+  if (frame.usesKernels) {
+    linkUGenKernels(*module);
+  }
+  // After linking, so the kernels get the flags too
+  if (m_fastMath) {
+    applyFastMath(*module);
+  }
 
   // Verify the module
   std::string errorInfo;
@@ -37,105 +290,314 @@ SynthDefCompiler::compile(const SynthDef &synthDef) {
     throw std::runtime_error("Module verification failed: " + errorInfo);
   }
 
+  optimize(*module);
+  return result;
+}
+
+unsigned int SynthDefCompiler::busParameter(const UGenInstance &ugen,
+                                            const std::string &name,
+                                            float fallback) {
+  const float value = parameterOr(ugen, name, fallback);
+  // Also false for NaN
+  if (!(value >= 0.0F && value <= static_cast<float>(MAX_BUSES)) ||
+      value != std::floor(value)) {
+    throw std::runtime_error("Invalid " + name + " in " + ugen.instanceName);
+  }
+  return static_cast<unsigned int>(value);
+}
+
+void SynthDefCompiler::checkBusRange(const UGenInstance &ugen, unsigned int bus,
+                                     unsigned int channels) {
+  if (bus + channels > MAX_BUSES) {
+    throw std::runtime_error("Bus out of range in " + ugen.instanceName +
+                             ": at most " + std::to_string(MAX_BUSES) +
+                             " buses");
+  }
+}
+
+void SynthDefCompiler::applyFastMath(llvm::Module &module) {
+  for (llvm::Function &function : module) {
+    if (function.isDeclaration()) {
+      continue;
+    }
+    function.addFnAttr("no-nans-fp-math", "true");
+    function.addFnAttr("no-infs-fp-math", "true");
+    function.addFnAttr("denormal-fp-math", "preserve-sign,preserve-sign");
+    for (llvm::Instruction &instruction : llvm::instructions(function)) {
+      if (llvm::isa<llvm::FPMathOperator>(instruction)) {
+        instruction.setHasNoNaNs(true);
+        instruction.setHasNoInfs(true);
+      }
+    }
+  }
+}
 
-  // Optimize the module
+void SynthDefCompiler::optimize(llvm::Module &module) {
   llvm::PassManagerBuilder PMBuilder;
   PMBuilder.OptLevel = 3;
-  llvm::legacy::FunctionPassManager FPM(module.get());
+  PMBuilder.LoopVectorize = true;
+  PMBuilder.SLPVectorize = true;
+  // Needed to inline the bitcode kernels into the sample loop
+  PMBuilder.Inliner = llvm::createFunctionInliningPass(3, 0, false);
+  llvm::legacy::FunctionPassManager FPM(&module);
   PMBuilder.populateFunctionPassManager(FPM);
 
   FPM.doInitialization();
-
-  // If you want to run module-level passes as well:
-  llvm::legacy::PassManager MPM;
-  PMBuilder.populateModulePassManager(MPM);
-  MPM.run(*module);
-
-  for (auto &F : *module) {
+  for (auto &F : module) {
     FPM.run(F);
   }
+  FPM.doFinalization();
 
-  return module;
+  llvm::legacy::PassManager MPM;
+  PMBuilder.populateModulePassManager(MPM);
+  MPM.run(module);
 }
 
 llvm::Function *
 SynthDefCompiler::createMainProcessFunction(llvm::Module *module,
-                                            const SynthDef &synthDef) {
-  // Create function signature: void process(float* input, float* output, int
-  // numFrames)
-  llvm::FunctionType *funcType =
-      llvm::FunctionType::get(llvm::Type::getVoidTy(*m_context),
-                              {llvm::Type::getFloatPtrTy(*m_context),
-                               llvm::Type::getFloatPtrTy(*m_context),
-                               llvm::Type::getInt32Ty(*m_context)},
-                              false);
+                                            const std::string &name,
+                                            bool batched) {
+  // void process(i8* state, float** inputs, float** outputs, i32 numFrames,
+  //              float sampleRate [, i32 laneMask])
+  llvm::Type *bufferArray =
+      llvm::Type::getFloatPtrTy(*m_context)->getPointerTo();
+  std::vector<llvm::Type *> params{
+      llvm::Type::getInt8PtrTy(*m_context), bufferArray, bufferArray,
+      llvm::Type::getInt32Ty(*m_context), llvm::Type::getFloatTy(*m_context)};
+  if (batched) {
+    params.push_back(llvm::Type::getInt32Ty(*m_context));
+  }
+  llvm::FunctionType *funcType = llvm::FunctionType::get(
+      llvm::Type::getVoidTy(*m_context), params, false);
 
   llvm::Function *func = llvm::Function::Create(
-      funcType, llvm::Function::ExternalLinkage, "process", module);
+      funcType, llvm::Function::ExternalLinkage, name, module);
+  for (unsigned int i = 0; i < 3; ++i) {
+    func->addParamAttr(i, llvm::Attribute::NoAlias);
+  }
 
   // Create the entry basic block
-  llvm::BasicBlock *entryBlock =
-      llvm::BasicBlock::Create(*m_context, "entry", func);
-  m_builder->SetInsertPoint(entryBlock);
-
-  // TODO: Implement the main processing loop here
-
-  m_builder->CreateRetVoid();
+  llvm::BasicBlock::Create(*m_context, "entry", func);
   return func;
 }
 
-void SynthDefCompiler::compileUGen(const UGenInstance &ugen,
-                                   llvm::Module *module) {
-  std::unique_ptr<llvm::Module> ugenModule;
-
-  if (ugen.ugenType == "SineOsc") {
-    ugenModule = m_ugenBuilder.buildSineOsc();
-  } else if (ugen.ugenType == "SawOsc") {
-    ugenModule = m_ugenBuilder.buildSawOsc();
-  } else if (ugen.ugenType == "TriangleOsc") {
-    ugenModule = m_ugenBuilder.buildTriangleOsc();
-  } else if (ugen.ugenType == "PulseOsc") {
-    ugenModule = m_ugenBuilder.buildPulseOsc();
-  } else {
-    throw std::runtime_error("Unknown UGen type: " + ugen.ugenType);
+void SynthDefCompiler::connectUGens(const std::vector<Connection> &connections,
+                                    FrameContext &frame) {
+  for (const auto &conn : connections) {
+    frame.wires[conn.toUGen][conn.inputIndex] = {conn.fromUGen,
+                                                 conn.outputIndex};
   }
+}
 
-  // Verify the UGen module
-  std::string errorInfo;
-  llvm::raw_string_ostream errorStream(errorInfo);
-  if (llvm::verifyModule(*ugenModule, &errorStream)) {
-    throw std::runtime_error("UGen module verification failed: " + errorInfo);
+llvm::Value *SynthDefCompiler::inputValue(const UGenInstance &ugen,
+                                          unsigned int index,
+                                          FrameContext &frame) {
+  const UGenSpec *spec = frame.registry.find(ugen.ugenType);
+  const std::string name = index < spec->inputNames.size()
+                               ? spec->inputNames[index]
+                               : "in" + std::to_string(index);
+  const float parameter = parameterOr(ugen, name, spec->inputDefault(index));
+  llvm::Value *constant = llvm::ConstantFP::get(frame.sampleType, parameter);
+
+  auto ugenWires = frame.wires.find(ugen.instanceName);
+  if (ugenWires == frame.wires.end()) {
+    return constant;
   }
+  auto wire = ugenWires->second.find(index);
+  if (wire == ugenWires->second.end()) {
+    return constant;
+  }
+
+  const auto &[fromUGen, outputIndex] = wire->second;
+  auto source = frame.values.find(fromUGen);
+  if (source == frame.values.end() || outputIndex >= source->second.size()) {
+    throw std::runtime_error("Unresolved input " + name + " of " +
+                             ugen.instanceName + " from " + fromUGen);
+  }
+  llvm::Value *signal = source->second[outputIndex];
 
-  // Link the UGen module into the main module
-  bool linkError = llvm::Linker::linkModules(*module, std::move(ugenModule));
-  if (linkError) {
-    throw std::runtime_error("Failed to link UGen module for " + ugen.ugenType);
+  switch (spec->inputMode(index)) {
+  case InputMode::Add:
+    return parameter == 0.0F ? signal : m_builder->CreateFAdd(constant, signal);
+  case InputMode::Multiply:
+    return parameter == 1.0F ? signal : m_builder->CreateFMul(constant, signal);
+  case InputMode::Replace:
+    break;
   }
+  return signal;
+}
 
-  // Find the linked UGen function
-  llvm::Function *ugenFunc = module->getFunction(ugen.ugenType + "_process");
-  if (!ugenFunc) {
-    throw std::runtime_error("Failed to find linked UGen function for " +
-                             ugen.ugenType);
+void SynthDefCompiler::compileUGen(const UGenInstance &ugen,
+                                   FrameContext &frame) {
+  const std::string &type = ugen.ugenType;
+  if (frame.registry.find(type) == nullptr) {
+    throw std::runtime_error("Unknown UGen type: " + type);
   }
+  auto &outputs = frame.values[ugen.instanceName];
+  auto input = [&](unsigned int index) { return inputValue(ugen, index, frame); };
 
-  // Set UGen parameters
-  for (const auto &[paramName, paramValue] : ugen.parameters) {
-    llvm::Function *setParamFunc =
-        module->getFunction(ugen.ugenType + "_setParameter");
-    if (setParamFunc) {
-      std::vector<llvm::Value *> args = {
-          llvm::ConstantFP::get(m_builder->getFloatTy(), paramValue)};
-      m_builder->CreateCall(setParamFunc, args);
+  if (type == "Control") {
+    const auto first = static_cast<std::size_t>(parameterOr(ugen, "index", 0));
+    const auto channels =
+        static_cast<std::size_t>(parameterOr(ugen, "numChannels", 1));
+    const auto &controls = frame.synthDef.getControls();
+    for (std::size_t k = 0; k < channels; ++k) {
+      if (first + k >= controls.size()) {
+        throw std::runtime_error("Control index out of range in " +
+                                 ugen.instanceName);
+      }
+      // Controls are block-rate: read once before the loop
+      std::size_t offset = *frame.layout.controlOffset(controls[first + k].name);
+      outputs.push_back(frame.prologue.CreateLoad(frame.sampleType,
+                                                  frame.statePointer(offset)));
+    }
+  } else if (type == "In") {
+    const unsigned int bus = busParameter(ugen, "bus", 0);
+    const unsigned int channels = busParameter(ugen, "numChannels", 1);
+    checkBusRange(ugen, bus, channels);
+    for (unsigned int k = 0; k < channels; ++k) {
+      llvm::Value *buffer =
+          frame.bufferPointer(frame.inputs, bus + k, frame.inputBuffers);
+      llvm::Type *scalarType = frame.sampleType->getScalarType();
+      llvm::Value *sample = m_builder->CreateLoad(
+          scalarType,
+          m_builder->CreateInBoundsGEP(scalarType, buffer, frame.frame));
+      if (frame.lanes > 1) {
+        sample = m_builder->CreateVectorSplat(frame.lanes, sample);
+      }
+      outputs.push_back(sample);
     }
+  } else if (type == "Out" || type == "ReplaceOut") {
+    // Out mixes into the host's buffers, like scsynth's Out; ReplaceOut
+    // overwrites what earlier UGens wrote there
+    const unsigned int bus = busParameter(ugen, "bus", 0);
+    unsigned int channels = busParameter(ugen, "numChannels", 0);
+    auto ugenWires = frame.wires.find(ugen.instanceName);
+    if (ugenWires != frame.wires.end()) {
+      for (const auto &[inputIndex, _] : ugenWires->second) {
+        channels = std::max(channels, inputIndex + 1);
+      }
+    }
+    checkBusRange(ugen, bus, channels);
+    for (unsigned int k = 0; k < channels; ++k) {
+      llvm::Value *buffer =
+          frame.bufferPointer(frame.outputs, bus + k, frame.outputBuffers);
+      llvm::Type *scalarType = frame.sampleType->getScalarType();
+      llvm::Value *sample =
+          m_builder->CreateInBoundsGEP(scalarType, buffer, frame.frame);
+      llvm::Value *signal = input(k);
+      if (frame.lanes > 1) {
+        // All nodes of a batch play to the same bus: sum the active lanes
+        signal = m_builder->CreateSelect(
+            frame.laneMask, signal,
+            llvm::Constant::getNullValue(frame.sampleType));
+        auto *sum = m_builder->CreateFAddReduce(
+            llvm::ConstantFP::get(scalarType, 0.0), signal);
+        llvm::cast<llvm::Instruction>(sum)->setHasAllowReassoc(true);
+        signal = sum;
+      }
+      if (type == "Out") {
+        signal = m_builder->CreateFAdd(
+            m_builder->CreateLoad(scalarType, sample), signal);
+      }
+      m_builder->CreateStore(signal, sample);
+    }
+  } else if (isOscillator(type)) {
+    auto offset = frame.layout.offsetOf(ugen.instanceName, "phase");
+    // The phase lives in a local for the whole block; mem2reg turns it into
+    // a register and the exit block writes it back
+    llvm::AllocaInst *local = frame.createLocal(frame.sampleType);
+    frame.prologue.CreateStore(
+        frame.prologue.CreateLoad(frame.sampleType, frame.statePointer(*offset)),
+        local);
+    frame.carried.emplace_back(local, *offset);
+
+    llvm::Value *frequency = input(0);
+    llvm::Value *amplitude = input(1);
+    llvm::Value *phase = m_builder->CreateLoad(frame.sampleType, local);
+    llvm::Value *waveform = m_ugenBuilder.buildWaveform(type, phase);
+    outputs.push_back(m_builder->CreateFMul(amplitude, waveform));
+    // Same rounding as the Oscillator modules, so the phases never drift
+    // apart; with a constant frequency this is hoisted out of the loop
+    llvm::Value *increment = m_builder->CreateFDiv(
+        m_builder->CreateFMul(
+            frequency, llvm::ConstantFP::get(frame.sampleType,
+                                             Constants<float>::twoPiConstant)),
+        frame.rate);
+    m_builder->CreateStore(m_ugenBuilder.addPhaseAccumulation(phase, increment),
+                           local);
+  } else if (type == "Add") {
+    outputs.push_back(m_builder->CreateFAdd(input(0), input(1)));
+  } else if (type == "Sub") {
+    outputs.push_back(m_builder->CreateFSub(input(0), input(1)));
+  } else if (type == "Mul") {
+    outputs.push_back(m_builder->CreateFMul(input(0), input(1)));
+  } else if (type == "Div") {
+    outputs.push_back(m_builder->CreateFDiv(input(0), input(1)));
+  } else if (type == "MulAdd") {
+    outputs.push_back(m_builder->CreateFAdd(
+        m_builder->CreateFMul(input(0), input(1)), input(2)));
+  } else if (const UGenSpec *spec = frame.registry.find(type);
+             !spec->kernel.empty()) {
+    outputs.push_back(compileKernelCall(ugen, *spec, frame));
+  } else {
+    throw std::runtime_error("No code generator for UGen type: " + type);
   }
 }
 
-void SynthDefCompiler::connectUGens(const std::vector<Connection> &connections,
-                                    llvm::Module *module) {
-  // TODO: Implement UGen connections
-  // This will involve creating function calls between UGens in the LLVM IR
+llvm::Value *SynthDefCompiler::compileKernelCall(const UGenInstance &ugen,
+                                                 const UGenSpec &spec,
+                                                 FrameContext &frame) {
+  // Defined by the bitcode library linked in once the loop is built
+  llvm::Type *floatType = m_builder->getFloatTy();
+  llvm::Type *floatPtr = floatType->getPointerTo();
+  llvm::Module *module = m_builder->GetInsertBlock()->getModule();
+  frame.usesKernels = true;
+
+  std::vector<llvm::Value *> inputs;
+  for (unsigned int i = 0; i < spec.inputNames.size(); ++i) {
+    inputs.push_back(inputValue(ugen, i, frame));
+  }
+  // Scratch arrays for the inputs and, batched, the output; SROA removes
+  // them once the kernel is inlined
+  llvm::AllocaInst *inputArray = frame.createLocal(
+      frame.sampleType, std::max<unsigned int>(inputs.size(), 1));
+  for (unsigned int i = 0; i < inputs.size(); ++i) {
+    m_builder->CreateStore(inputs[i], m_builder->CreateConstInBoundsGEP1_32(
+                                          frame.sampleType, inputArray, i));
+  }
+  llvm::Value *inputPointer = m_builder->CreateBitCast(inputArray, floatPtr);
+
+  llvm::Value *state = llvm::Constant::getNullValue(floatPtr);
+  if (!spec.kernelState.empty()) {
+    auto offset = frame.layout.offsetOf(ugen.instanceName, spec.kernelState[0]);
+    state = frame.prologue.CreateBitCast(
+        frame.prologue.CreateConstInBoundsGEP1_64(
+            frame.prologue.getInt8Ty(), frame.state, frame.fieldOffset(*offset)),
+        floatPtr);
+  }
+
+  if (frame.lanes == 1) {
+    // float kernel(float* state, i32 stride, float* inputs, float sampleRate)
+    llvm::FunctionCallee kernel = module->getOrInsertFunction(
+        spec.kernel,
+        llvm::FunctionType::get(
+            floatType, {floatPtr, m_builder->getInt32Ty(), floatPtr, floatType},
+            false));
+    return m_builder->CreateCall(kernel, {state, m_builder->getInt32(1),
+                                          inputPointer, frame.sampleRate});
+  }
+  // Batched: the kernel's _x<lanes> variant computes every lane at once,
+  //   void kernel_xN(float* state, float* inputs, float* out, float sampleRate)
+  llvm::FunctionCallee kernel = module->getOrInsertFunction(
+      spec.kernel + "_x" + std::to_string(frame.lanes),
+      llvm::FunctionType::get(m_builder->getVoidTy(),
+                              {floatPtr, floatPtr, floatPtr, floatType}, false));
+  llvm::AllocaInst *output = frame.createLocal(frame.sampleType);
+  m_builder->CreateCall(kernel, {state, inputPointer,
+                                 m_builder->CreateBitCast(output, floatPtr),
+                                 frame.sampleRate});
+  return m_builder->CreateLoad(frame.sampleType, output);
 }
 
-} // namespace tinysynth
\ No newline at end of file
+} // namespace tinysynth
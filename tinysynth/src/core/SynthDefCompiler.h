@@ -3,25 +3,101 @@
 
 #include "SynthDef.h"
 #include "LLVMUGenBuilder.h"
+#include "StateLayout.h"
+#include "SynthDefOptimizer.h"
+#include <llvm/IR/DataLayout.h>
 #include <llvm/IR/Module.h>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 
 namespace tinysynth {
 
+struct UGenSpec;
+
+// Result of compiling one SynthDef. The module holds a single function
+//   void <processName>(i8* state, float** inputs, float** outputs,
+//                      i32 numFrames, float sampleRate)
+// that keeps everything that must survive between blocks in the state
+// block described by `layout`, so one function serves every node.
+struct SynthDefModule {
+    std::unique_ptr<llvm::Module> module;
+    std::string processName;
+    StateLayout layout;
+    // Buffers the function reads and writes: `inputs` and `outputs` must
+    // hold at least this many pointers
+    unsigned int numInputs = 0;
+    unsigned int numOutputs = 0;
+};
+
 class SynthDefCompiler {
 public:
     SynthDefCompiler();
-    
-    std::unique_ptr<llvm::Module> compile(const SynthDef& synthDef);
+    // Compiles into a context owned by the caller (e.g. a JIT)
+    explicit SynthDefCompiler(llvm::LLVMContext& context);
+
+    SynthDefModule compile(const SynthDef& synthDef,
+                           const std::string& processName = "process");
+
+    // Variant that runs `lanes` (4, 8 or 16) nodes of the def at once, one
+    // per SIMD lane. Its function takes an extra i32 mask of active lanes,
+    // and its state block is SoA: field f of lane l sits at
+    // f.offset * lanes + l * sizeof(float). Out sums the active lanes; the
+    // state of the inactive ones is left as it was. Kernels run through
+    // their _x<lanes> variants, on vectors.
+    SynthDefModule compileBatched(const SynthDef& synthDef, unsigned int lanes,
+                                  const std::string& processName = "process_batch");
+
+    // Target data layout, so the optimizer can vectorize for the host
+    void setDataLayout(const llvm::DataLayout& dataLayout) { m_dataLayout = dataLayout; }
+
+    // Marks every float operation nnan/ninf and assumes denormals are
+    // flushed (see ScopedDenormalGuard), so LLVM can drop NaN and infinity
+    // handling and reassociate compares. Results stay IEEE for finite
+    // inputs; a graph that produces NaN or infinity becomes undefined.
+    void setFastMath(bool enabled) { m_fastMath = enabled; }
+
+    // Runs SynthDefOptimizer on the graph first (the default). Off compiles
+    // the graph as written, to check the optimizer against.
+    void setGraphOptimization(bool enabled) { m_graphOptimization = enabled; }
+
+    // Per-node state a SynthDef needs, without generating any code
+    static StateLayout buildStateLayout(const SynthDef& synthDef);
+
+    // Highest bus an In or Out may reach. Bus indices are baked into the
+    // code, so anything past it is rejected when the def is compiled.
+    static constexpr unsigned int MAX_BUSES = 1024;
+
+    // The `bus` or `numChannels` parameter of an In or Out as a whole
+    // number in [0, MAX_BUSES]; throws std::runtime_error otherwise
+    static unsigned int busParameter(const UGenInstance& ugen, const std::string& name,
+                                     float fallback);
+    // Throws std::runtime_error when bus + channels passes MAX_BUSES
+    static void checkBusRange(const UGenInstance& ugen, unsigned int bus, unsigned int channels);
 
 private:
-    std::unique_ptr<llvm::LLVMContext> m_context;
+    struct FrameContext;
+
+    std::unique_ptr<llvm::LLVMContext> m_ownedContext;
+    llvm::LLVMContext* m_context;
     std::unique_ptr<llvm::IRBuilder<>> m_builder;
     LLVMUGenBuilder m_ugenBuilder;
+    SynthDefOptimizer m_optimizer;
+    std::optional<llvm::DataLayout> m_dataLayout;
+    bool m_fastMath = false;
+    bool m_graphOptimization = true;
 
-    llvm::Function* createMainProcessFunction(llvm::Module* module, const SynthDef& synthDef);
-    void compileUGen(const UGenInstance& ugen, llvm::Module* module);
-    void connectUGens(const std::vector<Connection>& connections, llvm::Module* module);
+    SynthDefModule compileModule(const SynthDef& synthDef, const std::string& processName,
+                                 unsigned int lanes);
+    llvm::Function* createMainProcessFunction(llvm::Module* module, const std::string& name,
+                                              bool batched);
+    void compileUGen(const UGenInstance& ugen, FrameContext& frame);
+    void connectUGens(const std::vector<Connection>& connections, FrameContext& frame);
+    llvm::Value* inputValue(const UGenInstance& ugen, unsigned int index, FrameContext& frame);
+    llvm::Value* compileKernelCall(const UGenInstance& ugen, const UGenSpec& spec,
+                                   FrameContext& frame);
+    void applyFastMath(llvm::Module& module);
+    void optimize(llvm::Module& module);
 };
 
-} // namespace tinysynth
\ No newline at end of file
+} // namespace tinysynth
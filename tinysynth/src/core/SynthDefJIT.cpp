@@ -0,0 +1,102 @@
+// SynthDefJIT.cpp
+#include "SynthDefJIT.h"
+#include "SynthDefCompiler.h"
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TargetSelect.h>
+#include <stdexcept>
+
+namespace tinysynth {
+
+namespace {
+
+template <typename T> T unwrap(llvm::Expected<T> value, const char *what) {
+  if (!value) {
+    throw std::runtime_error(std::string(what) + ": " +
+                             llvm::toString(value.takeError()));
+  }
+  return std::move(*value);
+}
+
+void check(llvm::Error error, const char *what) {
+  if (error) {
+    throw std::runtime_error(std::string(what) + ": " +
+                             llvm::toString(std::move(error)));
+  }
+}
+
+} // namespace
+
+SynthDefJIT::SynthDefJIT(SynthDefJITOptions options)
+    : m_options(options), m_context(std::make_unique<llvm::LLVMContext>()) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  m_jit = unwrap(llvm::orc::LLJITBuilder().create(), "Failed to create JIT");
+
+  // Resolve libm calls (sinf, ...) against the host process
+  m_jit->getMainJITDylib().addGenerator(
+      unwrap(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                 m_jit->getDataLayout().getGlobalPrefix()),
+             "Failed to expose process symbols"));
+}
+
+SynthDefJIT::~SynthDefJIT() = default;
+
+template <typename Function>
+Function SynthDefJIT::addModule(SynthDefModule compiled) {
+  check(m_jit->addIRModule(
+            llvm::orc::ThreadSafeModule(std::move(compiled.module), m_context)),
+        "Failed to add SynthDef module");
+
+  auto address =
+      unwrap(m_jit->lookup(compiled.processName), "Failed to look up process");
+#if LLVM_VERSION_MAJOR >= 15
+  return address.template toPtr<Function>();
+#else
+  return reinterpret_cast<Function>(address.getAddress());
+#endif
+}
+
+std::shared_ptr<const CompiledSynthDef>
+SynthDefJIT::compile(const SynthDef &synthDef, unsigned int batchLanes) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // Every def gets its own symbol so a redefinition never clashes
+  const std::string symbol = "synthdef_" + std::to_string(m_nextId++);
+  SynthDefModule compiled;
+  SynthDefModule batched;
+  {
+    auto contextLock = m_context.getLock();
+    SynthDefCompiler compiler(*m_context.getContext());
+    compiler.setDataLayout(m_jit->getDataLayout());
+    compiler.setFastMath(m_options.fastMath);
+    compiler.setGraphOptimization(m_options.optimizeGraph);
+    compiled = compiler.compile(synthDef, symbol);
+    if (batchLanes > 0) {
+      batched = compiler.compileBatched(synthDef, batchLanes, symbol + "_batch");
+    }
+  }
+
+  CompiledSynthDef result{synthDef.getName(), nullptr, compiled.layout};
+  result.numInputs = compiled.numInputs;
+  result.numOutputs = compiled.numOutputs;
+  result.process = addModule<ProcessFunction>(std::move(compiled));
+  if (batchLanes > 0) {
+    result.processBatch = addModule<BatchProcessFunction>(std::move(batched));
+    result.batchLanes = batchLanes;
+  }
+
+  auto shared = std::make_shared<const CompiledSynthDef>(std::move(result));
+  m_compiled[synthDef.getName()] = shared;
+  return shared;
+}
+
+std::shared_ptr<const CompiledSynthDef>
+SynthDefJIT::find(const std::string &name) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_compiled.find(name);
+  return it == m_compiled.end() ? nullptr : it->second;
+}
+
+} // namespace tinysynth
@@ -0,0 +1,91 @@
+// SynthDefJIT.h
+#pragma once
+
+#include "NodeStatePool.h"
+#include "StateLayout.h"
+#include "SynthDef.h"
+#include "SynthDefCompiler.h"
+#include <cstdint>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace tinysynth {
+
+using ProcessFunction = void (*)(void* state, const float* const* inputs,
+                                 float* const* outputs, std::int32_t numFrames,
+                                 float sampleRate);
+
+// Batched variant: one SoA state block drives up to `lanes` nodes; bit l of
+// laneMask marks lane l as playing, and the other lanes keep their state
+using BatchProcessFunction = void (*)(void* state, const float* const* inputs,
+                                      float* const* outputs, std::int32_t numFrames,
+                                      float sampleRate, std::uint32_t laneMask);
+
+// Machine code for one SynthDef plus the layout of the state each node owns
+struct CompiledSynthDef {
+    std::string name;
+    ProcessFunction process;
+    StateLayout layout;
+    BatchProcessFunction processBatch = nullptr;
+    unsigned int batchLanes = 0;
+    // See SynthDefModule: buffers process() reads and writes
+    unsigned int numInputs = 0;
+    unsigned int numOutputs = 0;
+};
+
+// One playing instance: shared code, private state block from a pool
+struct SynthNode {
+    const CompiledSynthDef* def = nullptr;
+    void* state = nullptr;
+
+    void process(const float* const* inputs, float* const* outputs,
+                 std::int32_t numFrames, float sampleRate) const {
+        def->process(state, inputs, outputs, numFrames, sampleRate);
+    }
+
+    // offset as returned by StateLayout::controlOffset
+    void setControl(std::size_t offset, float value) const {
+        *reinterpret_cast<float*>(static_cast<char*>(state) + offset) = value;
+    }
+};
+
+struct SynthDefJITOptions {
+    // nnan/ninf float math, see SynthDefCompiler::setFastMath. Only for
+    // graphs known to stay finite, run under a ScopedDenormalGuard.
+    bool fastMath = false;
+    // See SynthDefCompiler::setGraphOptimization
+    bool optimizeGraph = true;
+};
+
+// Compiles each SynthDef once; spawning nodes afterwards never touches LLVM.
+// Code is never unloaded, so nodes of a replaced def keep running safely.
+class SynthDefJIT {
+public:
+    explicit SynthDefJIT(SynthDefJITOptions options = {});
+    SynthDefJIT(const SynthDefJIT&) = delete;
+    SynthDefJIT& operator=(const SynthDefJIT&) = delete;
+    ~SynthDefJIT();
+
+    // batchLanes of 4, 8 or 16 also builds the voice-batched variant
+    std::shared_ptr<const CompiledSynthDef> compile(const SynthDef& synthDef,
+                                                    unsigned int batchLanes = 0);
+
+    [[nodiscard]] std::shared_ptr<const CompiledSynthDef> find(const std::string& name) const;
+
+private:
+    SynthDefJITOptions m_options;
+    llvm::orc::ThreadSafeContext m_context;
+    std::unique_ptr<llvm::orc::LLJIT> m_jit;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const CompiledSynthDef>> m_compiled;
+    unsigned int m_nextId = 0;
+
+    template <typename Function>
+    Function addModule(SynthDefModule compiled);
+};
+
+} // namespace tinysynth
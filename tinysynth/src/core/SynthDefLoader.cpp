@@ -0,0 +1,338 @@
+// SynthDefLoader.cpp
+#include "SynthDefLoader.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tinysynth {
+
+namespace {
+
+constexpr std::uint32_t SCGF_MAGIC = 0x53436766; // "SCgf"
+constexpr std::int32_t SCGF_VERSION = 2;
+
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open SynthDef file: " + path);
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Failed to stat SynthDef file: " + path);
+    }
+    m_size = static_cast<std::size_t>(info.st_size);
+    if (m_size > 0) {
+      m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (m_data == MAP_FAILED) {
+      throw std::runtime_error("Failed to map SynthDef file: " + path);
+    }
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    if (m_data != nullptr && m_data != MAP_FAILED) {
+      ::munmap(m_data, m_size);
+    }
+  }
+
+  [[nodiscard]] std::span<const std::uint8_t> bytes() const {
+    if (m_data == nullptr) {
+      return {};
+    }
+    return {static_cast<const std::uint8_t *>(m_data), m_size};
+  }
+
+private:
+  void *m_data = nullptr;
+  std::size_t m_size = 0;
+};
+
+// Big-endian cursor over the mapped bytes
+class Reader {
+public:
+  explicit Reader(std::span<const std::uint8_t> data)
+      : m_pos(data.data()), m_end(data.data() + data.size()) {}
+
+  std::int8_t readInt8() { return static_cast<std::int8_t>(*take(1)); }
+
+  std::int16_t readInt16() {
+    return static_cast<std::int16_t>(load<std::uint16_t>(take(2)));
+  }
+
+  std::int32_t readInt32() {
+    return static_cast<std::int32_t>(load<std::uint32_t>(take(4)));
+  }
+
+  float readFloat() { return std::bit_cast<float>(load<std::uint32_t>(take(4))); }
+
+  std::string_view readPString() {
+    auto length = static_cast<std::size_t>(*take(1));
+    return {reinterpret_cast<const char *>(take(length)), length};
+  }
+
+  // Returns a pointer to count big-endian floats and skips past them
+  const std::uint8_t *takeFloats(std::int32_t count) {
+    if (count < 0) {
+      throw std::runtime_error("SCgf: negative count");
+    }
+    return take(static_cast<std::size_t>(count) * 4);
+  }
+
+  [[nodiscard]] bool atEnd() const { return m_pos == m_end; }
+
+  template <typename T> static T load(const std::uint8_t *bytes) {
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    if constexpr (std::endian::native == std::endian::little) {
+      if constexpr (sizeof(T) == 2) {
+        value = __builtin_bswap16(value);
+      } else {
+        value = __builtin_bswap32(value);
+      }
+    }
+    return value;
+  }
+
+  static float floatAt(const std::uint8_t *base, std::int32_t index) {
+    return std::bit_cast<float>(load<std::uint32_t>(base + 4 * index));
+  }
+
+private:
+  const std::uint8_t *take(std::size_t count) {
+    if (static_cast<std::size_t>(m_end - m_pos) < count) {
+      throw std::runtime_error("SCgf: unexpected end of file");
+    }
+    const std::uint8_t *current = m_pos;
+    m_pos += count;
+    return current;
+  }
+
+  const std::uint8_t *m_pos;
+  const std::uint8_t *m_end;
+};
+
+// What the inputs of later UGens need to know about one already parsed
+struct ParsedUGen {
+  std::string instanceName; // empty when the UGen was dropped
+  std::int32_t numOutputs;  // as the file declares them
+};
+
+void reportUnsupported(LoadedSynthDef &result, std::string name) {
+  auto &list = result.unsupported;
+  if (std::find(list.begin(), list.end(), name) == list.end()) {
+    list.push_back(std::move(name));
+  }
+}
+
+LoadedSynthDef parseDef(Reader &reader, const UGenRegistry &registry,
+                        std::vector<std::string_view> &paramNames,
+                        std::vector<ParsedUGen> &parsed) {
+  LoadedSynthDef result;
+  SynthDef &def = result.synthDef;
+  def.setName(std::string(reader.readPString()));
+
+  const std::int32_t numConstants = reader.readInt32();
+  const std::uint8_t *constants = reader.takeFloats(numConstants);
+
+  const std::int32_t numParams = reader.readInt32();
+  const std::uint8_t *initialValues = reader.takeFloats(numParams);
+
+  paramNames.assign(static_cast<std::size_t>(numParams), std::string_view{});
+  const std::int32_t numParamNames = reader.readInt32();
+  for (std::int32_t i = 0; i < numParamNames; ++i) {
+    std::string_view name = reader.readPString();
+    std::int32_t index = reader.readInt32();
+    if (index < 0 || index >= numParams) {
+      throw std::runtime_error("SCgf: parameter index out of range");
+    }
+    paramNames[index] = name;
+  }
+  for (std::int32_t i = 0; i < numParams; ++i) {
+    std::string name = paramNames[i].empty() ? "param" + std::to_string(i)
+                                             : std::string(paramNames[i]);
+    def.addControl({std::move(name), Reader::floatAt(initialValues, i)});
+  }
+
+  const std::int32_t numUGens = reader.readInt32();
+  if (numUGens < 0) {
+    throw std::runtime_error("SCgf: negative UGen count");
+  }
+  def.reserve(static_cast<std::size_t>(numUGens),
+              static_cast<std::size_t>(numUGens) * 2);
+  parsed.clear();
+
+  for (std::int32_t u = 0; u < numUGens; ++u) {
+    std::string_view scName = reader.readPString();
+    reader.readInt8(); // calculation rate
+    const std::int32_t numInputs = reader.readInt32();
+    const std::int32_t numOutputs = reader.readInt32();
+    const std::int16_t specialIndex = reader.readInt16();
+    if (numInputs < 0 || numOutputs < 0) {
+      throw std::runtime_error("SCgf: negative input/output count");
+    }
+
+    const SCUGenMapping *mapping = registry.findSC(scName, specialIndex);
+    const UGenSpec *spec = mapping ? registry.find(mapping->type) : nullptr;
+
+    UGenInstance ugen;
+    if (spec != nullptr) {
+      ugen.ugenType = spec->type;
+      ugen.instanceName = spec->type + "_" + std::to_string(u);
+    } else {
+      reportUnsupported(result, std::string(scName));
+    }
+
+    const auto numMapped = static_cast<std::int32_t>(
+        mapping ? mapping->inputs.size() : 0);
+    for (std::int32_t i = 0; i < numInputs; ++i) {
+      const std::int32_t source = reader.readInt32();
+      const std::int32_t outputOrConstant = reader.readInt32();
+      if (source >= u) {
+        throw std::runtime_error("SCgf: UGen input references a later UGen");
+      }
+      if (source >= 0 && (outputOrConstant < 0 ||
+                          outputOrConstant >= parsed[source].numOutputs)) {
+        throw std::runtime_error("SCgf: UGen output index out of range");
+      }
+      if (spec == nullptr) {
+        continue;
+      }
+
+      int inputIndex = -1;
+      std::string parameter;
+      if (i < numMapped) {
+        inputIndex = mapping->inputs[i].inputIndex;
+        parameter = mapping->inputs[i].parameter;
+      } else if (spec->variadic) {
+        inputIndex = i - numMapped;
+        parameter = "in" + std::to_string(inputIndex);
+      } else {
+        // Trailing SC inputs we have no slot for; only constants are harmless
+        if (source >= 0) {
+          reportUnsupported(result, std::string(scName) + " input " +
+                                        std::to_string(i));
+        }
+        continue;
+      }
+
+      if (source < 0) {
+        if (outputOrConstant < 0 || outputOrConstant >= numConstants) {
+          throw std::runtime_error("SCgf: constant index out of range");
+        }
+        ugen.parameters[parameter] = Reader::floatAt(constants, outputOrConstant);
+      } else if (inputIndex < 0) {
+        reportUnsupported(result, std::string(scName) + " " + parameter +
+                                      " (audio-rate input)");
+      } else if (!parsed[source].instanceName.empty()) {
+        // Leave the parameter at the identity of how it combines with the wire
+        const InputMode mode =
+            spec->inputMode(static_cast<unsigned int>(inputIndex));
+        ugen.parameters[parameter] = mode == InputMode::Multiply ? 1.0F : 0.0F;
+        def.addConnection({parsed[source].instanceName,
+                           static_cast<unsigned int>(outputOrConstant),
+                           ugen.instanceName,
+                           static_cast<unsigned int>(inputIndex)});
+      }
+    }
+
+    for (std::int32_t o = 0; o < numOutputs; ++o) {
+      reader.readInt8(); // output rate
+    }
+
+    parsed.push_back({std::string{}, numOutputs});
+    if (spec == nullptr) {
+      continue;
+    }
+    if (spec->variadic) {
+      const std::int32_t channels =
+          spec->sink ? numInputs - numMapped : numOutputs;
+      ugen.parameters["numChannels"] = static_cast<float>(channels);
+    }
+    if (spec->type == "Control") {
+      ugen.parameters["index"] = static_cast<float>(specialIndex);
+    }
+    parsed.back().instanceName = ugen.instanceName;
+    def.addUGen(ugen);
+  }
+
+  // Variants are named presets of the parameter values; not used yet
+  const std::int16_t numVariants = reader.readInt16();
+  for (std::int16_t v = 0; v < numVariants; ++v) {
+    reader.readPString();
+    reader.takeFloats(numParams);
+  }
+
+  return result;
+}
+
+} // namespace
+
+SynthDefLoader::SynthDefLoader(const UGenRegistry &registry)
+    : m_registry(registry) {}
+
+std::vector<LoadedSynthDef>
+SynthDefLoader::loadFile(const std::string &path) const {
+  MappedFile file(path);
+  return parse(file.bytes());
+}
+
+std::vector<LoadedSynthDef>
+SynthDefLoader::loadDirectory(const std::string &path) const {
+  std::vector<LoadedSynthDef> defs;
+  for (const auto &entry : std::filesystem::directory_iterator(path)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".scsyndef") {
+      auto loaded = loadFile(entry.path().string());
+      std::move(loaded.begin(), loaded.end(), std::back_inserter(defs));
+    }
+  }
+  return defs;
+}
+
+std::vector<LoadedSynthDef>
+SynthDefLoader::parse(std::span<const std::uint8_t> data) const {
+  Reader reader(data);
+  if (static_cast<std::uint32_t>(reader.readInt32()) != SCGF_MAGIC) {
+    throw std::runtime_error("Not an SCgf SynthDef file");
+  }
+  const std::int32_t version = reader.readInt32();
+  if (version != SCGF_VERSION) {
+    throw std::runtime_error("Unsupported SCgf version: " +
+                             std::to_string(version));
+  }
+
+  const std::int16_t numDefs = reader.readInt16();
+  if (numDefs < 0) {
+    throw std::runtime_error("SCgf: negative def count");
+  }
+  std::vector<LoadedSynthDef> defs;
+  defs.reserve(static_cast<std::size_t>(numDefs));
+
+  // Scratch storage reused across defs
+  std::vector<std::string_view> paramNames;
+  std::vector<ParsedUGen> parsed;
+  for (std::int16_t i = 0; i < numDefs; ++i) {
+    defs.push_back(parseDef(reader, m_registry, paramNames, parsed));
+  }
+  if (!reader.atEnd()) {
+    throw std::runtime_error("SCgf: trailing bytes after the last def");
+  }
+  return defs;
+}
+
+} // namespace tinysynth
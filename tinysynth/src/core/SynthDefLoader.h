@@ -0,0 +1,36 @@
+// SynthDefLoader.h
+#pragma once
+
+#include "SynthDef.h"
+#include "UGenRegistry.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+struct LoadedSynthDef {
+    SynthDef synthDef;
+    // SC UGens (or inputs) that have no tinysynth equivalent and were dropped
+    std::vector<std::string> unsupported;
+};
+
+// Reads compiled scsynth SynthDef files (SCgf, version 2). Files are mapped
+// read-only and parsed in place; only the resulting SynthDefs are allocated.
+class SynthDefLoader {
+public:
+    explicit SynthDefLoader(const UGenRegistry& registry = UGenRegistry::builtin());
+
+    std::vector<LoadedSynthDef> loadFile(const std::string& path) const;
+
+    // Loads every *.scsyndef file in a directory (non-recursive)
+    std::vector<LoadedSynthDef> loadDirectory(const std::string& path) const;
+
+    std::vector<LoadedSynthDef> parse(std::span<const std::uint8_t> data) const;
+
+private:
+    const UGenRegistry& m_registry;
+};
+
+} // namespace tinysynth
@@ -0,0 +1,136 @@
+// SynthDefNode.cpp
+#include "SynthDefNode.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace tinysynth {
+
+namespace {
+
+constexpr std::array<float, 1024> SILENCE{};
+
+unsigned int parameterOr(const UGenInstance &ugen, const std::string &name,
+                         float fallback) {
+  const auto found = ugen.parameters.find(name);
+  return static_cast<unsigned int>(found != ugen.parameters.end()
+                                       ? found->second
+                                       : fallback);
+}
+
+} // namespace
+
+SynthDefBuses SynthDefBuses::of(const SynthDef &synthDef) {
+  SynthDefBuses buses;
+  for (const auto &ugen : synthDef.getUGens()) {
+    const unsigned int bus = parameterOr(ugen, "bus", 0);
+    if (ugen.ugenType == "In") {
+      buses.numInputs = std::max(
+          buses.numInputs, bus + parameterOr(ugen, "numChannels", 1));
+    } else if (ugen.ugenType == "Out" || ugen.ugenType == "ReplaceOut") {
+      // Like the compiler: as many channels as wired inputs, if more
+      unsigned int channels = parameterOr(ugen, "numChannels", 0);
+      for (const auto &connection : synthDef.getConnections()) {
+        if (connection.toUGen == ugen.instanceName) {
+          channels = std::max(channels, connection.inputIndex + 1);
+        }
+      }
+      buses.numOutputs = std::max(buses.numOutputs, bus + channels);
+    }
+  }
+  return buses;
+}
+
+SynthDefNode::SynthDefNode(std::shared_ptr<const CompiledSynthDef> def,
+                               SynthDefBuses buses)
+    : m_def(std::move(def)), m_buses(buses), m_sampleRate(48000.0F),
+      m_inputPointers(buses.numInputs), m_outputPointers(buses.numOutputs) {
+  static_assert(SILENCE.size() == MAX_SLICE);
+  if (!m_def) {
+    throw std::invalid_argument("SynthDefNode needs a compiled SynthDef");
+  }
+  if (buses.numInputs < m_def->numInputs ||
+      buses.numOutputs < m_def->numOutputs) {
+    throw std::invalid_argument("SynthDefNode has fewer buses than " +
+                                m_def->name + " reaches");
+  }
+  m_state = RealtimeMemory::allocate(m_def->layout.size(),
+                                     m_def->layout.alignment());
+  m_def->layout.initialize(m_state);
+}
+
+SynthDefNode::~SynthDefNode() {
+  RealtimeMemory::deallocate(m_state, m_def->layout.size(),
+                             m_def->layout.alignment());
+}
+
+void SynthDefNode::process(const std::vector<std::optional<float *>> &inputs,
+                             std::vector<float *> &outputs,
+                             unsigned int numFrames) {
+  for (unsigned int offset = 0; offset < numFrames; offset += MAX_SLICE) {
+    const unsigned int count = std::min(numFrames - offset, MAX_SLICE);
+    for (std::size_t i = 0; i < m_inputPointers.size(); ++i) {
+      const bool connected = i < inputs.size() && inputs[i].has_value();
+      m_inputPointers[i] =
+          connected ? *inputs[i] + offset : SILENCE.data();
+    }
+    // Out mixes, so the buffers start silent
+    for (std::size_t o = 0; o < m_outputPointers.size(); ++o) {
+      m_outputPointers[o] = outputs[o] + offset;
+      std::fill(m_outputPointers[o], m_outputPointers[o] + count, 0.0F);
+    }
+    m_def->process(m_state, m_inputPointers.data(), m_outputPointers.data(),
+                   static_cast<std::int32_t>(count), m_sampleRate);
+  }
+}
+
+std::string SynthDefNode::getInputName(unsigned int index) const {
+  return "in" + std::to_string(index);
+}
+
+std::string SynthDefNode::getOutputName(unsigned int index) const {
+  return "out" + std::to_string(index);
+}
+
+float *SynthDefNode::control(const std::string &name) const {
+  const auto offset = m_def->layout.controlOffset(name);
+  return offset ? reinterpret_cast<float *>(static_cast<char *>(m_state) +
+                                            *offset)
+                : nullptr;
+}
+
+void SynthDefNode::setParameter(const std::string &name, float value) {
+  float *target = control(name);
+  if (target == nullptr) {
+    throw std::invalid_argument("Unknown parameter: " + name);
+  }
+  *target = value;
+}
+
+float SynthDefNode::getParameter(const std::string &name) const {
+  const float *source = control(name);
+  if (source == nullptr) {
+    throw std::invalid_argument("Unknown parameter: " + name);
+  }
+  return *source;
+}
+
+std::vector<std::string> SynthDefNode::getParameterNames() const {
+  std::vector<std::string> names;
+  for (const auto &field : m_def->layout.fields()) {
+    if (field.owner.empty()) {
+      names.push_back(field.name);
+    }
+  }
+  return names;
+}
+
+std::unique_ptr<Module<float>> SynthDefNode::clone() const {
+  auto copy = std::make_unique<SynthDefNode>(m_def, m_buses);
+  copy->m_sampleRate = m_sampleRate;
+  std::copy_n(static_cast<const char *>(m_state), m_def->layout.size(),
+              static_cast<char *>(copy->m_state));
+  return copy;
+}
+
+} // namespace tinysynth
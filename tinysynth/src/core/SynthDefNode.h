@@ -0,0 +1,64 @@
+// SynthDefNode.h
+#pragma once
+
+#include "Module.h"
+#include "SynthDefJIT.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// Bus counts a SynthDef's In and Out UGens reach: a node must be handed at
+// least this many input and output buffers
+struct SynthDefBuses {
+    unsigned int numInputs = 0;
+    unsigned int numOutputs = 0;
+
+    static SynthDefBuses of(const SynthDef& synthDef);
+};
+
+// One node of a compiled SynthDef as a graph module, so SynthDefs and
+// ModularSystem modules play in the same graph. Input i is the SynthDef's
+// In bus i and output i its Out bus i; parameters are its controls. The
+// state block is allocated with the module, never on the audio thread.
+class SynthDefNode : public Module<float> {
+public:
+    SynthDefNode(std::shared_ptr<const CompiledSynthDef> def, SynthDefBuses buses);
+    SynthDefNode(const SynthDefNode&) = delete;
+    SynthDefNode& operator=(const SynthDefNode&) = delete;
+    ~SynthDefNode() override;
+
+    void process(const std::vector<std::optional<float*>>& inputs, std::vector<float*>& outputs,
+                 unsigned int numFrames) override;
+
+    [[nodiscard]] unsigned int getNumInputs() const override { return m_buses.numInputs; }
+    [[nodiscard]] unsigned int getNumOutputs() const override { return m_buses.numOutputs; }
+    [[nodiscard]] std::string getInputName(unsigned int index) const override;
+    [[nodiscard]] std::string getOutputName(unsigned int index) const override;
+    void setParameter(const std::string& name, float value) override;
+    [[nodiscard]] float getParameter(const std::string& name) const override;
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override;
+    [[nodiscard]] std::string getName() const override { return m_def->name; }
+    [[nodiscard]] std::string getDescription() const override { return "SynthDef node"; }
+    [[nodiscard]] std::unique_ptr<Module<float>> clone() const override;
+    void reset() override { m_def->layout.initialize(m_state); }
+    void prepare(unsigned int sampleRate) override {
+        m_sampleRate = static_cast<float>(sampleRate);
+    }
+
+private:
+    // Unconnected inputs read silence, at most this many frames per call
+    static constexpr unsigned int MAX_SLICE = 1024;
+
+    [[nodiscard]] float* control(const std::string& name) const;
+
+    std::shared_ptr<const CompiledSynthDef> m_def;
+    SynthDefBuses m_buses;
+    void* m_state;
+    float m_sampleRate;
+    std::vector<const float*> m_inputPointers;
+    std::vector<float*> m_outputPointers;
+};
+
+} // namespace tinysynth
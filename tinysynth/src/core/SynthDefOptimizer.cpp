@@ -0,0 +1,436 @@
+// SynthDefOptimizer.cpp
+#include "SynthDefOptimizer.h"
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace tinysynth {
+
+namespace {
+
+struct Source {
+  int node = -1;
+  unsigned int output = 0;
+
+  [[nodiscard]] bool connected() const { return node >= 0; }
+};
+
+struct Node {
+  UGenInstance ugen;
+  const UGenSpec *spec;
+  std::vector<Source> inputs;
+  bool alive = true;
+};
+
+std::optional<float> evaluate(const std::string &type,
+                              const std::vector<float> &in) {
+  if (type == "Add") {
+    return in[0] + in[1];
+  }
+  if (type == "Sub") {
+    return in[0] - in[1];
+  }
+  if (type == "Mul") {
+    return in[0] * in[1];
+  }
+  if (type == "Div" && in[1] != 0.0F) {
+    return in[0] / in[1];
+  }
+  if (type == "MulAdd") {
+    return in[0] * in[1] + in[2];
+  }
+  return std::nullopt;
+}
+
+std::string formatFloat(float value) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%a", static_cast<double>(value));
+  return buffer;
+}
+
+class Graph {
+public:
+  Graph(const SynthDef &synthDef, const UGenRegistry &registry)
+      : m_registry(registry) {
+    const auto &ugens = synthDef.getUGens();
+    m_nodes.reserve(ugens.size());
+    std::unordered_map<std::string, int> indices;
+    for (const auto &ugen : ugens) {
+      indices[ugen.instanceName] = static_cast<int>(m_nodes.size());
+      const UGenSpec *spec = registry.find(ugen.ugenType);
+      Node node{ugen, spec, {}};
+      if (spec != nullptr) {
+        node.inputs.resize(spec->inputNames.size());
+      }
+      m_nodes.push_back(std::move(node));
+    }
+
+    for (const auto &conn : synthDef.getConnections()) {
+      auto from = indices.find(conn.fromUGen);
+      auto to = indices.find(conn.toUGen);
+      if (from == indices.end() || to == indices.end()) {
+        throw std::runtime_error("Connection references unknown UGen: " +
+                                 conn.fromUGen + " -> " + conn.toUGen);
+      }
+      auto &inputs = m_nodes[to->second].inputs;
+      if (conn.inputIndex >= inputs.size()) {
+        inputs.resize(conn.inputIndex + 1);
+      }
+      inputs[conn.inputIndex] = {from->second, conn.outputIndex};
+    }
+  }
+
+  // Pure UGens whose inputs are all constant become a constant
+  bool foldConstants(OptimizationStats &stats) {
+    bool changed = false;
+    for (int n = 0; n < static_cast<int>(m_nodes.size()); ++n) {
+      Node &node = m_nodes[n];
+      if (!node.alive || node.spec == nullptr || !node.spec->pure) {
+        continue;
+      }
+      std::vector<float> values;
+      bool allConstant = true;
+      for (unsigned int i = 0; i < node.spec->inputNames.size(); ++i) {
+        auto value = constantInput(node, i);
+        if (!value) {
+          allConstant = false;
+          break;
+        }
+        values.push_back(*value);
+      }
+      if (!allConstant) {
+        continue;
+      }
+      if (auto result = evaluate(node.ugen.ugenType, values)) {
+        replaceWithConstant(n, *result);
+        ++stats.folded;
+        changed = true;
+      }
+    }
+    return changed;
+  }
+
+  // Algebraic identities: x*1, x+0, x-0, x/1, x*0 and MulAdd special cases
+  bool reduceStrength(OptimizationStats &stats) {
+    bool changed = false;
+    for (int n = 0; n < static_cast<int>(m_nodes.size()); ++n) {
+      Node &node = m_nodes[n];
+      if (!node.alive || node.spec == nullptr || !node.spec->pure) {
+        continue;
+      }
+      if (reduceNode(n)) {
+        ++stats.reduced;
+        changed = true;
+      }
+    }
+    return changed;
+  }
+
+  // Merges pure UGens of the same type with identical inputs and
+  // parameters. Stateful ones (oscillators, noise, filters) are never
+  // merged: two of them are independent sources even when fed alike.
+  bool eliminateCommonSubexpressions(OptimizationStats &stats) {
+    bool changed = false;
+    std::unordered_map<std::string, int> seen;
+    for (int n = 0; n < static_cast<int>(m_nodes.size()); ++n) {
+      const Node &node = m_nodes[n];
+      if (!node.alive || node.spec == nullptr || !node.spec->pure) {
+        continue;
+      }
+      auto [it, inserted] = seen.emplace(signature(node), n);
+      if (!inserted) {
+        redirect(n, it->second);
+        m_nodes[n].alive = false;
+        ++stats.merged;
+        changed = true;
+      }
+    }
+    return changed;
+  }
+
+  // Keeps only UGens that (transitively) feed a side effect: a sink (Out,
+  // ReplaceOut) or an unknown UGen, which may have one. A def without any
+  // has no audible output and is emptied.
+  bool removeDeadUGens(OptimizationStats &stats) {
+    std::vector<bool> live(m_nodes.size(), false);
+    std::vector<int> stack;
+    for (int n = 0; n < static_cast<int>(m_nodes.size()); ++n) {
+      const Node &node = m_nodes[n];
+      if (node.alive && (node.spec == nullptr || node.spec->sink)) {
+        live[n] = true;
+        stack.push_back(n);
+      }
+    }
+    while (!stack.empty()) {
+      int n = stack.back();
+      stack.pop_back();
+      for (const auto &input : m_nodes[n].inputs) {
+        if (input.connected() && !live[input.node]) {
+          live[input.node] = true;
+          stack.push_back(input.node);
+        }
+      }
+    }
+
+    bool changed = false;
+    for (std::size_t n = 0; n < m_nodes.size(); ++n) {
+      if (m_nodes[n].alive && !live[n]) {
+        m_nodes[n].alive = false;
+        ++stats.removed;
+        changed = true;
+      }
+    }
+    return changed;
+  }
+
+  [[nodiscard]] SynthDef toSynthDef(const SynthDef &original) const {
+    SynthDef result;
+    result.setName(original.getName());
+    for (const auto &control : original.getControls()) {
+      result.addControl(control);
+    }
+    for (const auto &node : m_nodes) {
+      if (node.alive) {
+        result.addUGen(node.ugen);
+      }
+    }
+    for (const auto &node : m_nodes) {
+      if (!node.alive) {
+        continue;
+      }
+      for (unsigned int i = 0; i < node.inputs.size(); ++i) {
+        const Source &input = node.inputs[i];
+        if (input.connected()) {
+          result.addConnection({m_nodes[input.node].ugen.instanceName,
+                                input.output, node.ugen.instanceName, i});
+        }
+      }
+    }
+    return result;
+  }
+
+private:
+  static std::string parameterName(const Node &node, unsigned int index) {
+    if (index < node.spec->inputNames.size()) {
+      return node.spec->inputNames[index];
+    }
+    return "in" + std::to_string(index);
+  }
+
+  static bool isInputParameter(const Node &node, const std::string &name) {
+    const auto &names = node.spec->inputNames;
+    if (std::find(names.begin(), names.end(), name) != names.end()) {
+      return true;
+    }
+    return node.spec->variadic && name.size() > 2 && name.starts_with("in") &&
+           std::all_of(name.begin() + 2, name.end(),
+                       [](char c) { return c >= '0' && c <= '9'; });
+  }
+
+  static std::optional<float> constantInput(const Node &node,
+                                            unsigned int index) {
+    if (index < node.inputs.size() && node.inputs[index].connected()) {
+      return std::nullopt;
+    }
+    auto it = node.ugen.parameters.find(parameterName(node, index));
+    return it != node.ugen.parameters.end() ? it->second
+                                            : node.spec->inputDefault(index);
+  }
+
+  bool isConstant(const Node &node, unsigned int index, float value) const {
+    auto constant = constantInput(node, index);
+    return constant && *constant == value;
+  }
+
+  bool reduceNode(int n) {
+    Node &node = m_nodes[n];
+    const std::string &type = node.ugen.ugenType;
+    auto bypass = [&](unsigned int input) {
+      if (!node.inputs[input].connected()) {
+        return false;
+      }
+      replaceWithSource(n, node.inputs[input]);
+      node.alive = false;
+      return true;
+    };
+
+    if (type == "Mul") {
+      if (isConstant(node, 0, 0.0F) || isConstant(node, 1, 0.0F)) {
+        replaceWithConstant(n, 0.0F);
+        return true;
+      }
+      return (isConstant(node, 0, 1.0F) && bypass(1)) ||
+             (isConstant(node, 1, 1.0F) && bypass(0));
+    }
+    if (type == "Add") {
+      return (isConstant(node, 0, 0.0F) && bypass(1)) ||
+             (isConstant(node, 1, 0.0F) && bypass(0));
+    }
+    if (type == "Sub") {
+      return isConstant(node, 1, 0.0F) && bypass(0);
+    }
+    if (type == "Div") {
+      return isConstant(node, 1, 1.0F) && bypass(0);
+    }
+    if (type == "MulAdd") {
+      if (isConstant(node, 1, 0.0F)) {
+        if (auto add = constantInput(node, 2)) {
+          replaceWithConstant(n, *add);
+          return true;
+        }
+        return bypass(2);
+      }
+      if (isConstant(node, 1, 1.0F) && isConstant(node, 2, 0.0F)) {
+        return bypass(0);
+      }
+      if (isConstant(node, 2, 0.0F)) {
+        rewriteBinary(node, "Mul", 0, 1);
+        return true;
+      }
+      if (isConstant(node, 1, 1.0F)) {
+        rewriteBinary(node, "Add", 0, 2);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Turns a MulAdd into a two-input UGen fed by its inputs a and b
+  void rewriteBinary(Node &node, const std::string &type, unsigned int a,
+                     unsigned int b) {
+    const UGenSpec *spec = m_registry.find(type);
+    if (spec == nullptr) {
+      throw std::runtime_error("UGen type not registered: " + type);
+    }
+    UGenInstance ugen{type, node.ugen.instanceName, {}};
+    std::vector<Source> inputs(2);
+    for (unsigned int i = 0; i < 2; ++i) {
+      unsigned int from = i == 0 ? a : b;
+      inputs[i] = node.inputs[from];
+      ugen.parameters[spec->inputNames[i]] =
+          constantInput(node, from).value_or(0.0F);
+    }
+    node.ugen = std::move(ugen);
+    node.spec = spec;
+    node.inputs = std::move(inputs);
+  }
+
+  void replaceWithConstant(int n, float value) {
+    for (auto &consumer : m_nodes) {
+      if (!consumer.alive) {
+        continue;
+      }
+      for (unsigned int i = 0; i < consumer.inputs.size(); ++i) {
+        Source &input = consumer.inputs[i];
+        if (input.node != n) {
+          continue;
+        }
+        input = {};
+        if (consumer.spec == nullptr) {
+          continue;
+        }
+        const std::string name = parameterName(consumer, i);
+        auto it = consumer.ugen.parameters
+                      .emplace(name, consumer.spec->inputDefault(i))
+                      .first;
+        switch (consumer.spec->inputMode(i)) {
+        case InputMode::Replace:
+          it->second = value;
+          break;
+        case InputMode::Add:
+          it->second += value;
+          break;
+        case InputMode::Multiply:
+          it->second *= value;
+          break;
+        }
+      }
+    }
+    m_nodes[n].alive = false;
+  }
+
+  void replaceWithSource(int n, Source replacement) {
+    for (auto &consumer : m_nodes) {
+      for (auto &input : consumer.inputs) {
+        if (input.node == n) {
+          input = replacement;
+        }
+      }
+    }
+  }
+
+  // Points every use of node `from` at the same output of node `to`
+  void redirect(int from, int to) {
+    for (auto &consumer : m_nodes) {
+      for (auto &input : consumer.inputs) {
+        if (input.node == from) {
+          input.node = to;
+        }
+      }
+    }
+  }
+
+  [[nodiscard]] std::string signature(const Node &node) const {
+    std::vector<std::string> inputs;
+    for (unsigned int i = 0; i < node.inputs.size(); ++i) {
+      const Source &input = node.inputs[i];
+      if (input.connected()) {
+        inputs.push_back("n" + std::to_string(input.node) + ":" +
+                         std::to_string(input.output));
+      } else {
+        inputs.push_back("c" + formatFloat(*constantInput(node, i)));
+      }
+    }
+    const std::string &type = node.ugen.ugenType;
+    if ((type == "Add" || type == "Mul") && inputs.size() == 2 &&
+        inputs[1] < inputs[0]) {
+      std::swap(inputs[0], inputs[1]);
+    }
+
+    // Parameters that are not inputs (phase, bus, ...) also matter
+    std::vector<std::string> extra;
+    for (const auto &[name, value] : node.ugen.parameters) {
+      if (!isInputParameter(node, name)) {
+        extra.push_back(name + "=" + formatFloat(value));
+      }
+    }
+    std::sort(extra.begin(), extra.end());
+
+    std::string key = type;
+    for (const auto &part : inputs) {
+      key += "|" + part;
+    }
+    for (const auto &part : extra) {
+      key += "|" + part;
+    }
+    return key;
+  }
+
+  const UGenRegistry &m_registry;
+  std::vector<Node> m_nodes;
+};
+
+} // namespace
+
+SynthDefOptimizer::SynthDefOptimizer(const UGenRegistry &registry)
+    : m_registry(registry) {}
+
+SynthDef SynthDefOptimizer::optimize(const SynthDef &synthDef,
+                                     OptimizationStats *stats) const {
+  OptimizationStats local;
+  OptimizationStats &counters = stats ? *stats : local;
+
+  Graph graph(synthDef, m_registry);
+  bool changed = true;
+  while (changed) {
+    changed = graph.foldConstants(counters);
+    changed |= graph.reduceStrength(counters);
+    changed |= graph.eliminateCommonSubexpressions(counters);
+    changed |= graph.removeDeadUGens(counters);
+  }
+  return graph.toSynthDef(synthDef);
+}
+
+} // namespace tinysynth
@@ -0,0 +1,29 @@
+// SynthDefOptimizer.h
+#pragma once
+
+#include "SynthDef.h"
+#include "UGenRegistry.h"
+
+namespace tinysynth {
+
+struct OptimizationStats {
+    unsigned int folded = 0;  // UGens replaced by a constant
+    unsigned int reduced = 0; // UGens bypassed or simplified (x*1, x+0, ...)
+    unsigned int merged = 0;  // duplicate UGens merged into one
+    unsigned int removed = 0; // UGens whose outputs were unused
+};
+
+// Graph-level rewrites applied to a SynthDef before it is compiled or
+// instantiated. UGen types unknown to the registry are never touched.
+class SynthDefOptimizer {
+public:
+    explicit SynthDefOptimizer(const UGenRegistry& registry = UGenRegistry::builtin());
+
+    [[nodiscard]] SynthDef optimize(const SynthDef& synthDef,
+                                    OptimizationStats* stats = nullptr) const;
+
+private:
+    const UGenRegistry& m_registry;
+};
+
+} // namespace tinysynth
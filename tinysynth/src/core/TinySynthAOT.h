@@ -0,0 +1,55 @@
+// TinySynthAOT.h
+#pragma once
+
+// C ABI of SynthDefs compiled ahead of time by SynthDefCodeGenerator. A
+// generated source file exports one function per SynthDef,
+//
+//   const TinySynthAOTSynthDef* tinysynth_synthdef_<name>(void);
+//
+// where <name> is the SynthDef name with every character outside
+// [A-Za-z0-9_] replaced by '_'. Plain C, so hosts without tinysynth can load
+// the libraries; a host must check abiVersion before using anything else.
+
+#include <stdint.h>
+
+#define TINYSYNTH_AOT_ABI_VERSION 2
+
+#if defined(_WIN32)
+#define TINYSYNTH_AOT_EXPORT __declspec(dllexport)
+#else
+#define TINYSYNTH_AOT_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One float of per-node state; owner is "" for synth-level controls
+typedef struct TinySynthAOTField {
+    const char* owner;
+    const char* name;
+    uint32_t offset; // bytes from the start of the state block
+    float initialValue;
+} TinySynthAOTField;
+
+typedef struct TinySynthAOTSynthDef {
+    uint32_t abiVersion;
+    const char* name;
+    uint32_t stateSize;
+    uint32_t stateAlignment;
+    uint32_t numFields;
+    const TinySynthAOTField* fields;
+    // Writes the initial state into a block of stateSize bytes
+    void (*initialize)(void* state);
+    // Mixes numFrames samples into outputs, like a JIT-compiled SynthDef
+    void (*process)(void* state, const float* const* inputs, float* const* outputs,
+                    int32_t numFrames, float sampleRate);
+    // Buffers process reads and writes: inputs and outputs must hold at
+    // least this many pointers
+    uint32_t numInputs;
+    uint32_t numOutputs;
+} TinySynthAOTSynthDef;
+
+#ifdef __cplusplus
+}
+#endif
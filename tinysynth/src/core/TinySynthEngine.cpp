@@ -0,0 +1,595 @@
+// TinySynthEngine.cpp
+#include "TinySynthEngine.h"
+#include "../modules/Oscillator.h"
+#include "DenormalGuard.h"
+#include "GraphProcessor.h"
+#include "Interleave.h"
+#include "SynthDefJIT.h"
+#include "SynthDefLoader.h"
+#include "SynthDefNode.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace tinysynth;
+
+namespace {
+
+thread_local std::string lastError;
+
+// Errors that map to TINYSYNTH_ERROR_NOT_FOUND and _QUEUE_FULL
+struct NotFound : std::invalid_argument {
+  using std::invalid_argument::invalid_argument;
+};
+struct QueueFull : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+// Runs an API call, turning any exception into a status
+template <typename Call> int32_t guard(Call &&call) {
+  try {
+    return call();
+  } catch (const NotFound &error) {
+    lastError = error.what();
+    return TINYSYNTH_ERROR_NOT_FOUND;
+  } catch (const std::invalid_argument &error) {
+    lastError = error.what();
+    return TINYSYNTH_ERROR_INVALID_ARGUMENT;
+  } catch (const QueueFull &error) {
+    lastError = error.what();
+    return TINYSYNTH_ERROR_QUEUE_FULL;
+  } catch (const std::exception &error) {
+    lastError = error.what();
+  } catch (...) {
+    lastError = "unknown error";
+  }
+  return TINYSYNTH_ERROR_FAILED;
+}
+
+template <typename Oscillator> std::unique_ptr<Module<float>> makeModule() {
+  return std::make_unique<Oscillator>();
+}
+
+} // namespace
+
+// The engine behind the handle: a GraphProcessor rendered by the host, and
+// the node table of the OSC server without the OSC. Control calls hold
+// m_controlMutex, which makes them the single producer thread of both
+// control sources; render calls only touch the GraphProcessor.
+struct TinySynthEngine {
+  using ModuleFactory = std::function<std::unique_ptr<Module<float>>()>;
+
+  // A node def: a compiled SynthDef or a module type
+  struct Definition {
+    std::shared_ptr<const CompiledSynthDef> synthDef;
+    SynthDefBuses buses;
+    ModuleFactory factory;
+  };
+
+  struct Node {
+    std::string module;
+    std::vector<std::string> parameters;
+    // Identifies the node when the audio side rejects its AddModule
+    const Module<float> *instance = nullptr;
+    // Until its scheduled AddModule is confirmed: its frame and sequence.
+    // Commands for the node go no earlier than that frame.
+    std::optional<std::uint64_t> startFrame;
+    std::uint32_t addSequence = 0;
+    // Freed before it started; the ID stays taken until the removal has run
+    bool freed = false;
+  };
+
+  TinySynthEngine(unsigned int numInputs, unsigned int numOutputs,
+                  unsigned int sampleRate, unsigned int maxBlockSize);
+
+  int32_t loadSynthDefs(std::span<const std::uint8_t> data);
+  int32_t loadSynthDefFile(const std::string &path);
+  int32_t newNode(const char *defName, int32_t node,
+                  std::span<const TinySynthControl> controls,
+                  std::uint64_t frame);
+  int32_t freeNodes(std::span<const int32_t> nodes, std::uint64_t frame);
+  int32_t paramIndex(int32_t node, const char *name);
+  int32_t setParams(std::span<const TinySynthParamSet> sets,
+                    std::uint64_t frame);
+  void render(const float *const *inputs, float *const *outputs,
+              unsigned int numFrames);
+  void renderInterleaved(const float *input, float *output,
+                         unsigned int numFrames);
+  TinySynthStats getStats();
+
+  void addSynthDef(const SynthDef &synthDef);
+  ControlEventBus::Producer &producer(std::uint64_t frame) {
+    return frame == TINYSYNTH_NOW ? m_commands : m_scheduled;
+  }
+  // `frame`, or the node's start frame when that is later
+  static std::uint64_t frameFor(const Node &record, std::uint64_t frame);
+  // Pushes or throws QueueFull
+  void push(std::uint64_t frame, EngineCommand &command);
+  // Deletes returned modules, forgets nodes the audio side rejected or
+  // removed after freeing them early, and notes nodes that have started
+  void collectReplies();
+  const Node &findNode(int32_t node) const;
+
+  GraphProcessor m_graph;
+  SynthDefJIT m_jit;
+  unsigned int m_maxBlockSize;
+  ControlEventBus::Producer &m_commands;
+  ControlEventBus::Producer &m_scheduled;
+
+  std::mutex m_controlMutex;
+  std::unordered_map<std::string, Definition> m_definitions;
+  std::unordered_map<int32_t, Node> m_nodes;
+  int32_t m_nextAutoNode = -2;
+  std::uint64_t m_queued = 0;
+  std::uint64_t m_failed = 0;
+
+  // Render thread: block pointers and interleaving buffers
+  std::vector<const float *> m_inputPointers;
+  std::vector<float *> m_outputPointers;
+  std::vector<std::vector<float>> m_inputBuffers;
+  std::vector<std::vector<float>> m_outputBuffers;
+  std::vector<float *> m_bufferInputs;
+  std::vector<float *> m_bufferOutputs;
+};
+
+TinySynthEngine::TinySynthEngine(unsigned int numInputs,
+                                 unsigned int numOutputs,
+                                 unsigned int sampleRate,
+                                 unsigned int maxBlockSize)
+    : m_graph(numInputs, numOutputs), m_maxBlockSize(maxBlockSize),
+      // Only rejections and removed modules come back, so a host that
+      // streams controls and rarely frees has next to nothing to collect
+      m_commands(m_graph.addControlSource("capi", false)),
+      m_scheduled(m_graph.addScheduledControlSource("capi-scheduled", false)),
+      m_inputPointers(numInputs), m_outputPointers(numOutputs),
+      m_inputBuffers(numInputs, std::vector<float>(maxBlockSize, 0.0F)),
+      m_outputBuffers(numOutputs, std::vector<float>(maxBlockSize)) {
+  if (sampleRate == 0 || maxBlockSize == 0) {
+    throw std::invalid_argument("Engine needs a sample rate and a block size");
+  }
+  for (auto &buffer : m_inputBuffers) {
+    m_bufferInputs.push_back(buffer.data());
+  }
+  for (auto &buffer : m_outputBuffers) {
+    m_bufferOutputs.push_back(buffer.data());
+  }
+  m_graph.prepare(sampleRate, maxBlockSize);
+  m_definitions["SineOsc"] = {nullptr, {}, makeModule<SineOsc<float>>};
+  m_definitions["SawOsc"] = {nullptr, {}, makeModule<SawOsc<float>>};
+  m_definitions["TriangleOsc"] = {nullptr, {}, makeModule<TriangleOsc<float>>};
+  m_definitions["SquareOsc"] = {nullptr, {}, makeModule<SquareOsc<float>>};
+  m_definitions["PulseOsc"] = {nullptr, {}, makeModule<PulseOsc<float>>};
+}
+
+void TinySynthEngine::addSynthDef(const SynthDef &synthDef) {
+  m_definitions[synthDef.getName()] = {
+      m_jit.compile(synthDef), SynthDefBuses::of(synthDef), nullptr};
+}
+
+int32_t TinySynthEngine::loadSynthDefs(std::span<const std::uint8_t> data) {
+  SynthDefLoader loader;
+  const auto loaded = loader.parse(data);
+  std::lock_guard<std::mutex> lock(m_controlMutex);
+  for (const auto &def : loaded) {
+    addSynthDef(def.synthDef);
+  }
+  return static_cast<int32_t>(loaded.size());
+}
+
+int32_t TinySynthEngine::loadSynthDefFile(const std::string &path) {
+  SynthDefLoader loader;
+  const auto loaded = loader.loadFile(path);
+  std::lock_guard<std::mutex> lock(m_controlMutex);
+  for (const auto &def : loaded) {
+    addSynthDef(def.synthDef);
+  }
+  return static_cast<int32_t>(loaded.size());
+}
+
+int32_t TinySynthEngine::newNode(const char *defName, int32_t node,
+                                 std::span<const TinySynthControl> controls,
+                                 std::uint64_t frame) {
+  std::lock_guard<std::mutex> lock(m_controlMutex);
+  collectReplies();
+  const auto found = m_definitions.find(defName);
+  if (found == m_definitions.end()) {
+    throw NotFound("SynthDef " + std::string(defName) + " not found");
+  }
+  const Definition &definition = found->second;
+  if (node < 0) {
+    node = m_nextAutoNode--;
+  }
+  if (m_nodes.count(node) != 0) {
+    throw std::invalid_argument("duplicate node ID " + std::to_string(node));
+  }
+
+  std::unique_ptr<Module<float>> module;
+  if (definition.synthDef) {
+    module =
+        std::make_unique<SynthDefNode>(definition.synthDef, definition.buses);
+  } else {
+    module = definition.factory();
+  }
+  Node record;
+  record.module = "n" + std::to_string(node);
+  record.parameters = module->getParameterNames();
+  record.instance = module.get();
+  unsigned int firstChannel = 0;
+  for (const TinySynthControl &control : controls) {
+    const std::string name = control.name != nullptr ? control.name : "";
+    if (name == "out" && definition.factory) {
+      firstChannel =
+          static_cast<unsigned int>(std::max(0, static_cast<int>(control.value)));
+      continue;
+    }
+    if (std::find(record.parameters.begin(), record.parameters.end(), name) ==
+        record.parameters.end()) {
+      throw NotFound("unknown control " + name);
+    }
+    module->setParameter(name, control.value);
+  }
+  m_graph.prepareModule(*module);
+
+  // The node and its routes go together or not at all
+  const unsigned int numOutputs =
+      firstChannel < m_graph.getNumOutputs()
+          ? std::min(module->getNumOutputs(),
+                     m_graph.getNumOutputs() - firstChannel)
+          : 0;
+  const unsigned int numInputs =
+      definition.synthDef
+          ? std::min(module->getNumInputs(), m_graph.getNumInputs())
+          : 0;
+  if (producer(frame).getFreeSpace() < 1 + numOutputs + numInputs) {
+    throw QueueFull("engine command queue full");
+  }
+  EngineCommand add = EngineCommand::addModule(record.module, module.get());
+  // A scheduled node's commands wait for its start until this comes back
+  add.confirm = frame != TINYSYNTH_NOW;
+  push(frame, add);
+  module.release(); // owned by the command now
+  if (add.confirm) {
+    record.startFrame = frame;
+    record.addSequence = add.sequence;
+  }
+  for (unsigned int output = 0; output < numOutputs; ++output) {
+    EngineCommand route = EngineCommand::connectOutput(record.module, output,
+                                                       firstChannel + output);
+    push(frame, route);
+  }
+  for (unsigned int input = 0; input < numInputs; ++input) {
+    EngineCommand capture = EngineCommand::connect(
+        GraphProcessor::INPUT_MODULE, input, record.module, input);
+    push(frame, capture);
+  }
+  m_nodes.emplace(node, std::move(record));
+  return node;
+}
+
+int32_t TinySynthEngine::freeNodes(std::span<const int32_t> nodes,
+                                   std::uint64_t frame) {
+  std::lock_guard<std::mutex> lock(m_controlMutex);
+  collectReplies();
+  for (const int32_t node : nodes) {
+    findNode(node);
+  }
+  int32_t freed = 0;
+  for (const int32_t node : nodes) {
+    // A node listed twice is already gone
+    const auto found = m_nodes.find(node);
+    if (found == m_nodes.end() || found->second.freed) {
+      continue;
+    }
+    EngineCommand command = EngineCommand::removeModule(found->second.module);
+    const std::uint64_t at = frameFor(found->second, frame);
+    if (!producer(at).push(at, command)) {
+      break;
+    }
+    ++m_queued;
+    if (found->second.startFrame) {
+      // Removed at its start frame at the earliest; until then the ID is
+      // taken, or a new node under it would be the one removed
+      found->second.freed = true;
+    } else {
+      m_nodes.erase(found);
+    }
+    ++freed;
+  }
+  return freed;
+}
+
+int32_t TinySynthEngine::paramIndex(int32_t node, const char *name) {
+  std::lock_guard<std::mutex> lock(m_controlMutex);
+  const Node &record = findNode(node);
+  const auto match =
+      std::find(record.parameters.begin(), record.parameters.end(), name);
+  if (match == record.parameters.end()) {
+    throw NotFound("unknown control " + std::string(name) + " on node " +
+                   std::to_string(node));
+  }
+  return static_cast<int32_t>(match - record.parameters.begin());
+}
+
+int32_t TinySynthEngine::setParams(std::span<const TinySynthParamSet> sets,
+                                   std::uint64_t frame) {
+  std::lock_guard<std::mutex> lock(m_controlMutex);
+  collectReplies();
+  // Unknown controls would be rejected on the audio side; they stop here
+  for (const TinySynthParamSet &set : sets) {
+    if (set.param >= findNode(set.node).parameters.size()) {
+      throw NotFound("control index " + std::to_string(set.param) +
+                     " out of range on node " + std::to_string(set.node));
+    }
+  }
+  int32_t queued = 0;
+  for (const TinySynthParamSet &set : sets) {
+    const Node &record = m_nodes.find(set.node)->second;
+    EngineCommand command = EngineCommand::setParameter(
+        record.module, record.parameters[set.param], set.value);
+    const std::uint64_t at = frameFor(record, frame);
+    if (!producer(at).push(at, command)) {
+      break;
+    }
+    ++queued;
+  }
+  m_queued += static_cast<std::uint64_t>(queued);
+  return queued;
+}
+
+void TinySynthEngine::render(const float *const *inputs,
+                             float *const *outputs, unsigned int numFrames) {
+  ScopedDenormalGuard denormalGuard;
+  for (unsigned int done = 0; done < numFrames;) {
+    const unsigned int block = std::min(m_maxBlockSize, numFrames - done);
+    for (std::size_t i = 0; i < m_inputPointers.size(); ++i) {
+      m_inputPointers[i] = inputs[i] + done;
+    }
+    for (std::size_t i = 0; i < m_outputPointers.size(); ++i) {
+      m_outputPointers[i] = outputs[i] + done;
+      std::fill(m_outputPointers[i], m_outputPointers[i] + block, 0.0F);
+    }
+    m_graph.process(m_inputPointers.data(), m_outputPointers.data(), block);
+    done += block;
+  }
+}
+
+void TinySynthEngine::renderInterleaved(const float *input, float *output,
+                                        unsigned int numFrames) {
+  ScopedDenormalGuard denormalGuard;
+  const auto numInputs = static_cast<unsigned int>(m_inputBuffers.size());
+  const auto numOutputs = static_cast<unsigned int>(m_outputBuffers.size());
+  for (unsigned int done = 0; done < numFrames;) {
+    const unsigned int block = std::min(m_maxBlockSize, numFrames - done);
+    if (numInputs > 0) {
+      deinterleave(input + static_cast<std::size_t>(done) * numInputs,
+                   numInputs, m_bufferInputs.data(), block);
+    }
+    for (auto &buffer : m_outputBuffers) {
+      std::fill(buffer.begin(), buffer.begin() + block, 0.0F);
+    }
+    m_graph.process(m_bufferInputs.data(), m_bufferOutputs.data(), block);
+    interleave(m_bufferOutputs.data(), numOutputs,
+               output + static_cast<std::size_t>(done) * numOutputs, block);
+    done += block;
+  }
+}
+
+TinySynthStats TinySynthEngine::getStats() {
+  std::lock_guard<std::mutex> lock(m_controlMutex);
+  collectReplies();
+  TinySynthStats stats{};
+  stats.frames = m_graph.getFrameTime();
+  stats.commands = m_queued;
+  stats.failed = m_failed;
+  stats.late = m_scheduled.getLateEvents();
+  return stats;
+}
+
+std::uint64_t TinySynthEngine::frameFor(const Node &record,
+                                        std::uint64_t frame) {
+  // Run before the node's AddModule, the command would find no node
+  if (record.startFrame &&
+      (frame == TINYSYNTH_NOW || frame < *record.startFrame)) {
+    return *record.startFrame;
+  }
+  return frame;
+}
+
+void TinySynthEngine::push(std::uint64_t frame, EngineCommand &command) {
+  if (!producer(frame).push(frame, command)) {
+    throw QueueFull("engine command queue full");
+  }
+  ++m_queued;
+}
+
+void TinySynthEngine::collectReplies() {
+  auto check = [this](const EngineReply &reply) {
+    if (reply.status != EngineReply::Status::Rejected) {
+      return;
+    }
+    ++m_failed;
+    if (reply.type != EngineCommand::Type::AddModule) {
+      return;
+    }
+    const auto found =
+        std::find_if(m_nodes.begin(), m_nodes.end(), [&](const auto &entry) {
+          return entry.second.instance == reply.garbage;
+        });
+    if (found != m_nodes.end()) {
+      m_nodes.erase(found);
+    }
+  };
+  m_commands.collectReplies(check);
+  m_scheduled.collectReplies([&](const EngineReply &reply) {
+    check(reply);
+    if (reply.status == EngineReply::Status::Rejected) {
+      return;
+    }
+    if (reply.type == EngineCommand::Type::AddModule) {
+      // Started: later commands need not wait for it
+      for (auto &entry : m_nodes) {
+        if (entry.second.startFrame &&
+            entry.second.addSequence == reply.sequence) {
+          entry.second.startFrame.reset();
+          break;
+        }
+      }
+    } else if (reply.type == EngineCommand::Type::RemoveModule) {
+      const auto found =
+          std::find_if(m_nodes.begin(), m_nodes.end(), [&](const auto &entry) {
+            return entry.second.freed && entry.second.instance == reply.garbage;
+          });
+      if (found != m_nodes.end()) {
+        m_nodes.erase(found);
+      }
+    }
+  });
+}
+
+const TinySynthEngine::Node &TinySynthEngine::findNode(int32_t node) const {
+  const auto found = m_nodes.find(node);
+  if (found == m_nodes.end() || found->second.freed) {
+    throw NotFound("Node " + std::to_string(node) + " not found");
+  }
+  return found->second;
+}
+
+extern "C" {
+
+uint32_t tinysynth_abi_version(void) { return TINYSYNTH_ABI_VERSION; }
+
+const char *tinysynth_last_error(void) { return lastError.c_str(); }
+
+TinySynthEngine *tinysynth_engine_create(uint32_t numInputs,
+                                         uint32_t numOutputs,
+                                         uint32_t sampleRate,
+                                         uint32_t maxBlockSize) {
+  TinySynthEngine *engine = nullptr;
+  guard([&] {
+    engine = new TinySynthEngine(numInputs, numOutputs, sampleRate,
+                                 maxBlockSize);
+    return TINYSYNTH_OK;
+  });
+  return engine;
+}
+
+void tinysynth_engine_destroy(TinySynthEngine *engine) { delete engine; }
+
+int32_t tinysynth_synthdef_load(TinySynthEngine *engine, const uint8_t *data,
+                                size_t size) {
+  return guard([&] {
+    if (engine == nullptr || (data == nullptr && size > 0)) {
+      throw std::invalid_argument("null engine or data");
+    }
+    return engine->loadSynthDefs({data, size});
+  });
+}
+
+int32_t tinysynth_synthdef_load_file(TinySynthEngine *engine,
+                                     const char *path) {
+  return guard([&] {
+    if (engine == nullptr || path == nullptr) {
+      throw std::invalid_argument("null engine or path");
+    }
+    return engine->loadSynthDefFile(path);
+  });
+}
+
+int32_t tinysynth_node_new(TinySynthEngine *engine, const char *defName,
+                           int32_t node, const TinySynthControl *controls,
+                           uint32_t numControls, uint64_t frame,
+                           int32_t *nodeOut) {
+  return guard([&] {
+    if (engine == nullptr || defName == nullptr ||
+        (controls == nullptr && numControls > 0)) {
+      throw std::invalid_argument("null engine, def name or controls");
+    }
+    const int32_t id =
+        engine->newNode(defName, node, {controls, numControls}, frame);
+    if (nodeOut != nullptr) {
+      *nodeOut = id;
+    }
+    return TINYSYNTH_OK;
+  });
+}
+
+int32_t tinysynth_node_free(TinySynthEngine *engine, const int32_t *nodes,
+                            uint32_t count, uint64_t frame) {
+  return guard([&] {
+    if (engine == nullptr || (nodes == nullptr && count > 0)) {
+      throw std::invalid_argument("null engine or nodes");
+    }
+    return engine->freeNodes({nodes, count}, frame);
+  });
+}
+
+int32_t tinysynth_node_param_index(TinySynthEngine *engine, int32_t node,
+                                   const char *name) {
+  return guard([&] {
+    if (engine == nullptr || name == nullptr) {
+      throw std::invalid_argument("null engine or control name");
+    }
+    return engine->paramIndex(node, name);
+  });
+}
+
+int32_t tinysynth_set_param_batch(TinySynthEngine *engine,
+                                  const TinySynthParamSet *sets,
+                                  uint32_t count, uint64_t frame) {
+  return guard([&] {
+    if (engine == nullptr || (sets == nullptr && count > 0)) {
+      throw std::invalid_argument("null engine or control changes");
+    }
+    return engine->setParams({sets, count}, frame);
+  });
+}
+
+int32_t tinysynth_engine_render(TinySynthEngine *engine,
+                                const float *const *inputs,
+                                float *const *outputs, uint32_t numFrames) {
+  return guard([&] {
+    if (engine == nullptr || (outputs == nullptr && numFrames > 0) ||
+        (inputs == nullptr && engine->m_graph.getNumInputs() > 0)) {
+      throw std::invalid_argument("null engine or buffers");
+    }
+    engine->render(inputs, outputs, numFrames);
+    return TINYSYNTH_OK;
+  });
+}
+
+int32_t tinysynth_engine_render_interleaved(TinySynthEngine *engine,
+                                            const float *input, float *output,
+                                            uint32_t numFrames) {
+  return guard([&] {
+    if (engine == nullptr || (output == nullptr && numFrames > 0) ||
+        (input == nullptr && engine->m_graph.getNumInputs() > 0)) {
+      throw std::invalid_argument("null engine or buffers");
+    }
+    engine->renderInterleaved(input, output, numFrames);
+    return TINYSYNTH_OK;
+  });
+}
+
+uint64_t tinysynth_engine_frame(const TinySynthEngine *engine) {
+  return engine != nullptr ? engine->m_graph.getFrameTime() : 0;
+}
+
+int32_t tinysynth_engine_stats(TinySynthEngine *engine,
+                               TinySynthStats *stats) {
+  return guard([&] {
+    if (engine == nullptr || stats == nullptr) {
+      throw std::invalid_argument("null engine or stats");
+    }
+    *stats = engine->getStats();
+    return TINYSYNTH_OK;
+  });
+}
+
+} // extern "C"
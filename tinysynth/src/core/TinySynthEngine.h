@@ -0,0 +1,125 @@
+// TinySynthEngine.h
+#pragma once
+
+// C ABI of the engine for hosts that embed it in-process (Klarenz through
+// its FFI, or any language with a C FFI), built as the tinysynth_engine
+// shared library. It covers what the OSC server does without encoding
+// anything: SynthDefs, module nodes with controls, batched control changes
+// and host-driven rendering.
+//
+// Every call returns a status (or a count, >= 0 on success) and never
+// lets a C++ exception out; tinysynth_last_error() describes the last
+// failure on the calling thread. Control calls may come from any thread
+// and are serialised by the engine; render calls must come from one thread
+// at a time, and never block on the control calls. Commands reach the
+// audio side through the engine's lock-free rings: TINYSYNTH_NOW applies
+// them at the start of the next rendered block, any other frame (see
+// tinysynth_engine_frame) on exactly that frame, or at the next block when
+// it is already past. A host must check tinysynth_abi_version() first.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TINYSYNTH_ABI_VERSION 1
+
+// Frame of commands that apply at the next block
+#define TINYSYNTH_NOW 0
+
+#if defined(_WIN32)
+#define TINYSYNTH_EXPORT __declspec(dllexport)
+#else
+#define TINYSYNTH_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TinySynthEngine TinySynthEngine;
+
+typedef enum TinySynthStatus {
+    TINYSYNTH_OK = 0,
+    TINYSYNTH_ERROR_INVALID_ARGUMENT = -1,
+    TINYSYNTH_ERROR_NOT_FOUND = -2, // no such SynthDef, node or control
+    TINYSYNTH_ERROR_QUEUE_FULL = -3, // render, then send again
+    TINYSYNTH_ERROR_FAILED = -4     // anything else: files, JIT, memory
+} TinySynthStatus;
+
+// An initial control of a new node. "out" sets the first output channel of
+// a module node; SynthDef nodes play their Out bus i to channel i.
+typedef struct TinySynthControl {
+    const char* name;
+    float value;
+} TinySynthControl;
+
+// One control change; param is an index from tinysynth_node_param_index
+typedef struct TinySynthParamSet {
+    int32_t node;
+    uint32_t param;
+    float value;
+} TinySynthParamSet;
+
+typedef struct TinySynthStats {
+    uint64_t frames;   // rendered so far
+    uint64_t commands; // queued so far
+    uint64_t failed;   // commands the audio side rejected
+    uint64_t late;     // commands sent for a frame that ran after it
+} TinySynthStats;
+
+TINYSYNTH_EXPORT uint32_t tinysynth_abi_version(void);
+// Never NULL; "" when nothing failed yet on this thread
+TINYSYNTH_EXPORT const char* tinysynth_last_error(void);
+
+// Built-in module nodes: SineOsc, SawOsc, TriangleOsc, SquareOsc and
+// PulseOsc. Returns NULL on failure.
+TINYSYNTH_EXPORT TinySynthEngine* tinysynth_engine_create(uint32_t numInputs, uint32_t numOutputs,
+                                                          uint32_t sampleRate,
+                                                          uint32_t maxBlockSize);
+// Frees the engine and its nodes; nothing may render it any more
+TINYSYNTH_EXPORT void tinysynth_engine_destroy(TinySynthEngine* engine);
+
+// Compiles the SynthDefs of an SCgf file, in memory or on disk, replacing
+// those of the same names; returns how many
+TINYSYNTH_EXPORT int32_t tinysynth_synthdef_load(TinySynthEngine* engine, const uint8_t* data,
+                                                 size_t size);
+TINYSYNTH_EXPORT int32_t tinysynth_synthdef_load_file(TinySynthEngine* engine, const char* path);
+
+// Starts a node of a SynthDef or built-in module as node ID `node`, or as
+// one the engine picks when it is negative; the ID is stored in *nodeOut.
+TINYSYNTH_EXPORT int32_t tinysynth_node_new(TinySynthEngine* engine, const char* defName,
+                                            int32_t node, const TinySynthControl* controls,
+                                            uint32_t numControls, uint64_t frame,
+                                            int32_t* nodeOut);
+// Frees nodes; returns how many were queued. Unknown nodes fail the call
+// before anything is sent.
+TINYSYNTH_EXPORT int32_t tinysynth_node_free(TinySynthEngine* engine, const int32_t* nodes,
+                                             uint32_t count, uint64_t frame);
+// Index of a node's control for TinySynthParamSet, looked up once
+TINYSYNTH_EXPORT int32_t tinysynth_node_param_index(TinySynthEngine* engine, int32_t node,
+                                                    const char* name);
+
+// Sends control changes, all at `frame`, and returns how many were queued.
+// The batch is checked first, so an unknown node or control sends
+// nothing; fewer than count means the rings are full, and the rest should
+// be sent again after a render.
+TINYSYNTH_EXPORT int32_t tinysynth_set_param_batch(TinySynthEngine* engine,
+                                                   const TinySynthParamSet* sets, uint32_t count,
+                                                   uint64_t frame);
+
+// Renders numFrames frames (any number; blocks are at most maxBlockSize)
+// from planar inputs (NULL without inputs) into planar outputs
+TINYSYNTH_EXPORT int32_t tinysynth_engine_render(TinySynthEngine* engine,
+                                                 const float* const* inputs,
+                                                 float* const* outputs, uint32_t numFrames);
+// The same with interleaved frames; input may be NULL without inputs
+TINYSYNTH_EXPORT int32_t tinysynth_engine_render_interleaved(TinySynthEngine* engine,
+                                                             const float* input, float* output,
+                                                             uint32_t numFrames);
+// Frames rendered so far; a command for this frame lands at the start of
+// the next render
+TINYSYNTH_EXPORT uint64_t tinysynth_engine_frame(const TinySynthEngine* engine);
+TINYSYNTH_EXPORT int32_t tinysynth_engine_stats(TinySynthEngine* engine, TinySynthStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
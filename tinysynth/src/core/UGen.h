@@ -12,9 +12,13 @@
 #include <vector>
 #include <optional>
 
+#include "RealtimeMemory.h"
+
 namespace tinysynth {
 
-template <typename sample_type> class UGen {
+// Instances are RealtimeAllocated, so they live in the realtime arena when
+// one is set up
+template <typename sample_type> class UGen : public RealtimeAllocated {
 public:
     UGen() = default;
     UGen(const UGen &) = default;
@@ -0,0 +1,73 @@
+// UGenKernels.cpp
+#include "UGenKernels.h"
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <stdexcept>
+#include <vector>
+
+// Generated by CMake from the bitcode of src/kernels/UGenKernels.cpp
+extern "C" {
+extern const unsigned char tinysynth_ugen_kernels[];
+extern const std::size_t tinysynth_ugen_kernels_size;
+}
+
+namespace tinysynth {
+
+namespace {
+
+constexpr llvm::StringLiteral KERNEL_PREFIX = "tinysynth_kernel_";
+
+} // namespace
+
+void linkUGenKernels(llvm::Module &module) {
+  std::vector<std::string> wanted;
+  for (const auto &function : module) {
+    if (function.isDeclaration() &&
+        function.getName().startswith(KERNEL_PREFIX)) {
+      wanted.push_back(function.getName().str());
+    }
+  }
+  if (wanted.empty()) {
+    return;
+  }
+
+  llvm::StringRef bitcode(
+      reinterpret_cast<const char *>(tinysynth_ugen_kernels),
+      tinysynth_ugen_kernels_size);
+  auto library = llvm::getOwningLazyBitcodeModule(
+      llvm::MemoryBuffer::getMemBuffer(bitcode, "UGenKernels", false),
+      module.getContext());
+  if (!library) {
+    throw std::runtime_error("Failed to load UGen kernels: " +
+                             llvm::toString(library.takeError()));
+  }
+  // The kernels are built for the host, like the JIT target
+  (*library)->setDataLayout(module.getDataLayout());
+  (*library)->setTargetTriple(module.getTargetTriple());
+
+  if (llvm::Linker::linkModules(module, std::move(*library),
+                                llvm::Linker::LinkOnlyNeeded)) {
+    throw std::runtime_error("Failed to link UGen kernels");
+  }
+
+  for (const auto &name : wanted) {
+    llvm::Function *kernel = module.getFunction(name);
+    if (kernel == nullptr || kernel->isDeclaration()) {
+      throw std::runtime_error("UGen kernel not in library: " + name);
+    }
+    kernel->setLinkage(llvm::GlobalValue::InternalLinkage);
+    kernel->removeFnAttr(llvm::Attribute::NoInline);
+    kernel->addFnAttr(llvm::Attribute::AlwaysInline);
+  }
+  // Clang tags its functions with the CPU it compiled for; the inliner
+  // refuses to mix those with the untagged process function
+  for (auto &function : module) {
+    function.removeFnAttr("target-cpu");
+    function.removeFnAttr("target-features");
+    function.removeFnAttr("tune-cpu");
+  }
+}
+
+} // namespace tinysynth
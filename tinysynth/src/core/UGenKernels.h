@@ -0,0 +1,13 @@
+// UGenKernels.h
+#pragma once
+
+#include <llvm/IR/Module.h>
+
+namespace tinysynth {
+
+// Links the bitcode UGen kernels (src/kernels) that `module` declares into it
+// and marks them always-inline. The embedded library is materialised lazily,
+// so only the kernels in use are read.
+void linkUGenKernels(llvm::Module& module);
+
+} // namespace tinysynth
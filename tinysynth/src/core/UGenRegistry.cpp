@@ -0,0 +1,146 @@
+// UGenRegistry.cpp
+#include "UGenRegistry.h"
+
+namespace tinysynth {
+
+namespace {
+
+// scsynth BinaryOpUGen special indices
+constexpr int SC_OP_ADD = 0;
+constexpr int SC_OP_SUB = 1;
+constexpr int SC_OP_MUL = 2;
+constexpr int SC_OP_FDIV = 4;
+
+UGenRegistry makeBuiltinRegistry() {
+  UGenRegistry registry;
+
+  registry.registerUGen({.type = "Control", .variadic = true});
+  registry.registerUGen({.type = "In", .variadic = true});
+  registry.registerUGen(
+      {.type = "Out", .numOutputs = 0, .sink = true, .variadic = true});
+  registry.registerUGen(
+      {.type = "ReplaceOut", .numOutputs = 0, .sink = true, .variadic = true});
+
+  for (const char *osc :
+       {"SineOsc", "SawOsc", "TriangleOsc", "SquareOsc", "PulseOsc"}) {
+    registry.registerUGen({.type = osc,
+                           .inputNames = {"frequency", "amplitude"},
+                           .inputModes = {InputMode::Add, InputMode::Multiply},
+                           .inputDefaults = {440.0F, 1.0F}});
+  }
+
+  for (const char *op : {"Add", "Sub", "Mul", "Div"}) {
+    registry.registerUGen(
+        {.type = op, .inputNames = {"a", "b"}, .pure = true});
+  }
+  registry.registerUGen({.type = "MulAdd",
+                         .inputNames = {"in", "mul", "add"},
+                         .pure = true,
+                         .inputDefaults = {0.0F, 1.0F, 0.0F}});
+
+  // UGens whose per-sample code comes from the bitcode kernel library
+  registry.registerUGen({.type = "Phasor",
+                         .inputNames = {"frequency"},
+                         .inputModes = {InputMode::Add},
+                         .inputDefaults = {1.0F},
+                         .kernel = "tinysynth_kernel_Phasor",
+                         .kernelState = {"phase"}});
+  registry.registerUGen({.type = "OnePole",
+                         .inputNames = {"in", "coef"},
+                         .inputDefaults = {0.0F, 0.5F},
+                         .kernel = "tinysynth_kernel_OnePole",
+                         .kernelState = {"y1"}});
+  registry.registerUGen({.type = "Lag",
+                         .inputNames = {"in", "lagTime"},
+                         .inputDefaults = {0.0F, 0.1F},
+                         .kernel = "tinysynth_kernel_Lag",
+                         .kernelState = {"y1", "lagTime", "b1"}});
+  registry.registerUGen(
+      {.type = "LowPass",
+       .inputNames = {"in", "frequency"},
+       .inputDefaults = {0.0F, 440.0F},
+       .kernel = "tinysynth_kernel_LowPass",
+       .kernelState = {"y1", "y2", "frequency", "a0", "b1", "b2"}});
+  registry.registerUGen(
+      {.type = "ADSR",
+       .inputNames = {"gate", "attack", "decay", "sustain", "release"},
+       .inputDefaults = {1.0F, 0.01F, 0.3F, 0.5F, 1.0F},
+       .kernel = "tinysynth_kernel_ADSR",
+       .kernelState = {"level", "stage", "gate", "releaseStep"}});
+  registry.registerUGen({.type = "WhiteNoise",
+                         .kernel = "tinysynth_kernel_WhiteNoise",
+                         .kernelState = {"seed"}});
+
+  const SCInputMapping freq{0, "frequency"};
+  const SCInputMapping phase{-1, "phase"};
+  registry.registerSCUGen("SinOsc", -1, {"SineOsc", {freq, phase}});
+  registry.registerSCUGen("Saw", -1, {"SawOsc", {freq}});
+  registry.registerSCUGen("LFSaw", -1, {"SawOsc", {freq, phase}});
+  registry.registerSCUGen("LFTri", -1, {"TriangleOsc", {freq, phase}});
+  registry.registerSCUGen("LFPulse", -1, {"PulseOsc", {freq, phase}});
+
+  const std::vector<SCInputMapping> binaryInputs{{0, "a"}, {1, "b"}};
+  registry.registerSCUGen("BinaryOpUGen", SC_OP_ADD, {"Add", binaryInputs});
+  registry.registerSCUGen("BinaryOpUGen", SC_OP_SUB, {"Sub", binaryInputs});
+  registry.registerSCUGen("BinaryOpUGen", SC_OP_MUL, {"Mul", binaryInputs});
+  registry.registerSCUGen("BinaryOpUGen", SC_OP_FDIV, {"Div", binaryInputs});
+  registry.registerSCUGen("MulAdd", -1,
+                          {"MulAdd", {{0, "in"}, {1, "mul"}, {2, "add"}}});
+
+  registry.registerSCUGen("OnePole", -1,
+                          {"OnePole", {{0, "in"}, {1, "coef"}}});
+  registry.registerSCUGen("Lag", -1, {"Lag", {{0, "in"}, {1, "lagTime"}}});
+  registry.registerSCUGen("LPF", -1, {"LowPass", {{0, "in"}, {1, "frequency"}}});
+  registry.registerSCUGen("WhiteNoise", -1, {"WhiteNoise", {}});
+
+  registry.registerSCUGen("In", -1, {"In", {{-1, "bus"}}});
+  registry.registerSCUGen("Out", -1, {"Out", {{-1, "bus"}}});
+  registry.registerSCUGen("ReplaceOut", -1, {"ReplaceOut", {{-1, "bus"}}});
+  // Commands already land on their exact frame, so the sub-block offset
+  // OffsetOut adds in scsynth is built in
+  registry.registerSCUGen("OffsetOut", -1, {"Out", {{-1, "bus"}}});
+
+  for (const char *control :
+       {"Control", "AudioControl", "TrigControl", "LagControl"}) {
+    registry.registerSCUGen(control, -1, {"Control", {}});
+  }
+
+  return registry;
+}
+
+} // namespace
+
+const UGenRegistry &UGenRegistry::builtin() {
+  static const UGenRegistry registry = makeBuiltinRegistry();
+  return registry;
+}
+
+void UGenRegistry::registerUGen(const UGenSpec &spec) {
+  m_specs[spec.type] = spec;
+}
+
+void UGenRegistry::registerSCUGen(const std::string &scName, int specialIndex,
+                                  const SCUGenMapping &mapping) {
+  m_scMappings[scName].push_back({specialIndex, mapping});
+}
+
+const UGenSpec *UGenRegistry::find(std::string_view type) const {
+  auto it = m_specs.find(type);
+  return it == m_specs.end() ? nullptr : &it->second;
+}
+
+const SCUGenMapping *UGenRegistry::findSC(std::string_view scName,
+                                          int specialIndex) const {
+  auto it = m_scMappings.find(scName);
+  if (it == m_scMappings.end()) {
+    return nullptr;
+  }
+  for (const auto &entry : it->second) {
+    if (entry.specialIndex == -1 || entry.specialIndex == specialIndex) {
+      return &entry.mapping;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace tinysynth
@@ -0,0 +1,88 @@
+// UGenRegistry.h
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace tinysynth {
+
+// How a connected signal combines with the parameter of the same input
+enum class InputMode {
+    Replace,  // the signal is used as is
+    Add,      // signal + parameter (frequency modulation)
+    Multiply, // signal * parameter (amplitude modulation)
+};
+
+// Describes a UGen type that may appear in a SynthDef. Input i corresponds to
+// the parameter inputNames[i], which supplies its value while unconnected.
+struct UGenSpec {
+    std::string type;
+    std::vector<std::string> inputNames{};
+    unsigned int numOutputs = 1;
+    bool pure = false;     // output depends only on the current inputs
+    bool sink = false;     // has side effects, never dead
+    bool variadic = false; // extra inputs/outputs are named "in<N>"
+    std::vector<InputMode> inputModes{}; // empty means all Replace
+    std::vector<float> inputDefaults{}; // value of a parameter never set
+    // Bitcode kernel that computes one sample (see src/kernels), and the
+    // floats it keeps in the node's state block between samples
+    std::string kernel{};
+    std::vector<std::string> kernelState{};
+
+    [[nodiscard]] InputMode inputMode(unsigned int index) const {
+        return index < inputModes.size() ? inputModes[index] : InputMode::Replace;
+    }
+
+    [[nodiscard]] float inputDefault(unsigned int index) const {
+        return index < inputDefaults.size() ? inputDefaults[index] : 0.0F;
+    }
+};
+
+// How an scsynth input slot maps onto a tinysynth UGen. inputIndex is -1
+// when the slot can only be set as a constant parameter.
+struct SCInputMapping {
+    int inputIndex;
+    std::string parameter;
+};
+
+struct SCUGenMapping {
+    std::string type;
+    std::vector<SCInputMapping> inputs;
+};
+
+class UGenRegistry {
+public:
+    // Registry with every UGen the engine knows how to run
+    static const UGenRegistry& builtin();
+
+    void registerUGen(const UGenSpec& spec);
+
+    // specialIndex of -1 matches any special index of the SC class
+    void registerSCUGen(const std::string& scName, int specialIndex,
+                        const SCUGenMapping& mapping);
+
+    [[nodiscard]] const UGenSpec* find(std::string_view type) const;
+    [[nodiscard]] const SCUGenMapping* findSC(std::string_view scName,
+                                              int specialIndex) const;
+
+private:
+    struct StringHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view value) const {
+            return std::hash<std::string_view>{}(value);
+        }
+    };
+
+    struct SCEntry {
+        int specialIndex;
+        SCUGenMapping mapping;
+    };
+
+    std::unordered_map<std::string, UGenSpec, StringHash, std::equal_to<>> m_specs;
+    std::unordered_map<std::string, std::vector<SCEntry>, StringHash, std::equal_to<>>
+        m_scMappings;
+};
+
+} // namespace tinysynth
@@ -0,0 +1,58 @@
+// VoiceAllocator.cpp
+#include "VoiceAllocator.h"
+
+namespace tinysynth {
+
+void VoiceAllocator::setNumVoices(unsigned int numVoices) {
+  m_voices.assign(numVoices, Voice{});
+  m_clock = 0;
+}
+
+int VoiceAllocator::noteOn(unsigned int channel, unsigned int note) {
+  int chosen = -1;
+  for (std::size_t i = 0; i < m_voices.size(); ++i) {
+    const Voice &voice = m_voices[i];
+    if (voice.active && voice.channel == channel && voice.note == note) {
+      chosen = static_cast<int>(i);
+      break;
+    }
+    if (chosen < 0) {
+      chosen = static_cast<int>(i);
+      continue;
+    }
+    // Free voices before sounding ones, then the oldest of either
+    const Voice &best = m_voices[static_cast<std::size_t>(chosen)];
+    if ((best.active && !voice.active) ||
+        (best.active == voice.active && voice.stamp < best.stamp)) {
+      chosen = static_cast<int>(i);
+    }
+  }
+  if (chosen >= 0) {
+    Voice &voice = m_voices[static_cast<std::size_t>(chosen)];
+    voice.active = true;
+    voice.channel = static_cast<std::uint8_t>(channel);
+    voice.note = static_cast<std::uint8_t>(note);
+    voice.stamp = ++m_clock;
+  }
+  return chosen;
+}
+
+int VoiceAllocator::noteOff(unsigned int channel, unsigned int note) {
+  for (std::size_t i = 0; i < m_voices.size(); ++i) {
+    Voice &voice = m_voices[i];
+    if (voice.active && voice.channel == channel && voice.note == note) {
+      voice.active = false;
+      voice.stamp = ++m_clock;
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+void VoiceAllocator::releaseAll() {
+  for (auto &voice : m_voices) {
+    voice.active = false;
+  }
+}
+
+} // namespace tinysynth
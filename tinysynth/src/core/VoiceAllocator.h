@@ -0,0 +1,39 @@
+// VoiceAllocator.h
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace tinysynth {
+
+// Assigns MIDI notes to a fixed pool of voices. A note takes a free voice,
+// the one released longest ago, or, when all are sounding, steals the one
+// started longest ago; a repeated note retriggers its own voice. The pool
+// is sized on the control thread; noteOn/noteOff never allocate.
+class VoiceAllocator {
+public:
+    void setNumVoices(unsigned int numVoices);
+    [[nodiscard]] unsigned int getNumVoices() const {
+        return static_cast<unsigned int>(m_voices.size());
+    }
+
+    // The voice to start, -1 without voices
+    int noteOn(unsigned int channel, unsigned int note);
+    // The voice playing the note, -1 when none is
+    int noteOff(unsigned int channel, unsigned int note);
+    void releaseAll();
+
+private:
+    struct Voice {
+        bool active = false;
+        std::uint8_t channel = 0;
+        std::uint8_t note = 0;
+        // Allocation order of the last note on or off
+        std::uint64_t stamp = 0;
+    };
+
+    std::vector<Voice> m_voices;
+    std::uint64_t m_clock = 0;
+};
+
+} // namespace tinysynth
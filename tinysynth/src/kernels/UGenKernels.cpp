@@ -0,0 +1,350 @@
+// UGenKernels.cpp
+//
+// UGen kernels written in plain C++. This file is not part of the TinySynth
+// library: CMake compiles it to LLVM bitcode, embeds the bitcode in the
+// binary, and the SynthDef compiler links and inlines the kernels a graph
+// uses into its fused sample loop.
+//
+// A kernel computes one sample of a UGen registered with `.kernel`:
+//   float <kernel>(float* state, int stride, const float* inputs,
+//                  float sampleRate)
+// The k-th name of the spec's kernelState lives at state[k * stride], so the
+// same code serves a single node (stride 1) and a SoA batch (stride = lanes).
+// inputs[i] is the value of the spec's inputNames[i] for this sample.
+//
+// Each kernel also has batched variants for the voice-batched SynthDefs,
+//   void <kernel>_x<lanes>(float* state, const float* inputs, float* out,
+//                          float sampleRate)
+// for 4, 8 and 16 lanes, which compute one sample of every lane of a SoA
+// batch on vectors of `lanes` floats: field k of lane l is
+// state[k * lanes + l], inputs[i * lanes + l] is input i of lane l, and
+// out[l] receives lane l's sample. Rare per-lane work (coefficients after a
+// parameter change, seeding) falls back to the scalar code for the lanes
+// that need it, so a batch computes exactly what its lanes would alone; the
+// ADSR stage machine runs lane by lane throughout.
+//
+// Kernels have C linkage so the JIT can find them by name in the bitcode.
+// Code generated ahead of time includes this file with TINYSYNTH_KERNEL
+// defined as `static inline` instead, and without the batched variants,
+// which only the JIT uses.
+#include "../modules/Envelope.h"
+#include "../modules/Filters.h"
+#include "../modules/Phasor.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifndef TINYSYNTH_KERNEL
+#define TINYSYNTH_KERNEL extern "C"
+#define TINYSYNTH_BATCH_KERNELS
+#endif
+
+namespace {
+
+class KernelState {
+public:
+    KernelState(float* data, int stride) : m_data(data), m_stride(stride) {}
+
+    float& operator[](int field) const { return m_data[field * m_stride]; }
+
+private:
+    float* m_data;
+    int m_stride;
+};
+
+// s[1] = lagTime, s[2] = the coefficient reaching 60 dB in lagTime
+inline void lagCoefficient(const KernelState& s, float lagTime, float sampleRate) {
+    s[1] = lagTime;
+    s[2] = tinysynth::detail::lagCoefficient(lagTime, sampleRate);
+}
+
+// s[2] = frequency, s[3..5] = the Butterworth coefficients for it
+inline void lowPassCoefficients(const KernelState& s, float frequency, float sampleRate) {
+    s[2] = frequency;
+    tinysynth::detail::lowPassCoefficients(frequency, sampleRate, s[3], s[4], s[5]);
+}
+
+// First xorshift state of a node, from the address of its seed slot
+inline std::uint32_t noiseSeed(const float* slot) {
+    return static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(slot)) * 2654435761U |
+           1U;
+}
+
+} // namespace
+
+// Ramp from 0 to 1 at `frequency` Hz, as modules/Phasor.h computes it
+TINYSYNTH_KERNEL
+float tinysynth_kernel_Phasor(float* state, int stride, const float* inputs,
+                              float sampleRate) {
+    KernelState s(state, stride);
+    float phase = s[0];
+    const float out =
+        tinysynth::detail::phasorComputeSample<float, float>(phase, inputs[0] / sampleRate, 1.0F);
+    s[0] = phase;
+    return out;
+}
+
+// y = (1 - |coef|) * in + coef * y1
+TINYSYNTH_KERNEL
+float tinysynth_kernel_OnePole(float* state, int stride, const float* inputs,
+                               float /*sampleRate*/) {
+    KernelState s(state, stride);
+    return tinysynth::detail::onePoleComputeSample(inputs[0], inputs[1], s[0]);
+}
+
+// Exponential lag reaching 60 dB of a step in lagTime seconds
+TINYSYNTH_KERNEL
+float tinysynth_kernel_Lag(float* state, int stride, const float* inputs,
+                           float sampleRate) {
+    KernelState s(state, stride);
+    const float lagTime = inputs[1];
+    if (lagTime != s[1]) {
+        lagCoefficient(s, lagTime, sampleRate);
+    }
+    return tinysynth::detail::lagComputeSample(inputs[0], s[2], s[0]);
+}
+
+// Second-order Butterworth lowpass; coefficients are recomputed only when
+// the cutoff changes
+TINYSYNTH_KERNEL
+float tinysynth_kernel_LowPass(float* state, int stride, const float* inputs,
+                               float sampleRate) {
+    KernelState s(state, stride);
+    const float frequency = tinysynth::detail::lowPassClamp(inputs[1], sampleRate);
+    if (frequency != s[2]) {
+        lowPassCoefficients(s, frequency, sampleRate);
+    }
+    return tinysynth::detail::lowPassComputeSample(inputs[0], s[3], s[4], s[5], s[0], s[1]);
+}
+
+// xorshift32 noise in [-1, 1). The seed is kept as raw bits in a float
+// slot; a fresh node seeds itself from its state address so nodes differ.
+TINYSYNTH_KERNEL
+float tinysynth_kernel_WhiteNoise(float* state, int stride, const float* /*inputs*/,
+                                  float /*sampleRate*/) {
+    KernelState s(state, stride);
+    std::uint32_t seed;
+    std::memcpy(&seed, &s[0], sizeof(seed));
+    if (seed == 0) {
+        seed = noiseSeed(&s[0]);
+    }
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    std::memcpy(&s[0], &seed, sizeof(seed));
+    return static_cast<float>(static_cast<std::int32_t>(seed)) * (1.0F / 2147483648.0F);
+}
+
+// Linear ADSR envelope, as modules/EnvelopeModule.h computes it; the stage
+// is kept as a float in its slot
+TINYSYNTH_KERNEL
+float tinysynth_kernel_ADSR(float* state, int stride, const float* inputs,
+                            float sampleRate) {
+    KernelState s(state, stride);
+    return tinysynth::detail::envelopeComputeSample(inputs[0], inputs[1], inputs[2],
+                                                    inputs[3], inputs[4], sampleRate, s[0],
+                                                    s[1], s[2], s[3]);
+}
+
+#ifdef TINYSYNTH_BATCH_KERNELS
+
+namespace {
+
+// One SoA batch of `Lanes` nodes. Only pointers cross function boundaries:
+// vectors passed by value would change the ABI with the target features.
+template <int Lanes>
+struct Batch {
+    typedef float Vec __attribute__((vector_size(Lanes * sizeof(float))));
+    typedef std::int32_t Mask __attribute__((vector_size(Lanes * sizeof(float))));
+    typedef std::uint32_t Bits __attribute__((vector_size(Lanes * sizeof(float))));
+
+    explicit Batch(float* state) : m_state(state) {}
+
+    // Field k of every lane
+    void get(int field, Vec& value) const {
+        std::memcpy(&value, m_state + field * Lanes, sizeof(Vec));
+    }
+    void set(int field, const Vec& value) const {
+        std::memcpy(m_state + field * Lanes, &value, sizeof(Vec));
+    }
+    // The scalar view of one lane
+    [[nodiscard]] KernelState lane(int l) const { return {m_state + l, Lanes}; }
+
+    static void input(const float* inputs, int index, Vec& value) {
+        std::memcpy(&value, inputs + index * Lanes, sizeof(Vec));
+    }
+    static void output(float* out, const Vec& value) { std::memcpy(out, &value, sizeof(Vec)); }
+
+private:
+    float* m_state;
+};
+
+// Bitwise a where mask is set, else b
+#define TINYSYNTH_SELECT(V, M, mask, a, b) ((V)(((M)(a) & (mask)) | ((M)(b) & ~(mask))))
+
+template <int Lanes>
+void phasorBatch(float* state, const float* inputs, float* out, float sampleRate) {
+    using B = Batch<Lanes>;
+    using Vec = typename B::Vec;
+    using Mask = typename B::Mask;
+    const B s(state);
+    Vec phase;
+    Vec frequency;
+    s.get(0, phase);
+    B::input(inputs, 0, frequency);
+    phase += frequency / sampleRate;
+    // fmod(phase, 1) is phase - trunc(phase); from 2^23 on every float is
+    // whole and the remainder 0
+    const Vec magnitude = (Vec)((Mask)phase & 0x7FFFFFFF);
+    const Mask small = magnitude < 8388608.0F;
+    const Vec whole = __builtin_convertvector(
+        __builtin_convertvector(TINYSYNTH_SELECT(Vec, Mask, small, phase, Vec{}), Mask), Vec);
+    phase -= TINYSYNTH_SELECT(Vec, Mask, small, whole, phase);
+    s.set(0, phase);
+    B::output(out, phase);
+}
+
+template <int Lanes>
+void onePoleBatch(float* state, const float* inputs, float* out, float /*sampleRate*/) {
+    using B = Batch<Lanes>;
+    using Vec = typename B::Vec;
+    using Mask = typename B::Mask;
+    const B s(state);
+    Vec in;
+    Vec coef;
+    Vec y1;
+    B::input(inputs, 0, in);
+    B::input(inputs, 1, coef);
+    s.get(0, y1);
+    const Vec gain = 1.0F - (Vec)((Mask)coef & 0x7FFFFFFF);
+    const Vec y = gain * in + coef * y1;
+    s.set(0, y);
+    B::output(out, y);
+}
+
+template <int Lanes>
+void lagBatch(float* state, const float* inputs, float* out, float sampleRate) {
+    using B = Batch<Lanes>;
+    using Vec = typename B::Vec;
+    const B s(state);
+    Vec lagTime;
+    Vec current;
+    B::input(inputs, 1, lagTime);
+    s.get(1, current);
+    const auto changed = lagTime != current;
+    for (int l = 0; l < Lanes; ++l) {
+        if (changed[l] != 0) {
+            lagCoefficient(s.lane(l), lagTime[l], sampleRate);
+        }
+    }
+    Vec in;
+    Vec y1;
+    Vec coef;
+    B::input(inputs, 0, in);
+    s.get(0, y1);
+    s.get(2, coef);
+    const Vec y = in + coef * (y1 - in);
+    s.set(0, y);
+    B::output(out, y);
+}
+
+template <int Lanes>
+void lowPassBatch(float* state, const float* inputs, float* out, float sampleRate) {
+    using B = Batch<Lanes>;
+    using Vec = typename B::Vec;
+    using Mask = typename B::Mask;
+    const B s(state);
+    Vec frequency;
+    Vec current;
+    B::input(inputs, 1, frequency);
+    s.get(2, current);
+    // fmin(fmax(f, 1), sampleRate * 0.49), NaN ending up at 1 as there
+    const Vec one = Vec{} + 1.0F;
+    const Vec highest = Vec{} + sampleRate * 0.49F;
+    frequency = TINYSYNTH_SELECT(Vec, Mask, frequency > 1.0F, frequency, one);
+    frequency = TINYSYNTH_SELECT(Vec, Mask, frequency < highest, frequency, highest);
+    const auto changed = frequency != current;
+    for (int l = 0; l < Lanes; ++l) {
+        if (changed[l] != 0) {
+            lowPassCoefficients(s.lane(l), frequency[l], sampleRate);
+        }
+    }
+    Vec in;
+    Vec y1;
+    Vec y2;
+    Vec a0;
+    Vec b1;
+    Vec b2;
+    B::input(inputs, 0, in);
+    s.get(0, y1);
+    s.get(1, y2);
+    s.get(3, a0);
+    s.get(4, b1);
+    s.get(5, b2);
+    const Vec y0 = in + b1 * y1 + b2 * y2;
+    s.set(1, y1);
+    s.set(0, y0);
+    B::output(out, a0 * (y0 + 2.0F * y1 + y2));
+}
+
+template <int Lanes>
+void whiteNoiseBatch(float* state, const float* /*inputs*/, float* out, float /*sampleRate*/) {
+    using B = Batch<Lanes>;
+    using Vec = typename B::Vec;
+    using Mask = typename B::Mask;
+    using Bits = typename B::Bits;
+    const B s(state);
+    Vec slots;
+    s.get(0, slots);
+    Bits seed = (Bits)slots;
+    for (int l = 0; l < Lanes; ++l) {
+        if (seed[l] == 0) {
+            seed[l] = noiseSeed(state + l);
+        }
+    }
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    s.set(0, (Vec)seed);
+    B::output(out, __builtin_convertvector((Mask)seed, Vec) * (1.0F / 2147483648.0F));
+}
+
+template <int Lanes>
+void adsrBatch(float* state, const float* inputs, float* out, float sampleRate) {
+    // Every lane can be in a different stage: run the stage machine per lane
+    for (int l = 0; l < Lanes; ++l) {
+        const KernelState s(state + l, Lanes);
+        out[l] = tinysynth::detail::envelopeComputeSample(
+            inputs[l], inputs[Lanes + l], inputs[2 * Lanes + l], inputs[3 * Lanes + l],
+            inputs[4 * Lanes + l], sampleRate, s[0], s[1], s[2], s[3]);
+    }
+}
+
+#undef TINYSYNTH_SELECT
+
+} // namespace
+
+#define TINYSYNTH_BATCH_KERNEL(kernel, batch)                                          \
+    TINYSYNTH_KERNEL void kernel##_x4(float* state, const float* inputs, float* out,   \
+                                      float sampleRate) {                              \
+        batch<4>(state, inputs, out, sampleRate);                                      \
+    }                                                                                  \
+    TINYSYNTH_KERNEL void kernel##_x8(float* state, const float* inputs, float* out,   \
+                                      float sampleRate) {                              \
+        batch<8>(state, inputs, out, sampleRate);                                      \
+    }                                                                                  \
+    TINYSYNTH_KERNEL void kernel##_x16(float* state, const float* inputs, float* out,  \
+                                       float sampleRate) {                             \
+        batch<16>(state, inputs, out, sampleRate);                                     \
+    }
+
+TINYSYNTH_BATCH_KERNEL(tinysynth_kernel_Phasor, phasorBatch)
+TINYSYNTH_BATCH_KERNEL(tinysynth_kernel_OnePole, onePoleBatch)
+TINYSYNTH_BATCH_KERNEL(tinysynth_kernel_Lag, lagBatch)
+TINYSYNTH_BATCH_KERNEL(tinysynth_kernel_LowPass, lowPassBatch)
+TINYSYNTH_BATCH_KERNEL(tinysynth_kernel_WhiteNoise, whiteNoiseBatch)
+TINYSYNTH_BATCH_KERNEL(tinysynth_kernel_ADSR, adsrBatch)
+
+#undef TINYSYNTH_BATCH_KERNEL
+
+#endif // TINYSYNTH_BATCH_KERNELS
@@ -15,13 +15,19 @@
  */
 
 #include "main.h"
-#include <atomic>
+#include "core/GraphProcessor.h"
+#include "core/JackClient.h"
+#include "core/OscServer.h"
+#include "core/PipelinedProcessor.h"
+#include "core/RealtimeMemory.h"
+#include "core/SharedEngineState.h"
+#include "modules/AudioEngine.h"
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <memory>
-#include <mutex>
 #include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -43,6 +49,8 @@ public:
   virtual ~DSP() = default;
   virtual void process_audio(jack_nframes_t nframes, float *out,
                              double sample_rate) = 0;
+  // Audio thread only; the GUI goes through a SetParameter command
+  virtual void set_frequency(double freq) = 0;
 };
 
 // SinOsc DSP implementation
@@ -50,11 +58,11 @@ class SinOsc : public DSP {
 public:
   SinOsc() : phase(0.0), frequency(DEFAULT_FREQUENCY) {}
 
-  void set_frequency(double freq) { frequency.store(freq); }
+  void set_frequency(double freq) override { frequency = freq; }
 
   void process_audio(jack_nframes_t nframes, float *out,
                      double sample_rate) override {
-    double phase_increment = TWO_PI * frequency.load() / sample_rate;
+    double phase_increment = TWO_PI * frequency / sample_rate;
     for (jack_nframes_t i = 0; i < nframes; ++i) {
       out[i] = std::sin(phase);
       phase += phase_increment;
@@ -66,7 +74,7 @@ public:
 
 private:
   double phase;
-  std::atomic<double> frequency;
+  double frequency;
 };
 
 // SquareWave DSP implementation
@@ -74,11 +82,11 @@ class SquareWave : public DSP {
 public:
   SquareWave() : phase(0.0), frequency(DEFAULT_FREQUENCY) {}
 
-  void set_frequency(double freq) { frequency.store(freq); }
+  void set_frequency(double freq) override { frequency = freq; }
 
   void process_audio(jack_nframes_t nframes, float *out,
                      double sample_rate) override {
-    double phase_increment = TWO_PI * frequency.load() / sample_rate;
+    double phase_increment = TWO_PI * frequency / sample_rate;
     for (jack_nframes_t i = 0; i < nframes; ++i) {
       out[i] = (phase < M_PI) ? 1.0f : -1.0f;
       phase += phase_increment;
@@ -90,7 +98,7 @@ public:
 
 private:
   double phase;
-  std::atomic<double> frequency;
+  double frequency;
 };
 
 // SawWave DSP implementation
@@ -98,11 +106,11 @@ class SawWave : public DSP {
 public:
   SawWave() : phase(0.0), frequency(DEFAULT_FREQUENCY) {}
 
-  void set_frequency(double freq) { frequency.store(freq); }
+  void set_frequency(double freq) override { frequency = freq; }
 
   void process_audio(jack_nframes_t nframes, float *out,
                      double sample_rate) override {
-    double phase_increment = TWO_PI * frequency.load() / sample_rate;
+    double phase_increment = TWO_PI * frequency / sample_rate;
     for (jack_nframes_t i = 0; i < nframes; ++i) {
       out[i] = 2.0f * (phase / TWO_PI) - 1.0f;
       phase += phase_increment;
@@ -114,7 +122,7 @@ public:
 
 private:
   double phase;
-  std::atomic<double> frequency;
+  double frequency;
 };
 
 // Enumeration for DSP types
@@ -138,99 +146,196 @@ std::unique_ptr<DSP> create_dsp(DSPType type) {
   }
 }
 
-class JackClient {
+// Adapts a DSP to a graph node with one output, so every voice runs inside
+// the engine graph
+class DSPModule : public tinysynth::Module<float> {
 public:
-  JackClient(const char *client_name, std::unique_ptr<DSP> dsp);
-  ~JackClient();
+  explicit DSPModule(std::unique_ptr<DSP> dsp) : dsp(std::move(dsp)) {}
 
-  DSP *get_dsp() const { return dsp.get(); }
-  const char *get_name() const { return name.c_str(); }
-  float &get_frequency() { return frequency; }
-
-private:
-  static int process(jack_nframes_t nframes, void *arg);
-  static void jack_shutdown(void *arg);
+  void process(const std::vector<std::optional<float *>> &,
+               std::vector<float *> &outputs, unsigned int numFrames) override {
+    dsp->process_audio(numFrames, outputs[0],
+                       tinysynth::AudioEngine::getSampleRate());
+  }
 
-  void process_audio(jack_nframes_t nframes);
+  unsigned int getNumInputs() const override { return 0; }
+  unsigned int getNumOutputs() const override { return 1; }
+  std::string getInputName(unsigned int) const override { return ""; }
+  std::string getOutputName(unsigned int) const override { return "out"; }
+  void setParameter(const std::string &name, float value) override {
+    if (name == "frequency") {
+      frequency = value;
+      dsp->set_frequency(static_cast<double>(value));
+    }
+  }
+  float getParameter(const std::string &name) const override {
+    return name == "frequency" ? frequency : 0.0f;
+  }
+  std::vector<std::string> getParameterNames() const override {
+    return {"frequency"};
+  }
+  std::string getName() const override { return "DSP"; }
+  std::string getDescription() const override { return "DSP voice"; }
+  std::unique_ptr<tinysynth::Module<float>> clone() const override {
+    return nullptr;
+  }
+  void reset() override {}
 
-  jack_client_t *client = nullptr;
-  jack_port_t *output_port = nullptr;
+private:
   std::unique_ptr<DSP> dsp;
-  std::string name;
-  float frequency; // Instance variable for frequency
+  float frequency = DEFAULT_FREQUENCY;
 };
 
-JackClient::JackClient(const char *client_name, std::unique_ptr<DSP> dsp)
-    : dsp(std::move(dsp)), name(client_name), frequency(DEFAULT_FREQUENCY) {
-  client = jack_client_open(name.c_str(), JackNullOption, nullptr);
-  if (!client) {
-    throw std::runtime_error("Failed to open JACK client");
-  }
-
-  if (jack_set_process_callback(client, process, this) != 0) {
-    jack_client_close(client);
-    throw std::runtime_error("Failed to set JACK process callback");
-  }
-
-  jack_on_shutdown(client, jack_shutdown, this);
+// A voice is a node of the engine graph routed to every output port. The
+// GUI only keeps its name; every change is a command to the audio thread.
+struct Voice {
+  std::string name;
+  float frequency = DEFAULT_FREQUENCY;
+};
 
-  output_port = jack_port_register(client, "output", JACK_DEFAULT_AUDIO_TYPE,
-                                   JackPortIsOutput, 0);
-  if (!output_port) {
-    jack_client_close(client);
-    throw std::runtime_error("Failed to register JACK port");
+constexpr unsigned int NUM_OUTPUTS = 2;
+
+void add_voice(tinysynth::GraphProcessor &engine, std::vector<Voice> &voices,
+               DSPType type) {
+  static int voice_count = 1;
+  Voice voice{"voice" + std::to_string(voice_count++)};
+  std::unique_ptr<tinysynth::Module<float>> module =
+      std::make_unique<DSPModule>(create_dsp(type));
+  if (!engine.sendAddModule(voice.name, module)) {
+    std::fprintf(stderr, "Command queue full, voice not added\n");
+    return;
   }
-  if (jack_activate(client)) {
-    jack_client_close(client);
-    throw std::runtime_error("Failed to activate JACK client");
+  for (unsigned int port = 0; port < NUM_OUTPUTS; ++port) {
+    engine.sendConnectOutput(voice.name, 0, port);
   }
+  voices.push_back(std::move(voice));
 }
 
-JackClient::~JackClient() {
-  if (client) {
-    jack_client_close(client);
+void remove_voice(tinysynth::GraphProcessor &engine,
+                  std::vector<Voice> &voices) {
+  // The module's output routes go with it
+  if (engine.sendRemoveModule(voices.back().name)) {
+    voices.pop_back();
   }
 }
 
-int JackClient::process(jack_nframes_t nframes, void *arg) {
-  auto *self = static_cast<JackClient *>(arg);
-  self->process_audio(nframes);
-  return 0;
+void render_voice_gui(tinysynth::GraphProcessor &engine, Voice &voice) {
+  ImGui::Begin(voice.name.c_str());
+  ImGui::Text("Simple DSP");
+  if (ImGui::SliderFloat("Frequency", &voice.frequency, 20.0f, 2000.0f)) {
+    engine.sendSetParameter(voice.name, "frequency", voice.frequency);
+  }
+  ImGui::End();
 }
 
-void JackClient::jack_shutdown(void *arg) { /* Add necessary cleanup here */ }
-
-void JackClient::process_audio(jack_nframes_t nframes) {
-  double sample_rate = jack_get_sample_rate(client);
-  auto *out = static_cast<jack_default_audio_sample_t *>(
-      jack_port_get_buffer(output_port, nframes));
-  dsp->process_audio(nframes, out, sample_rate);
-}
+int main(int argc, char **argv) {
+  // --lock-memory [--rt-arena-mb N]: lock memory and prefault a realtime
+  // arena before anything the audio thread touches is created
+  tinysynth::RealtimeMemory::Config memoryConfig;
+  bool lockMemory = false;
+  // --osc-port N: UDP port of the OSC server, 0 to disable it
+  int oscPort = tinysynth::OscServer::DEFAULT_PORT;
+  // --shm NAME: publish meters and node status to, and read control buses
+  // from, the shared-memory segment NAME ("/tinysynth")
+  std::string shmName;
+  // --pipelined [--pipeline-cpu N]: render the engine one period ahead on
+  // its own realtime thread, optionally pinned to core N, for a period of
+  // added latency
+  bool pipelined = false;
+  tinysynth::PipelinedProcessor::Config pipelineConfig;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--lock-memory") {
+      lockMemory = true;
+    } else if (arg == "--rt-arena-mb" && i + 1 < argc) {
+      memoryConfig.arenaBytes = std::stoul(argv[++i]) << 20;
+    } else if (arg == "--osc-port" && i + 1 < argc) {
+      oscPort = std::stoi(argv[++i]);
+    } else if (arg == "--shm" && i + 1 < argc) {
+      shmName = argv[++i];
+    } else if (arg == "--pipelined") {
+      pipelined = true;
+    } else if (arg == "--pipeline-cpu" && i + 1 < argc) {
+      pipelineConfig.cpu = std::stoi(argv[++i]);
+    }
+  }
+  if (lockMemory) {
+    try {
+      tinysynth::RealtimeMemory::initialise(memoryConfig);
+    } catch (const std::runtime_error &error) {
+      std::fprintf(stderr, "%s\n", error.what());
+      return 1;
+    }
+  }
 
-void render_client_gui(JackClient *client) {
-  ImGui::Begin(client->get_name());
-  ImGui::Text("Simple DSP");
-  if (ImGui::SliderFloat("Frequency", &client->get_frequency(), 20.0f,
-                         2000.0f)) {
-    if (auto sin_osc = dynamic_cast<SinOsc *>(client->get_dsp())) {
-      sin_osc->set_frequency(static_cast<double>(client->get_frequency()));
-    } else if (auto square_wave =
-                   dynamic_cast<SquareWave *>(client->get_dsp())) {
-      square_wave->set_frequency(static_cast<double>(client->get_frequency()));
-    } else if (auto saw_wave = dynamic_cast<SawWave *>(client->get_dsp())) {
-      saw_wave->set_frequency(static_cast<double>(client->get_frequency()));
+  // Declared first, so they outlive the engine: it publishes into the
+  // shared state, and its SynthDef nodes run code the JIT owns
+  std::unique_ptr<tinysynth::SharedEngineState> sharedState;
+  tinysynth::SynthDefJIT jit;
+  tinysynth::GraphProcessor engine(0, NUM_OUTPUTS);
+  std::unique_ptr<tinysynth::PipelinedProcessor> pipeline;
+  if (pipelined) {
+    pipeline = std::make_unique<tinysynth::PipelinedProcessor>(
+        engine, 0, NUM_OUTPUTS, pipelineConfig);
+  }
+  tinysynth::JackClient backend("TinySynth", 0, NUM_OUTPUTS);
+  if (!shmName.empty()) {
+    try {
+      sharedState = tinysynth::SharedEngineState::create(
+          shmName, backend.getSampleRate(), NUM_OUTPUTS);
+      engine.setSharedState(sharedState.get());
+      std::printf("Engine state shared as %s\n", shmName.c_str());
+    } catch (const std::runtime_error &error) {
+      std::fprintf(stderr, "Shared engine state disabled: %s\n",
+                   error.what());
     }
   }
-  ImGui::End();
-}
+  if (pipeline) {
+    backend.start(*pipeline);
+    std::printf("Pipelined: %u frames of latency\n", pipeline->getLatency());
+  } else {
+    backend.start(engine);
+  }
+  if (lockMemory) {
+    std::printf("%s\n", tinysynth::RealtimeMemory::describeUsage().c_str());
+  }
 
-int main(int, char **) {
-  std::vector<std::unique_ptr<JackClient>> jack_clients;
+  // The GUI's DSP types are OSC defs too, next to SynthDefs sent with /d_recv
+  std::unique_ptr<tinysynth::OscServer> oscServer;
+  if (oscPort > 0) {
+    tinysynth::OscServer::Config oscConfig;
+    oscConfig.port = static_cast<std::uint16_t>(oscPort);
+    oscServer = std::make_unique<tinysynth::OscServer>(engine, jit, oscConfig);
+    const std::pair<const char *, DSPType> types[] = {
+        {"SinOsc", DSPType::SinOsc},
+        {"SquareWave", DSPType::SquareWave},
+        {"SawWave", DSPType::SawWave}};
+    for (const auto &[name, type] : types) {
+      oscServer->registerModule(name, [type = type] {
+        return std::make_unique<DSPModule>(create_dsp(type));
+      });
+    }
+    try {
+      oscServer->start();
+      std::printf("OSC server on UDP port %u\n", oscServer->getPort());
+    } catch (const std::runtime_error &error) {
+      std::fprintf(stderr, "OSC server disabled: %s\n", error.what());
+      oscServer.reset();
+    }
+  }
+  // Stops command traffic, then the audio thread, before anything either
+  // of them uses is destroyed
+  auto shutdown = [&] {
+    oscServer.reset();
+    backend.stop();
+  };
+  std::vector<Voice> voices;
   DSPType selected_dsp_type = DSPType::SinOsc; // Default DSP type
 
   glfwSetErrorCallback(glfw_error_callback);
   if (!glfwInit()) {
     std::fprintf(stderr, "Failed to initialize GLFW\n");
+    shutdown();
     return -1;
   }
 
@@ -242,6 +347,7 @@ int main(int, char **) {
       glfwCreateWindow(1280, 720, "Prototype", nullptr, nullptr);
   if (!window) {
     glfwTerminate();
+    shutdown();
     return -1;
   }
 
@@ -261,15 +367,15 @@ int main(int, char **) {
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
-    // Add buttons to add/remove JackClients
-    if (ImGui::Button("Add JackClient")) {
-      static int client_count = 1;
-      std::string client_name = "DearJack" + std::to_string(client_count++);
-      jack_clients.push_back(std::make_unique<JackClient>(
-          client_name.c_str(), create_dsp(selected_dsp_type)));
+    // Frees removed voices off the audio thread
+    engine.collectReplies();
+
+    // Add buttons to add/remove voices
+    if (ImGui::Button("Add Voice")) {
+      add_voice(engine, voices, selected_dsp_type);
     }
-    if (ImGui::Button("Remove Last JackClient") && !jack_clients.empty()) {
-      jack_clients.pop_back();
+    if (ImGui::Button("Remove Last Voice") && !voices.empty()) {
+      remove_voice(engine, voices);
     }
 
     // Dropdown to select DSP type
@@ -280,9 +386,9 @@ int main(int, char **) {
       selected_dsp_type = static_cast<DSPType>(current_dsp_type);
     }
 
-    // Render GUI for each JackClient
-    for (auto &client : jack_clients) {
-      render_client_gui(client.get());
+    // Render GUI for each voice
+    for (auto &voice : voices) {
+      render_voice_gui(engine, voice);
     }
 
     ImGui::Render();
@@ -302,5 +408,6 @@ int main(int, char **) {
   glfwDestroyWindow(window);
   glfwTerminate();
 
+  shutdown();
   return 0;
 }
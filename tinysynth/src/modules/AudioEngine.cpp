@@ -1,6 +1,6 @@
 #include "AudioEngine.h"
 namespace tinysynth {
 
-unsigned int AudioEngine::s_sampleRate = 96000; 
+std::atomic<unsigned int> AudioEngine::m_sampleRate{96000};
 
 }
\ No newline at end of file
@@ -1,20 +1,23 @@
 #ifndef AUDIO_ENGINE_H
 #define AUDIO_ENGINE_H
 
+#include <atomic>
+
 namespace tinysynth {
 
 class AudioEngine {
 public:
     static void setSampleRate(unsigned int sampleRate) {
-        m_sampleRate = sampleRate;
+        m_sampleRate.store(sampleRate, std::memory_order_relaxed);
     }
 
     static unsigned int getSampleRate() {
-        return m_sampleRate;
+        return m_sampleRate.load(std::memory_order_relaxed);
     }
 
 private:
-    static unsigned int m_sampleRate;
+    // Written by prepare() on control threads while voices read it
+    static std::atomic<unsigned int> m_sampleRate;
 };
 
 } // namespace tinysynth
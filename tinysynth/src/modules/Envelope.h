@@ -0,0 +1,63 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+// Per-sample ADSR math shared by EnvelopeModule and the ADSR UGen kernel.
+// Segments are linear; a rising gate (re)starts the attack from the current
+// level and a falling one releases from wherever the envelope is.
+
+namespace tinysynth {
+namespace detail {
+
+// Stages, kept as floats so the kernel can hold them in its state slots
+constexpr float ENVELOPE_IDLE = 0.0F;
+constexpr float ENVELOPE_ATTACK = 1.0F;
+constexpr float ENVELOPE_DECAY = 2.0F;
+constexpr float ENVELOPE_SUSTAIN = 3.0F;
+constexpr float ENVELOPE_RELEASE = 4.0F;
+
+/** Segment times are in seconds; a time <= 0 jumps straight to its target */
+template <typename sample_type>
+inline sample_type envelopeComputeSample(const sample_type gate, const sample_type attack,
+                                         const sample_type decay, const sample_type sustain,
+                                         const sample_type release,
+                                         const sample_type sampleRate, sample_type &level,
+                                         sample_type &stage, sample_type &lastGate,
+                                         sample_type &releaseStep) {
+    const sample_type zero(0);
+    const sample_type one(1);
+    if (gate > zero && lastGate <= zero) {
+        stage = ENVELOPE_ATTACK;
+    } else if (gate <= zero && lastGate > zero) {
+        stage = ENVELOPE_RELEASE;
+        releaseStep = release > zero ? level / (release * sampleRate) : level;
+    }
+    lastGate = gate;
+
+    if (stage == ENVELOPE_ATTACK) {
+        level += attack > zero ? one / (attack * sampleRate) : one;
+        if (level >= one) {
+            level = one;
+            stage = ENVELOPE_DECAY;
+        }
+    } else if (stage == ENVELOPE_DECAY) {
+        level -= decay > zero ? (one - sustain) / (decay * sampleRate) : one;
+        if (level <= sustain) {
+            level = sustain;
+            stage = ENVELOPE_SUSTAIN;
+        }
+    } else if (stage == ENVELOPE_SUSTAIN) {
+        level = sustain;
+    } else if (stage == ENVELOPE_RELEASE) {
+        level -= releaseStep;
+        if (level <= zero) {
+            level = zero;
+            stage = ENVELOPE_IDLE;
+        }
+    }
+    return level;
+}
+
+} // namespace detail
+} // namespace tinysynth
+
+#endif // ENVELOPE_H
@@ -0,0 +1,111 @@
+#ifndef ENVELOPE_MODULE_H
+#define ENVELOPE_MODULE_H
+
+#include "../core/Module.h"
+#include "AudioEngine.h"
+#include "Envelope.h"
+#include <array>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// Linear ADSR envelope. Each parameter has an input of the same name that
+// overrides it sample by sample, as a wire does in a SynthDef; the math is
+// in Envelope.h, shared with the ADSR kernel.
+template <typename sample_type>
+class EnvelopeModule : public Module<sample_type> {
+public:
+    static constexpr unsigned int NUM_CONTROLS = 5;
+
+    void setParameter(const std::string& name, sample_type value) override {
+        m_values[indexOf(name)] = value;
+    }
+
+    [[nodiscard]] float getParameter(const std::string& name) const override {
+        return static_cast<float>(m_values[indexOf(name)]);
+    }
+
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override {
+        return {"gate", "attack", "decay", "sustain", "release"};
+    }
+
+    [[nodiscard]] std::string getInputName(unsigned int index) const override {
+        return index < NUM_CONTROLS ? getParameterNames()[index] : "";
+    }
+
+    [[nodiscard]] std::string getOutputName(unsigned int index) const override {
+        return (index == 0) ? "output" : "";
+    }
+
+    [[nodiscard]] unsigned int getNumInputs() const override { return NUM_CONTROLS; }
+
+    [[nodiscard]] unsigned int getNumOutputs() const override { return 1; }
+
+    void process(const std::vector<std::optional<sample_type *>> &inputs,
+                 std::vector<sample_type *> &outputs, unsigned int numFrames) override {
+        if (outputs.empty()) {
+            return;
+        }
+        std::array<const sample_type *, NUM_CONTROLS> controls{};
+        for (unsigned int k = 0; k < NUM_CONTROLS && k < inputs.size(); ++k) {
+            controls[k] = inputs[k] ? *inputs[k] : nullptr;
+        }
+        auto value = [&](unsigned int k, unsigned int i) {
+            return controls[k] != nullptr ? controls[k][i] : m_values[k];
+        };
+        const auto sampleRate = static_cast<sample_type>(m_sampleRate);
+        sample_type *output = outputs[0];
+        for (unsigned int i = 0; i < numFrames; ++i) {
+            output[i] = detail::envelopeComputeSample(value(0, i), value(1, i), value(2, i),
+                                                      value(3, i), value(4, i), sampleRate,
+                                                      m_level, m_stage, m_lastGate,
+                                                      m_releaseStep);
+        }
+    }
+
+    [[nodiscard]] std::string getName() const override { return "ADSR Envelope"; }
+
+    [[nodiscard]] std::string getDescription() const override {
+        return "A linear attack-decay-sustain-release envelope";
+    }
+
+    [[nodiscard]] std::unique_ptr<Module<sample_type>> clone() const override {
+        return std::make_unique<EnvelopeModule>(*this);
+    }
+
+    void reset() override {
+        m_level = 0;
+        m_stage = detail::ENVELOPE_IDLE;
+        m_lastGate = 0;
+        m_releaseStep = 0;
+    }
+
+    void prepare(unsigned int sampleRate) override { m_sampleRate = sampleRate; }
+
+private:
+    [[nodiscard]] unsigned int indexOf(const std::string& name) const {
+        const auto names = getParameterNames();
+        for (unsigned int k = 0; k < NUM_CONTROLS; ++k) {
+            if (names[k] == name) {
+                return k;
+            }
+        }
+        throw std::invalid_argument("Unknown parameter: " + name);
+    }
+
+    // gate, attack, decay, sustain, release
+    std::array<sample_type, NUM_CONTROLS> m_values{1.0F, 0.01F, 0.3F, 0.5F, 1.0F};
+    sample_type m_level{0};
+    sample_type m_stage{detail::ENVELOPE_IDLE};
+    sample_type m_lastGate{0};
+    sample_type m_releaseStep{0};
+    unsigned int m_sampleRate{AudioEngine::getSampleRate()};
+};
+
+} // namespace tinysynth
+
+#endif // ENVELOPE_MODULE_H
@@ -0,0 +1,209 @@
+#ifndef FILTER_MODULE_H
+#define FILTER_MODULE_H
+
+#include "../core/Module.h"
+#include "AudioEngine.h"
+#include "Filters.h"
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tinysynth {
+
+// One input, one output and one control, which a signal on the second input
+// overrides sample by sample, as a wire does in a SynthDef. The per-sample
+// math is in Filters.h, shared with the OnePole, Lag and LowPass kernels.
+template <typename sample_type>
+class FilterModule : public Module<sample_type> {
+public:
+    FilterModule(std::string control, sample_type value)
+        : m_control(std::move(control)), m_value(value) {}
+
+    void setParameter(const std::string& name, sample_type value) override {
+        if (name != m_control) {
+            throw std::invalid_argument("Unknown parameter: " + name);
+        }
+        m_value = value;
+    }
+
+    [[nodiscard]] float getParameter(const std::string& name) const override {
+        if (name != m_control) {
+            throw std::invalid_argument("Unknown parameter: " + name);
+        }
+        return static_cast<float>(m_value);
+    }
+
+    [[nodiscard]] std::vector<std::string> getParameterNames() const override {
+        return {m_control};
+    }
+
+    [[nodiscard]] std::string getInputName(unsigned int index) const override {
+        switch (index) {
+        case 0:
+            return "Input";
+        case 1:
+            return m_control;
+        default:
+            return "";
+        }
+    }
+
+    [[nodiscard]] std::string getOutputName(unsigned int index) const override {
+        return (index == 0) ? "output" : "";
+    }
+
+    [[nodiscard]] unsigned int getNumInputs() const override { return 2; }
+
+    [[nodiscard]] unsigned int getNumOutputs() const override { return 1; }
+
+    void prepare(unsigned int sampleRate) override { m_sampleRate = sampleRate; }
+
+    [[nodiscard]] unsigned int getSampleRate() const { return m_sampleRate; }
+
+protected:
+    // out[i] = step(in[i], control[i]); a missing input reads 0, a missing
+    // control the parameter
+    template <typename Step>
+    void processWith(const std::vector<std::optional<sample_type *>> &inputs,
+                     std::vector<sample_type *> &outputs, unsigned int numFrames, Step step) {
+        if (outputs.empty()) {
+            return;
+        }
+        const sample_type *in = !inputs.empty() && inputs[0] ? *inputs[0] : nullptr;
+        const sample_type *control = inputs.size() > 1 && inputs[1] ? *inputs[1] : nullptr;
+        sample_type *output = outputs[0];
+        for (unsigned int i = 0; i < numFrames; ++i) {
+            output[i] = step(in != nullptr ? in[i] : sample_type(0),
+                             control != nullptr ? control[i] : m_value);
+        }
+    }
+
+private:
+    std::string m_control;
+    sample_type m_value;
+    unsigned int m_sampleRate{AudioEngine::getSampleRate()};
+};
+
+// y = (1 - |coef|) * in + coef * y1
+template <typename sample_type>
+class OnePoleFilter : public FilterModule<sample_type> {
+public:
+    OnePoleFilter() : FilterModule<sample_type>("coef", sample_type(0.5)) {}
+
+    void process(const std::vector<std::optional<sample_type *>> &inputs,
+                 std::vector<sample_type *> &outputs, unsigned int numFrames) override {
+        this->processWith(inputs, outputs, numFrames, [this](sample_type in, sample_type coef) {
+            return detail::onePoleComputeSample(in, coef, m_y1);
+        });
+    }
+
+    [[nodiscard]] std::string getName() const override { return "One Pole"; }
+
+    [[nodiscard]] std::string getDescription() const override {
+        return "A one-pole filter with a signed coefficient";
+    }
+
+    [[nodiscard]] std::unique_ptr<Module<sample_type>> clone() const override {
+        return std::make_unique<OnePoleFilter>(*this);
+    }
+
+    void reset() override { m_y1 = 0; }
+
+private:
+    sample_type m_y1{0};
+};
+
+// Exponential lag reaching 60 dB of a step in lagTime seconds
+template <typename sample_type>
+class LagFilter : public FilterModule<sample_type> {
+public:
+    LagFilter() : FilterModule<sample_type>("lagTime", sample_type(0.1)) {}
+
+    void process(const std::vector<std::optional<sample_type *>> &inputs,
+                 std::vector<sample_type *> &outputs, unsigned int numFrames) override {
+        const auto sampleRate = static_cast<sample_type>(this->getSampleRate());
+        this->processWith(inputs, outputs, numFrames,
+                          [this, sampleRate](sample_type in, sample_type lagTime) {
+                              if (lagTime != m_lagTime) {
+                                  m_lagTime = lagTime;
+                                  m_coef = detail::lagCoefficient(lagTime, sampleRate);
+                              }
+                              return detail::lagComputeSample(in, m_coef, m_y1);
+                          });
+    }
+
+    [[nodiscard]] std::string getName() const override { return "Lag"; }
+
+    [[nodiscard]] std::string getDescription() const override {
+        return "An exponential lag for smoothing controls";
+    }
+
+    [[nodiscard]] std::unique_ptr<Module<sample_type>> clone() const override {
+        return std::make_unique<LagFilter>(*this);
+    }
+
+    void reset() override {
+        m_y1 = 0;
+        m_lagTime = 0;
+        m_coef = 0;
+    }
+
+private:
+    sample_type m_y1{0};
+    sample_type m_lagTime{0};
+    sample_type m_coef{0};
+};
+
+// Second-order Butterworth lowpass; coefficients follow the cutoff only
+// when it changes
+template <typename sample_type>
+class LowPassFilter : public FilterModule<sample_type> {
+public:
+    LowPassFilter() : FilterModule<sample_type>("frequency", sample_type(440)) {}
+
+    void process(const std::vector<std::optional<sample_type *>> &inputs,
+                 std::vector<sample_type *> &outputs, unsigned int numFrames) override {
+        const auto sampleRate = static_cast<sample_type>(this->getSampleRate());
+        this->processWith(inputs, outputs, numFrames,
+                          [this, sampleRate](sample_type in, sample_type frequency) {
+                              frequency = detail::lowPassClamp(frequency, sampleRate);
+                              if (frequency != m_frequency) {
+                                  m_frequency = frequency;
+                                  detail::lowPassCoefficients(frequency, sampleRate, m_a0,
+                                                              m_b1, m_b2);
+                              }
+                              return detail::lowPassComputeSample(in, m_a0, m_b1, m_b2, m_y1,
+                                                                  m_y2);
+                          });
+    }
+
+    [[nodiscard]] std::string getName() const override { return "Low Pass"; }
+
+    [[nodiscard]] std::string getDescription() const override {
+        return "A second-order Butterworth lowpass filter";
+    }
+
+    [[nodiscard]] std::unique_ptr<Module<sample_type>> clone() const override {
+        return std::make_unique<LowPassFilter>(*this);
+    }
+
+    void reset() override {
+        m_y1 = 0;
+        m_y2 = 0;
+        m_frequency = 0;
+    }
+
+private:
+    sample_type m_y1{0};
+    sample_type m_y2{0};
+    sample_type m_frequency{0};
+    sample_type m_a0{0};
+    sample_type m_b1{0};
+    sample_type m_b2{0};
+};
+
+} // namespace tinysynth
+
+#endif // FILTER_MODULE_H
@@ -0,0 +1,72 @@
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <cmath>
+
+// Per-sample filter math shared by the filter modules and the UGen kernels,
+// so a SynthDef plays what the equivalent ModularSystem plays. Kept free of
+// the Module machinery: the kernels are compiled without exceptions.
+
+namespace tinysynth {
+namespace detail {
+
+constexpr float FILTER_LOG001 = -6.9077552789821368F; // log(0.001)
+constexpr float FILTER_PI = 3.14159265358979323846F;
+constexpr float FILTER_SQRT2 = 1.41421356237309504880F;
+
+/** y = (1 - |coef|) * in + coef * y1 */
+template <typename sample_type>
+inline sample_type onePoleComputeSample(const sample_type in, const sample_type coef,
+                                        sample_type &y1) {
+    y1 = (sample_type(1) - std::fabs(coef)) * in + coef * y1;
+    return y1;
+}
+
+/** Coefficient of an exponential lag reaching 60 dB of a step in lagTime */
+template <typename sample_type>
+inline sample_type lagCoefficient(const sample_type lagTime, const sample_type sampleRate) {
+    return lagTime <= sample_type(0)
+               ? sample_type(0)
+               : std::exp(sample_type(FILTER_LOG001) / (lagTime * sampleRate));
+}
+
+template <typename sample_type>
+inline sample_type lagComputeSample(const sample_type in, const sample_type coef,
+                                    sample_type &y1) {
+    y1 = in + coef * (y1 - in);
+    return y1;
+}
+
+/** The cutoff a lowpass can realize: [1 Hz, 0.49 * sampleRate], NaN as 1 */
+template <typename sample_type>
+inline sample_type lowPassClamp(const sample_type frequency, const sample_type sampleRate) {
+    return std::fmin(std::fmax(frequency, sample_type(1)), sampleRate * sample_type(0.49));
+}
+
+/** Second-order Butterworth coefficients for `frequency` */
+template <typename sample_type>
+inline void lowPassCoefficients(const sample_type frequency, const sample_type sampleRate,
+                                sample_type &a0, sample_type &b1, sample_type &b2) {
+    const sample_type c = sample_type(1) / std::tan(sample_type(FILTER_PI) * frequency / sampleRate);
+    const sample_type c2 = c * c;
+    const sample_type sqrt2c = c * sample_type(FILTER_SQRT2);
+    a0 = sample_type(1) / (sample_type(1) + sqrt2c + c2);
+    b1 = sample_type(-2) * (sample_type(1) - c2) * a0;
+    b2 = -(sample_type(1) - sqrt2c + c2) * a0;
+}
+
+template <typename sample_type>
+inline sample_type lowPassComputeSample(const sample_type in, const sample_type a0,
+                                        const sample_type b1, const sample_type b2,
+                                        sample_type &y1, sample_type &y2) {
+    const sample_type y0 = in + b1 * y1 + b2 * y2;
+    const sample_type out = a0 * (y0 + sample_type(2) * y1 + y2);
+    y2 = y1;
+    y1 = y0;
+    return out;
+}
+
+} // namespace detail
+} // namespace tinysynth
+
+#endif // FILTERS_H
@@ -5,6 +5,7 @@
 #include "../utils/Constants.h"
 #include "../utils/Utils.h"
 #include "AudioEngine.h"
+#include <cassert>
 #include <cmath>
 #include <immintrin.h>
 #include <memory>
@@ -13,6 +14,14 @@
 #include <string>
 #include <vector>
 
+// The vector paths below need SVML's _mm*_sin_ps and still share one phase
+// across all lanes; every other build uses the scalar loops
+#if defined(TINYSYNTH_OSCILLATOR_SVML) && defined(__AVX__)
+#define TINYSYNTH_OSCILLATOR_AVX 1
+#elif defined(TINYSYNTH_OSCILLATOR_SVML) && defined(__SSE__)
+#define TINYSYNTH_OSCILLATOR_SSE 1
+#endif
+
 namespace tinysynth {
 
 template <typename sample_type>
@@ -21,7 +30,7 @@ public:
     virtual sample_type getCurrentValue() const = 0;
 
     void setFrequency(sample_type frequency) {
-        assert(frequency > 0);
+        assert(frequency >= 0); // 0 when a modulator supplies the frequency
         m_frequency = frequency;
     }
 
@@ -86,17 +95,22 @@ public:
 
     void prepare(unsigned int sampleRate) override {
         AudioEngine::setSampleRate(sampleRate);
+        m_sampleRate = sampleRate;
     }
 
+    // Cached by prepare(), so process() reads no shared state per block
+    [[nodiscard]] unsigned int getSampleRate() const { return m_sampleRate; }
+
     sample_type getFrequency() const { return m_frequency; }
 
     sample_type getAmplitude() const { return m_amplitude; }
 
     sample_type getPhase() const { return m_phase; }
 
+    Oscillator() = default;
     virtual ~Oscillator() = default;
 
-    Oscillator(const Oscillator &) = delete;
+    Oscillator(const Oscillator &) = default; // clone() copies
     Oscillator(Oscillator &&) = delete;
     Oscillator &operator=(const Oscillator &) = delete;
     Oscillator &operator=(Oscillator &&) = delete;
@@ -105,6 +119,8 @@ private:
     sample_type m_frequency{440.0};
     sample_type m_amplitude{1.0};
     sample_type m_phase{0.0};
+    // The engine's rate until prepare() sets this one
+    unsigned int m_sampleRate{AudioEngine::getSampleRate()};
 };
 
 template <typename sample_type>
@@ -124,12 +140,12 @@ public:
         sample_type phase = this->getPhase();
         sample_type baseFrequency = this->getFrequency();
         sample_type baseAmplitude = this->getAmplitude();
-        const auto sampleRate = static_cast<sample_type>(AudioEngine::getSampleRate());
+        const auto sampleRate = static_cast<sample_type>(this->getSampleRate());
 
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
         processSIMD_AVX(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
         processSIMD_SSE(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
 #else
@@ -155,7 +171,7 @@ public:
     }
 
   private:
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
     void processSIMD_AVX(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -205,7 +221,7 @@ public:
         phaseVec = _mm256_sub_ps(phaseVec, _mm256_and_ps(twoPiVec, mask));
     }
 
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
     void processSIMD_SSE(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -332,12 +348,12 @@ public:
         sample_type phase = this->getPhase();
         sample_type baseFrequency = this->getFrequency();
         sample_type baseAmplitude = this->getAmplitude();
-        const auto sampleRate = static_cast<sample_type>(AudioEngine::getSampleRate());
+        const auto sampleRate = static_cast<sample_type>(this->getSampleRate());
 
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
         processSIMD_AVX(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
         processSIMD_SSE(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
 #else
@@ -364,7 +380,7 @@ public:
     }
 
   private:
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
     void processSIMD_AVX(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -415,7 +431,7 @@ public:
         phaseVec = _mm256_sub_ps(phaseVec, _mm256_and_ps(twoPiVec, mask));
     }
 
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
     void processSIMD_SSE(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -544,12 +560,12 @@ public:
         sample_type phase = this->getPhase();
         sample_type baseFrequency = this->getFrequency();
         sample_type baseAmplitude = this->getAmplitude();
-        const auto sampleRate = static_cast<sample_type>(AudioEngine::getSampleRate());
+        const auto sampleRate = static_cast<sample_type>(this->getSampleRate());
 
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
         processSIMD_AVX(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
         processSIMD_SSE(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
 #else
@@ -579,7 +595,7 @@ public:
     }
 
   private:
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
     void processSIMD_AVX(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -636,7 +652,7 @@ public:
         phaseVec = _mm256_sub_ps(phaseVec, _mm256_and_ps(twoPiVec, mask));
     }
 
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
     void processSIMD_SSE(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -775,12 +791,12 @@ public:
         sample_type phase = this->getPhase();
         sample_type baseFrequency = this->getFrequency();
         sample_type baseAmplitude = this->getAmplitude();
-        const auto sampleRate = static_cast<sample_type>(AudioEngine::getSampleRate());
+        const auto sampleRate = static_cast<sample_type>(this->getSampleRate());
 
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
         processSIMD_AVX(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
         processSIMD_SSE(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
 #else
@@ -807,7 +823,7 @@ public:
     }
 
 private:
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
     void processSIMD_AVX(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -861,7 +877,7 @@ private:
         phaseVec = _mm256_sub_ps(phaseVec, _mm256_and_ps(twoPiVec, mask));
     }
 
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
     void processSIMD_SSE(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -992,12 +1008,12 @@ public:
         sample_type phase = this->getPhase();
         sample_type baseFrequency = this->getFrequency();
         sample_type baseAmplitude = this->getAmplitude();
-        const auto sampleRate = static_cast<sample_type>(AudioEngine::getSampleRate());
+        const auto sampleRate = static_cast<sample_type>(this->getSampleRate());
 
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
         processSIMD_AVX(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
         processSIMD_SSE(output, freqMod, ampMod, phase, baseFrequency, baseAmplitude,
                         sampleRate, numFrames);
 #else
@@ -1024,7 +1040,7 @@ public:
     }
 
 private:
-#if defined(__AVX__)
+#if defined(TINYSYNTH_OSCILLATOR_AVX)
     void processSIMD_AVX(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -1077,7 +1093,7 @@ private:
         phaseVec = _mm256_sub_ps(phaseVec, _mm256_and_ps(twoPiVec, mask));
     }
 
-#elif defined(__SSE__)
+#elif defined(TINYSYNTH_OSCILLATOR_SSE)
     void processSIMD_SSE(sample_type *output, const std::optional<sample_type *> &freqMod,
                          const std::optional<sample_type *> &ampMod, sample_type &phase,
                          sample_type baseFrequency, sample_type baseAmplitude,
@@ -0,0 +1,102 @@
+// ScoreRender.cpp
+//
+// Non-realtime render of a binary OSC score (scsynth -N style):
+//   score_render <score.osc> -o <out.wav> [--input <in.wav>] [--rate SR]
+//                [--block N] [--channels N] [--inputs N]
+//                [--synthdefs <file.scsyndef>]... [--rf64]
+// The score's /s_new can name SynthDefs it sends with /d_recv, those of
+// --synthdefs files, or the built-in oscillator modules SineOsc, SawOsc,
+// TriangleOsc, SquareOsc and PulseOsc.
+#include "core/NrtRenderer.h"
+#include "core/SynthDefLoader.h"
+#include "modules/Oscillator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+int usage() {
+  std::fprintf(stderr,
+               "usage: score_render <score.osc> -o <out.wav> [--input <in.wav>] "
+               "[--rate SR] [--block N] [--channels N] [--inputs N] "
+               "[--synthdefs <file.scsyndef>]... [--rf64]\n");
+  return 2;
+}
+
+template <typename Oscillator> void addOscillator(tinysynth::OscServer &server,
+                                                  const std::string &name) {
+  server.registerModule(name, [] { return std::make_unique<Oscillator>(); });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  tinysynth::NrtRenderer::Config config;
+  unsigned int numInputs = 0;
+  unsigned int numOutputs = 2;
+  std::vector<std::string> synthDefFiles;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "-o" && hasValue) {
+      config.outputPath = argv[++i];
+    } else if (arg == "--input" && hasValue) {
+      config.inputPath = argv[++i];
+    } else if (arg == "--rate" && hasValue) {
+      config.sampleRate = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--block" && hasValue) {
+      config.blockSize = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--channels" && hasValue) {
+      numOutputs = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--inputs" && hasValue) {
+      numInputs = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--synthdefs" && hasValue) {
+      synthDefFiles.emplace_back(argv[++i]);
+    } else if (arg == "--rf64") {
+      config.format = tinysynth::AudioFileFormat::RF64;
+    } else if (arg[0] != '-' && config.scorePath.empty()) {
+      config.scorePath = arg;
+    } else {
+      return usage();
+    }
+  }
+  if (config.scorePath.empty() || config.outputPath.empty()) {
+    return usage();
+  }
+
+  try {
+    tinysynth::GraphProcessor engine(numInputs, numOutputs);
+    tinysynth::SynthDefJIT jit;
+    tinysynth::OscServer server(engine, jit);
+    addOscillator<tinysynth::SineOsc<float>>(server, "SineOsc");
+    addOscillator<tinysynth::SawOsc<float>>(server, "SawOsc");
+    addOscillator<tinysynth::TriangleOsc<float>>(server, "TriangleOsc");
+    addOscillator<tinysynth::SquareOsc<float>>(server, "SquareOsc");
+    addOscillator<tinysynth::PulseOsc<float>>(server, "PulseOsc");
+    tinysynth::SynthDefLoader loader;
+    for (const auto &file : synthDefFiles) {
+      for (const auto &loaded : loader.loadFile(file)) {
+        server.addSynthDef(loaded.synthDef);
+      }
+    }
+
+    tinysynth::NrtRenderer renderer(engine, server, config);
+    const tinysynth::NrtRenderStats stats = renderer.render();
+    std::printf("%s: %llu bundles, %.2f s of audio in %.3f s, %.1fx realtime",
+                config.scorePath.c_str(),
+                static_cast<unsigned long long>(stats.bundles),
+                static_cast<double>(stats.frames) / config.sampleRate,
+                stats.wallSeconds, stats.realtimeFactor);
+    std::printf(", %llu failed, %llu late\n",
+                static_cast<unsigned long long>(stats.failed),
+                static_cast<unsigned long long>(stats.late));
+    return stats.failed == 0 ? 0 : 1;
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "score_render: %s\n", e.what());
+    return 1;
+  }
+}
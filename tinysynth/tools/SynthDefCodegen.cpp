@@ -0,0 +1,76 @@
+// SynthDefCodegen.cpp
+//
+// Ahead-of-time SynthDef compiler:
+//   synthdef_codegen <file.scsyndef> [--synthdef NAME] -o <out.cpp>
+// Writes the SynthDefs of the file (or only NAME) as a C++ source file
+// exporting the C ABI of core/TinySynthAOT.h.
+#include "core/SynthDefCodeGenerator.h"
+#include "core/SynthDefLoader.h"
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int usage() {
+  std::fprintf(stderr, "usage: synthdef_codegen <file.scsyndef> "
+                       "[--synthdef NAME] -o <out.cpp>\n");
+  return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string input;
+  std::string output;
+  std::string only;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (std::strcmp(argv[i], "--synthdef") == 0 && i + 1 < argc) {
+      only = argv[++i];
+    } else if (argv[i][0] != '-' && input.empty()) {
+      input = argv[i];
+    } else {
+      return usage();
+    }
+  }
+  if (input.empty() || output.empty()) {
+    return usage();
+  }
+
+  try {
+    tinysynth::SynthDefLoader loader;
+    std::vector<tinysynth::SynthDef> synthDefs;
+    for (auto &loaded : loader.loadFile(input)) {
+      if (!only.empty() && loaded.synthDef.getName() != only) {
+        continue;
+      }
+      for (const auto &ugen : loaded.unsupported) {
+        std::fprintf(stderr, "%s: dropped unsupported %s\n",
+                     loaded.synthDef.getName().c_str(), ugen.c_str());
+      }
+      synthDefs.push_back(std::move(loaded.synthDef));
+    }
+    if (synthDefs.empty()) {
+      std::fprintf(stderr, "%s: no matching SynthDef\n", input.c_str());
+      return 1;
+    }
+
+    const std::string source =
+        tinysynth::SynthDefCodeGenerator().generate(synthDefs);
+    std::ofstream file(output, std::ios::binary);
+    file << source;
+    if (!file) {
+      std::fprintf(stderr, "%s: write failed\n", output.c_str());
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "synthdef_codegen: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}